@@ -1,55 +1,58 @@
-#include "bmp280.h"
+#include "BMP280.h"
 #include <stdlib.h>
-#include <pico/stdlib.h>
-#include "hardware/i2c.h"
+#include "hal.h"
+#include "log.h"
+#include "trace.h"
 #include <stdio.h>
+#include <string.h>
 
-// Define I2C instance and address
-static i2c_inst_t *i2c_instance;
-static uint8_t i2c_addr;
-
-static void bmp280_write_reg(const uint8_t reg, const uint32_t size, const uint8_t* src) {
+static bool bmp280_write_reg(const bmp280* device, const uint8_t reg, const uint32_t size, const uint8_t* src) {
     uint8_t* buff = (uint8_t*)calloc(size + 1, 1);
     if (buff == NULL) {
-        printf("Memory allocation failed in bmp280_write_reg\n");
-        return; // Error handling
+        LOG_ERROR("Memory allocation failed in bmp280_write_reg\n");
+        return false; // Error handling
     }
     buff[0] = reg;
     for (uint32_t i = 0; i < size; i++) {
         buff[i + 1] = src[i];
     }
-    int result = i2c_write_blocking(i2c_instance, i2c_addr, buff, size + 1, false);
+    int result = hal_i2c_write(device->i2c_instance, device->i2c_addr, buff, size + 1, false);
     if (result < 0) {
-        printf("I2C write failed in bmp280_write_reg\n");
+        LOG_WARN("I2C write failed in bmp280_write_reg\n");
     }
     free(buff);
+    return result >= 0;
 }
 
-static void bmp280_read_reg(const uint8_t reg, const uint32_t size, uint8_t* dst) {
-    
-    sleep_ms(20);
-    int result = i2c_write_blocking(i2c_instance, i2c_addr, &reg, 1, false);
+// Register reads need no settling delay: the pointer write and the read
+// back are a single repeated-start transaction.
+static bool bmp280_read_reg(const bmp280* device, const uint8_t reg, const uint32_t size, uint8_t* dst) {
+    TRACE_BEGIN(TRACE_BMP280_READ, reg);
+    int result = hal_i2c_write(device->i2c_instance, device->i2c_addr, &reg, 1, true);
     if (result < 0) {
-        printf("I2C write failed in bmp280_read_reg\n");
-        return;
+        TRACE_END(TRACE_BMP280_READ, result);
+        LOG_WARN("I2C write failed in bmp280_read_reg\n");
+        return false;
     }
-    sleep_ms(20);
 
-    result = i2c_read_blocking(i2c_instance, i2c_addr, dst, size, false);
+    result = hal_i2c_read(device->i2c_instance, device->i2c_addr, dst, size, false);
+    TRACE_END(TRACE_BMP280_READ, result);
     if (result < 0) {
-        printf("I2C read failed in bmp280_read_reg\n");
+        LOG_WARN("I2C read failed in bmp280_read_reg\n");
+        return false;
     }
+    return true;
 }
 
-int bmp280_init(i2c_inst_t *i2c_instance_param, uint8_t i2c_addr_param) {
-    i2c_instance = i2c_instance_param;
-    i2c_addr = i2c_addr_param;
+int bmp280_init(bmp280* device, HalI2cBus *i2c_instance, uint8_t i2c_addr) {
+    device->i2c_instance = i2c_instance;
+    device->i2c_addr = i2c_addr;
 
-    sleep_ms(20);
+    hal_sleep_ms(20);
     printf("BMP280 connected, initializing...\n");
 
-    uint8_t chip_ID;
-    bmp280_read_reg(BMP280_CHIP_ID_REG, 1, &chip_ID);
+    uint8_t chip_ID = 0;
+    bmp280_read_reg(device, BMP280_CHIP_ID_REG, 1, &chip_ID);
     if (chip_ID != BMP280_CHIP_ID) {
         printf("BMP280 chip ID mismatch: expected 0x%02x, got 0x%02x\n", BMP280_CHIP_ID, chip_ID);
         return -1;
@@ -57,20 +60,19 @@ int bmp280_init(i2c_inst_t *i2c_instance_param, uint8_t i2c_addr_param) {
     
     // Reset registers
     uint8_t reset_val = BMP280_RESET_VAL;
-    bmp280_write_reg(BMP280_RESET_REG, 1, &reset_val);
-    sleep_ms(10);
+    bmp280_write_reg(device, BMP280_RESET_REG, 1, &reset_val);
+    hal_sleep_ms(10);
 
-    // Power control
-    uint8_t ctl_data = (((BMP280_OVERSCAN_X2 << 3) | BMP280_OVERSCAN_X16) << 2) | BMP280_MODE_NORMAL;
-    bmp280_write_reg(BMP280_POWER_CTL_REG, 1, &ctl_data);
-    sleep_ms(10);
+    // Power control, conversions are started on demand in forced mode
+    uint8_t ctl_data = BMP280_CTRL_MEAS(BMP280_MODE_SLEEP);
+    bmp280_write_reg(device, BMP280_POWER_CTL_REG, 1, &ctl_data);
+    hal_sleep_ms(10);
 
     return 1;
 }
 
-void bmp280_calibrate(bmp280* device) {
-    bmp280_read_reg(0x88, 24, device->coefficients); // Calibration data start register
-
+// Unpack the raw calibration block into the dig_* coefficients
+static void bmp280_parse_calibration(bmp280* device) {
     // Extract calibration coefficients
     device->dig_T1 = (device->coefficients[1] << 8) | device->coefficients[0];
     device->dig_T2 = (device->coefficients[3] << 8) | device->coefficients[2];
@@ -86,52 +88,201 @@ void bmp280_calibrate(bmp280* device) {
     device->dig_P9 = (device->coefficients[23] << 8) | device->coefficients[22];
 }
 
+int bmp280_init_cached(bmp280* device, HalI2cBus *i2c_instance, uint8_t i2c_addr,
+                       const uint8_t coefficients[BMP280_CALIBRATION_SIZE]) {
+    device->i2c_instance = i2c_instance;
+    device->i2c_addr = i2c_addr;
+
+    // Right after power-on the chip may still be starting up; any later the
+    // wait is over already
+    hal_sleep_until(BMP280_STARTUP_US);
+
+    uint8_t chip_ID = 0;
+    bmp280_read_reg(device, BMP280_CHIP_ID_REG, 1, &chip_ID);
+    if (chip_ID != BMP280_CHIP_ID) {
+        printf("BMP280 chip ID mismatch: expected 0x%02x, got 0x%02x\n", BMP280_CHIP_ID, chip_ID);
+        return -1;
+    }
+
+    // Power-on leaves the chip in sleep mode, but a reboot without a power
+    // cycle may not have
+    uint8_t ctl_data = BMP280_CTRL_MEAS(BMP280_MODE_SLEEP);
+    bmp280_write_reg(device, BMP280_POWER_CTL_REG, 1, &ctl_data);
+
+    memcpy(device->coefficients, coefficients, BMP280_CALIBRATION_SIZE);
+    bmp280_parse_calibration(device);
+    return 1;
+}
+
+void bmp280_calibrate(bmp280* device) {
+    bmp280_read_reg(device, BMP280_CALIBRATION_REG, BMP280_CALIBRATION_SIZE, device->coefficients);
+    bmp280_parse_calibration(device);
+}
+
 // From Bosh documentation
 // Returns temperature in DegC, resolution is 0.01 DegC. Output value of “5123” equals 51.23 DegC.
 // t_fine carries fine temperature as global value
 
-void bmp280_read_temperature(bmp280* device) {
-    uint8_t data[3];
-    bmp280_read_reg(BMP280_TEMPERATURE_REG_LOW, 3, data);
-
-    int32_t adc_t = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
-
+static void bmp280_compensate_temperature(bmp280* device, int32_t adc_t) {
     int32_t var1, var2;
     var1 = ((((adc_t >> 3) - ((int32_t)device->dig_T1 << 1)) * 
         (int32_t)device->dig_T2) >> 11);
     var2 = (((((adc_t >> 4) - (int32_t)device->dig_T1) * ((adc_t >> 4) - 
         (int32_t)device->dig_T1)) >> 12) * (int32_t)device->dig_T3) >> 14;
     device->t_fine = var1 + var2;
-    device->temperature = (device->t_fine * 5 + 128) >> 8;
+    device->temperature_fixed = (device->t_fine * 5 + 128) >> 8;
 }
 
 // from Bosh documentation:
 // Returns pressure in Pa as unsigned 32 bit integer in Q24.8 format (24 integer bits and 8 fractional bits).
 // Output value of “24674867” represents 24674867/256 = 96386.2 Pa = 963.862 hPa
-
-void bmp280_read_pressure(bmp280* device) {
-    uint8_t data[3];
-    bmp280_read_reg(BMP280_PRESSURE_REG_LOW, 3, data);
-
-    int32_t adc_p = (data[0] << 12) | (data[1] << 4) | (data[2] >> 4);
-
+// Requires a t_fine from the same sample, so temperature has to be compensated first.
+// The M0+ has no 64 bit multiply, every int64_t product is a library call.
+// Bosch's left shifts of signed terms are written as multiplications, the
+// shift of a negative value is undefined; the compiler emits the same shift.
+uint32_t bmp280_compensate_pressure_int64(const bmp280* device, int32_t adc_p) {
     int64_t var1, var2;
     int64_t p;
     var1 = ((int64_t)device->t_fine) - 128000;
     var2 = var1 * var1 * (int64_t)device->dig_P6;
-    var2 = var2 + ((var1 * (int64_t)device->dig_P5) << 17);
-    var2 = var2 + ((int64_t)device->dig_P4 << 35);
-    var1 = ((var1 * var1 * (int64_t)device->dig_P3) >> 8) + ((var1 * (int64_t)device->dig_P2) << 12);
+    var2 = var2 + ((var1 * (int64_t)device->dig_P5) * ((int64_t)1 << 17));
+    var2 = var2 + ((int64_t)device->dig_P4 * ((int64_t)1 << 35));
+    var1 = ((var1 * var1 * (int64_t)device->dig_P3) >> 8) + ((var1 * (int64_t)device->dig_P2) * ((int64_t)1 << 12));
     var1 = ((((int64_t)1 << 47) + var1)) * ((int64_t)device->dig_P1) >> 33;
 
     if (var1 == 0) {
-        device->pressure = 0; // Avoid division by zero
-        return;
+        return 0; // Avoid division by zero
     }
 
     p = 1048576 - adc_p;
-    p = (((p << 31) - var2) * 3125) / var1;
-    var1 = ((int64_t)device->dig_P9 * (p << 31) * (p << 31)) >> 25;
+    p = (((p * ((int64_t)1 << 31)) - var2) * 3125) / var1;
+    var1 = ((int64_t)device->dig_P9 * (p >> 13) * (p >> 13)) >> 25;
     var2 = ((int64_t)device->dig_P8 * p) >> 19;
-    device->pressure = ((p + var1 + var2) >> 8) + (((int64_t)device->dig_P7) << 4); 
-}
\ No newline at end of file
+    return (uint32_t)(((p + var1 + var2) >> 8) + ((int64_t)device->dig_P7 * 16));
+}
+
+// From Bosh documentation, 32 bit only variant:
+// Returns pressure in Pa as unsigned 32 bit integer, resolution 1 Pa, shifted
+// to Q24.8 to match bmp280_compensate_pressure_int64. Its one division maps
+// onto the RP2040's hardware divider.
+uint32_t bmp280_compensate_pressure_int32(const bmp280* device, int32_t adc_p) {
+    int32_t var1, var2;
+    uint32_t p;
+    var1 = (device->t_fine >> 1) - (int32_t)64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)device->dig_P6;
+    var2 = var2 + ((var1 * (int32_t)device->dig_P5) * 2);
+    var2 = (var2 >> 2) + ((int32_t)device->dig_P4 * 65536);
+    var1 = ((((int32_t)device->dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) +
+            (((int32_t)device->dig_P2 * var1) >> 1)) >> 18;
+    var1 = ((32768 + var1) * (int32_t)device->dig_P1) >> 15;
+
+    if (var1 == 0) {
+        return 0; // Avoid division by zero
+    }
+
+    p = ((uint32_t)((int32_t)1048576 - adc_p) - (uint32_t)(var2 >> 12)) * 3125;
+    if (p < 0x80000000) {
+        p = (p << 1) / (uint32_t)var1;
+    } else {
+        p = (p / (uint32_t)var1) * 2;
+    }
+    var1 = ((int32_t)device->dig_P9 * (int32_t)(((p >> 3) * (p >> 3)) >> 13)) >> 12;
+    var2 = ((int32_t)(p >> 2) * (int32_t)device->dig_P8) >> 13;
+    p = (uint32_t)((int32_t)p + ((var1 + var2 + device->dig_P7) >> 4));
+    return p << 8;
+}
+
+static void bmp280_compensate_pressure(bmp280* device, int32_t adc_p) {
+#if BMP280_COMPENSATION_32BIT
+    device->pressure_fixed = bmp280_compensate_pressure_int32(device, adc_p);
+#else
+    device->pressure_fixed = bmp280_compensate_pressure_int64(device, adc_p);
+#endif
+}
+
+// The only float operations in the driver, skipped by the _fixed readers
+static void bmp280_update_float(bmp280* device) {
+    device->temperature = device->temperature_fixed / 100.0f;
+    device->pressure = (float)device->pressure_fixed;
+}
+
+// ADC values are 20 bit, MSB first: msb[19:12] lsb[11:4] xlsb[7:4]
+static int32_t bmp280_adc_value(const uint8_t* data) {
+    return ((int32_t)data[0] << 12) | ((int32_t)data[1] << 4) | (data[2] >> 4);
+}
+
+void bmp280_read_temperature(bmp280* device) {
+    uint8_t data[3];
+    bmp280_read_reg(device, BMP280_TEMPERATURE_REG_LOW, 3, data);
+    bmp280_compensate_temperature(device, bmp280_adc_value(data));
+    bmp280_update_float(device);
+}
+
+void bmp280_read_pressure(bmp280* device) {
+    uint8_t data[3];
+    bmp280_read_reg(device, BMP280_PRESSURE_REG_LOW, 3, data);
+    bmp280_compensate_pressure(device, bmp280_adc_value(data));
+    bmp280_update_float(device);
+}
+
+// Start a single forced conversion, the device returns to sleep mode when done.
+// Results can be read with bmp280_read_data after BMP280_MEASURE_TIME_US.
+bool bmp280_start_measurement(bmp280* device) {
+    uint8_t ctl_data = BMP280_CTRL_MEAS(BMP280_MODE_FORCED);
+    return bmp280_write_reg(device, BMP280_POWER_CTL_REG, 1, &ctl_data);
+}
+
+// Read temperature and pressure from one burst of 0xF7..0xFC. The BMP280
+// shadows the data registers while a burst read is in progress, so both
+// values are guaranteed to come from the same conversion.
+// Fills temperature_fixed and pressure_fixed only, integer math throughout.
+bool bmp280_read_data_fixed(bmp280* device) {
+    uint8_t data[BMP280_DATA_LEN];
+    if (!bmp280_read_reg(device, BMP280_PRESSURE_REG_LOW, BMP280_DATA_LEN, data)) {
+        return false;
+    }
+
+    // Temperature first, pressure compensation depends on t_fine
+    bmp280_compensate_temperature(device, bmp280_adc_value(&data[3]));
+    bmp280_compensate_pressure(device, bmp280_adc_value(&data[0]));
+    return true;
+}
+
+bool bmp280_read_data(bmp280* device) {
+    if (!bmp280_read_data_fixed(device)) {
+        return false;
+    }
+    bmp280_update_float(device);
+    return true;
+}
+
+void bmp280_start_job(const bmp280* device, I2cJob* job) {
+    uint8_t command[2] = {BMP280_POWER_CTL_REG, BMP280_CTRL_MEAS(BMP280_MODE_FORCED)};
+    i2c_job_write(job, device->i2c_addr, command, sizeof(command));
+}
+
+void bmp280_collect_job(const bmp280* device, I2cJob* job) {
+    i2c_job_write_read(job, device->i2c_addr, BMP280_PRESSURE_REG_LOW, BMP280_DATA_LEN);
+}
+
+// Compensate a burst read by bmp280_collect_job, fills the same fields as
+// bmp280_read_data_fixed
+bool bmp280_parse_job_fixed(bmp280* device, const I2cJob* job) {
+    if (job->result != job->write_length + job->read_length) {
+        LOG_WARN("I2C read failed in bmp280_parse_job\n");
+        return false;
+    }
+
+    bmp280_compensate_temperature(device, bmp280_adc_value(&job->read[3]));
+    bmp280_compensate_pressure(device, bmp280_adc_value(&job->read[0]));
+    return true;
+}
+
+// Same, fills the same fields as bmp280_read_data
+bool bmp280_parse_job(bmp280* device, const I2cJob* job) {
+    if (!bmp280_parse_job_fixed(device, job)) {
+        return false;
+    }
+    bmp280_update_float(device);
+    return true;
+}
@@ -2,26 +2,52 @@
 #define BMP280_H
 
 #include <stdint.h>
-#include "hardware/i2c.h"
-#include "pico/stdlib.h"
+#include "i2c_bus.h"
 
 #define BMP280_I2C_ADDRESS 0x76
 
 #define BMP280_CHIP_ID_REG 0xD0
 #define BMP280_CHIP_ID 0x58
 
+#define BMP280_CALIBRATION_REG 0x88 // dig_T1 .. dig_P9, little endian
+#define BMP280_CALIBRATION_SIZE 24
+
+// Power-on to first I2C access (datasheet t_startup)
+#define BMP280_STARTUP_US 2000
+
 #define BMP280_RESET_REG 0xE0
 #define BMP280_RESET_VAL 0xB6
 
 #define BMP280_POWER_CTL_REG 0xF4
 #define BMP280_OVERSCAN_X2 1
 #define BMP280_OVERSCAN_X16 2
+#define BMP280_MODE_SLEEP 0
+#define BMP280_MODE_FORCED 1
 #define BMP280_MODE_NORMAL 3
+#define BMP280_CTRL_MEAS(mode) ((((BMP280_OVERSCAN_X2 << 3) | BMP280_OVERSCAN_X16) << 2) | (mode))
+
+// Maximum forced conversion time for the oversampling set in BMP280_CTRL_MEAS
+// (datasheet: 1.25 ms + 2.3 ms * osrs_t + 2.3 ms * osrs_p + 0.575 ms)
+#define BMP280_MEASURE_TIME_US 8725
+
+// Fastest I2C clock short of high-speed mode (Fast mode)
+#define BMP280_I2C_MAX_HZ 400000
+
+// Pressure compensation kernel: 1 = Bosch 32 bit integer variant (1 Pa
+// resolution, within 6 Pa of the double formula), 0 = 64 bit variant
+// (1/256 Pa). Packets carry 0.1 hPa.
+#ifndef BMP280_COMPENSATION_32BIT
+#define BMP280_COMPENSATION_32BIT 1
+#endif
 
 #define BMP280_PRESSURE_REG_LOW 0xF7
 #define BMP280_TEMPERATURE_REG_LOW 0xFA
+#define BMP280_DATA_LEN 6 // press_msb (0xF7) .. temp_xlsb (0xFC)
 
 typedef struct {
+    HalI2cBus *i2c_instance;
+    uint8_t i2c_addr;
+
     // Calibration coefficients
     uint16_t  dig_T1;
     int16_t dig_T2;
@@ -38,16 +64,33 @@ typedef struct {
 
     // Temperature and pressure data
     int32_t t_fine;
-    float temperature; // or int32_t if you prefer integer representation
-    float pressure;    // or int32_t if you prefer integer representation
+    int32_t temperature_fixed; // 0.01 DegC
+    uint32_t pressure_fixed;   // Pa in Q24.8 format
+    float temperature; // DegC
+    float pressure;    // Pa in Q24.8 format
 
     // Raw calibration coefficients
-    uint8_t coefficients[24];
+    uint8_t coefficients[BMP280_CALIBRATION_SIZE];
 } bmp280;
 
-int bmp280_init(i2c_inst_t *i2c_instance, uint8_t i2c_addr);
+int bmp280_init(bmp280* device, HalI2cBus *i2c_instance, uint8_t i2c_addr);
+// Fast boot: chip-ID check and calibration from an earlier bmp280_calibrate,
+// no reset and no calibration read
+int bmp280_init_cached(bmp280* device, HalI2cBus *i2c_instance, uint8_t i2c_addr,
+                       const uint8_t coefficients[BMP280_CALIBRATION_SIZE]);
 void bmp280_calibrate(bmp280* device);
 void bmp280_read_pressure(bmp280* device);
 void bmp280_read_temperature(bmp280* device);
+bool bmp280_read_data(bmp280* device);
+bool bmp280_read_data_fixed(bmp280* device);
+bool bmp280_start_measurement(bmp280* device);
+// The same steps as i2c_bus.h jobs, to run alongside devices on the other bus
+void bmp280_start_job(const bmp280* device, I2cJob* job);
+void bmp280_collect_job(const bmp280* device, I2cJob* job);
+bool bmp280_parse_job(bmp280* device, const I2cJob* job);
+bool bmp280_parse_job_fixed(bmp280* device, const I2cJob* job);
+// Both kernels return Pa in Q24.8, BMP280_COMPENSATION_32BIT picks the one used
+uint32_t bmp280_compensate_pressure_int64(const bmp280* device, int32_t adc_p);
+uint32_t bmp280_compensate_pressure_int32(const bmp280* device, int32_t adc_p);
 
 #endif // BMP280_H
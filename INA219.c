@@ -1,12 +1,16 @@
-#include "ina219.h"
-#include "hardware/i2c.h"
+#include "INA219.h"
+#include "hal.h"
+#include "log.h"
+#include "trace.h"
 #include <stdio.h>
+#include <math.h>
 
 // Initialize the INA219 sensor
-bool ina219_init(INA219 *ina219, i2c_inst_t *i2c_instance, uint8_t i2c_addr) {
+bool ina219_init(INA219 *ina219, HalI2cBus *i2c_instance, uint8_t i2c_addr) {
     ina219->i2c_instance = i2c_instance;
     ina219->i2c_addr = i2c_addr;
     ina219->current_LSB = 0.0;
+    ina219->current_lsb_10na = 0;
 
     // Additional initialization steps if needed
     // Example: Configuring the INA219's calibration register, mode, etc.
@@ -14,23 +18,27 @@ bool ina219_init(INA219 *ina219, i2c_inst_t *i2c_instance, uint8_t i2c_addr) {
     return true;
 }
 
-// Read a register from INA219
-uint16_t ina219_read_register(INA219 *ina219, uint8_t reg) {
+// Read a register from INA219, false if the bus transfer failed
+bool ina219_read_register(INA219 *ina219, uint8_t reg, uint16_t *value) {
     uint8_t buf[2];
 
-    int ret = i2c_write_blocking(ina219->i2c_instance, ina219->i2c_addr, &reg, 1, true);
+    TRACE_BEGIN(TRACE_INA219_READ, reg);
+    int ret = hal_i2c_write(ina219->i2c_instance, ina219->i2c_addr, &reg, 1, true);
     if (ret != 1) {
-        printf("Failed to write reg: %d on addr: %d, ret: %d\n", reg, ina219->i2c_addr, ret);
-        return 0xFFFF;  // Return an error code
+        TRACE_END(TRACE_INA219_READ, ret);
+        LOG_WARN("Failed to write reg: %d on addr: %d, ret: %d\n", reg, ina219->i2c_addr, ret);
+        return false;
     }
     
-    ret = i2c_read_blocking(ina219->i2c_instance, ina219->i2c_addr, buf, 2, false);
+    ret = hal_i2c_read(ina219->i2c_instance, ina219->i2c_addr, buf, 2, false);
+    TRACE_END(TRACE_INA219_READ, ret);
     if (ret != 2) {
-        printf("Failed to read reg: %d on addr: %d, ret: %d\n", reg, ina219->i2c_addr, ret);
-        return 0xFFFF;  // Return an error code
+        LOG_WARN("Failed to read reg: %d on addr: %d, ret: %d\n", reg, ina219->i2c_addr, ret);
+        return false;
     }
 
-    return (buf[0] << 8) | buf[1];
+    *value = (buf[0] << 8) | buf[1];
+    return true;
 }
 
 // Write to a register in INA219
@@ -39,36 +47,168 @@ void ina219_write_register(INA219 *ina219, uint8_t reg, uint16_t value) {
     buf[0] = reg;
     buf[1] = (value >> 8) & 0xFF;
     buf[2] = value & 0xFF;
-    i2c_write_blocking(ina219->i2c_instance, ina219->i2c_addr, buf, 3, false);
+    hal_i2c_write(ina219->i2c_instance, ina219->i2c_addr, buf, 3, false);
 }
 
 // Calibrate the INA219 sensor
 void ina219_calibrate(INA219 *ina219, float shunt_resistor_value, float max_expected_amps) {
     ina219->current_LSB = max_expected_amps / 32768.0;
+    ina219->current_lsb_10na = (uint32_t)(ina219->current_LSB * 1e8 + 0.5);
     uint16_t cal_reg_value = (uint16_t)(0.04096 / (ina219->current_LSB * shunt_resistor_value));
     ina219_write_register(ina219, INA219_REG_CALIBRATION, cal_reg_value);
 }
 
-// Read voltage from the INA219 sensor
+// Read voltage from the INA219 sensor, NAN if the read failed
 float ina219_read_voltage(INA219 *ina219) {
-    uint16_t value = ina219_read_register(ina219, INA219_REG_BUSVOLTAGE);
+    uint16_t value;
+    if (!ina219_read_register(ina219, INA219_REG_BUSVOLTAGE, &value)) {
+        return NAN;
+    }
     return (value >> 3) * 0.004;
 }
 
-// Read shunt voltage from the INA219 sensor
+// Read shunt voltage from the INA219 sensor, NAN if the read failed
 float ina219_read_shunt_voltage(INA219 *ina219) {
-    int16_t value = (int16_t)ina219_read_register(ina219, INA219_REG_SHUNTVOLTAGE);
-    return value * 0.01;
+    uint16_t value;
+    if (!ina219_read_register(ina219, INA219_REG_SHUNTVOLTAGE, &value)) {
+        return NAN;
+    }
+    return (int16_t)value * 0.01;
 }
 
-// Read current from the INA219 sensor
+// Read current from the INA219 sensor, NAN if the read failed
 float ina219_read_current(INA219 *ina219) {
-    int16_t value = (int16_t)ina219_read_register(ina219, INA219_REG_CURRENT);
-    return value * ina219->current_LSB;
+    uint16_t value;
+    if (!ina219_read_register(ina219, INA219_REG_CURRENT, &value)) {
+        return NAN;
+    }
+    return (int16_t)value * ina219->current_LSB;
 }
 
-// Read power from the INA219 sensor
+// Read power from the INA219 sensor, NAN if the read failed
 float ina219_read_power(INA219 *ina219) {
-    uint16_t value = ina219_read_register(ina219, INA219_REG_POWER);
+    uint16_t value;
+    if (!ina219_read_register(ina219, INA219_REG_POWER, &value)) {
+        return NAN;
+    }
     return value * 0.02;
 }
+
+
+// Start a single shunt and bus conversion, ready after INA219_CONVERSION_TIME_US
+void ina219_start_conversion(INA219 *ina219) {
+    ina219_write_register(ina219, INA219_REG_CONFIG, INA219_CONFIG_DEFAULT | INA219_MODE_TRIGGERED);
+}
+
+// Power down between samples (~6 uA), the next triggered conversion wakes it
+void ina219_power_down(INA219 *ina219) {
+    ina219_write_register(ina219, INA219_REG_CONFIG, INA219_CONFIG_DEFAULT | INA219_MODE_POWER_DOWN);
+}
+
+// Read the result of a conversion started by ina219_start_conversion.
+// Reading the power register clears the conversion ready flag.
+bool ina219_collect_data(INA219 *ina219, float *voltage, float *current, float *power) {
+    uint16_t bus;
+    if (!ina219_read_register(ina219, INA219_REG_BUSVOLTAGE, &bus)) {
+        return false;
+    }
+    if (!(bus & INA219_BUSVOLTAGE_CNVR)) {
+        LOG_WARN("INA219 conversion not ready on addr: %d\n", ina219->i2c_addr);
+        return false;
+    }
+
+    *voltage = (bus >> 3) * 0.004;
+    *current = ina219_read_current(ina219);
+    *power = ina219_read_power(ina219);
+    return !isnan(*current) && !isnan(*power);
+}
+
+static void ina219_scale_fixed(const INA219 *ina219, uint16_t bus, uint16_t current_raw, uint16_t power_raw,
+                               int32_t *voltage_mv, int32_t *current_100ua, int32_t *power_mw) {
+    *voltage_mv = (bus >> 3) * 4;
+    int32_t current = (int16_t)current_raw * (int32_t)ina219->current_lsb_10na;
+    *current_100ua = (current + (current < 0 ? -5000 : 5000)) / 10000;
+    *power_mw = power_raw * 20;
+}
+
+// Same as ina219_collect_data with integer scaling only. The current LSB is
+// held in 10 nA, full scale stays inside 32 bits for max_expected_amps up to 21 A.
+bool ina219_collect_data_fixed(INA219 *ina219, int32_t *voltage_mv, int32_t *current_100ua, int32_t *power_mw) {
+    uint16_t bus, current_raw, power_raw;
+    if (!ina219_read_register(ina219, INA219_REG_BUSVOLTAGE, &bus)) {
+        return false;
+    }
+    if (!(bus & INA219_BUSVOLTAGE_CNVR)) {
+        LOG_WARN("INA219 conversion not ready on addr: %d\n", ina219->i2c_addr);
+        return false;
+    }
+    if (!ina219_read_register(ina219, INA219_REG_CURRENT, &current_raw) ||
+        !ina219_read_register(ina219, INA219_REG_POWER, &power_raw)) {
+        return false;
+    }
+
+    ina219_scale_fixed(ina219, bus, current_raw, power_raw, voltage_mv, current_100ua, power_mw);
+    return true;
+}
+
+static void ina219_config_job(INA219 *ina219, I2cJob *job, uint16_t value) {
+    uint8_t buf[3] = {INA219_REG_CONFIG, value >> 8, value & 0xFF};
+    i2c_job_write(job, ina219->i2c_addr, buf, sizeof(buf));
+}
+
+void ina219_start_job(INA219 *ina219, I2cJob *job) {
+    ina219_config_job(ina219, job, INA219_CONFIG_DEFAULT | INA219_MODE_TRIGGERED);
+}
+
+void ina219_power_down_job(INA219 *ina219, I2cJob *job) {
+    ina219_config_job(ina219, job, INA219_CONFIG_DEFAULT | INA219_MODE_POWER_DOWN);
+}
+
+void ina219_collect_jobs(INA219 *ina219, I2cJob jobs[INA219_COLLECT_JOBS]) {
+    i2c_job_write_read(&jobs[0], ina219->i2c_addr, INA219_REG_BUSVOLTAGE, 2);
+    i2c_job_write_read(&jobs[1], ina219->i2c_addr, INA219_REG_CURRENT, 2);
+    i2c_job_write_read(&jobs[2], ina219->i2c_addr, INA219_REG_POWER, 2);
+}
+
+// Register values from the results of ina219_collect_jobs, with the same
+// checks as ina219_collect_data
+static bool ina219_job_values(INA219 *ina219, const I2cJob jobs[INA219_COLLECT_JOBS],
+                              uint16_t values[INA219_COLLECT_JOBS]) {
+    for (uint8_t i = 0; i < INA219_COLLECT_JOBS; i++) {
+        if (jobs[i].result != jobs[i].write_length + jobs[i].read_length) {
+            LOG_WARN("Failed to read reg: %d on addr: %d, ret: %d\n", jobs[i].write[0], ina219->i2c_addr, jobs[i].result);
+            return false;
+        }
+        values[i] = (jobs[i].read[0] << 8) | jobs[i].read[1];
+    }
+    if (!(values[0] & INA219_BUSVOLTAGE_CNVR)) {
+        LOG_WARN("INA219 conversion not ready on addr: %d\n", ina219->i2c_addr);
+        return false;
+    }
+    return true;
+}
+
+// Same checks and scaling as ina219_collect_data on the results of ina219_collect_jobs
+bool ina219_parse_jobs(INA219 *ina219, const I2cJob jobs[INA219_COLLECT_JOBS], float *voltage, float *current, float *power) {
+    uint16_t values[INA219_COLLECT_JOBS];
+    if (!ina219_job_values(ina219, jobs, values)) {
+        return false;
+    }
+
+    *voltage = (values[0] >> 3) * 0.004;
+    *current = (int16_t)values[1] * ina219->current_LSB;
+    *power = values[2] * 0.02;
+    return true;
+}
+
+// Same as ina219_collect_data_fixed on the results of ina219_collect_jobs
+bool ina219_parse_jobs_fixed(INA219 *ina219, const I2cJob jobs[INA219_COLLECT_JOBS], int32_t *voltage_mv,
+                             int32_t *current_100ua, int32_t *power_mw) {
+    uint16_t values[INA219_COLLECT_JOBS];
+    if (!ina219_job_values(ina219, jobs, values)) {
+        return false;
+    }
+
+    ina219_scale_fixed(ina219, values[0], values[1], values[2], voltage_mv, current_100ua, power_mw);
+    return true;
+}
@@ -1,8 +1,7 @@
 #ifndef INA219_H
 #define INA219_H
 
-#include "hardware/i2c.h"
-#include "pico/stdlib.h"
+#include "i2c_bus.h"
 
 // Define INA219 register addresses
 #define INA219_REG_CONFIG 0x00
@@ -12,20 +11,52 @@
 #define INA219_REG_CURRENT 0x04
 #define INA219_REG_POWER 0x03
 
+// Configuration register: 32V range, /8 gain, 12-bit shunt and bus ADC, mode bits clear
+#define INA219_CONFIG_DEFAULT 0x3998
+#define INA219_MODE_POWER_DOWN 0x0000
+#define INA219_MODE_TRIGGERED 0x0003 // Shunt and bus, triggered
+#define INA219_MODE_CONTINUOUS 0x0007 // Shunt and bus, continuous
+
+// Bus voltage register flags
+#define INA219_BUSVOLTAGE_CNVR 0x0002 // Conversion ready
+#define INA219_BUSVOLTAGE_OVF 0x0001 // Math overflow
+
+// Shunt + bus conversion at 12 bit (datasheet: 586 us max each)
+#define INA219_CONVERSION_TIME_US 1172
+
+// Bus voltage, current and power register reads
+#define INA219_COLLECT_JOBS 3
+
+// Fastest I2C clock without the high-speed master code (Fast mode)
+#define INA219_I2C_MAX_HZ 400000
+
 typedef struct {
-    i2c_inst_t *i2c_instance;
+    HalI2cBus *i2c_instance;
     uint8_t i2c_addr;
     float current_LSB;
+    uint32_t current_lsb_10na; // current_LSB for the integer path, in 10 nA
 } INA219;
 
 // Function prototypes
-bool ina219_init(INA219 *ina219, i2c_inst_t *i2c_instance, uint8_t i2c_addr);
-uint16_t ina219_read_register(INA219 *ina219, uint8_t reg);
+bool ina219_init(INA219 *ina219, HalI2cBus *i2c_instance, uint8_t i2c_addr);
+bool ina219_read_register(INA219 *ina219, uint8_t reg, uint16_t *value);
 void ina219_write_register(INA219 *ina219, uint8_t reg, uint16_t value);
 void ina219_calibrate(INA219 *ina219, float shunt_resistor_value, float max_expected_amps);
 float ina219_read_voltage(INA219 *ina219);
 float ina219_read_shunt_voltage(INA219 *ina219);
 float ina219_read_current(INA219 *ina219);
 float ina219_read_power(INA219 *ina219);
+void ina219_start_conversion(INA219 *ina219);
+void ina219_power_down(INA219 *ina219);
+bool ina219_collect_data(INA219 *ina219, float *voltage, float *current, float *power);
+// Integer variant: bus voltage in mV, current in 0.1 mA, power in mW
+bool ina219_collect_data_fixed(INA219 *ina219, int32_t *voltage_mv, int32_t *current_100ua, int32_t *power_mw);
+// The same steps as i2c_bus.h jobs, to run alongside devices on the other bus
+void ina219_start_job(INA219 *ina219, I2cJob *job);
+void ina219_power_down_job(INA219 *ina219, I2cJob *job);
+void ina219_collect_jobs(INA219 *ina219, I2cJob jobs[INA219_COLLECT_JOBS]);
+bool ina219_parse_jobs(INA219 *ina219, const I2cJob jobs[INA219_COLLECT_JOBS], float *voltage, float *current, float *power);
+bool ina219_parse_jobs_fixed(INA219 *ina219, const I2cJob jobs[INA219_COLLECT_JOBS], int32_t *voltage_mv,
+                             int32_t *current_100ua, int32_t *power_mw);
 
 #endif
\ No newline at end of file
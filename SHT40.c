@@ -1,53 +1,185 @@
-#include "sht40.h"
-#include "pico/stdlib.h" // For Pico-specific functions like sleep_ms
-#include "hardware/i2c.h"
+#include "SHT40.h"
+#include "hal.h"
+#include "log.h"
 #include <stdio.h>
 
-// Define I2C instance and address
-static i2c_inst_t *i2c_instance;
-static uint8_t i2c_addr;
+static uint8_t sht40_crc8(const uint8_t *data, uint32_t length) {
+    uint8_t crc = SHT40_CRC8_INIT;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ SHT40_CRC8_POLYNOMIAL) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
 
 // Initialize SHT40 sensor
-void sht40_init(i2c_inst_t *i2c_instance_param, uint8_t i2c_addr_param) {
-    i2c_instance = i2c_instance_param;
-    i2c_addr = i2c_addr_param;
+void sht40_init(SHT40 *sht40, HalI2cBus *i2c_instance, uint8_t i2c_addr) {
+    sht40->i2c_instance = i2c_instance;
+    sht40->i2c_addr = i2c_addr;
+    sht40->measure_cmd = SHT40_MEASURE_HIGHREP_STRETCH;
+    sht40->measure_time_us = SHT40_MEASURE_TIME_HIGHREP_US;
 
     printf("SHT40 connected, initializing...\n");
 
     // Perform a soft reset
     uint8_t soft_reset_cmd = SHT40_SOFT_RESET; // Soft reset command
-    if (i2c_write_blocking(i2c_instance, i2c_addr, &soft_reset_cmd, sizeof(soft_reset_cmd), true) != PICO_ERROR_GENERIC) {
+    if (hal_i2c_write(i2c_instance, i2c_addr, &soft_reset_cmd, sizeof(soft_reset_cmd), true) != HAL_ERROR_GENERIC) {
         printf("SHT40 initialized\n");
     } else {
         printf("SHT40 soft reset failed\n");
     }
 }
 
-// Read temperature and humidity data from the SHT40 sensor
-bool sht40_read_data(float *temperature, float *humidity) {
+// Select the measurement command used by sht40_start_measurement.
+// Lower repeatability trades noise for a shorter conversion and less energy.
+bool sht40_set_repeatability(SHT40 *sht40, uint8_t cmd) {
+    switch (cmd) {
+        case SHT40_MEASURE_HIGHREP_STRETCH:
+            sht40->measure_time_us = SHT40_MEASURE_TIME_HIGHREP_US;
+            break;
+        case SHT40_MEASURE_MEDREP_STRETCH:
+            sht40->measure_time_us = SHT40_MEASURE_TIME_MEDREP_US;
+            break;
+        case SHT40_MEASURE_LOWREP_STRETCH:
+            sht40->measure_time_us = SHT40_MEASURE_TIME_LOWREP_US;
+            break;
+        default:
+            printf("SHT40 unknown measurement command: 0x%02X\n", cmd);
+            return false;
+    }
+    sht40->measure_cmd = cmd;
+    return true;
+}
+
+// Time until a started measurement can be collected
+uint32_t sht40_measure_time_us(const SHT40 *sht40) {
+    return sht40->measure_time_us;
+}
+
+// Send the measurement command; result is ready after sht40_measure_time_us()
+bool sht40_start_measurement(SHT40 *sht40) {
+    if (hal_i2c_write(sht40->i2c_instance, sht40->i2c_addr, &sht40->measure_cmd, sizeof(sht40->measure_cmd), false) < 0) {
+        LOG_WARN("SHT40 command send failed\n");
+        return false;
+    }
+    return true;
+}
+
+// Check the CRCs of a 6 byte result and unpack its raw words
+static bool sht40_parse_raw(const uint8_t *buffer, uint16_t *raw_temperature, uint16_t *raw_humidity) {
+    // Each word is followed by its CRC
+    if (sht40_crc8(&buffer[0], 2) != buffer[2] || sht40_crc8(&buffer[3], 2) != buffer[5]) {
+        LOG_WARN("SHT40 CRC mismatch\n");
+        return false;
+    }
+
+    *raw_temperature = ((uint16_t)buffer[0] << 8) | (uint16_t)buffer[1];
+    *raw_humidity = ((uint16_t)buffer[3] << 8) | (uint16_t)buffer[4];
+    return true;
+}
+
+// Read and check the raw words of a measurement started by sht40_start_measurement
+static bool sht40_collect_raw(SHT40 *sht40, uint16_t *raw_temperature, uint16_t *raw_humidity) {
     uint8_t buffer[6];
-    
-    // Send measurement command (e.g., high repeatability)
-    uint8_t measure_cmd = SHT40_MEASURE_HIGHREP_STRETCH; // Measurement command
-    if (i2c_write_blocking(i2c_instance, i2c_addr, &measure_cmd, sizeof(measure_cmd), false) < 0) {
-        printf("SHT40 command send failed\n");
+
+    // Read data from sensor
+    if (hal_i2c_read(sht40->i2c_instance, sht40->i2c_addr, buffer, sizeof(buffer), false) != sizeof(buffer)) {
+        LOG_WARN("SHT40 read data failed\n");
+        return false;
+    }
+    return sht40_parse_raw(buffer, raw_temperature, raw_humidity);
+}
+
+static void sht40_convert(uint16_t raw_temperature, uint16_t raw_humidity, float *temperature, float *humidity) {
+    *temperature = -45.0f + 175.0f * (raw_temperature / 65535.0f);
+    // Datasheet: the formula runs past 0..100 %RH near the ends, clamp it
+    *humidity = -6.0f + 125.0f * (raw_humidity / 65535.0f);
+    *humidity = *humidity < 0.0f ? 0.0f : *humidity > 100.0f ? 100.0f : *humidity;
+}
+
+// Temperature in 0.01 DegC, humidity in 0.01 %RH, rounded
+static void sht40_convert_fixed(uint16_t raw_temperature, uint16_t raw_humidity, int32_t *temperature,
+                                int32_t *humidity) {
+    *temperature = -4500 + (int32_t)((17500u * raw_temperature + 32767u) / 65535u);
+    *humidity = -600 + (int32_t)((12500u * raw_humidity + 32767u) / 65535u);
+    *humidity = *humidity < 0 ? 0 : *humidity > 10000 ? 10000 : *humidity;
+}
+
+// Read the result of a measurement started by sht40_start_measurement.
+// Temperature and humidity always come from the same measurement.
+bool sht40_collect_data(SHT40 *sht40, float *temperature, float *humidity) {
+    uint16_t raw_temperature, raw_humidity;
+    if (!sht40_collect_raw(sht40, &raw_temperature, &raw_humidity)) {
+        return false;
+    }
+
+    sht40_convert(raw_temperature, raw_humidity, temperature, humidity);
+    return true;
+}
+
+// Integer variant, see sht40_convert_fixed
+bool sht40_collect_data_fixed(SHT40 *sht40, int32_t *temperature, int32_t *humidity) {
+    uint16_t raw_temperature, raw_humidity;
+    if (!sht40_collect_raw(sht40, &raw_temperature, &raw_humidity)) {
+        return false;
+    }
+
+    sht40_convert_fixed(raw_temperature, raw_humidity, temperature, humidity);
+    return true;
+}
+
+// Read temperature and humidity data from the SHT40 sensor
+bool sht40_read_data(SHT40 *sht40, float *temperature, float *humidity) {
+    if (!sht40_start_measurement(sht40)) {
         return false;
     }
 
     // Wait for measurement to complete
-    sleep_ms(50); // Adjust timing if needed
+    hal_sleep_us(sht40->measure_time_us);
 
-    // Read data from sensor
-    if (i2c_read_blocking(i2c_instance, i2c_addr, buffer, sizeof(buffer), false) != sizeof(buffer)) {
-        printf("SHT40 read data failed\n");
+    return sht40_collect_data(sht40, temperature, humidity);
+}
+
+// The SHT40 NAKs its address while it measures: a NAKed job waits a whole
+// measurement before it runs again
+void sht40_start_job(const SHT40 *sht40, I2cJob *job) {
+    i2c_job_write(job, sht40->i2c_addr, &sht40->measure_cmd, 1);
+    job->nak_backoff_us = sht40->measure_time_us;
+}
+
+// Plain read of the result, the SHT40 has no register pointer
+void sht40_collect_job(const SHT40 *sht40, I2cJob *job) {
+    i2c_job_write(job, sht40->i2c_addr, NULL, 0);
+    job->read_length = 6;
+    job->nak_backoff_us = sht40->measure_time_us;
+}
+
+static bool sht40_job_raw(const I2cJob *job, uint16_t *raw_temperature, uint16_t *raw_humidity) {
+    if (job->result != job->read_length) {
+        LOG_WARN("SHT40 read data failed\n");
         return false;
     }
+    return sht40_parse_raw(job->read, raw_temperature, raw_humidity);
+}
 
-    uint16_t raw_temperature = ((uint16_t)buffer[0] << 8) | (uint16_t)buffer[1];
-    uint16_t raw_humidity = ((uint16_t)buffer[3] << 8) | (uint16_t)buffer[4];
+bool sht40_parse_job(const I2cJob *job, float *temperature, float *humidity) {
+    uint16_t raw_temperature, raw_humidity;
+    if (!sht40_job_raw(job, &raw_temperature, &raw_humidity)) {
+        return false;
+    }
 
-    *temperature = -45.0f + 175.0f * (raw_temperature / 65535.0f);
-    *humidity = 100.0f * (raw_humidity / 65535.0f);
+    sht40_convert(raw_temperature, raw_humidity, temperature, humidity);
+    return true;
+}
 
+bool sht40_parse_job_fixed(const I2cJob *job, int32_t *temperature, int32_t *humidity) {
+    uint16_t raw_temperature, raw_humidity;
+    if (!sht40_job_raw(job, &raw_temperature, &raw_humidity)) {
+        return false;
+    }
+
+    sht40_convert_fixed(raw_temperature, raw_humidity, temperature, humidity);
     return true;
-}
\ No newline at end of file
+}
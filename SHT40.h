@@ -1,8 +1,7 @@
 #ifndef SHT40_H
 #define SHT40_H
 
-#include "hardware/i2c.h"
-#include "pico/stdlib.h"
+#include "i2c_bus.h"
 
 // SHT40 I2C Address
 #define SHT40_I2C_ADDR 0x44
@@ -13,8 +12,38 @@
 #define SHT40_MEASURE_LOWREP_STRETCH 0xE0
 #define SHT40_SOFT_RESET 0x94
 
+// Maximum measurement duration per repeatability (datasheet)
+#define SHT40_MEASURE_TIME_HIGHREP_US 8300
+#define SHT40_MEASURE_TIME_MEDREP_US 4500
+#define SHT40_MEASURE_TIME_LOWREP_US 1600
+
+// Fastest I2C clock (Fast-mode Plus)
+#define SHT40_I2C_MAX_HZ 1000000
+
+// CRC-8 over each 16-bit word: polynomial 0x31, init 0xFF
+#define SHT40_CRC8_POLYNOMIAL 0x31
+#define SHT40_CRC8_INIT 0xFF
+
+typedef struct {
+    HalI2cBus *i2c_instance;
+    uint8_t i2c_addr;
+    uint8_t measure_cmd;
+    uint32_t measure_time_us;
+} SHT40;
+
 // Function prototypes
-void sht40_init(i2c_inst_t *i2c_instance, uint8_t i2c_addr);
-bool sht40_read_data(float *temperature, float *humidity);
+void sht40_init(SHT40 *sht40, HalI2cBus *i2c_instance, uint8_t i2c_addr);
+bool sht40_read_data(SHT40 *sht40, float *temperature, float *humidity);
+bool sht40_set_repeatability(SHT40 *sht40, uint8_t measure_cmd);
+uint32_t sht40_measure_time_us(const SHT40 *sht40);
+bool sht40_start_measurement(SHT40 *sht40);
+bool sht40_collect_data(SHT40 *sht40, float *temperature, float *humidity);
+bool sht40_collect_data_fixed(SHT40 *sht40, int32_t *temperature, int32_t *humidity);
+
+// The same steps as i2c_bus.h jobs, to run alongside devices on the other bus
+void sht40_start_job(const SHT40 *sht40, I2cJob *job);
+void sht40_collect_job(const SHT40 *sht40, I2cJob *job);
+bool sht40_parse_job(const I2cJob *job, float *temperature, float *humidity);
+bool sht40_parse_job_fixed(const I2cJob *job, int32_t *temperature, int32_t *humidity);
 
 #endif
@@ -0,0 +1,351 @@
+#include "bench.h"
+#include "sensors.h"
+#include "radio.h"
+#include "packet.h"
+#include "hal.h"
+#include "log.h"
+#include "trace.h"
+#include "INA219.h"
+#include "SHT40.h"
+#include "BMP280.h"
+#include "boot_cache.h"
+#include "power.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Benchmark: runs the sampling and transmit stages back to back and
+// prints min/p50/p99/max per stage and per driver call as CSV on stdio.
+// Each stage is split into time on the I2C/SPI bus, time in deliberate
+// sleeps and the remainder (float math, logging, call overhead).
+// Rows named "*.cycles" are CPU cycles per call, the rest microseconds.
+// Log records are drained into the same stream; pipe it through
+// tools/log_decode.py, which passes the CSV lines through unchanged.
+// The "bench,power_model" line is a charge estimate from these times and the
+// datasheet currents in power.h; no energy is measured on hardware here.
+// The firmware entry point is bench_main.c.
+
+#define BENCH_MAX_STATS 80
+
+// Driver state owned by sensors.c
+extern INA219 ina219_solar;
+extern SHT40 sht40;
+extern bmp280 bmp;
+
+typedef struct {
+    const char* name;
+    uint32_t count;
+    uint32_t samples_us[BENCH_ITERATIONS];
+} BenchStat;
+
+typedef struct {
+    uint64_t start_us;
+    uint64_t sleep_us;
+    HalBusStats i2c[HAL_I2C_COUNT];
+    HalBusStats spi;
+} BenchMark;
+
+static BenchStat stats[BENCH_MAX_STATS];
+static uint8_t stat_count;
+
+static BenchStat* bench_stat(const char* name) {
+    for (uint8_t i = 0; i < stat_count; i++) {
+        if (strcmp(stats[i].name, name) == 0) {
+            return &stats[i];
+        }
+    }
+    if (stat_count == BENCH_MAX_STATS) {
+        return NULL;
+    }
+    stats[stat_count].name = name;
+    stats[stat_count].count = 0;
+    return &stats[stat_count++];
+}
+
+static void bench_record(const char* name, uint64_t elapsed_us) {
+    BenchStat* stat = bench_stat(name);
+    if (stat != NULL && stat->count < BENCH_ITERATIONS) {
+        stat->samples_us[stat->count++] = (uint32_t)elapsed_us;
+    }
+}
+
+static void bench_begin(BenchMark* mark) {
+    hal_get_i2c_stats(HAL_I2C0, &mark->i2c[0]);
+    hal_get_i2c_stats(HAL_I2C1, &mark->i2c[1]);
+    hal_get_spi_stats(HAL_SPI0, &mark->spi);
+    mark->sleep_us = hal_sleep_total_us();
+    mark->start_us = hal_time_us();
+}
+
+// Record the total plus its bus/sleep/cpu breakdown as "<stage>", "<stage>.i2c", ...
+// I2C time is summed over both controllers; where they overlap it can exceed
+// the stage time and the cpu remainder reads 0.
+static void bench_end(const BenchMark* mark, const char* stage, const char* i2c, const char* spi,
+                      const char* sleep, const char* cpu) {
+    uint64_t total = hal_time_us() - mark->start_us;
+    HalBusStats i2c0_now, i2c1_now, spi_now;
+    hal_get_i2c_stats(HAL_I2C0, &i2c0_now);
+    hal_get_i2c_stats(HAL_I2C1, &i2c1_now);
+    hal_get_spi_stats(HAL_SPI0, &spi_now);
+    uint64_t i2c_us = (i2c0_now.busy_us - mark->i2c[0].busy_us) + (i2c1_now.busy_us - mark->i2c[1].busy_us);
+    uint64_t spi_us = spi_now.busy_us - mark->spi.busy_us;
+    uint64_t sleep_us = hal_sleep_total_us() - mark->sleep_us;
+    uint64_t accounted = i2c_us + spi_us + sleep_us;
+
+    bench_record(stage, total);
+    if (i2c != NULL) bench_record(i2c, i2c_us);
+    if (spi != NULL) bench_record(spi, spi_us);
+    if (sleep != NULL) bench_record(sleep, sleep_us);
+    if (cpu != NULL) bench_record(cpu, total > accounted ? total - accounted : 0);
+}
+
+static uint32_t bench_mean(const char* name) {
+    BenchStat* stat = bench_stat(name);
+    uint64_t total = 0;
+    for (uint32_t i = 0; stat != NULL && i < stat->count; i++) {
+        total += stat->samples_us[i];
+    }
+    return stat != NULL && stat->count > 0 ? (uint32_t)(total / stat->count) : 0;
+}
+
+static int bench_compare(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile over sorted samples
+static uint32_t bench_percentile(const uint32_t* sorted, uint32_t count, uint32_t percent) {
+    uint32_t rank = (percent * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void bench_report(void) {
+    printf("bench,name,count,min_us,p50_us,p99_us,max_us\n");
+    for (uint8_t i = 0; i < stat_count; i++) {
+        BenchStat* stat = &stats[i];
+        if (stat->count == 0) {
+            continue;
+        }
+        qsort(stat->samples_us, stat->count, sizeof(uint32_t), bench_compare);
+        printf("bench,%s,%lu,%lu,%lu,%lu,%lu\n", stat->name, (unsigned long)stat->count,
+               (unsigned long)stat->samples_us[0],
+               (unsigned long)bench_percentile(stat->samples_us, stat->count, 50),
+               (unsigned long)bench_percentile(stat->samples_us, stat->count, 99),
+               (unsigned long)stat->samples_us[stat->count - 1]);
+    }
+    printf("bench,end\n");
+}
+
+// Each driver call on its own, so the per-stage numbers can be attributed
+static void bench_drivers(void) {
+    BenchMark mark;
+    float a, b, c;
+
+    bench_begin(&mark);
+    ina219_start_conversion(&ina219_solar);
+    bench_end(&mark, "ina219_start_conversion", "ina219_start_conversion.i2c", NULL, NULL, NULL);
+    hal_sleep_us(INA219_CONVERSION_TIME_US);
+    bench_begin(&mark);
+    ina219_collect_data(&ina219_solar, &a, &b, &c);
+    bench_end(&mark, "ina219_collect_data", "ina219_collect_data.i2c", NULL, NULL, "ina219_collect_data.cpu");
+
+    bench_begin(&mark);
+    sht40_start_measurement(&sht40);
+    bench_end(&mark, "sht40_start_measurement", "sht40_start_measurement.i2c", NULL, NULL, NULL);
+    hal_sleep_us(sht40_measure_time_us(&sht40));
+    bench_begin(&mark);
+    sht40_collect_data(&sht40, &a, &b);
+    bench_end(&mark, "sht40_collect_data", "sht40_collect_data.i2c", NULL, NULL, "sht40_collect_data.cpu");
+
+    bench_begin(&mark);
+    bmp280_start_measurement(&bmp);
+    bench_end(&mark, "bmp280_start_measurement", "bmp280_start_measurement.i2c", NULL, NULL, NULL);
+    hal_sleep_us(BMP280_MEASURE_TIME_US);
+    bench_begin(&mark);
+    bmp280_read_data(&bmp);
+    bench_end(&mark, "bmp280_read_data", "bmp280_read_data.i2c", NULL, NULL, "bmp280_read_data.cpu");
+}
+
+// Cycles for one call of each pressure compensation kernel, over a sweep of
+// raw readings with the live calibration and t_fine
+static void bench_bmp280_compensation(void) {
+    volatile uint32_t sink;
+    for (int32_t adc_p = 0; adc_p < (1 << 20); adc_p += (1 << 20) / BENCH_ITERATIONS) {
+        uint32_t start = hal_cycles_start();
+        sink = bmp280_compensate_pressure_int64(&bmp, adc_p);
+        bench_record("bmp280_compensate_pressure_int64.cycles", hal_cycles_since(start));
+
+        start = hal_cycles_start();
+        sink = bmp280_compensate_pressure_int32(&bmp, adc_p);
+        bench_record("bmp280_compensate_pressure_int32.cycles", hal_cycles_since(start));
+    }
+    (void)sink;
+}
+
+// Sea level reduction per sample against one evaluation of the full formula
+static void bench_sea_level(void) {
+    volatile float sink;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        float pressure = 95000.0f + i * 100.0f;
+        uint32_t start = hal_cycles_start();
+        sink = convert_pressure_to_sea_level(pressure * 256.0f);
+        bench_record("convert_pressure_to_sea_level.cycles", hal_cycles_since(start));
+
+        start = hal_cycles_start();
+        sink = calculate_sea_level_pressure(pressure / 100.0f, STATION_ALTITUDE_M);
+        bench_record("calculate_sea_level_pressure.cycles", hal_cycles_since(start));
+    }
+    (void)sink;
+}
+
+// Encoding a sample for the air, float against integer pipeline
+static void bench_encode(const SensorData* data, const SensorDataFixed* fixed) {
+    uint8_t buffer[RADIO_MAX_PAYLOAD];
+    uint32_t start = hal_cycles_start();
+    packet_encode(data, 0, buffer, sizeof(buffer));
+    bench_record("packet_encode.cycles", hal_cycles_since(start));
+
+    start = hal_cycles_start();
+    packet_encode_fixed(fixed, 0, buffer, sizeof(buffer));
+    bench_record("packet_encode_fixed.cycles", hal_cycles_since(start));
+}
+
+// One record through log_write against formatting the same message with
+// snprintf, which each LOG() call does with LOG_TEXT=1 before any output
+static void bench_log(void) {
+    static const char format[] = "sample %lu: %.2f DegC, %.1f hPa\n";
+    char line[64];
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        float temperature = 21.5f + i * 0.01f;
+        uint32_t start = hal_cycles_start();
+        const uint32_t words[] = {log_word_pointer(format), log_word_int(i), log_word_float(temperature),
+                                  log_word_float(1013.25f)};
+        log_write(LOG_LEVEL_DEBUG, words, sizeof(words) / sizeof(words[0]));
+        bench_record("log_tokenized.cycles", hal_cycles_since(start));
+
+        start = hal_cycles_start();
+        snprintf(line, sizeof(line), format, (unsigned long)i, temperature, 1013.25f);
+        bench_record("log_text.cycles", hal_cycles_since(start));
+        log_drain();
+    }
+}
+
+// Modelled charge of one cycle of the baseline loop, a sensor read and a
+// frame every SCHEDULER_NORMAL_INTERVAL_MS, built from the measured stage
+// times and the datasheet currents in power.h, with and without the radio
+// and INA219 power-down. The MCU is charged at its WFE current between
+// samples both ways: the station still sleeps in WFE, as the baseline did.
+static void bench_power_model(const RadioPowerStats* before, const RadioPowerStats* after) {
+    uint32_t frames = after->frames - before->frames;
+    if (frames == 0) {
+        return;
+    }
+    PowerCycle cycle = {
+        .cycle_us = SCHEDULER_NORMAL_INTERVAL_MS * 1000,
+        .radio_awake_us = (after->awake_us - before->awake_us) / frames,
+        .radio_tx_us = (after->tx_us - before->tx_us) / frames,
+        .radio_rx_us = (after->rx_us - before->rx_us) / frames,
+        .ina219_active_us = bench_mean("sensors_read_all_quiet"),
+    };
+    cycle.mcu_active_us = cycle.ina219_active_us + cycle.radio_awake_us;
+    printf("bench,power_model,cycle_us=%lu,mcu_active_us=%lu,radio_awake_us=%lu,charge_uc=%lu,"
+           "charge_no_power_down_uc=%lu,measured=no\n",
+           (unsigned long)cycle.cycle_us, (unsigned long)cycle.mcu_active_us,
+           (unsigned long)cycle.radio_awake_us, (unsigned long)power_cycle_charge_uc(&cycle, true),
+           (unsigned long)power_cycle_charge_uc(&cycle, false));
+}
+
+// Every stage BENCH_ITERATIONS times, then the CSV report and the trace
+void bench_run(void) {
+    printf("bench,start,iterations=%d\n", BENCH_ITERATIONS);
+
+    hal_cycles_init();
+    BenchMark mark;
+    bench_begin(&mark);
+    sensors_init();
+    bench_end(&mark, "sensors_init", "sensors_init.i2c", NULL, "sensors_init.sleep", "sensors_init.cpu");
+
+    // Both boot paths: dropping the boot cache forces the full one, which
+    // writes the cache again for the fast one
+    boot_cache_erase();
+    bench_begin(&mark);
+    sensors_init();
+    bench_end(&mark, "sensors_init_full", "sensors_init_full.i2c", NULL, "sensors_init_full.sleep",
+              "sensors_init_full.cpu");
+    bench_begin(&mark);
+    sensors_init();
+    bench_end(&mark, "sensors_init_fast", "sensors_init_fast.i2c", NULL, "sensors_init_fast.sleep",
+              "sensors_init_fast.cpu");
+
+    bench_begin(&mark);
+    radio_init(F_433);
+    bench_end(&mark, "radio_init", NULL, "radio_init.spi", "radio_init.sleep", "radio_init.cpu");
+    // As on the station: each send wakes the radio and puts it back in SLEEP
+    radio_sleep();
+    RadioPowerStats radio_before, radio_after;
+    radio_get_power_stats(&radio_before);
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        // The difference between the verbose and quiet runs is the logging
+        // cost at the call sites; log_drain is the deferred output cost.
+        // Build with -DLOG_TEXT=1 to compare against plain printf.
+        log_set_level(LOG_LEVEL_DEBUG);
+        bench_begin(&mark);
+        SensorData data = sensors_read_all();
+        bench_end(&mark, "sensors_read_all", "sensors_read_all.i2c", NULL,
+                  "sensors_read_all.sleep", "sensors_read_all.cpu");
+
+        bench_begin(&mark);
+        log_drain();
+        bench_end(&mark, "log_drain", NULL, NULL, NULL, NULL);
+
+        log_set_level(LOG_LEVEL_WARN);
+        bench_begin(&mark);
+        data = sensors_read_all();
+        bench_end(&mark, "sensors_read_all_quiet", "sensors_read_all_quiet.i2c", NULL,
+                  "sensors_read_all_quiet.sleep", "sensors_read_all_quiet.cpu");
+
+        bench_record("sensors_read_all.bound", sensors_cycle_bound_us());
+
+        // Same cycle at the old fixed 100 kHz, compare the .i2c rows for the
+        // gain from the negotiated clocks
+        uint32_t clock0 = hal_i2c_get_clock(HAL_I2C0), clock1 = hal_i2c_get_clock(HAL_I2C1);
+        hal_i2c_set_clock(HAL_I2C0, I2C_FREQ_HZ);
+        hal_i2c_set_clock(HAL_I2C1, I2C_FREQ_HZ);
+        bench_begin(&mark);
+        sensors_read_all();
+        bench_end(&mark, "sensors_read_all_100khz", "sensors_read_all_100khz.i2c", NULL,
+                  "sensors_read_all_100khz.sleep", "sensors_read_all_100khz.cpu");
+        bench_record("sensors_read_all_100khz.bound", sensors_cycle_bound_us());
+        hal_i2c_set_clock(HAL_I2C0, clock0);
+        hal_i2c_set_clock(HAL_I2C1, clock1);
+
+        // Same cycle on the integer pipeline. It runs the same job chains as
+        // sensors_read_all, so against the quiet run only the .cpu rows differ.
+        bench_begin(&mark);
+        SensorDataFixed fixed = sensors_read_all_fixed();
+        bench_end(&mark, "sensors_read_all_fixed", "sensors_read_all_fixed.i2c", NULL,
+                  "sensors_read_all_fixed.sleep", "sensors_read_all_fixed.cpu");
+        bench_encode(&data, &fixed);
+
+        bench_drivers();
+
+        // The remainder here also covers waiting for the packet to go on air
+        bench_begin(&mark);
+        radio_send_data(&data);
+        bench_end(&mark, "radio_send_data", NULL, "radio_send_data.spi", NULL, "radio_send_data.cpu");
+        log_drain();
+    }
+
+    radio_get_power_stats(&radio_after);
+    bench_power_model(&radio_before, &radio_after);
+
+    bench_bmp280_compensation();
+    bench_sea_level();
+    bench_log();
+    log_drain();
+    bench_report();
+    trace_dump();
+}
@@ -0,0 +1,10 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 100
+#endif
+
+void bench_run(void);
+
+#endif // BENCH_H
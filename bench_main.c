@@ -0,0 +1,19 @@
+#include "bench.h"
+#include "hal.h"
+#include "log.h"
+#include "pico/stdlib.h"
+
+// Benchmark firmware, see bench.c
+
+int main()
+{
+    stdio_init_all();
+    log_init();
+    hal_sleep_ms(2000); // Give the USB host time to attach
+
+    bench_run();
+
+    while (true) {
+        hal_wait_event();
+    }
+}
@@ -0,0 +1,58 @@
+#include "boot_cache.h"
+#include "hal.h"
+#include "crc32.h"
+#include <string.h>
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t crc;      // CRC-32 of the payload
+} BootCacheHeader;
+
+static const uint8_t *boot_cache_flash(void) {
+    return hal_flash_read(BOOT_CACHE_FLASH_OFFSET);
+}
+
+// Copy the payload out if the sector holds one of this version and length
+bool boot_cache_load(uint16_t version, void *payload, uint16_t length) {
+    BootCacheHeader header;
+    memcpy(&header, boot_cache_flash(), sizeof(header));
+    if (header.magic != BOOT_CACHE_MAGIC || header.version != version || header.length != length ||
+        length > BOOT_CACHE_MAX_PAYLOAD) {
+        return false;
+    }
+    const uint8_t *stored = boot_cache_flash() + sizeof(header);
+    if (crc32(stored, length) != header.crc) {
+        return false;
+    }
+    memcpy(payload, stored, length);
+    return true;
+}
+
+// Write the payload, skipped if the sector already holds the same bytes
+bool boot_cache_store(uint16_t version, const void *payload, uint16_t length) {
+    if (length > BOOT_CACHE_MAX_PAYLOAD) {
+        return false;
+    }
+    uint8_t page[HAL_FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    BootCacheHeader header = {
+        .magic = BOOT_CACHE_MAGIC,
+        .version = version,
+        .length = length,
+        .crc = crc32(payload, length),
+    };
+    memcpy(page, &header, sizeof(header));
+    memcpy(page + sizeof(header), payload, length);
+    if (memcmp(page, boot_cache_flash(), sizeof(header) + length) == 0) {
+        return true; // Saves an erase cycle on every full boot
+    }
+    return hal_flash_erase(BOOT_CACHE_FLASH_OFFSET, HAL_FLASH_SECTOR_SIZE) &&
+           hal_flash_program(BOOT_CACHE_FLASH_OFFSET, page, sizeof(page));
+}
+
+// Drop the cached payload, the next boot takes the full path
+bool boot_cache_erase(void) {
+    return hal_flash_erase(BOOT_CACHE_FLASH_OFFSET, HAL_FLASH_SECTOR_SIZE);
+}
@@ -0,0 +1,25 @@
+#ifndef BOOT_CACHE_H
+#define BOOT_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Boot-time state kept across resets in the last flash sector, so a node
+// that browns out and reboots can skip the slow discovery steps. The caller
+// owns the payload layout and bumps its version when the layout changes;
+// a payload is only handed back if the version, length and CRC-32 match.
+// Writes go through the HAL flash calls: the other core must have called
+// flash_safe_execute_core_init, or the write is refused and retried on a
+// later boot.
+
+#define BOOT_CACHE_FLASH_OFFSET (HAL_FLASH_SIZE_BYTES - HAL_FLASH_SECTOR_SIZE)
+#define BOOT_CACHE_MAGIC 0x57534243 // "CBSW"
+#define BOOT_CACHE_HEADER_SIZE 12
+#define BOOT_CACHE_MAX_PAYLOAD (HAL_FLASH_PAGE_SIZE - BOOT_CACHE_HEADER_SIZE)
+
+bool boot_cache_load(uint16_t version, void *payload, uint16_t length);
+bool boot_cache_store(uint16_t version, const void *payload, uint16_t length);
+bool boot_cache_erase(void);
+
+#endif // BOOT_CACHE_H
@@ -1,116 +1,680 @@
 #include "cc1101.h"
-#include "pico/stdlib.h" // For Pico-specific functions like sleep_ms
-#include "hardware/spi.h"
-#include "hardware/gpio.h"
+#include "hal.h"
+#include "log.h"
+#include "trace.h"
 #include <stdio.h>
 #include <string.h>
 
+// GDO0 state machine, only touched from the core that called cc1101_init
+static volatile CC1101State state = CC1101_STATE_IDLE;
+static cc1101_callback_t done_callback;
+static int32_t timeout_alarm;
+static uint64_t rx_deadline_us;
+static uint8_t rx_buffer[CC1101_FIFO_SIZE];
+static uint8_t rx_bytes;
+static bool rx_continuous;
+static uint8_t tx_frame[CC1101_FIFO_SIZE];
+
+// Replies waiting for a gap in continuous receive, the head one is sent
+// first. reply_loaded: it is in the TX FIFO; replying: the TX states belong
+// to it rather than to cc1101_send_data_async.
+typedef struct {
+    uint8_t frame[CC1101_REPLY_MAX_LENGTH + 2];
+    uint8_t length;
+    cc1101_callback_t callback;
+} CC1101Reply;
+
+static CC1101Reply replies[CC1101_REPLY_QUEUE];
+static uint8_t reply_head;
+static uint8_t reply_count;
+static bool reply_loaded;
+static bool replying;
+
+// RAM copy of the configuration registers, so static settings are never read over SPI
+static uint8_t config_shadow[CC1101_CONFIG_SIZE];
+static CC1101Stats stats;
+// PATABLE and TEST0..2 are not retained in SLEEP, they are rewritten on wake
+static uint8_t patable_shadow[CC1101_PATABLE_SIZE];
+static uint8_t patable_length;
+static bool powered_down;
+
+static inline void cc1101_set_state(CC1101State next) {
+    state = next;
+    TRACE_INSTANT(TRACE_CC1101_STATE, next);
+}
+
+static inline void cc1101_count(uint32_t bytes) {
+    stats.transactions++;
+    stats.bytes += bytes;
+}
+
+// DMA burst path (hal_spi_transfer_async): reads land in the buffer and
+// writes never overrun the RX FIFO, the CPU is free until the done interrupt.
+typedef void (*cc1101_dma_callback_t)(void);
+
+static volatile bool dma_busy;
+static cc1101_dma_callback_t dma_callback;
+static uint32_t dma_start_us;
+static uint32_t dma_length;
+
+static void cc1101_gdo0_irq(uint32_t gpio, uint32_t events);
+
+static inline uint32_t cc1101_time_us(void) {
+    return (uint32_t)hal_time_us();
+}
+
 void cc1101_init(void) {
-    spi_init(spi0, 500 * 1000);  // 500 kHz SPI
-    gpio_set_function(CC1101_SCLK_PIN, GPIO_FUNC_SPI);
-    gpio_set_function(CC1101_MOSI_PIN, GPIO_FUNC_SPI);
-    gpio_set_function(CC1101_MISO_PIN, GPIO_FUNC_SPI);
-    
-    gpio_init(CC1101_CS_PIN);
-    gpio_set_dir(CC1101_CS_PIN, GPIO_OUT);
-    gpio_put(CC1101_CS_PIN, 1);  // CS high
-    gpio_init(CC1101_GDO0_PIN);
-    gpio_set_dir(CC1101_GDO0_PIN, GPIO_IN);
+    // Burst completion interrupt on the calling core
+    hal_spi_init(HAL_SPI0, CC1101_SPI_BAUDRATE, CC1101_SCLK_PIN, CC1101_MOSI_PIN, CC1101_MISO_PIN);
+    hal_gpio_init_output(CC1101_CS_PIN, 1);  // CS high
+    hal_gpio_init_input(CC1101_GDO0_PIN);
 
     cc1101_reset();
+
+    // Transfers complete from GDO0 edge interrupts and timeout alarms, both
+    // are delivered to the calling core which then owns the radio.
+    hal_alarm_init();
+    hal_gpio_set_irq(CC1101_GDO0_PIN, HAL_GPIO_EDGE_RISE | HAL_GPIO_EDGE_FALL, cc1101_gdo0_irq);
+}
+
+// The whole burst is clocked out
+static void cc1101_dma_done(void) {
+    if (!dma_busy) {
+        return; // Aborted by a timeout
+    }
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
+    uint32_t elapsed = cc1101_time_us() - dma_start_us;
+    stats.dma_transfers++;
+    stats.dma_bytes += dma_length;
+    stats.dma_transfer_us += elapsed;
+    stats.last_dma_bytes = dma_length;
+    stats.last_dma_transfer_us = elapsed;
+
+    cc1101_dma_callback_t callback = dma_callback;
+    dma_callback = NULL;
+    dma_busy = false;
+    if (callback != NULL) {
+        callback();
+    }
+}
+
+// Send the header byte by hand, then hand the payload to DMA. CS stays low
+// until cc1101_dma_done.
+static void cc1101_dma_start(uint8_t header, const uint8_t* tx, uint8_t* rx, uint8_t length,
+                             cc1101_dma_callback_t callback) {
+    uint32_t setup_start = cc1101_time_us();
+    dma_busy = true;
+    dma_callback = callback;
+    dma_length = length;
+
+    hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+    hal_spi_write(HAL_SPI0, &header, 1);
+
+    dma_start_us = cc1101_time_us();
+    stats.dma_busy_us += dma_start_us - setup_start;
+    stats.last_dma_busy_us = dma_start_us - setup_start;
+    if (!hal_spi_transfer_async(HAL_SPI0, tx, rx, length, cc1101_dma_done)) {
+        // Bus still busy, cannot happen while dma_busy is honoured; clock it out by hand
+        if (tx != NULL) {
+            hal_spi_write(HAL_SPI0, tx, length);
+        } else {
+            hal_spi_read(HAL_SPI0, 0x00, rx, length);
+        }
+        cc1101_dma_done();
+    }
+}
+
+// A burst overran its state's timeout: stop it and release CS
+static void cc1101_dma_abort(void) {
+    if (!dma_busy) {
+        return;
+    }
+    hal_spi_abort(HAL_SPI0);
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
+    dma_callback = NULL;
+    dma_busy = false;
+}
+
+// Block until the running burst is done, the wait counts as CPU busy time
+static void cc1101_dma_wait(void) {
+    uint32_t wait_start = cc1101_time_us();
+    while (dma_busy) {
+        hal_spin();
+    }
+    uint32_t waited = cc1101_time_us() - wait_start;
+    stats.dma_busy_us += waited;
+    stats.last_dma_busy_us += waited;
 }
 
 void cc1101_write_reg(uint8_t addr, uint8_t value) {
-    gpio_put(CC1101_CS_PIN, 0);  // CS low
-    spi_write_blocking(spi0, &addr, 1);
-    spi_write_blocking(spi0, &value, 1);
-    gpio_put(CC1101_CS_PIN, 1);  // CS high
+    if (addr < CC1101_CONFIG_SIZE) {
+        config_shadow[addr] = value;
+    }
+    uint8_t frame[2] = {addr, value};
+    cc1101_count(2);
+    hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+    hal_spi_write(HAL_SPI0, frame, sizeof(frame));
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
 }
 
-void cc1101_write_burst(uint8_t addr, uint8_t* data, uint8_t length) {
+// Start a burst write and return, callback runs from the DMA interrupt once
+// CS is released. Short bursts are written directly and call back at once.
+// data must stay valid until the callback.
+void cc1101_write_burst_async(uint8_t addr, const uint8_t* data, uint8_t length, void (*callback)(void)) {
+    if (addr + length <= CC1101_CONFIG_SIZE) {
+        memcpy(&config_shadow[addr], data, length);
+    } else if (addr == CC1101_PATABLE && length <= CC1101_PATABLE_SIZE) {
+        memcpy(patable_shadow, data, length);
+        patable_length = length;
+    }
     addr |= 0x40;  // Burst mode bit set (bit 6)
-    gpio_put(CC1101_CS_PIN, 0);  // CS low
-    spi_write_blocking(spi0, &addr, 1);  // Write address with burst mode
-    spi_write_blocking(spi0, data, length);  // Write data bytes
-    gpio_put(CC1101_CS_PIN, 1);  // CS high
+    cc1101_count(1 + length);
+
+    if (length < CC1101_DMA_MIN_LENGTH) {
+        hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+        hal_spi_write(HAL_SPI0, &addr, 1);  // Write address with burst mode
+        hal_spi_write(HAL_SPI0, data, length);  // Write data bytes
+        hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
+        if (callback != NULL) {
+            callback();
+        }
+        return;
+    }
+    cc1101_dma_start(addr, data, NULL, length, callback);
+}
+
+void cc1101_write_burst(uint8_t addr, const uint8_t* data, uint8_t length) {
+    cc1101_write_burst_async(addr, data, length, NULL);
+    cc1101_dma_wait();
 }
 
 uint8_t cc1101_read_reg(uint8_t addr) {
     uint8_t result;
     addr |= 0x80; 
     
-    gpio_put(CC1101_CS_PIN, 0);  // CS low
-    spi_write_blocking(spi0, &addr, 1);
-    spi_read_blocking(spi0, 0x00, &result, 1);
-    gpio_put(CC1101_CS_PIN, 1);  // CS high
+    cc1101_count(2);
+    hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+    hal_spi_write(HAL_SPI0, &addr, 1);
+    hal_spi_read(HAL_SPI0, 0x00, &result, 1);
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
     
     return result;
 }
 
-void cc1101_read_burst(uint8_t addr, uint8_t* buffer, uint8_t length) {
+// Status registers (0x30-0x3D) need the burst bit, otherwise the address
+// is decoded as a command strobe.
+uint8_t cc1101_read_status(uint8_t addr) {
+    uint8_t result;
+    addr |= 0xC0;
+
+    cc1101_count(2);
+    hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+    hal_spi_write(HAL_SPI0, &addr, 1);
+    hal_spi_read(HAL_SPI0, 0x00, &result, 1);
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
+
+    return result;
+}
+
+// Start a burst read and return, same completion rules as cc1101_write_burst_async
+void cc1101_read_burst_async(uint8_t addr, uint8_t* buffer, uint8_t length, void (*callback)(void)) {
     addr |= 0xC0;  // Burst mode bit set (bit 6) and read bit set (bit 7)
-    gpio_put(CC1101_CS_PIN, 0);  // CS low
-    spi_write_blocking(spi0, &addr, 1);  // Write address with burst mode
-    spi_read_blocking(spi0, 0x00, buffer, length);  // Read data bytes into buffer
-    gpio_put(CC1101_CS_PIN, 1);  // CS high
-}
-
-// Function to send data using the TX FIFO
-void cc1101_send_data(uint8_t* buffer, uint8_t length, uint8_t address) {
-    // Write the length byte to TX FIFO
-    cc1101_write_reg(CC1101_TXFIFO_SINGLE_BYTE, length);
-    // Write the prepared data to TX FIFO
-    cc1101_write_burst(CC1101_TXFIFO_BURST, buffer, length);
-    // Start the transmission
+    cc1101_count(1 + length);
+
+    if (length < CC1101_DMA_MIN_LENGTH) {
+        hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+        hal_spi_write(HAL_SPI0, &addr, 1);  // Write address with burst mode
+        hal_spi_read(HAL_SPI0, 0x00, buffer, length);  // Read data bytes into buffer
+        hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
+        if (callback != NULL) {
+            callback();
+        }
+        return;
+    }
+    cc1101_dma_start(addr, NULL, buffer, length, callback);
+}
+
+void cc1101_read_burst(uint8_t addr, uint8_t* buffer, uint8_t length) {
+    cc1101_read_burst_async(addr, buffer, length, NULL);
+    cc1101_dma_wait();
+}
+
+// Upload all configuration registers in one burst and read them back.
+// Afterwards cc1101_get_config serves every register from the shadow.
+bool cc1101_load_config(const uint8_t* config) {
+    uint8_t readback[CC1101_CONFIG_SIZE];
+
+    cc1101_write_burst(CC1101_IOCFG2, config, CC1101_CONFIG_SIZE);
+    cc1101_read_burst(CC1101_IOCFG2, readback, CC1101_CONFIG_SIZE);
+
+    for (uint8_t addr = 0; addr < CC1101_CONFIG_SIZE; addr++) {
+        if (readback[addr] != config[addr]) {
+            printf("CC1101 config mismatch at 0x%02X: wrote 0x%02X, read 0x%02X\n",
+                   addr, config[addr], readback[addr]);
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t cc1101_get_config(uint8_t addr) {
+    return addr < CC1101_CONFIG_SIZE ? config_shadow[addr] : 0;
+}
+
+void cc1101_get_stats(CC1101Stats* out) {
+    *out = stats;
+}
+
+static void cc1101_cancel_timeout(void) {
+    if (timeout_alarm > 0) {
+        hal_alarm_cancel(timeout_alarm);
+        timeout_alarm = 0;
+    }
+}
+
+static void cc1101_timeout_irq(int32_t id);
+
+static void cc1101_wait_idle(void) {
+    while (state != CC1101_STATE_IDLE) {
+        hal_wait_event(); // Woken by the GDO0 or timeout interrupt
+    }
+}
+
+// Interrupts stay off until the id is stored: an alarm firing in between
+// would leave timeout_alarm pointing at a spent alarm. A deadline already
+// past runs cc1101_timeout_irq right here, with id 0.
+static void cc1101_arm_timeout(uint64_t deadline_us) {
+    uint32_t flags = hal_irq_save();
+    cc1101_cancel_timeout();
+    int32_t id = hal_alarm_at(deadline_us, cc1101_timeout_irq);
+    if (id > 0) {
+        timeout_alarm = id;
+    }
+    hal_irq_restore(flags);
+}
+
+static void cc1101_rx_packet_end(void);
+
+// Send the head reply if the radio is only waiting for sync. With CCA the
+// STX is refused while the channel is busy; the radio then stays in RX and
+// the reply is tried again after a received packet or CC1101_REPLY_RETRY_US.
+// Needs MCSM1.TXOFF_MODE = RX.
+static void cc1101_try_reply(void) {
+    if (reply_count == 0 || hal_gpio_get(CC1101_GDO0_PIN)) {
+        return; // Nothing to send, or sync already seen
+    }
+    if ((cc1101_read_status(CC1101_MARCSTATE) & 0x1F) != CC1101_MARCSTATE_RX) {
+        cc1101_arm_timeout(hal_time_us() + CC1101_REPLY_RETRY_US); // Still calibrating
+        return;
+    }
+    if (!reply_loaded) {
+        CC1101Reply* reply = &replies[reply_head];
+        cc1101_write_burst(CC1101_TXFIFO_BURST, reply->frame, reply->length);
+        reply_loaded = true;
+    }
+    replying = true;
+    cc1101_set_state(CC1101_STATE_TX_WAIT_SYNC);
+    cc1101_arm_timeout(hal_time_us() + CC1101_TX_SYNC_TIMEOUT_US);
     cc1101_strobe(CC1101_STX);
-    // Wait for GDO0 to be set -> sync transmitted
-    while (!gpio_get(CC1101_GDO0_PIN));
-    // Wait for GDO0 to be cleared -> end of packet
-    while (gpio_get(CC1101_GDO0_PIN));
-    // Flush TX FIFO
+    if ((cc1101_read_status(CC1101_MARCSTATE) & 0x1F) == CC1101_MARCSTATE_RX) {
+        replying = false;
+        cc1101_set_state(CC1101_STATE_RX_WAIT_SYNC);
+        cc1101_arm_timeout(hal_time_us() + CC1101_REPLY_RETRY_US);
+    }
+}
+
+static void cc1101_finish(CC1101Result result, const uint8_t* buffer, uint8_t length) {
+    cc1101_cancel_timeout();
+    // Continuous receive goes straight back to listening
+    bool relisten = rx_continuous;
+    cc1101_set_state(relisten ? CC1101_STATE_RX_WAIT_SYNC : CC1101_STATE_IDLE);
+    if (replying) {
+        cc1101_callback_t callback = replies[reply_head].callback;
+        replying = false;
+        reply_loaded = false;
+        reply_head = (reply_head + 1) % CC1101_REPLY_QUEUE;
+        reply_count--;
+        if (callback != NULL) {
+            callback(result, NULL, 0);
+        }
+    } else if (done_callback != NULL) {
+        done_callback(result, buffer, length);
+    }
+    if (relisten) {
+        cc1101_strobe(CC1101_SRX);
+        // A back-to-back packet may have completed while this one drained
+        if (!hal_gpio_get(CC1101_GDO0_PIN) && (cc1101_read_status(CC1101_RXBYTES) & 0x7F) > 0) {
+            cc1101_rx_packet_end();
+        } else {
+            cc1101_try_reply();
+        }
+    }
+    hal_signal_event(); // Wake a blocking waiter
+}
+
+// Number of bytes waiting in the RX FIFO, clears the FIFO on overflow
+static CC1101Result cc1101_rx_fifo_count(uint8_t* rxBytes) {
+    uint8_t rxBytesVerify = 0;
+
+    // Recommended process to check RX bytes
+    do {
+        *rxBytes = cc1101_read_status(CC1101_RXBYTES) & 0x7F;  // Mask to get only the lower 7 bits
+        rxBytesVerify = cc1101_read_status(CC1101_RXBYTES) & 0x7F;
+    } while (*rxBytes != rxBytesVerify);
+
+    // Check for RX FIFO Overflow error
+    if (*rxBytes > 0 &&
+        ((cc1101_read_status(CC1101_MARCSTATE) & 0x1F) == CC1101_MARCSTATE_RXFIFO_OVERFLOW ||
+         *rxBytes > CC1101_FIFO_SIZE)) {
+        cc1101_strobe(CC1101_SIDLE);
+        cc1101_strobe(CC1101_SFRX);  // Clear RX FIFO
+        *rxBytes = 0;
+        return CC1101_RESULT_OVERFLOW;
+    }
+    return CC1101_RESULT_OK;
+}
+
+// Check CRC (bit 7 in the last status byte) of a drained packet
+static CC1101Result cc1101_rx_check(const uint8_t* buffer, uint8_t rxBytes, uint8_t* length) {
+    if (!(buffer[rxBytes - 1] & CC1101_LQI_CRC_OK)) {
+        *length = 0;
+        return CC1101_RESULT_CRC_ERROR;
+    }
+    *length = rxBytes;
+    return CC1101_RESULT_OK;
+}
+
+// Read the length byte of the first packet in the RX FIFO and work out how
+// many bytes the whole packet takes (length, address, payload, RSSI, LQI).
+// Only that packet is drained, later ones stay in the FIFO.
+static CC1101Result cc1101_rx_packet_size(uint8_t* buffer, uint8_t rxBytes, uint8_t* packetBytes) {
+    buffer[0] = cc1101_read_reg(CC1101_RXFIFO_SINGLE_BYTE);
+    *packetBytes = buffer[0] + 3;
+    if (buffer[0] == 0 || *packetBytes > rxBytes) {
+        cc1101_strobe(CC1101_SIDLE);
+        cc1101_strobe(CC1101_SFRX);  // Resynchronize on a clean FIFO
+        return CC1101_RESULT_LENGTH_ERROR;
+    }
+    return CC1101_RESULT_OK;
+}
+
+// Drain one packet from the RX FIFO without flushing it first.
+// length is set to 0 if the FIFO was empty (e.g. address filtered).
+static CC1101Result cc1101_read_rx_fifo(uint8_t* buffer, uint8_t* length) {
+    uint8_t rxBytes, packetBytes;
+
+    *length = 0;
+    CC1101Result result = cc1101_rx_fifo_count(&rxBytes);
+    if (result != CC1101_RESULT_OK || rxBytes == 0) {
+        return result;
+    }
+    result = cc1101_rx_packet_size(buffer, rxBytes, &packetBytes);
+    if (result != CC1101_RESULT_OK) {
+        return result;
+    }
+
+    // Read the rest of the packet
+    cc1101_read_burst(CC1101_RXFIFO_BURST, &buffer[1], packetBytes - 1);
+    return cc1101_rx_check(buffer, packetBytes, length);
+}
+
+// Timeout for whichever state the machine is in, radio is forced back to IDLE
+static void cc1101_timeout_irq(int32_t id) {
+    if (id != timeout_alarm) {
+        return; // Cancelled while already firing, the state has moved on
+    }
+    timeout_alarm = 0;
+    CC1101State timed_out = state;
+    if (timed_out == CC1101_STATE_IDLE) {
+        return;
+    }
+    if (timed_out == CC1101_STATE_RX_WAIT_SYNC && rx_continuous) {
+        cc1101_try_reply(); // Retry after CCA refused a reply
+        return;
+    }
+    if (timed_out == CC1101_STATE_TX_LOAD || timed_out == CC1101_STATE_RX_DRAIN) {
+        cc1101_dma_abort();
+    }
+    cc1101_strobe(CC1101_SIDLE);
+    if (timed_out == CC1101_STATE_TX_LOAD || timed_out == CC1101_STATE_TX_WAIT_SYNC ||
+        timed_out == CC1101_STATE_TX_WAIT_END) {
+        cc1101_strobe(CC1101_SFTX);
+    } else {
+        cc1101_strobe(CC1101_SFRX);
+    }
+    cc1101_finish(CC1101_RESULT_TIMEOUT, NULL, 0);
+}
+
+static void cc1101_rx_relisten(void) {
+    cc1101_set_state(CC1101_STATE_RX_WAIT_SYNC);
+    cc1101_strobe(CC1101_SRX);
+    if (!rx_continuous) {
+        cc1101_arm_timeout(rx_deadline_us);
+    } else {
+        cc1101_try_reply();
+    }
+}
+
+static void cc1101_rx_drained(void) {
+    uint8_t length;
+    CC1101Result result = cc1101_rx_check(rx_buffer, rx_bytes, &length);
+    cc1101_finish(result, rx_buffer, length);
+}
+
+// GDO0 fell in RX: a packet ended or was dropped by the radio
+static void cc1101_rx_packet_end(void) {
+    uint8_t fifo_bytes;
+    CC1101Result result = cc1101_rx_fifo_count(&fifo_bytes);
+    if (result == CC1101_RESULT_OK && fifo_bytes == 0) {
+        // Packet was filtered by the radio, keep listening
+        cc1101_rx_relisten();
+        return;
+    }
+    if (result == CC1101_RESULT_OK) {
+        result = cc1101_rx_packet_size(rx_buffer, fifo_bytes, &rx_bytes);
+    }
+    if (result != CC1101_RESULT_OK) {
+        cc1101_finish(result, rx_buffer, 0);
+        return;
+    }
+
+    // Drain by DMA, the state machine continues in cc1101_rx_drained
+    cc1101_set_state(CC1101_STATE_RX_DRAIN);
+    cc1101_arm_timeout(hal_time_us() + CC1101_RX_DRAIN_TIMEOUT_US);
+    cc1101_read_burst_async(CC1101_RXFIFO_BURST, &rx_buffer[1], rx_bytes - 1, cc1101_rx_drained);
+}
+
+// TX FIFO is loaded, start the transmission
+static void cc1101_tx_loaded(void) {
+    cc1101_set_state(CC1101_STATE_TX_WAIT_SYNC);
+    cc1101_arm_timeout(hal_time_us() + CC1101_TX_SYNC_TIMEOUT_US);
+    cc1101_strobe(CC1101_STX);
+}
+
+// IOCFG0 = 0x06: GDO0 rises when sync is sent/received and falls at the end
+// of the packet (or when RX drops a packet on address/CRC filtering).
+static void cc1101_gdo0_irq(uint32_t gpio, uint32_t events) {
+    if (gpio != CC1101_GDO0_PIN) {
+        return;
+    }
+
+    if (events & HAL_GPIO_EDGE_RISE) {
+        if (state == CC1101_STATE_TX_WAIT_SYNC) {
+            cc1101_set_state(CC1101_STATE_TX_WAIT_END);
+            cc1101_arm_timeout(hal_time_us() + CC1101_TX_END_TIMEOUT_US);
+        } else if (state == CC1101_STATE_RX_WAIT_SYNC) {
+            cc1101_set_state(CC1101_STATE_RX_WAIT_END);
+            cc1101_arm_timeout(hal_time_us() + CC1101_RX_END_TIMEOUT_US);
+        }
+    }
+
+    if (events & HAL_GPIO_EDGE_FALL) {
+        if (state == CC1101_STATE_TX_WAIT_END) {
+            // Flush TX FIFO; a reply leaves the radio in RX (TXOFF_MODE)
+            // with the FIFO already empty, SFTX is only valid in IDLE
+            if (!replying) {
+                cc1101_strobe(CC1101_SFTX);
+            }
+            cc1101_finish(CC1101_RESULT_OK, NULL, 0);
+        } else if (state == CC1101_STATE_RX_WAIT_END || state == CC1101_STATE_RX_WAIT_SYNC) {
+            // In RX_WAIT_SYNC the rising edge was missed while the previous
+            // packet was being drained
+            cc1101_rx_packet_end();
+        }
+    }
+}
+
+// Load the TX FIFO and start transmission. Completion (or timeout) is
+// reported through callback from interrupt context.
+bool cc1101_send_data_async(const uint8_t* buffer, uint8_t length, uint8_t address, cc1101_callback_t callback) {
+    // Length byte counts the address byte, all of it has to fit the FIFO
+    if (state != CC1101_STATE_IDLE || length + 2 > CC1101_FIFO_SIZE) {
+        return false;
+    }
+
+    tx_frame[0] = length + 1;
+    tx_frame[1] = address;
+    memcpy(&tx_frame[2], buffer, length);
+    done_callback = callback;
+
+    cc1101_strobe(CC1101_SIDLE);
     cc1101_strobe(CC1101_SFTX);
+    // Write the length and address bytes and the prepared data to TX FIFO in
+    // one DMA burst, cc1101_tx_loaded starts the transmission once it is done
+    cc1101_set_state(CC1101_STATE_TX_LOAD);
+    cc1101_arm_timeout(hal_time_us() + CC1101_TX_LOAD_TIMEOUT_US);
+    cc1101_write_burst_async(CC1101_TXFIFO_BURST, tx_frame, length + 2, cc1101_tx_loaded);
+    return true;
 }
-// Function to receive data using the RX FIFOvoid 
-void cc1101_receive_data(uint8_t* buffer, uint8_t* length) {
-    uint8_t rxBytes = 0, rxBytesVerify = 0, marcState = 0;
 
-    // Set to IDLE and flush RX FIFO
+// Enter RX and wait for one packet. timeout_us bounds the wait for sync and
+// must not be 0: that would time out at once, use cc1101_receive_continuous
+// to wait without a bound.
+bool cc1101_receive_async(uint32_t timeout_us, cc1101_callback_t callback) {
+    if (state != CC1101_STATE_IDLE || (timeout_us == 0 && !rx_continuous)) {
+        return false;
+    }
+
+    done_callback = callback;
+    rx_deadline_us = hal_time_us() + timeout_us;
+
     cc1101_strobe(CC1101_SIDLE);
     cc1101_strobe(CC1101_SFRX);
+
+    cc1101_set_state(CC1101_STATE_RX_WAIT_SYNC);
+    if (!rx_continuous) {
+        cc1101_arm_timeout(rx_deadline_us);
+    }
     cc1101_strobe(CC1101_SRX);
+    return true;
+}
+
+// Stay in RX and report every packet through callback until
+// cc1101_stop_receive. Waiting for sync is unbounded in this mode, every
+// other state keeps its timeout. Needs MCSM1.RXOFF_MODE = RX.
+bool cc1101_receive_continuous(cc1101_callback_t callback) {
+    if (state != CC1101_STATE_IDLE) {
+        return false;
+    }
+    rx_continuous = true;
+    return cc1101_receive_async(0, callback);
+}
+
+// Queue a reply (length, address and data, at most CC1101_REPLY_MAX_LENGTH
+// bytes of data) to go out as soon as the channel is free, without leaving
+// continuous receive. Only valid from the continuous receive callback;
+// callback reports the send from interrupt context.
+bool cc1101_queue_reply(const uint8_t* data, uint8_t length, uint8_t address, cc1101_callback_t callback) {
+    if (!rx_continuous || length > CC1101_REPLY_MAX_LENGTH || reply_count == CC1101_REPLY_QUEUE) {
+        return false;
+    }
+    CC1101Reply* reply = &replies[(reply_head + reply_count) % CC1101_REPLY_QUEUE];
+    reply->frame[0] = length + 1;
+    reply->frame[1] = address;
+    memcpy(&reply->frame[2], data, length);
+    reply->length = length + 2;
+    reply->callback = callback;
+    reply_count++;
+    return true;
+}
+
+// Leave continuous receive. Queued replies are dropped, a drain or send in
+// progress is let finish (its callback still runs) so neither the SPI burst
+// nor the FIFOs are cut off halfway.
+void cc1101_stop_receive(void) {
+    uint32_t flags = hal_irq_save();
+    rx_continuous = false;
+    reply_count = replying ? 1 : 0;
+    reply_loaded = replying;
+    if (state != CC1101_STATE_TX_LOAD && state != CC1101_STATE_TX_WAIT_SYNC &&
+        state != CC1101_STATE_TX_WAIT_END && state != CC1101_STATE_RX_DRAIN) {
+        cc1101_cancel_timeout();
+        cc1101_set_state(CC1101_STATE_IDLE);
+    }
+    hal_irq_restore(flags);
+    cc1101_wait_idle();
+    cc1101_strobe(CC1101_SIDLE);
+    cc1101_strobe(CC1101_SFTX); // A reply refused by CCA may be left loaded
+}
+
+CC1101State cc1101_get_state(void) {
+    return state;
+}
+
+static volatile CC1101Result blocking_result;
+static uint8_t* blocking_buffer;
+static uint8_t* blocking_length;
+
+static void cc1101_blocking_done(CC1101Result result, const uint8_t* buffer, uint8_t length) {
+    blocking_result = result;
+    if (blocking_buffer != NULL && length > 0) {
+        memcpy(blocking_buffer, buffer, length);
+    }
+    if (blocking_length != NULL) {
+        *blocking_length = length;
+    }
+}
+
+
+// Function to send data using the TX FIFO, sleeps until the packet is out
+bool cc1101_send_data(uint8_t* buffer, uint8_t length, uint8_t address) {
+    blocking_buffer = NULL;
+    blocking_length = NULL;
+    TRACE_BEGIN(TRACE_CC1101_SEND, length);
+    if (!cc1101_send_data_async(buffer, length, address, cc1101_blocking_done)) {
+        TRACE_END(TRACE_CC1101_SEND, CC1101_RESULT_TIMEOUT);
+        return false;
+    }
+    cc1101_wait_idle();
+    TRACE_END(TRACE_CC1101_SEND, blocking_result);
+    return blocking_result == CC1101_RESULT_OK;
+}
+
+// Receive one packet into buffer, sleeping until it arrives or timeout_us passes
+CC1101Result cc1101_receive(uint8_t* buffer, uint8_t* length, uint32_t timeout_us) {
+    *length = 0;
+    blocking_buffer = buffer;
+    blocking_length = length;
+    if (!cc1101_receive_async(timeout_us, cc1101_blocking_done)) {
+        return CC1101_RESULT_TIMEOUT;
+    }
+    cc1101_wait_idle();
+    return blocking_result;
+}
+
+// Drain whatever packet is waiting in the RX FIFO
+void cc1101_receive_data(uint8_t* buffer, uint8_t* length) {
     cc1101_signal_strength(); // Print signal strength
 
-    // Recommended process to check RX bytes
-    do {
-        rxBytes = cc1101_read_reg(CC1101_RXBYTES) & 0x7F;  // Mask to get only the lower 7 bits
-        rxBytesVerify = cc1101_read_reg(CC1101_RXBYTES) & 0x7F;
-    } while (rxBytes != rxBytesVerify);
-
-    if (rxBytes > 0) {
-        marcState = cc1101_read_reg(CC1101_MARCSTATE) & 0x1F;
-
-        // Check for RX FIFO Overflow error
-        if (marcState == 0x11) {  // RXFIFO_OVERFLOW
-            cc1101_strobe(CC1101_SFRX);  // Clear RX FIFO
-            printf("RX FIFO overflow, data discarded.\n");
-            *length = 0;  // Update length to 0 due to overflow
-        } else {
-            // Read the RX FIFO content
-            cc1101_read_burst(CC1101_RXFIFO_BURST, buffer, rxBytes);
-
-            // Check CRC (bit 7 in the last status byte)
-            if (buffer[rxBytes - 1] & 0x80) {
-                printf("Packet received correctly.\n");
-                *length = rxBytes;  // Update length to the number of bytes received
-            } else {
-                printf("CRC error, packet discarded.\n");
-                memset(buffer, 0, *length);  // Clear the buffer due to CRC error
-                *length = 0;  // Update length to 0 due to CRC error
-            }
-        }
+    CC1101Result result = cc1101_read_rx_fifo(buffer, length);
+    if (result == CC1101_RESULT_OVERFLOW) {
+        LOG_WARN("RX FIFO overflow, data discarded.\n");
+    } else if (result == CC1101_RESULT_CRC_ERROR) {
+        LOG_WARN("CRC error, packet discarded.\n");
+    } else if (*length == 0) {
+        LOG_DEBUG("No data in RX FIFO.\n");
     } else {
-        printf("No data in RX FIFO.\n");
-        *length = 0;  // Update length to 0 if no data
+        LOG_DEBUG("Packet received correctly.\n");
     }
 
     // Set radio back to RX mode
@@ -118,37 +682,111 @@ void cc1101_receive_data(uint8_t* buffer, uint8_t* length) {
 }
 
 void cc1101_strobe(uint8_t strobe) {
-    gpio_put(CC1101_CS_PIN, 0);  // CS low
-    spi_write_blocking(spi0, &strobe, 1);
-    gpio_put(CC1101_CS_PIN, 1);  // CS high
+    TRACE_INSTANT(TRACE_CC1101_STROBE, strobe);
+    cc1101_count(1);
+    hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+    hal_spi_write(HAL_SPI0, &strobe, 1);
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
 }
 
+// With CSn low, MISO doubles as CHIP_RDYn: it drops once the crystal runs
+static bool cc1101_wait_chip_ready(uint32_t timeout_us) {
+    uint32_t start = cc1101_time_us();
+    while (hal_gpio_get(CC1101_MISO_PIN)) {
+        if (cc1101_time_us() - start > timeout_us) {
+            return false;
+        }
+        hal_spin();
+    }
+    return true;
+}
+
+// Manual reset after power-on (datasheet 19.1.2): pulse CSn, strobe SRES
+// once the chip is ready and wait for CHIP_RDYn again, the reset is done then
 void cc1101_reset(void) {
-    gpio_put(CC1101_CS_PIN, 0);
-    sleep_ms(10);
-    gpio_put(CC1101_CS_PIN, 1);
-    sleep_ms(10);
-    // Reset the CC1101
-    cc1101_strobe(CC1101_SRES);  // Strobe SRES (reset)
+    hal_gpio_put(CC1101_CS_PIN, 0);
+    hal_sleep_us(CC1101_RESET_PULSE_US);
+    hal_gpio_put(CC1101_CS_PIN, 1);
+    hal_sleep_us(CC1101_RESET_PULSE_US);
+
+    uint8_t strobe = CC1101_SRES;
+    TRACE_INSTANT(TRACE_CC1101_STROBE, strobe);
+    cc1101_count(1);
+    hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+    bool ready = cc1101_wait_chip_ready(CC1101_WAKE_TIMEOUT_US);
+    hal_spi_write(HAL_SPI0, &strobe, 1);
+    ready = cc1101_wait_chip_ready(CC1101_WAKE_TIMEOUT_US) && ready;
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
+    if (!ready) {
+        LOG_WARN("CC1101 reset timed out\n");
+    }
 }
 
-void cc1101_signal_strength() {
-    uint8_t rssi_raw = cc1101_read_reg(CC1101_RSSI);
-    int8_t rssi_dbm;
+// Enter SLEEP (SPWD takes effect when CSn goes high). Only valid from IDLE,
+// so any transfer in progress must have finished.
+void cc1101_power_down(void) {
+    if (powered_down) {
+        return;
+    }
+    cc1101_strobe(CC1101_SIDLE);
+    cc1101_strobe(CC1101_SPWD);
+    powered_down = true;
+    stats.power_downs++;
+}
+
+// Leave SLEEP: hold CSn low until MISO drops (crystal running), then rewrite
+// the registers SLEEP does not retain. The radio is in IDLE afterwards.
+bool cc1101_wake(void) {
+    if (!powered_down) {
+        return true;
+    }
+    uint32_t start = cc1101_time_us();
+    hal_gpio_put(CC1101_CS_PIN, 0);  // CS low
+    bool ready = cc1101_wait_chip_ready(CC1101_WAKE_TIMEOUT_US);
+    hal_gpio_put(CC1101_CS_PIN, 1);  // CS high
+    uint32_t elapsed = cc1101_time_us() - start;
+    stats.last_wake_us = elapsed;
+    if (elapsed > stats.max_wake_us) {
+        stats.max_wake_us = elapsed;
+    }
+    if (!ready) {
+        LOG_WARN("CC1101 wake timed out after %lu us\n", (unsigned long)elapsed);
+        return false;
+    }
+    powered_down = false;
+
+    uint8_t test[3];
+    memcpy(test, &config_shadow[CC1101_TEST2], sizeof(test)); // TEST2, TEST1, TEST0
+    cc1101_write_burst(CC1101_TEST2, test, sizeof(test));
+    if (patable_length > 0) {
+        cc1101_write_burst(CC1101_PATABLE, patable_shadow, patable_length);
+    }
+    return true;
+}
+
+bool cc1101_is_powered_down(void) {
+    return powered_down;
+}
+
+// Convert a raw RSSI register or appended status byte to dBm
+int8_t cc1101_rssi_dbm(uint8_t rssi_raw) {
     if (rssi_raw >= 128) {
-        rssi_dbm = (int8_t)(rssi_raw - 256) / 2 - 74;
-    } else {
-        rssi_dbm = (rssi_raw / 2) - 74;
+        return (int8_t)(rssi_raw - 256) / 2 - 74;
     }
+    return (rssi_raw / 2) - 74;
+}
+
+void cc1101_signal_strength() {
+    int8_t rssi_dbm = cc1101_rssi_dbm(cc1101_read_status(CC1101_RSSI));
 
-    printf("Current RSSI: %d dBm\n", rssi_dbm);
+    LOG_DEBUG("Current RSSI: %d dBm\n", rssi_dbm);
 
     if (rssi_dbm < -100) {
-        printf("Signal is very weak\n");
+        LOG_DEBUG("Signal is very weak\n");
     } else if (rssi_dbm < -70) {
-        printf("Signal is moderate\n");
+        LOG_DEBUG("Signal is moderate\n");
     } else {
-        printf("Signal is strong\n");
+        LOG_DEBUG("Signal is strong\n");
     }
 }
 
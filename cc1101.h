@@ -11,7 +11,39 @@
 #define CC1101_MOSI_PIN   7   //Green SPI Master Out Slave In (MOSI) pin (GPIO 7)
 #define CC1101_MISO_PIN   4   //Purple SPI Master In Slave Out (MISO) pin (GPIO 4)
 
+// Datasheet limit for back-to-back burst access without inserted delays
+#define CC1101_SPI_BAUDRATE (6500 * 1000)
+// Bursts shorter than this are cheaper to clock out by hand than to set up DMA for
+#define CC1101_DMA_MIN_LENGTH 8
+
 #define CC1101_MAX_PAYLOAD_LENGTH 42   // Maximum length of payload
+#define CC1101_FIFO_SIZE 64
+#define CC1101_CONFIG_SIZE 0x2F // Configuration registers 0x00 (IOCFG2) .. 0x2E (TEST0)
+
+// Bounded time in each state of the GDO0 state machine. At ~100 kBaud a
+// full 64 byte FIFO takes ~5 ms on air, over SPI it is ~0.1 ms.
+#define CC1101_TX_LOAD_TIMEOUT_US 1000   // TX FIFO burst done
+#define CC1101_RX_DRAIN_TIMEOUT_US 1000  // RX FIFO burst done
+#define CC1101_TX_SYNC_TIMEOUT_US 5000   // STX -> sync sent (calibration, CCA, preamble)
+#define CC1101_TX_END_TIMEOUT_US  10000  // sync sent -> end of packet
+#define CC1101_RX_END_TIMEOUT_US  10000  // sync received -> end of packet
+
+// Replies queued from the continuous receive callback (e.g. ACKs) go out
+// between received packets, RX -> TX without calibration. Short enough to
+// be written to the TX FIFO directly, CCA refusal retries after a while.
+#define CC1101_REPLY_QUEUE 4
+#define CC1101_REPLY_MAX_LENGTH (CC1101_DMA_MIN_LENGTH - 3)
+#define CC1101_REPLY_RETRY_US 1000
+
+// CSn low -> MISO low after SPWD is the crystal start-up, ~150 us typical
+#define CC1101_WAKE_TIMEOUT_US 2000
+// Manual reset: CSn low and high again, each held at least 40 us
+#define CC1101_RESET_PULSE_US 40
+#define CC1101_PATABLE_SIZE 8
+
+#define CC1101_MARCSTATE_RX 0x0D
+#define CC1101_MARCSTATE_RXFIFO_OVERFLOW 0x11
+#define CC1101_LQI_CRC_OK 0x80 // CRC_OK bit in the appended LQI status byte
 
 // CC1101 Command Strobes
 #define CC1101_SRES          0x30  // Reset chip
@@ -94,15 +126,77 @@
 #define CC1101_RXFIFO_SINGLE_BYTE 0xBF // Single byte access to RX FIFO
 #define CC1101_RXFIFO_BURST 0xFF       // Burst access to RX FIFO
 
+// GDO0 driven transfer state machine
+typedef enum {
+    CC1101_STATE_IDLE,
+    CC1101_STATE_TX_LOAD,       // TX FIFO being filled by DMA
+    CC1101_STATE_TX_WAIT_SYNC,
+    CC1101_STATE_TX_WAIT_END,
+    CC1101_STATE_RX_WAIT_SYNC,
+    CC1101_STATE_RX_WAIT_END,
+    CC1101_STATE_RX_DRAIN,      // RX FIFO being drained by DMA
+} CC1101State;
+
+typedef enum {
+    CC1101_RESULT_OK,
+    CC1101_RESULT_TIMEOUT,
+    CC1101_RESULT_CRC_ERROR,
+    CC1101_RESULT_OVERFLOW,
+    CC1101_RESULT_LENGTH_ERROR,
+} CC1101Result;
+
+// Called from interrupt context when a transfer completes. For RX the
+// buffer holds length, address, payload, RSSI and LQI status bytes and is
+// valid until the next receive is started.
+typedef void (*cc1101_callback_t)(CC1101Result result, const uint8_t* buffer, uint8_t length);
+
+// SPI traffic counters, one transaction per CS low period
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;
+    // DMA bursts: wall time from start to completion, and the part of it the
+    // CPU spent setting up or waiting
+    uint32_t dma_transfers;
+    uint32_t dma_bytes;
+    uint32_t dma_transfer_us;
+    uint32_t dma_busy_us;
+    uint32_t last_dma_bytes;
+    uint32_t last_dma_transfer_us;
+    uint32_t last_dma_busy_us;
+    // Power-down: SPWD entries and CSn low -> chip ready time on wake
+    uint32_t power_downs;
+    uint32_t last_wake_us;
+    uint32_t max_wake_us;
+} CC1101Stats;
+
 // Prototypes
 void cc1101_init(void);
 void cc1101_write_reg(uint8_t addr, uint8_t value);
+void cc1101_write_burst(uint8_t addr, const uint8_t* data, uint8_t length);
 uint8_t cc1101_read_reg(uint8_t addr);
-void cc1101_send_data(uint8_t* data, uint8_t length, uint8_t address);
+void cc1101_read_burst(uint8_t addr, uint8_t* buffer, uint8_t length);
+void cc1101_write_burst_async(uint8_t addr, const uint8_t* data, uint8_t length, void (*callback)(void));
+void cc1101_read_burst_async(uint8_t addr, uint8_t* buffer, uint8_t length, void (*callback)(void));
+bool cc1101_load_config(const uint8_t* config);
+uint8_t cc1101_get_config(uint8_t addr);
+void cc1101_get_stats(CC1101Stats* stats);
+uint8_t cc1101_read_status(uint8_t addr);
+bool cc1101_send_data(uint8_t* data, uint8_t length, uint8_t address);
+bool cc1101_send_data_async(const uint8_t* data, uint8_t length, uint8_t address, cc1101_callback_t callback);
+bool cc1101_receive_async(uint32_t timeout_us, cc1101_callback_t callback);
+CC1101Result cc1101_receive(uint8_t* buffer, uint8_t* length, uint32_t timeout_us);
+bool cc1101_receive_continuous(cc1101_callback_t callback);
+bool cc1101_queue_reply(const uint8_t* data, uint8_t length, uint8_t address, cc1101_callback_t callback);
+void cc1101_stop_receive(void);
 void cc1101_receive_data(uint8_t* buffer, uint8_t* length);
+CC1101State cc1101_get_state(void);
 void cc1101_strobe(uint8_t strobe);
 void cc1101_reset(void);
+void cc1101_power_down(void);
+bool cc1101_wake(void);
+bool cc1101_is_powered_down(void);
 void cc1101_signal_strength(void);
+int8_t cc1101_rssi_dbm(uint8_t rssi_raw);
 void cc1101_set_tx_power(uint8_t power);
 
 #endif // CC1101_H
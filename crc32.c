@@ -0,0 +1,13 @@
+#include "crc32.h"
+
+uint32_t crc32(const void *data, uint32_t length) {
+    const uint8_t *bytes = data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= bytes[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,11 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320), check value
+// 0xCBF43926 for "123456789". Bitwise, for the few hundred bytes of a flash
+// page; no table in RAM.
+uint32_t crc32(const void *data, uint32_t length);
+
+#endif // CRC32_H
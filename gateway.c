@@ -0,0 +1,284 @@
+#include "gateway.h"
+#include "cc1101.h"
+#include "radio.h"
+#include "packet.h"
+#include "spsc_queue.h"
+#include "hal.h"
+#include "log.h"
+#include <string.h>
+
+// Receiver logic: keeps the CC1101 in RX, drains packets from the GDO0
+// interrupt into a ring, acknowledges each frame from there and forwards decoded samples
+// to the console. The firmware entry point is gateway_main.c.
+
+#define GATEWAY_PACKET_QUEUE_CAPACITY 16 // Must be a power of two
+
+typedef struct {
+    uint32_t timestamp_ms;
+    uint8_t length;
+    uint8_t data[CC1101_FIFO_SIZE];
+} GatewayPacket;
+
+typedef struct {
+    uint8_t address;
+    uint32_t packets;
+    uint32_t lost;          // Frames missing from the sequence numbers
+    uint8_t last_sequence;
+    uint32_t last_seen_ms;
+} GatewayStation;
+
+// Filled from the GDO0/DMA interrupt, drained by the main loop
+static GatewayPacket packet_storage[GATEWAY_PACKET_QUEUE_CAPACITY];
+static SpscQueue packet_queue;
+
+static GatewayStation stations[GATEWAY_MAX_STATIONS];
+static uint8_t station_count;
+
+static uint64_t next_stats_us;
+
+static volatile uint32_t packets_received;
+static volatile uint32_t crc_errors;
+static volatile uint32_t rx_errors;
+
+static void gateway_ack_done(CC1101Result result, const uint8_t* buffer, uint8_t length) {
+    if (result != CC1101_RESULT_OK) {
+        rx_errors++;
+    }
+}
+
+// Acknowledge a station's frame (see packet.h) from the receive interrupt:
+// the CC1101 sends it in the next gap between packets without leaving RX,
+// well inside the station's RADIO_ACK_TIMEOUT_MS even when the main loop is
+// busy forwarding. Only frames that made it into the queue are acknowledged,
+// the station keeps the others and sends them again.
+static void gateway_ack(const uint8_t* buffer, uint8_t length) {
+    // FIFO layout: length, address, payload, RSSI, LQI
+    uint8_t packet_length = buffer[0];
+    const uint8_t* payload = &buffer[2];
+    uint8_t payload_length = packet_length - 1;
+    if (packet_length + 3 != length || payload_length < PACKET_HEADER_SIZE ||
+        packet_is_ack(payload, payload_length)) {
+        return;
+    }
+    uint8_t ack[PACKET_ACK_SIZE];
+    packet_encode_ack(packet_sequence(payload), ack, sizeof(ack));
+    if (!cc1101_queue_reply(ack, sizeof(ack), buffer[1], gateway_ack_done)) {
+        rx_errors++;
+    }
+}
+
+static void gateway_on_packet(CC1101Result result, const uint8_t* buffer, uint8_t length) {
+    if (result == CC1101_RESULT_CRC_ERROR) {
+        crc_errors++;
+        return;
+    }
+    if (result != CC1101_RESULT_OK || length == 0) {
+        rx_errors++;
+        return;
+    }
+
+    GatewayPacket packet;
+    packet.timestamp_ms = (uint32_t)(hal_time_us() / 1000);
+    packet.length = length;
+    memcpy(packet.data, buffer, length);
+    if (spsc_queue_push(&packet_queue, &packet)) {
+        packets_received++;
+        gateway_ack(buffer, length);
+    }
+}
+
+// Find the station by source address, adding it if there is room
+static GatewayStation* gateway_station(uint8_t address) {
+    for (uint8_t i = 0; i < station_count; i++) {
+        if (stations[i].address == address) {
+            return &stations[i];
+        }
+    }
+    if (station_count == GATEWAY_MAX_STATIONS) {
+        return NULL;
+    }
+    GatewayStation* station = &stations[station_count++];
+    memset(station, 0, sizeof(*station));
+    station->address = address;
+    return station;
+}
+
+static uint8_t gateway_crc8(uint8_t crc, const uint8_t* data, uint8_t length) {
+    for (uint8_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void gateway_write_frame(uint8_t type, const uint8_t* payload, uint8_t length) {
+    uint8_t header[3] = {GATEWAY_FRAME_SYNC, type, length};
+    uint8_t crc = gateway_crc8(0, &header[1], 2);
+    crc = gateway_crc8(crc, payload, length);
+
+    for (uint8_t i = 0; i < sizeof(header); i++) {
+        hal_console_put(header[i]);
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        hal_console_put(payload[i]);
+    }
+    hal_console_put(crc);
+}
+
+static void gateway_put_u32(uint8_t* buffer, uint32_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = value >> 24;
+}
+
+// Follows the SAMPLE frame of a report that carries per-interval spread
+static void gateway_forward_spread(const GatewayStation* station, uint32_t age_ms, const SensorData* data) {
+    uint8_t payload[7 + SENSOR_CH_COUNT * sizeof(SensorSpread)];
+    uint8_t byte_index = 0;
+
+    payload[byte_index++] = station->address;
+    gateway_put_u32(&payload[byte_index], age_ms); byte_index += 4;
+    payload[byte_index++] = data->spread_present & 0xFF;
+    payload[byte_index++] = data->spread_present >> 8;
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (data->spread_present & SENSOR_BIT(ch)) {
+            memcpy(&payload[byte_index], &data->spread[ch], sizeof(SensorSpread));
+            byte_index += sizeof(SensorSpread);
+        }
+    }
+
+    gateway_write_frame(GATEWAY_FRAME_SPREAD, payload, byte_index);
+}
+
+static void gateway_forward_sample(const GatewayStation* station, int8_t rssi, uint32_t age_ms,
+                                   const SensorData* data) {
+    uint8_t payload[16 + SENSOR_CH_COUNT * sizeof(float)];
+    uint8_t byte_index = 0;
+
+    payload[byte_index++] = station->address;
+    payload[byte_index++] = (uint8_t)rssi;
+    gateway_put_u32(&payload[byte_index], age_ms); byte_index += 4;
+    gateway_put_u32(&payload[byte_index], station->packets); byte_index += 4;
+    gateway_put_u32(&payload[byte_index], station->lost); byte_index += 4;
+    payload[byte_index++] = data->present & 0xFF;
+    payload[byte_index++] = data->present >> 8;
+    // Every channel in channel order, absent ones as 0
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        float value = sensor_value(data, ch);
+        memcpy(&payload[byte_index], &value, sizeof(float));
+        byte_index += sizeof(float);
+    }
+
+    gateway_write_frame(GATEWAY_FRAME_SAMPLE, payload, byte_index);
+    if (data->spread_present) {
+        gateway_forward_spread(station, age_ms, data);
+    }
+}
+
+static void gateway_forward_stats(void) {
+    uint8_t payload[17];
+    gateway_put_u32(&payload[0], packets_received);
+    gateway_put_u32(&payload[4], crc_errors);
+    gateway_put_u32(&payload[8], rx_errors);
+    gateway_put_u32(&payload[12], spsc_queue_overruns(&packet_queue));
+    payload[16] = station_count;
+    gateway_write_frame(GATEWAY_FRAME_STATS, payload, sizeof(payload));
+}
+
+// Demultiplex by source address and forward every sample the packet holds
+static void gateway_process(const GatewayPacket* packet) {
+    // FIFO layout: length, address, payload, RSSI, LQI
+    uint8_t packet_length = packet->data[0];
+    if (packet_length < 1 || packet_length + 3 != packet->length) {
+        rx_errors++;
+        return;
+    }
+    const uint8_t* payload = &packet->data[2];
+    uint8_t payload_length = packet_length - 1;
+    if (packet_is_ack(payload, payload_length)) {
+        return; // Another gateway's acknowledgement
+    }
+    int8_t rssi = cc1101_rssi_dbm(packet->data[packet_length + 1]);
+    uint32_t queued_ms = (uint32_t)(hal_time_us() / 1000) - packet->timestamp_ms;
+
+    GatewayStation* station = gateway_station(packet->data[1]);
+    if (station == NULL) {
+        rx_errors++;
+        return;
+    }
+    station->last_seen_ms = packet->timestamp_ms;
+
+    // A gap in the sequence is lost frames; samples the station suppressed
+    // never had a frame and leave no gap
+    if (payload_length >= PACKET_HEADER_SIZE) {
+        uint8_t sequence = packet_sequence(payload);
+        if (station->packets > 0 && sequence != station->last_sequence) {
+            station->lost += (uint8_t)(sequence - station->last_sequence - 1);
+        }
+        station->last_sequence = sequence;
+    }
+    station->packets++;
+
+    if (packet_is_batch(payload, payload_length)) {
+        SensorData samples[RADIO_BATCH_MAX_SAMPLES];
+        uint32_t ages_ms[RADIO_BATCH_MAX_SAMPLES];
+        uint8_t count;
+        if (!packet_decode_batch(payload, payload_length, samples, ages_ms, RADIO_BATCH_MAX_SAMPLES, &count)) {
+            rx_errors++;
+            return;
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            gateway_forward_sample(station, rssi, ages_ms[i] + queued_ms, &samples[i]);
+        }
+    } else {
+        SensorData sample;
+        if (!packet_decode(payload, payload_length, &sample)) {
+            rx_errors++;
+            return;
+        }
+        gateway_forward_sample(station, rssi, queued_ms, &sample);
+    }
+}
+
+// Radio in continuous RX, the caller has set up the console
+void gateway_init(void) {
+    spsc_queue_init(&packet_queue, packet_storage, sizeof(GatewayPacket), GATEWAY_PACKET_QUEUE_CAPACITY);
+
+    radio_init(F_433);
+    cc1101_write_reg(CC1101_PKTCTRL1, GATEWAY_PKTCTRL1);
+    cc1101_write_reg(CC1101_MCSM1, GATEWAY_MCSM1);
+    cc1101_receive_continuous(gateway_on_packet);
+    next_stats_us = hal_time_us() + GATEWAY_STATS_INTERVAL_MS * 1000ull;
+}
+
+// Process one received packet or send the periodic stats. Returns false when
+// there was nothing to do; the caller may then wait for an event, at the
+// latest until gateway_next_deadline_us.
+bool gateway_poll(void) {
+    GatewayPacket packet;
+    if (spsc_queue_pop(&packet_queue, &packet)) {
+        gateway_process(&packet);
+        return true;
+    }
+    if (hal_time_us() >= next_stats_us) {
+        gateway_forward_stats();
+        next_stats_us += GATEWAY_STATS_INTERVAL_MS * 1000ull;
+        return true;
+    }
+    return false;
+}
+
+uint64_t gateway_next_deadline_us(void) {
+    return next_stats_us;
+}
+
+void gateway_get_stats(GatewayStats* out) {
+    out->received = packets_received;
+    out->crc_errors = crc_errors;
+    out->rx_errors = rx_errors;
+    out->overruns = spsc_queue_overruns(&packet_queue);
+    out->stations = station_count;
+}
@@ -0,0 +1,36 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GATEWAY_MAX_STATIONS 16
+#define GATEWAY_STATS_INTERVAL_MS 10000
+
+// USB framing: SYNC, type, payload length, payload, CRC-8 over type..payload.
+// Text from radio_init shares the stream; the host resyncs on SYNC + CRC.
+#define GATEWAY_FRAME_SYNC 0xA5
+#define GATEWAY_FRAME_SAMPLE 0x01 // address, RSSI, age (ms), packet count, lost frames, present, one float per channel
+#define GATEWAY_FRAME_STATS 0x02  // received, CRC errors, other errors, overruns, stations
+#define GATEWAY_FRAME_SPREAD 0x03 // address, age (ms), spread bitmap, min/max/stddev floats per channel in it
+
+// Radio config deviating from the station profile. No CRC autoflush: frames
+// failing the CRC reach the handler and are counted in crc_errors.
+#define GATEWAY_PKTCTRL1 0xE4 // No address check: accept every station, append status
+#define GATEWAY_MCSM1 0x3F    // CCA enabled TX->RX RX->RX, ACKs go out without leaving RX
+
+// Counters of the STATS frame
+typedef struct {
+    uint32_t received;
+    uint32_t crc_errors;
+    uint32_t rx_errors;
+    uint32_t overruns;
+    uint8_t stations;
+} GatewayStats;
+
+void gateway_init(void);
+bool gateway_poll(void);
+uint64_t gateway_next_deadline_us(void);
+void gateway_get_stats(GatewayStats* stats);
+
+#endif // GATEWAY_H
@@ -0,0 +1,22 @@
+#include "gateway.h"
+#include "hal.h"
+#include "log.h"
+#include "pico/stdlib.h"
+
+// Receiver firmware, see gateway.c. USB carries the binary sample framing.
+
+int main()
+{
+    stdio_init_all();
+    // Driver log records are never drained here, USB carries only the frames
+    log_init();
+    log_set_level(LOG_LEVEL_ERROR);
+
+    gateway_init();
+    while (true) {
+        if (!gateway_poll()) {
+            // Woken by the radio interrupts, or at the latest by the stats deadline
+            hal_wait_event_until(gateway_next_deadline_us());
+        }
+    }
+}
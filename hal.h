@@ -0,0 +1,168 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Thin seam between the drivers and the platform. Drivers do all bus I/O,
+// pin access, timers, interrupts and delays through these calls, so every
+// transaction is charged to its bus and a different backend can be linked
+// in: hal_pico.c on the RP2040, host/hal_host.c for the host tests (device
+// models on a virtual clock). Nothing here depends on the Pico SDK.
+
+// Buses are opaque; the handles are address constants, usable in static tables
+typedef struct HalI2cBus HalI2cBus;
+typedef struct HalSpiBus HalSpiBus;
+
+extern HalI2cBus hal_i2c0_bus;
+extern HalI2cBus hal_i2c1_bus;
+extern HalSpiBus hal_spi0_bus;
+
+#define HAL_I2C0 (&hal_i2c0_bus)
+#define HAL_I2C1 (&hal_i2c1_bus)
+#define HAL_I2C_COUNT 2
+#define HAL_SPI0 (&hal_spi0_bus)
+
+// Negative results of the bus calls, same values as the Pico SDK's
+#define HAL_ERROR_TIMEOUT (-1) // Missed its deadline
+#define HAL_ERROR_GENERIC (-2) // NAK, or a bus call that could not start
+#define HAL_PENDING       (-3) // hal_i2c_poll: still on the wire
+
+// Per-bus accounting, reset with hal_reset_stats()
+typedef struct {
+    uint32_t transactions;  // Calls into the bus, successful or not
+    uint32_t errors;        // Transactions that returned fewer bytes than asked
+    uint32_t bytes;         // Payload bytes moved (address bytes excluded)
+    uint64_t busy_us;       // Wall time spent inside the bus calls
+    uint32_t timeouts;      // Transactions that ran past their deadline (I2C)
+    uint32_t retries;       // Transactions repeated after an error (I2C)
+    uint32_t recoveries;    // SCL-toggle bus recoveries (I2C)
+} HalBusStats;
+
+// I2C deadlines: a fixed allowance for clock stretching plus twice the
+// nominal time on the wire at the bus clock
+#define HAL_I2C_TIMEOUT_BASE_US 1000
+// Upper bound of hal_i2c_recover at the slowest (100 kHz) clock
+#define HAL_I2C_RECOVER_MAX_US 250
+
+// On-board flash geometry, the Waveshare RP2040-Zero carries 2 MiB
+#ifndef HAL_FLASH_SIZE_BYTES
+#define HAL_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+#endif
+#define HAL_FLASH_SECTOR_SIZE 4096
+#define HAL_FLASH_PAGE_SIZE 256
+// Longest a flash erase/program waits for the other core to stop
+#define HAL_FLASH_LOCKOUT_TIMEOUT_MS 100
+
+// GPIO interrupt edges
+#define HAL_GPIO_EDGE_FALL 0x4
+#define HAL_GPIO_EDGE_RISE 0x8
+
+typedef void (*hal_gpio_callback_t)(uint32_t gpio, uint32_t events);
+typedef void (*hal_alarm_callback_t)(int32_t id);
+typedef void (*hal_done_callback_t)(void);
+
+// Console output, raw bytes without newline translation
+void hal_console_put(uint8_t byte);
+
+// Board unique ID, the flash chip's 64 bit ID on the RP2040
+#define HAL_UNIQUE_ID_SIZE 8
+void hal_unique_id(uint8_t id[HAL_UNIQUE_ID_SIZE]);
+
+// I2C setup: pins with pull-ups, then the controller at hz. The internal
+// pull-ups only carry 100 kHz; faster clocks need external ones.
+void hal_i2c_init(HalI2cBus *i2c, uint32_t sda_pin, uint32_t scl_pin, uint32_t hz);
+uint32_t hal_i2c_set_clock(HalI2cBus *i2c, uint32_t hz);
+uint32_t hal_i2c_get_clock(HalI2cBus *i2c);
+uint32_t hal_i2c_timeout_us(HalI2cBus *i2c, size_t length);
+bool hal_i2c_recover(HalI2cBus *i2c);
+uint8_t hal_i2c_index(const HalI2cBus *i2c);
+HalI2cBus *hal_i2c_bus(uint8_t index);
+
+// I2C, returns the bytes moved or a HAL_ERROR_* code. Each call has a
+// deadline from hal_i2c_timeout_us. A call that misses it returns
+// HAL_ERROR_TIMEOUT after recovering the bus; it is not retried, the
+// register pointer of a split write/read would be lost.
+int hal_i2c_write(HalI2cBus *i2c, uint8_t addr, const uint8_t *src, size_t length, bool nostop);
+int hal_i2c_read(HalI2cBus *i2c, uint8_t addr, uint8_t *dst, size_t length, bool nostop);
+
+// Split-phase I2C for i2c_bus.c: write_length bytes, then read_length bytes
+// after a repeated start, STOP at the end. Runs without the CPU (DMA on the
+// RP2040); hal_i2c_poll returns HAL_PENDING until it is done, then the bytes
+// moved or HAL_ERROR_GENERIC on a NAK. Deadlines are up to the caller, an
+// overdue transfer is stopped with hal_i2c_abort. One transfer per bus, at
+// most HAL_I2C_ASYNC_MAX bytes in total.
+#define HAL_I2C_ASYNC_MAX 16
+bool hal_i2c_start(HalI2cBus *i2c, uint8_t addr, const uint8_t *src, size_t write_length, uint8_t *dst,
+                   size_t read_length);
+int hal_i2c_poll(HalI2cBus *i2c);
+void hal_i2c_abort(HalI2cBus *i2c);
+
+// Charge an I2C transaction that ran outside the blocking calls above
+void hal_i2c_account(HalI2cBus *i2c, uint64_t start_us, int result, size_t length);
+void hal_i2c_account_retry(HalI2cBus *i2c);
+
+// SPI master, mode 0. Blocking calls return the bytes moved.
+uint32_t hal_spi_init(HalSpiBus *spi, uint32_t hz, uint32_t sck_pin, uint32_t mosi_pin, uint32_t miso_pin);
+int hal_spi_write(HalSpiBus *spi, const uint8_t *src, size_t length);
+int hal_spi_read(HalSpiBus *spi, uint8_t repeated_tx, uint8_t *dst, size_t length);
+// Clock length bytes out of tx (NULL: zeros) into rx (NULL: discarded)
+// without the CPU, done runs in interrupt context once the last byte is in.
+// One transfer per bus, the buffers must stay valid until done.
+bool hal_spi_transfer_async(HalSpiBus *spi, const uint8_t *tx, uint8_t *rx, size_t length,
+                            hal_done_callback_t done);
+// Stop an overdue transfer, done is not called
+void hal_spi_abort(HalSpiBus *spi);
+
+// On-board flash, offsets from the start of flash. Erase takes whole
+// sectors, program whole pages. On the RP2040 both run under
+// flash_safe_execute, which locks the other core out; that core must have
+// called flash_safe_execute_core_init. Reads go through the XIP window.
+bool hal_flash_erase(uint32_t offset, size_t length);
+bool hal_flash_program(uint32_t offset, const uint8_t *src, size_t length);
+const uint8_t *hal_flash_read(uint32_t offset);
+
+// GPIO for chip selects and status pins
+void hal_gpio_init_output(uint32_t gpio, bool value);
+void hal_gpio_init_input(uint32_t gpio);
+void hal_gpio_put(uint32_t gpio, bool value);
+bool hal_gpio_get(uint32_t gpio);
+// Edge interrupts on gpio (HAL_GPIO_EDGE_*), delivered to the calling core
+void hal_gpio_set_irq(uint32_t gpio, uint32_t edges, hal_gpio_callback_t callback);
+
+// One-shot alarms in interrupt context, on the core that called
+// hal_alarm_init. hal_alarm_at returns the alarm id, or 0 if the time had
+// already passed and callback ran before it returned.
+void hal_alarm_init(void);
+int32_t hal_alarm_at(uint64_t at_us, hal_alarm_callback_t callback);
+bool hal_alarm_cancel(int32_t id);
+
+// Interrupts on the calling core; events wake a core waiting in
+// hal_wait_event, so do interrupts
+uint32_t hal_irq_save(void);
+void hal_irq_restore(uint32_t state);
+void hal_wait_event(void);
+void hal_wait_event_until(uint64_t at_us);
+void hal_signal_event(void);
+// Body of a busy-wait loop on a flag set from interrupt context
+void hal_spin(void);
+
+// Time base and delays; sleeps are accumulated separately from bus time
+uint64_t hal_time_us(void);
+void hal_sleep_us(uint64_t us);
+void hal_sleep_ms(uint32_t ms);
+void hal_sleep_until(uint64_t at_us);
+
+// CPU cycle counter for short code paths, 24 bits wide on the RP2040
+void hal_cycles_init(void);
+uint32_t hal_cycles_start(void);
+uint32_t hal_cycles_since(uint32_t start);
+
+void hal_get_i2c_stats(HalI2cBus *i2c, HalBusStats *stats);
+void hal_get_spi_stats(HalSpiBus *spi, HalBusStats *stats);
+void hal_get_flash_stats(HalBusStats *stats);
+uint64_t hal_sleep_total_us(void);
+void hal_reset_stats(void);
+
+#endif // HAL_H
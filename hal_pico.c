@@ -0,0 +1,561 @@
+#include "hal.h"
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/spi.h"
+#include "hardware/gpio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/flash.h"
+#include "hardware/structs/systick.h"
+#include "pico/time.h"
+#include "pico/flash.h"
+#include "pico/unique_id.h"
+#include "trace.h"
+#include <string.h>
+
+// RP2040 backend for hal.h: forwards to the Pico SDK and times each call.
+// I2C is driven from core 0 and SPI from core 1, so each bus's counters have
+// a single writer. Flash is written from both, its counters are updated with
+// the other core locked out.
+
+_Static_assert(HAL_FLASH_SIZE_BYTES == PICO_FLASH_SIZE_BYTES, "flash size");
+_Static_assert(HAL_FLASH_SECTOR_SIZE == FLASH_SECTOR_SIZE, "flash sector size");
+_Static_assert(HAL_FLASH_PAGE_SIZE == FLASH_PAGE_SIZE, "flash page size");
+_Static_assert(HAL_UNIQUE_ID_SIZE == PICO_UNIQUE_BOARD_ID_SIZE_BYTES, "unique ID size");
+_Static_assert(HAL_GPIO_EDGE_RISE == GPIO_IRQ_EDGE_RISE && HAL_GPIO_EDGE_FALL == GPIO_IRQ_EDGE_FALL,
+               "gpio edges");
+_Static_assert(HAL_ERROR_GENERIC == PICO_ERROR_GENERIC && HAL_ERROR_TIMEOUT == PICO_ERROR_TIMEOUT,
+               "error codes");
+
+struct HalI2cBus {
+    i2c_inst_t *i2c;
+    uint32_t sda_pin;
+    uint32_t scl_pin;
+    uint32_t clock_hz; // Actual clock after i2c_set_baudrate rounding
+    // hal_i2c_start: one DMA channel feeds IC_DATA_CMD with the write bytes
+    // and read commands, the other drains the replies
+    int tx_channel;
+    int rx_channel;
+    uint32_t commands[HAL_I2C_ASYNC_MAX];
+    size_t async_length;
+    bool async_read;
+    HalBusStats stats;
+};
+
+struct HalSpiBus {
+    spi_inst_t *spi;
+    // hal_spi_transfer_async: one channel feeds the TX FIFO, the other
+    // drains RX so reads land in the buffer and writes never overrun it
+    int tx_channel;
+    int rx_channel;
+    hal_done_callback_t done;
+    uint64_t async_start_us;
+    size_t async_length;
+    uint8_t dummy_tx;
+    uint8_t dummy_rx;
+    HalBusStats stats;
+};
+
+HalI2cBus hal_i2c0_bus = {.i2c = i2c0, .tx_channel = -1, .rx_channel = -1};
+HalI2cBus hal_i2c1_bus = {.i2c = i2c1, .tx_channel = -1, .rx_channel = -1};
+HalSpiBus hal_spi0_bus = {.spi = spi0, .tx_channel = -1, .rx_channel = -1};
+
+static HalBusStats flash_stats; // transactions = erases + programs, bytes = programmed
+static uint64_t sleep_total_us;
+static hal_gpio_callback_t gpio_callbacks[2]; // Per core, set and called on the same one
+static alarm_pool_t *alarm_pool;
+
+static void hal_account(HalBusStats *stats, uint64_t start_us, int result, size_t length) {
+    stats->busy_us += time_us_64() - start_us;
+    stats->transactions++;
+    if (result == PICO_ERROR_TIMEOUT) {
+        stats->timeouts++;
+    }
+    if (result == (int)length) {
+        stats->bytes += length;
+    } else {
+        stats->errors++;
+        if (result > 0) {
+            stats->bytes += result;
+        }
+    }
+}
+
+void hal_console_put(uint8_t byte) {
+    putchar_raw(byte);
+}
+
+// Read from flash by the SDK at boot, no flash access here
+void hal_unique_id(uint8_t id[HAL_UNIQUE_ID_SIZE]) {
+    pico_unique_board_id_t board_id;
+    pico_get_unique_board_id(&board_id);
+    memcpy(id, board_id.id, HAL_UNIQUE_ID_SIZE);
+}
+
+uint8_t hal_i2c_index(const HalI2cBus *i2c) {
+    return i2c == HAL_I2C1 ? 1 : 0;
+}
+
+HalI2cBus *hal_i2c_bus(uint8_t index) {
+    return index == 1 ? HAL_I2C1 : HAL_I2C0;
+}
+
+void hal_i2c_init(HalI2cBus *bus, uint32_t sda_pin, uint32_t scl_pin, uint32_t hz) {
+    bus->sda_pin = sda_pin;
+    bus->scl_pin = scl_pin;
+    bus->clock_hz = i2c_init(bus->i2c, hz);
+
+    gpio_set_function(sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(scl_pin, GPIO_FUNC_I2C);
+    gpio_pull_up(sda_pin);
+    gpio_pull_up(scl_pin);
+
+    if (bus->tx_channel < 0) {
+        bus->tx_channel = dma_claim_unused_channel(true);
+        bus->rx_channel = dma_claim_unused_channel(true);
+    }
+}
+
+uint32_t hal_i2c_set_clock(HalI2cBus *bus, uint32_t hz) {
+    bus->clock_hz = i2c_set_baudrate(bus->i2c, hz);
+    return bus->clock_hz;
+}
+
+uint32_t hal_i2c_get_clock(HalI2cBus *bus) {
+    return bus->clock_hz;
+}
+
+// Deadline for a transaction moving length bytes plus the address byte
+uint32_t hal_i2c_timeout_us(HalI2cBus *bus, size_t length) {
+    uint32_t hz = bus->clock_hz;
+    if (hz == 0) {
+        hz = 100000;
+    }
+    return HAL_I2C_TIMEOUT_BASE_US + (uint32_t)(2 * 9 * (length + 1) * 1000000ull / hz);
+}
+
+// A slave reset or glitched mid-byte can hold SDA low forever. Take the pins
+// over, clock SCL (open drain, by switching the pin direction) until the
+// slave lets go of SDA, at most nine times, then send a STOP and hand the
+// pins back to a reinitialised controller. Returns true if the bus is free.
+bool hal_i2c_recover(HalI2cBus *bus) {
+    const uint half_period_us = 5; // 100 kHz, every slave keeps up
+
+    gpio_set_function(bus->sda_pin, GPIO_FUNC_SIO);
+    gpio_set_function(bus->scl_pin, GPIO_FUNC_SIO);
+    gpio_put(bus->sda_pin, 0);
+    gpio_put(bus->scl_pin, 0);
+    gpio_set_dir(bus->sda_pin, GPIO_IN);
+    gpio_set_dir(bus->scl_pin, GPIO_IN);
+    busy_wait_us(half_period_us);
+
+    for (int pulse = 0; pulse < 9 && !gpio_get(bus->sda_pin); pulse++) {
+        gpio_set_dir(bus->scl_pin, GPIO_OUT); // SCL low
+        busy_wait_us(half_period_us);
+        gpio_set_dir(bus->scl_pin, GPIO_IN);  // SCL released
+        busy_wait_us(half_period_us);
+    }
+
+    // STOP: SDA rises while SCL is high
+    gpio_set_dir(bus->scl_pin, GPIO_OUT);
+    busy_wait_us(half_period_us);
+    gpio_set_dir(bus->sda_pin, GPIO_OUT);
+    busy_wait_us(half_period_us);
+    gpio_set_dir(bus->scl_pin, GPIO_IN);
+    busy_wait_us(half_period_us);
+    gpio_set_dir(bus->sda_pin, GPIO_IN);
+    busy_wait_us(half_period_us);
+    bool released = gpio_get(bus->sda_pin) && gpio_get(bus->scl_pin);
+
+    // The controller may be mid-transfer too, start it from reset
+    uint32_t hz = bus->clock_hz;
+    i2c_deinit(bus->i2c);
+    bus->clock_hz = i2c_init(bus->i2c, hz);
+    gpio_set_function(bus->sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(bus->scl_pin, GPIO_FUNC_I2C);
+
+    bus->stats.recoveries++;
+    TRACE_INSTANT(TRACE_I2C_RECOVER, (hal_i2c_index(bus) << 8) | released);
+    return released;
+}
+
+int hal_i2c_write(HalI2cBus *bus, uint8_t addr, const uint8_t *src, size_t length, bool nostop) {
+    TRACE_BEGIN(TRACE_I2C_WRITE, (addr << 8) | (length & 0xFF));
+    uint64_t start = time_us_64();
+    int result = i2c_write_timeout_us(bus->i2c, addr, src, length, nostop, hal_i2c_timeout_us(bus, length));
+    hal_account(&bus->stats, start, result, length);
+    TRACE_END(TRACE_I2C_WRITE, result);
+    if (result == PICO_ERROR_TIMEOUT) {
+        hal_i2c_recover(bus);
+    }
+    return result;
+}
+
+int hal_i2c_read(HalI2cBus *bus, uint8_t addr, uint8_t *dst, size_t length, bool nostop) {
+    TRACE_BEGIN(TRACE_I2C_READ, (addr << 8) | (length & 0xFF));
+    uint64_t start = time_us_64();
+    int result = i2c_read_timeout_us(bus->i2c, addr, dst, length, nostop, hal_i2c_timeout_us(bus, length));
+    hal_account(&bus->stats, start, result, length);
+    TRACE_END(TRACE_I2C_READ, result);
+    if (result == PICO_ERROR_TIMEOUT) {
+        hal_i2c_recover(bus);
+    }
+    return result;
+}
+
+bool hal_i2c_start(HalI2cBus *bus, uint8_t addr, const uint8_t *src, size_t write_length, uint8_t *dst,
+                   size_t read_length) {
+    size_t count = 0;
+    if (write_length + read_length == 0 || write_length + read_length > HAL_I2C_ASYNC_MAX) {
+        return false;
+    }
+    i2c_hw_t *hw = i2c_get_hw(bus->i2c);
+
+    // Write bytes, then read commands; STOP on the last one, RESTART on the
+    // turnaround from writing to reading
+    for (size_t i = 0; i < write_length; i++) {
+        bool last = i == write_length - 1 && read_length == 0;
+        bus->commands[count++] = src[i] | (last ? I2C_IC_DATA_CMD_STOP_BITS : 0);
+    }
+    for (size_t i = 0; i < read_length; i++) {
+        uint32_t command = I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == 0 && write_length > 0) {
+            command |= I2C_IC_DATA_CMD_RESTART_BITS;
+        }
+        if (i == read_length - 1) {
+            command |= I2C_IC_DATA_CMD_STOP_BITS;
+        }
+        bus->commands[count++] = command;
+    }
+
+    // The target address can only change with the controller disabled
+    hw->enable = 0;
+    hw->tar = addr;
+    hw->enable = I2C_IC_ENABLE_ENABLE_BITS;
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+
+    uint32_t mask = 1u << bus->tx_channel;
+    if (read_length > 0) {
+        dma_channel_config config = dma_channel_get_default_config(bus->rx_channel);
+        channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+        channel_config_set_dreq(&config, i2c_get_dreq(bus->i2c, false));
+        channel_config_set_read_increment(&config, false);
+        channel_config_set_write_increment(&config, true);
+        dma_channel_configure(bus->rx_channel, &config, dst, &hw->data_cmd, read_length, false);
+        mask |= 1u << bus->rx_channel;
+    }
+    dma_channel_config config = dma_channel_get_default_config(bus->tx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_dreq(&config, i2c_get_dreq(bus->i2c, true));
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    dma_channel_configure(bus->tx_channel, &config, &hw->data_cmd, bus->commands, count, false);
+
+    bus->async_length = count;
+    bus->async_read = read_length > 0;
+    dma_start_channel_mask(mask);
+    return true;
+}
+
+int hal_i2c_poll(HalI2cBus *bus) {
+    uint32_t status = i2c_get_hw(bus->i2c)->raw_intr_stat;
+    if (status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        return PICO_ERROR_GENERIC; // Address or data NAK
+    }
+    if ((status & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS) && !dma_channel_is_busy(bus->tx_channel) &&
+        (!bus->async_read || !dma_channel_is_busy(bus->rx_channel))) {
+        return (int)bus->async_length;
+    }
+    return HAL_PENDING;
+}
+
+void hal_i2c_abort(HalI2cBus *bus) {
+    dma_channel_abort(bus->tx_channel);
+    dma_channel_abort(bus->rx_channel);
+    (void)i2c_get_hw(bus->i2c)->clr_tx_abrt;
+}
+
+void hal_i2c_account(HalI2cBus *bus, uint64_t start_us, int result, size_t length) {
+    hal_account(&bus->stats, start_us, result, length);
+}
+
+void hal_i2c_account_retry(HalI2cBus *bus) {
+    bus->stats.retries++;
+}
+
+// The RX channel completes last, at that point the whole transfer is clocked out
+static void hal_spi_dma_irq(void) {
+    HalSpiBus *bus = HAL_SPI0;
+    if (bus->rx_channel < 0 || !dma_channel_get_irq0_status(bus->rx_channel)) {
+        return;
+    }
+    dma_channel_acknowledge_irq0(bus->rx_channel);
+    hal_account(&bus->stats, bus->async_start_us, (int)bus->async_length, bus->async_length);
+
+    hal_done_callback_t done = bus->done;
+    bus->done = NULL;
+    if (done != NULL) {
+        done();
+    }
+}
+
+// Pins, clock and the DMA channels; the completion interrupt is taken on the
+// calling core
+uint32_t hal_spi_init(HalSpiBus *bus, uint32_t hz, uint32_t sck_pin, uint32_t mosi_pin, uint32_t miso_pin) {
+    uint32_t actual_hz = spi_init(bus->spi, hz);
+    gpio_set_function(sck_pin, GPIO_FUNC_SPI);
+    gpio_set_function(mosi_pin, GPIO_FUNC_SPI);
+    gpio_set_function(miso_pin, GPIO_FUNC_SPI);
+
+    if (bus->tx_channel < 0) {
+        bus->tx_channel = dma_claim_unused_channel(true);
+        bus->rx_channel = dma_claim_unused_channel(true);
+        dma_channel_set_irq0_enabled(bus->rx_channel, true);
+        irq_add_shared_handler(DMA_IRQ_0, hal_spi_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+    }
+    return actual_hz;
+}
+
+int hal_spi_write(HalSpiBus *bus, const uint8_t *src, size_t length) {
+    TRACE_BEGIN(TRACE_SPI_WRITE, length);
+    uint64_t start = time_us_64();
+    int result = spi_write_blocking(bus->spi, src, length);
+    hal_account(&bus->stats, start, result, length);
+    TRACE_END(TRACE_SPI_WRITE, result);
+    return result;
+}
+
+int hal_spi_read(HalSpiBus *bus, uint8_t repeated_tx, uint8_t *dst, size_t length) {
+    TRACE_BEGIN(TRACE_SPI_READ, length);
+    uint64_t start = time_us_64();
+    int result = spi_read_blocking(bus->spi, repeated_tx, dst, length);
+    hal_account(&bus->stats, start, result, length);
+    TRACE_END(TRACE_SPI_READ, result);
+    return result;
+}
+
+bool hal_spi_transfer_async(HalSpiBus *bus, const uint8_t *tx, uint8_t *rx, size_t length,
+                            hal_done_callback_t done) {
+    if (bus->tx_channel < 0 || length == 0 || bus->done != NULL) {
+        return false;
+    }
+    bus->done = done;
+    bus->async_length = length;
+
+    dma_channel_config config = dma_channel_get_default_config(bus->tx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_dreq(&config, spi_get_dreq(bus->spi, true));
+    channel_config_set_read_increment(&config, tx != NULL);
+    channel_config_set_write_increment(&config, false);
+    dma_channel_configure(bus->tx_channel, &config, &spi_get_hw(bus->spi)->dr,
+                          tx != NULL ? tx : &bus->dummy_tx, length, false);
+
+    config = dma_channel_get_default_config(bus->rx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_dreq(&config, spi_get_dreq(bus->spi, false));
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, rx != NULL);
+    dma_channel_configure(bus->rx_channel, &config, rx != NULL ? rx : &bus->dummy_rx,
+                          &spi_get_hw(bus->spi)->dr, length, false);
+
+    bus->async_start_us = time_us_64();
+    dma_start_channel_mask((1u << bus->tx_channel) | (1u << bus->rx_channel));
+    return true;
+}
+
+void hal_spi_abort(HalSpiBus *bus) {
+    if (bus->tx_channel < 0 || bus->done == NULL) {
+        return;
+    }
+    dma_channel_abort(bus->tx_channel);
+    dma_channel_abort(bus->rx_channel);
+    dma_channel_acknowledge_irq0(bus->rx_channel); // The abort may raise it
+    bus->done = NULL;
+    hal_account(&bus->stats, bus->async_start_us, PICO_ERROR_TIMEOUT, bus->async_length);
+}
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t *src; // NULL to erase
+    size_t length;
+} HalFlashOp;
+
+// Runs with the other core locked out and interrupts off
+static void hal_flash_execute(void *param) {
+    const HalFlashOp *op = param;
+    uint64_t start = time_us_64();
+    if (op->src == NULL) {
+        flash_range_erase(op->offset, op->length);
+    } else {
+        flash_range_program(op->offset, op->src, op->length);
+        flash_stats.bytes += op->length;
+    }
+    flash_stats.busy_us += time_us_64() - start;
+    flash_stats.transactions++;
+}
+
+static bool hal_flash_run(const HalFlashOp *op) {
+    if (flash_safe_execute(hal_flash_execute, (void *)op, HAL_FLASH_LOCKOUT_TIMEOUT_MS) != PICO_OK) {
+        flash_stats.errors++; // Nothing was written, the other core is not locked out
+        return false;
+    }
+    return true;
+}
+
+bool hal_flash_erase(uint32_t offset, size_t length) {
+    HalFlashOp op = {offset, NULL, length};
+    return hal_flash_run(&op);
+}
+
+bool hal_flash_program(uint32_t offset, const uint8_t *src, size_t length) {
+    HalFlashOp op = {offset, src, length};
+    return hal_flash_run(&op);
+}
+
+const uint8_t *hal_flash_read(uint32_t offset) {
+    return (const uint8_t *)(uintptr_t)(XIP_BASE + offset);
+}
+
+void hal_gpio_init_output(uint32_t gpio, bool value) {
+    gpio_init(gpio);
+    gpio_put(gpio, value);
+    gpio_set_dir(gpio, GPIO_OUT);
+}
+
+void hal_gpio_init_input(uint32_t gpio) {
+    gpio_init(gpio);
+    gpio_set_dir(gpio, GPIO_IN);
+}
+
+void hal_gpio_put(uint32_t gpio, bool value) {
+    gpio_put(gpio, value);
+}
+
+bool hal_gpio_get(uint32_t gpio) {
+    return gpio_get(gpio);
+}
+
+// The SDK keeps one GPIO callback per core, so does this: the interrupt is
+// taken on the core that enabled it
+static void hal_gpio_irq(uint gpio, uint32_t events) {
+    hal_gpio_callback_t callback = gpio_callbacks[get_core_num()];
+    if (callback != NULL) {
+        callback(gpio, events);
+    }
+}
+
+void hal_gpio_set_irq(uint32_t gpio, uint32_t edges, hal_gpio_callback_t callback) {
+    gpio_callbacks[get_core_num()] = callback;
+    gpio_set_irq_enabled_with_callback(gpio, edges, true, hal_gpio_irq);
+}
+
+static int64_t hal_alarm_fire(alarm_id_t id, void *user_data) {
+    hal_alarm_callback_t callback = (hal_alarm_callback_t)(uintptr_t)user_data;
+    callback(id);
+    return 0; // One-shot
+}
+
+// A pool of its own, so the alarms fire on this core
+void hal_alarm_init(void) {
+    if (alarm_pool == NULL) {
+        alarm_pool = alarm_pool_create_with_unused_hardware_alarm(2);
+    }
+}
+
+int32_t hal_alarm_at(uint64_t at_us, hal_alarm_callback_t callback) {
+    return alarm_pool_add_alarm_at(alarm_pool, from_us_since_boot(at_us), hal_alarm_fire,
+                                   (void *)(uintptr_t)callback, true);
+}
+
+bool hal_alarm_cancel(int32_t id) {
+    return id > 0 && alarm_pool_cancel_alarm(alarm_pool, id);
+}
+
+uint32_t hal_irq_save(void) {
+    return save_and_disable_interrupts();
+}
+
+void hal_irq_restore(uint32_t state) {
+    restore_interrupts(state);
+}
+
+void hal_wait_event(void) {
+    __wfe();
+}
+
+void hal_wait_event_until(uint64_t at_us) {
+    best_effort_wfe_or_timeout(from_us_since_boot(at_us));
+}
+
+void hal_signal_event(void) {
+    __sev();
+}
+
+void hal_spin(void) {
+    tight_loop_contents();
+}
+
+uint64_t hal_time_us(void) {
+    return time_us_64();
+}
+
+void hal_sleep_us(uint64_t us) {
+    TRACE_BEGIN(TRACE_SLEEP, us / 1000);
+    sleep_us(us);
+    sleep_total_us += us;
+    TRACE_END(TRACE_SLEEP, 0);
+}
+
+void hal_sleep_ms(uint32_t ms) {
+    hal_sleep_us((uint64_t)ms * 1000);
+}
+
+void hal_sleep_until(uint64_t at_us) {
+    TRACE_BEGIN(TRACE_SLEEP, 0);
+    uint64_t start = time_us_64();
+    sleep_until(from_us_since_boot(at_us));
+    sleep_total_us += time_us_64() - start;
+    TRACE_END(TRACE_SLEEP, 0);
+}
+
+// SysTick as a cycle counter, it counts down and wraps at 24 bits
+void hal_cycles_init(void) {
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->csr = 0x5; // Enabled, processor clock
+}
+
+uint32_t hal_cycles_start(void) {
+    systick_hw->cvr = 0;
+    return systick_hw->cvr;
+}
+
+uint32_t hal_cycles_since(uint32_t start) {
+    return (start - systick_hw->cvr) & 0x00FFFFFF;
+}
+
+void hal_get_i2c_stats(HalI2cBus *bus, HalBusStats *stats) {
+    *stats = bus->stats;
+}
+
+void hal_get_spi_stats(HalSpiBus *bus, HalBusStats *stats) {
+    *stats = bus->stats;
+}
+
+void hal_get_flash_stats(HalBusStats *stats) {
+    *stats = flash_stats;
+}
+
+uint64_t hal_sleep_total_us(void) {
+    return sleep_total_us;
+}
+
+void hal_reset_stats(void) {
+    memset(&hal_i2c0_bus.stats, 0, sizeof(HalBusStats));
+    memset(&hal_i2c1_bus.stats, 0, sizeof(HalBusStats));
+    memset(&hal_spi0_bus.stats, 0, sizeof(HalBusStats));
+    memset(&flash_stats, 0, sizeof(flash_stats));
+    sleep_total_us = 0;
+}
@@ -0,0 +1,492 @@
+#include "cc1101_model.h"
+#include "cc1101.h"
+#include <string.h>
+
+#define MODEL_AIR_FRAMES 16
+#define MODEL_RSSI_RAW 0x1C // -60 dBm
+#define MODEL_LQI 0x20
+
+typedef enum {
+    MODEL_SLEEP,
+    MODEL_IDLE,
+    MODEL_CAL_RX, // Calibrating, RX afterwards
+    MODEL_CAL_TX,
+    MODEL_RX,
+    MODEL_TX,
+    MODEL_RX_OVERFLOW,
+} ModelState;
+
+typedef struct {
+    bool used;
+    uint8_t frame[CC1101_FIFO_SIZE];
+    uint8_t length;
+    bool crc_ok;
+    uint64_t start_us; // Preamble starts
+    uint64_t sync_us;
+    uint64_t end_us;
+} AirFrame;
+
+static const uint8_t model_reset_regs[CC1101_CONFIG_SIZE] = {
+    0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04, 0x45, 0x00, 0x00, 0x0F, 0x00, 0x1E, 0xC4, 0xEC,
+    0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30, 0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B,
+    0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41, 0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B,
+};
+
+static struct {
+    HostSpiDevice device;
+    uint8_t regs[CC1101_CONFIG_SIZE];
+    uint8_t patable[CC1101_PATABLE_SIZE];
+    ModelState state;
+    uint64_t ready_us;      // CHIP_RDYn low from then on
+    uint64_t rx_since_us;   // Listening since
+    AirFrame *receiving;    // Sync seen, frame on its way in
+    int32_t state_event;    // Calibration end or TX progress
+    int32_t rx_event;       // End of the frame being received
+    bool gdo0;
+    uint8_t rx_fifo[CC1101_FIFO_SIZE];
+    uint8_t rx_count;
+    uint8_t tx_fifo[CC1101_FIFO_SIZE];
+    uint8_t tx_count;
+    // SPI decoding, one access per header byte
+    bool header_next;
+    uint8_t addr;
+    bool read;
+    bool burst;
+    uint8_t patable_index;
+    bool power_down_pending;
+    AirFrame air[MODEL_AIR_FRAMES];
+    uint64_t air_busy_until_us;
+    cc1101_model_tx_hook_t tx_hook;
+    void *tx_context;
+    Cc1101ModelStats stats;
+} model;
+
+// Modem timing from the registers
+
+static double model_bit_us(void) {
+    uint8_t exponent = model.regs[CC1101_MDMCFG4] & 0x0F;
+    uint8_t mantissa = model.regs[CC1101_MDMCFG3];
+    double rate = (256.0 + mantissa) * (double)(1u << exponent) * 26e6 / (double)(1u << 28);
+    return 1e6 / rate;
+}
+
+static uint8_t model_sync_bytes(void) {
+    uint8_t mode = model.regs[CC1101_MDMCFG2] & 0x07;
+    return (mode == 0 || mode == 4) ? 0 : (mode == 3 || mode == 7) ? 4 : 2;
+}
+
+uint32_t cc1101_model_sync_us(void) {
+    static const uint8_t preamble[8] = {2, 3, 4, 6, 8, 12, 16, 24};
+    uint32_t bytes = preamble[(model.regs[CC1101_MDMCFG1] >> 4) & 0x07] + model_sync_bytes();
+    return (uint32_t)(bytes * 8 * model_bit_us() + 0.999);
+}
+
+uint32_t cc1101_model_frame_us(uint8_t length) {
+    uint32_t bytes = length + ((model.regs[CC1101_PKTCTRL0] & 0x04) ? 2 : 0);
+    return (uint32_t)(bytes * 8 * model_bit_us() + 0.999);
+}
+
+// State machine
+
+static void model_gdo0(bool level) {
+    if (model.gdo0 != level) {
+        model.gdo0 = level;
+        hal_host_gpio_drive(CC1101_GDO0_PIN, level);
+    }
+}
+
+static void model_cancel_events(void) {
+    hal_host_cancel(model.state_event);
+    hal_host_cancel(model.rx_event);
+    model.state_event = 0;
+    model.rx_event = 0;
+    model.receiving = NULL;
+}
+
+static void model_enter_rx(void) {
+    model.state = MODEL_RX;
+    model.rx_since_us = hal_time_us();
+}
+
+static void model_tx_sync(int32_t id, void *context);
+static void model_tx_end(int32_t id, void *context);
+
+static void model_start_tx(void) {
+    // Underflow: nothing complete to send
+    if (model.tx_count == 0 || model.tx_count < model.tx_fifo[0] + 1) {
+        model.state = MODEL_IDLE;
+        return;
+    }
+    model.state = MODEL_TX;
+    model.receiving = NULL;
+    hal_host_cancel(model.rx_event);
+    model.rx_event = 0;
+    uint64_t sync_us = hal_time_us() + cc1101_model_sync_us();
+    uint64_t end_us = sync_us + cc1101_model_frame_us(model.tx_fifo[0] + 1);
+    if (end_us > model.air_busy_until_us) {
+        model.air_busy_until_us = end_us;
+    }
+    model.state_event = hal_host_schedule(sync_us, model_tx_sync, NULL);
+}
+
+static void model_tx_sync(int32_t id, void *context) {
+    model_gdo0(true);
+    uint8_t length = model.tx_fifo[0] + 1;
+    model.state_event = hal_host_schedule(hal_time_us() + cc1101_model_frame_us(length), model_tx_end, NULL);
+}
+
+static void model_tx_end(int32_t id, void *context) {
+    model.state_event = 0;
+    uint8_t length = model.tx_fifo[0] + 1;
+    model.stats.sent++;
+    uint8_t frame[CC1101_FIFO_SIZE];
+    memcpy(frame, model.tx_fifo, length);
+    model.tx_count -= length;
+    memmove(model.tx_fifo, &model.tx_fifo[length], model.tx_count);
+
+    // TXOFF_MODE
+    switch (model.regs[CC1101_MCSM1] & 0x03) {
+        case 2:
+            model_start_tx();
+            break;
+        case 3:
+            model_enter_rx();
+            break;
+        default:
+            model.state = MODEL_IDLE;
+            break;
+    }
+    model_gdo0(false);
+    if (model.tx_hook != NULL) {
+        model.tx_hook(frame, length, model.tx_context);
+    }
+}
+
+static void model_calibrated(int32_t id, void *context) {
+    model.state_event = 0;
+    model.stats.calibrations++;
+    if (model.state == MODEL_CAL_RX) {
+        model_enter_rx();
+    } else if (model.state == MODEL_CAL_TX) {
+        model_start_tx();
+    }
+}
+
+// IDLE -> RX/TX, through calibration with MCSM0.FS_AUTOCAL = 1
+static void model_leave_idle(ModelState calibrating) {
+    if (((model.regs[CC1101_MCSM0] >> 4) & 0x03) == 1) {
+        model.state = calibrating;
+        model.state_event = hal_host_schedule(hal_time_us() + CC1101_MODEL_CAL_US, model_calibrated, NULL);
+    } else if (calibrating == MODEL_CAL_RX) {
+        model_enter_rx();
+    } else {
+        model_start_tx();
+    }
+}
+
+static bool model_channel_busy(void) {
+    uint64_t now = hal_time_us();
+    if (model.receiving != NULL) {
+        return true;
+    }
+    for (int i = 0; i < MODEL_AIR_FRAMES; i++) {
+        if (model.air[i].used && model.air[i].start_us <= now && now < model.air[i].end_us) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool model_address_ok(const AirFrame *frame) {
+    uint8_t mode = model.regs[CC1101_PKTCTRL1] & 0x03;
+    uint8_t addr = frame->length > 1 ? frame->frame[1] : 0;
+    return mode == 0 || addr == model.regs[CC1101_ADDR] || (mode >= 2 && addr == 0x00) ||
+           (mode == 3 && addr == 0xFF);
+}
+
+static void model_rx_end(int32_t id, void *context) {
+    AirFrame *frame = context;
+    model.rx_event = 0;
+    model.receiving = NULL;
+
+    bool autoflush = model.regs[CC1101_PKTCTRL1] & 0x08;
+    bool append = model.regs[CC1101_PKTCTRL1] & 0x04;
+    if (frame->frame[0] > model.regs[CC1101_PKTLEN] || !model_address_ok(frame) ||
+        (!frame->crc_ok && autoflush)) {
+        // Dropped, the radio goes back to listening for sync
+        model.stats.filtered++;
+        model_gdo0(false);
+        return;
+    }
+
+    uint8_t bytes = frame->length + (append ? 2 : 0);
+    if (model.rx_count + bytes > CC1101_FIFO_SIZE) {
+        model.rx_count = CC1101_FIFO_SIZE;
+        model.state = MODEL_RX_OVERFLOW;
+        model.stats.overflows++;
+        model_gdo0(false);
+        return;
+    }
+    memcpy(&model.rx_fifo[model.rx_count], frame->frame, frame->length);
+    model.rx_count += frame->length;
+    if (append) {
+        model.rx_fifo[model.rx_count++] = MODEL_RSSI_RAW;
+        model.rx_fifo[model.rx_count++] = (frame->crc_ok ? CC1101_LQI_CRC_OK : 0) | MODEL_LQI;
+    }
+    model.stats.received++;
+
+    // RXOFF_MODE
+    switch ((model.regs[CC1101_MCSM1] >> 2) & 0x03) {
+        case 2:
+            model_start_tx();
+            break;
+        case 3:
+            break;
+        default:
+            model.state = MODEL_IDLE;
+            break;
+    }
+    model_gdo0(false);
+}
+
+static void model_rx_sync(int32_t id, void *context) {
+    AirFrame *frame = context;
+    uint32_t sync_word_us = (uint32_t)(model_sync_bytes() * 8 * model_bit_us());
+    if (model.state != MODEL_RX || model.receiving != NULL ||
+        model.rx_since_us + sync_word_us > frame->sync_us) {
+        model.stats.lost++;
+        return;
+    }
+    model.receiving = frame;
+    model_gdo0(true);
+    model.rx_event = hal_host_schedule(frame->end_us, model_rx_end, frame);
+}
+
+void cc1101_model_inject(const uint8_t *data, uint8_t length, uint64_t sync_us, bool crc_ok) {
+    uint64_t now = hal_time_us();
+    AirFrame *frame = NULL;
+    for (int i = 0; i < MODEL_AIR_FRAMES && frame == NULL; i++) {
+        if (!model.air[i].used || (model.air[i].end_us < now && &model.air[i] != model.receiving)) {
+            frame = &model.air[i];
+        }
+    }
+    if (frame == NULL || length > CC1101_FIFO_SIZE) {
+        model.stats.lost++;
+        return;
+    }
+    frame->used = true;
+    memcpy(frame->frame, data, length);
+    frame->length = length;
+    frame->crc_ok = crc_ok;
+    frame->sync_us = sync_us;
+    frame->start_us = sync_us - cc1101_model_sync_us();
+    frame->end_us = sync_us + cc1101_model_frame_us(length);
+    if (frame->end_us > model.air_busy_until_us) {
+        model.air_busy_until_us = frame->end_us;
+    }
+    hal_host_schedule(sync_us, model_rx_sync, frame);
+}
+
+// SPI
+
+static void model_reset(void) {
+    model_cancel_events();
+    memcpy(model.regs, model_reset_regs, sizeof(model.regs));
+    memset(model.patable, 0, sizeof(model.patable));
+    model.patable[0] = 0xC6;
+    model.rx_count = 0;
+    model.tx_count = 0;
+    model.state = MODEL_IDLE;
+    model_gdo0(false);
+}
+
+static void model_strobe(uint8_t strobe) {
+    switch (strobe) {
+        case CC1101_SRES:
+            model_reset();
+            model.ready_us = hal_time_us() + CC1101_MODEL_RESET_US;
+            break;
+        case CC1101_SRX:
+            if (model.state == MODEL_IDLE) {
+                model_leave_idle(MODEL_CAL_RX);
+            }
+            break;
+        case CC1101_STX:
+            if (model.state == MODEL_IDLE) {
+                model_leave_idle(MODEL_CAL_TX);
+            } else if (model.state == MODEL_RX) {
+                // CCA_MODE: stay in RX while the channel is not clear
+                if (((model.regs[CC1101_MCSM1] >> 4) & 0x03) == 0 || !model_channel_busy()) {
+                    model_start_tx();
+                }
+            }
+            break;
+        case CC1101_SIDLE:
+            if (model.state != MODEL_SLEEP) {
+                model_cancel_events();
+                model.state = MODEL_IDLE;
+                model_gdo0(false);
+            }
+            break;
+        case CC1101_SFRX:
+            if (model.state == MODEL_IDLE || model.state == MODEL_RX_OVERFLOW) {
+                model.rx_count = 0;
+                model.state = MODEL_IDLE;
+            }
+            break;
+        case CC1101_SFTX:
+            if (model.state == MODEL_IDLE) {
+                model.tx_count = 0;
+            }
+            break;
+        case CC1101_SPWD:
+            model.power_down_pending = true;
+            break;
+        default:
+            break;
+    }
+}
+
+static uint8_t model_marcstate(void) {
+    static const uint8_t marcstate[] = {
+        [MODEL_SLEEP] = 0x00, [MODEL_IDLE] = 0x01,  [MODEL_CAL_RX] = 0x08, [MODEL_CAL_TX] = 0x08,
+        [MODEL_RX] = 0x0D,    [MODEL_TX] = 0x13,    [MODEL_RX_OVERFLOW] = CC1101_MARCSTATE_RXFIFO_OVERFLOW,
+    };
+    return marcstate[model.state];
+}
+
+static uint8_t model_status_reg(uint8_t addr) {
+    switch (addr) {
+        case CC1101_PARTNUM:
+            return 0x00;
+        case CC1101_VERSION:
+            return 0x14;
+        case CC1101_RSSI:
+            return MODEL_RSSI_RAW;
+        case CC1101_MARCSTATE:
+            return model_marcstate();
+        case CC1101_PKTSTATUS:
+            return model.gdo0 ? 0x01 : 0x00;
+        case CC1101_TXBYTES:
+            return model.tx_count;
+        case CC1101_RXBYTES:
+            return model.rx_count | (model.state == MODEL_RX_OVERFLOW ? 0x80 : 0);
+        default:
+            return 0;
+    }
+}
+
+// Chip status byte: CHIP_RDYn, STATE, FIFO bytes available
+static uint8_t model_chip_status(void) {
+    static const uint8_t states[] = {
+        [MODEL_SLEEP] = 0, [MODEL_IDLE] = 0, [MODEL_CAL_RX] = 4, [MODEL_CAL_TX] = 4,
+        [MODEL_RX] = 1,    [MODEL_TX] = 2,   [MODEL_RX_OVERFLOW] = 6,
+    };
+    bool ready = hal_time_us() >= model.ready_us;
+    uint8_t available = model.read ? model.rx_count : CC1101_FIFO_SIZE - model.tx_count;
+    return (ready ? 0 : 0x80) | states[model.state] << 4 | (available > 15 ? 15 : available);
+}
+
+static uint8_t model_transfer(HostSpiDevice *device, uint8_t mosi) {
+    if (model.header_next) {
+        model.addr = mosi & 0x3F;
+        model.read = mosi & 0x80;
+        model.burst = mosi & 0x40;
+        uint8_t status = model_chip_status();
+        if (model.addr >= 0x30 && model.addr <= 0x3D && !(model.read && model.burst)) {
+            model_strobe(model.addr);
+        } else {
+            model.header_next = false;
+        }
+        return status;
+    }
+
+    uint8_t miso = model_chip_status();
+    if (model.addr == CC1101_TXFIFO_SINGLE_BYTE) {
+        if (model.read) {
+            miso = model.rx_count > 0 ? model.rx_fifo[0] : 0;
+            if (model.rx_count > 0) {
+                memmove(model.rx_fifo, &model.rx_fifo[1], --model.rx_count);
+            }
+        } else if (model.tx_count < CC1101_FIFO_SIZE) {
+            model.tx_fifo[model.tx_count++] = mosi;
+        }
+    } else if (model.addr == CC1101_PATABLE) {
+        uint8_t index = model.patable_index++ & (CC1101_PATABLE_SIZE - 1);
+        if (model.read) {
+            miso = model.patable[index];
+        } else {
+            model.patable[index] = mosi;
+        }
+    } else if (model.addr >= 0x30) {
+        miso = model_status_reg(model.addr);
+    } else if (model.addr < CC1101_CONFIG_SIZE) {
+        if (model.read) {
+            miso = model.regs[model.addr];
+        } else {
+            model.regs[model.addr] = mosi;
+        }
+        if (model.addr < CC1101_CONFIG_SIZE - 1) {
+            model.addr++;
+        }
+    }
+    // Status registers are single byte even with the burst bit set
+    if (!model.burst || (model.addr >= 0x30 && model.addr <= 0x3D)) {
+        model.header_next = true;
+    }
+    return miso;
+}
+
+static void model_select(HostSpiDevice *device, bool selected) {
+    if (selected) {
+        model.header_next = true;
+        if (model.state == MODEL_SLEEP) {
+            // Wake: the crystal starts, PATABLE and TEST0..2 are lost
+            model.state = MODEL_IDLE;
+            model.ready_us = hal_time_us() + CC1101_MODEL_WAKE_US;
+            memset(model.patable, 0, sizeof(model.patable));
+            memcpy(&model.regs[CC1101_TEST2], &model_reset_regs[CC1101_TEST2], 3);
+        }
+    } else {
+        model.patable_index = 0;
+        if (model.power_down_pending && model.state == MODEL_IDLE) {
+            model.state = MODEL_SLEEP;
+        }
+        model.power_down_pending = false;
+    }
+}
+
+// MISO is CHIP_RDYn while CSn is low
+static bool model_miso(void *context, uint32_t gpio) {
+    return !hal_host_gpio_output(CC1101_CS_PIN) && hal_time_us() < model.ready_us;
+}
+
+void cc1101_model_init(void) {
+    memset(&model, 0, sizeof(model));
+    model.device = (HostSpiDevice){
+        .cs_pin = CC1101_CS_PIN, .select = model_select, .transfer = model_transfer};
+    model_reset();
+    hal_host_spi_attach(HAL_SPI0, &model.device);
+    hal_host_gpio_source(CC1101_MISO_PIN, model_miso, NULL);
+}
+
+void cc1101_model_on_tx(cc1101_model_tx_hook_t hook, void *context) {
+    model.tx_hook = hook;
+    model.tx_context = context;
+}
+
+uint64_t cc1101_model_air_busy_until(void) {
+    return model.air_busy_until_us;
+}
+
+uint8_t cc1101_model_marcstate(void) {
+    return model_marcstate();
+}
+
+uint8_t cc1101_model_reg(uint8_t addr) {
+    return addr < CC1101_CONFIG_SIZE ? model.regs[addr] : 0;
+}
+
+void cc1101_model_get_stats(Cc1101ModelStats *stats) {
+    *stats = model.stats;
+}
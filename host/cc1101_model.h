@@ -0,0 +1,49 @@
+#ifndef CC1101_MODEL_H
+#define CC1101_MODEL_H
+
+#include "hal_host.h"
+
+// Register model of the CC1101 for the host backend, on HAL_SPI0 with the
+// pins in cc1101.h. Covers what cc1101.c relies on: the SPI header byte
+// (strobes, registers, status, PATABLE, FIFOs), CHIP_RDYn on MISO, the main
+// radio state machine with calibration, RXOFF/TXOFF modes and CCA, packet
+// timing from the modem registers, address filtering, CRC autoflush,
+// appended status bytes and GDO0 in IOCFG0 = 0x06 mode (asserts on sync,
+// deasserts at the end of the packet).
+//
+// The other side of the link is simulated by injecting frames on air. A
+// frame is only received if the radio has been listening since before its
+// sync word and is not busy with another one.
+
+#define CC1101_MODEL_CAL_US  721 // IDLE -> RX/TX with FS_AUTOCAL, 26 MHz crystal
+#define CC1101_MODEL_WAKE_US 150 // SLEEP -> crystal running
+#define CC1101_MODEL_RESET_US 50 // SRES -> CHIP_RDYn low
+
+typedef struct {
+    uint32_t sent;      // Frames transmitted
+    uint32_t received;  // Frames put in the RX FIFO
+    uint32_t filtered;  // Dropped by the address check or CRC autoflush
+    uint32_t lost;      // On air while the radio was not listening or busy
+    uint32_t overflows; // RX FIFO overflows
+    uint32_t calibrations;
+} Cc1101ModelStats;
+
+// Frame as sent: length byte, address, payload (no CRC)
+typedef void (*cc1101_model_tx_hook_t)(const uint8_t *frame, uint8_t length, void *context);
+
+void cc1101_model_init(void);
+void cc1101_model_on_tx(cc1101_model_tx_hook_t hook, void *context);
+// Put a frame (length byte, address, payload) on air with its sync word
+// ending at sync_us. A frame with crc_ok false fails the CRC check.
+void cc1101_model_inject(const uint8_t *frame, uint8_t length, uint64_t sync_us, bool crc_ok);
+// Air time of a frame of length bytes with the current modem settings:
+// preamble and sync, then the frame and CRC
+uint32_t cc1101_model_sync_us(void);
+uint32_t cc1101_model_frame_us(uint8_t length);
+// End of the last frame on air, injected or sent, for callers emulating CCA
+uint64_t cc1101_model_air_busy_until(void);
+uint8_t cc1101_model_marcstate(void);
+uint8_t cc1101_model_reg(uint8_t addr);
+void cc1101_model_get_stats(Cc1101ModelStats *stats);
+
+#endif // CC1101_MODEL_H
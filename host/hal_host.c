@@ -0,0 +1,620 @@
+#include "hal_host.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Host backend for hal.h, see hal_host.h
+
+#define HOST_MAX_EVENTS 64
+#define HOST_MAX_GPIOS 32
+
+struct HalI2cBus {
+    uint32_t clock_hz;
+    HostI2cDevice *devices;
+    HalBusStats stats;
+    // Split-phase transfer: moved at the start, done at ready_us
+    bool async_busy;
+    int async_result;
+    uint64_t async_ready_us;
+};
+
+struct HalSpiBus {
+    uint32_t clock_hz;
+    HostSpiDevice *device;
+    HalBusStats stats;
+    bool async_busy;
+    size_t async_length;
+    uint64_t async_start_us;
+    int32_t async_event;
+    bool stalled;
+    hal_done_callback_t done;
+};
+
+HalI2cBus hal_i2c0_bus;
+HalI2cBus hal_i2c1_bus;
+HalSpiBus hal_spi0_bus;
+
+typedef struct {
+    int32_t id; // 0 = free
+    uint64_t at_us;
+    hal_host_event_t event;
+    void *context;
+} HostEvent;
+
+typedef struct {
+    bool level;
+    uint32_t irq_edges;
+    hal_host_gpio_source_t source;
+    void *source_context;
+} HostGpio;
+
+// Some board's ID, hal_host_set_unique_id gives a station another
+static const uint8_t hal_host_default_unique_id[HAL_UNIQUE_ID_SIZE] = {0xE6, 0x60, 0x58, 0x38, 0x83, 0x4B, 0x2A, 0x2F};
+
+static uint64_t now_us;
+static HostEvent events[HOST_MAX_EVENTS];
+static int32_t next_event_id = 1;
+static bool irq_masked;
+static bool event_flag;
+static HostGpio gpios[HOST_MAX_GPIOS];
+static hal_gpio_callback_t gpio_callback;
+static void (*console_put)(uint8_t byte);
+static uint8_t unique_id[HAL_UNIQUE_ID_SIZE];
+static uint8_t flash[HAL_FLASH_SIZE_BYTES];
+static HalBusStats flash_stats;
+static uint64_t sleep_total_us;
+
+int32_t hal_host_schedule(uint64_t at_us, hal_host_event_t event, void *context) {
+    for (int i = 0; i < HOST_MAX_EVENTS; i++) {
+        if (events[i].id == 0) {
+            events[i] = (HostEvent){next_event_id++, at_us, event, context};
+            return events[i].id;
+        }
+    }
+    fprintf(stderr, "hal_host: event queue full\n");
+    abort();
+}
+
+bool hal_host_cancel(int32_t id) {
+    for (int i = 0; i < HOST_MAX_EVENTS; i++) {
+        if (id > 0 && events[i].id == id) {
+            events[i].id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Earliest pending event, ties in scheduling order
+static HostEvent *hal_host_next(void) {
+    HostEvent *next = NULL;
+    for (int i = 0; i < HOST_MAX_EVENTS; i++) {
+        if (events[i].id != 0 &&
+            (next == NULL || events[i].at_us < next->at_us ||
+             (events[i].at_us == next->at_us && events[i].id < next->id))) {
+            next = &events[i];
+        }
+    }
+    return next;
+}
+
+// Deliver the earliest event if it is due by limit_us. Interrupts are taken
+// like on the target: the waiting core wakes with the event flag set.
+static bool hal_host_dispatch(uint64_t limit_us) {
+    HostEvent *next = hal_host_next();
+    if (irq_masked || next == NULL || next->at_us > limit_us) {
+        return false;
+    }
+    HostEvent event = *next;
+    next->id = 0;
+    if (event.at_us > now_us) {
+        now_us = event.at_us;
+    }
+    event.event(event.id, event.context);
+    event_flag = true;
+    return true;
+}
+
+void hal_host_run_until(uint64_t at_us) {
+    while (hal_host_dispatch(at_us)) {
+    }
+    if (at_us > now_us) {
+        now_us = at_us;
+    }
+}
+
+void hal_host_charge(uint64_t us) {
+    now_us += us;
+}
+
+void hal_host_reset(void) {
+    now_us = 0;
+    memset(events, 0, sizeof(events));
+    irq_masked = false;
+    event_flag = false;
+    memset(gpios, 0, sizeof(gpios));
+    gpio_callback = NULL;
+    console_put = NULL;
+    memcpy(unique_id, hal_host_default_unique_id, sizeof(unique_id));
+    memset(&hal_i2c0_bus, 0, sizeof(hal_i2c0_bus));
+    memset(&hal_i2c1_bus, 0, sizeof(hal_i2c1_bus));
+    memset(&hal_spi0_bus, 0, sizeof(hal_spi0_bus));
+    memset(flash, 0xFF, sizeof(flash));
+    hal_reset_stats();
+}
+
+static void hal_account(HalBusStats *stats, uint64_t start_us, int result, size_t length) {
+    stats->busy_us += now_us - start_us;
+    stats->transactions++;
+    if (result == HAL_ERROR_TIMEOUT) {
+        stats->timeouts++;
+    }
+    if (result == (int)length) {
+        stats->bytes += length;
+    } else {
+        stats->errors++;
+        if (result > 0) {
+            stats->bytes += result;
+        }
+    }
+}
+
+void hal_host_set_console(void (*put)(uint8_t byte)) {
+    console_put = put;
+}
+
+void hal_host_set_unique_id(const uint8_t id[HAL_UNIQUE_ID_SIZE]) {
+    memcpy(unique_id, id, sizeof(unique_id));
+}
+
+void hal_unique_id(uint8_t id[HAL_UNIQUE_ID_SIZE]) {
+    memcpy(id, unique_id, sizeof(unique_id));
+}
+
+void hal_console_put(uint8_t byte) {
+    if (console_put != NULL) {
+        console_put(byte);
+    }
+}
+
+uint8_t *hal_host_flash(void) {
+    return flash;
+}
+
+// I2C
+
+uint8_t hal_i2c_index(const HalI2cBus *i2c) {
+    return i2c == HAL_I2C1 ? 1 : 0;
+}
+
+HalI2cBus *hal_i2c_bus(uint8_t index) {
+    return index == 1 ? HAL_I2C1 : HAL_I2C0;
+}
+
+void hal_host_i2c_attach(HalI2cBus *bus, HostI2cDevice *device) {
+    device->next = bus->devices;
+    bus->devices = device;
+}
+
+void hal_i2c_init(HalI2cBus *bus, uint32_t sda_pin, uint32_t scl_pin, uint32_t hz) {
+    bus->clock_hz = hz;
+}
+
+uint32_t hal_i2c_set_clock(HalI2cBus *bus, uint32_t hz) {
+    bus->clock_hz = hz;
+    return hz;
+}
+
+uint32_t hal_i2c_get_clock(HalI2cBus *bus) {
+    return bus->clock_hz;
+}
+
+uint32_t hal_i2c_timeout_us(HalI2cBus *bus, size_t length) {
+    uint32_t hz = bus->clock_hz == 0 ? 100000 : bus->clock_hz;
+    return HAL_I2C_TIMEOUT_BASE_US + (uint32_t)(2 * 9 * (length + 1) * 1000000ull / hz);
+}
+
+bool hal_i2c_recover(HalI2cBus *bus) {
+    hal_host_charge(HAL_HOST_I2C_RECOVER_US);
+    bus->stats.recoveries++;
+    return true;
+}
+
+// Time on the wire for the address byte plus length bytes, ACK bits included
+static uint64_t hal_i2c_wire_us(const HalI2cBus *bus, size_t length) {
+    uint32_t hz = bus->clock_hz == 0 ? 100000 : bus->clock_hz;
+    uint64_t bits = (length + 1) * 9 + HAL_HOST_I2C_OVERHEAD_BITS;
+    return HAL_HOST_I2C_SETUP_US + (bits * 1000000 + hz - 1) / hz;
+}
+
+// A device that is absent, or clocked faster than it can follow, NAKs its
+// address and only the address byte is on the wire
+static HostI2cDevice *hal_i2c_device(HalI2cBus *bus, uint8_t addr) {
+    for (HostI2cDevice *device = bus->devices; device != NULL; device = device->next) {
+        if (device->addr == addr) {
+            if (bus->clock_hz > device->max_hz) {
+                device->naks++;
+                return NULL;
+            }
+            return device;
+        }
+    }
+    return NULL;
+}
+
+static int hal_i2c_move(HalI2cBus *bus, uint8_t addr, const uint8_t *src, size_t write_length, uint8_t *dst,
+                        size_t read_length, uint64_t *wire_us) {
+    HostI2cDevice *device = hal_i2c_device(bus, addr);
+    if (device == NULL) {
+        *wire_us = hal_i2c_wire_us(bus, 0);
+        return HAL_ERROR_GENERIC;
+    }
+    *wire_us = hal_i2c_wire_us(bus, write_length + read_length);
+    if (write_length > 0 && !device->write(device, src, write_length)) {
+        device->naks++;
+        *wire_us = hal_i2c_wire_us(bus, 0);
+        return HAL_ERROR_GENERIC;
+    }
+    if (read_length > 0 && !device->read(device, dst, read_length)) {
+        device->naks++;
+        *wire_us = hal_i2c_wire_us(bus, write_length);
+        return HAL_ERROR_GENERIC;
+    }
+    return (int)(write_length + read_length);
+}
+
+int hal_i2c_write(HalI2cBus *bus, uint8_t addr, const uint8_t *src, size_t length, bool nostop) {
+    uint64_t start = now_us, wire_us;
+    int result = hal_i2c_move(bus, addr, src, length, NULL, 0, &wire_us);
+    hal_host_charge(wire_us);
+    hal_account(&bus->stats, start, result, length);
+    return result;
+}
+
+int hal_i2c_read(HalI2cBus *bus, uint8_t addr, uint8_t *dst, size_t length, bool nostop) {
+    uint64_t start = now_us, wire_us;
+    int result = hal_i2c_move(bus, addr, NULL, 0, dst, length, &wire_us);
+    hal_host_charge(wire_us);
+    hal_account(&bus->stats, start, result, length);
+    return result;
+}
+
+bool hal_i2c_start(HalI2cBus *bus, uint8_t addr, const uint8_t *src, size_t write_length, uint8_t *dst,
+                   size_t read_length) {
+    if (bus->async_busy || write_length + read_length == 0 || write_length + read_length > HAL_I2C_ASYNC_MAX) {
+        return false;
+    }
+    uint64_t wire_us;
+    bus->async_result = hal_i2c_move(bus, addr, src, write_length, dst, read_length, &wire_us);
+    bus->async_ready_us = now_us + wire_us;
+    bus->async_busy = true;
+    return true;
+}
+
+int hal_i2c_poll(HalI2cBus *bus) {
+    if (!bus->async_busy || now_us < bus->async_ready_us) {
+        return HAL_PENDING;
+    }
+    bus->async_busy = false;
+    return bus->async_result;
+}
+
+void hal_i2c_abort(HalI2cBus *bus) {
+    bus->async_busy = false;
+}
+
+void hal_i2c_account(HalI2cBus *bus, uint64_t start_us, int result, size_t length) {
+    hal_account(&bus->stats, start_us, result, length);
+}
+
+void hal_i2c_account_retry(HalI2cBus *bus) {
+    bus->stats.retries++;
+}
+
+// SPI
+
+void hal_host_spi_attach(HalSpiBus *bus, HostSpiDevice *device) {
+    bus->device = device;
+}
+
+uint32_t hal_spi_init(HalSpiBus *bus, uint32_t hz, uint32_t sck_pin, uint32_t mosi_pin, uint32_t miso_pin) {
+    bus->clock_hz = hz;
+    return hz;
+}
+
+static uint64_t hal_spi_wire_us(const HalSpiBus *bus, size_t length) {
+    uint32_t hz = bus->clock_hz == 0 ? 1000000 : bus->clock_hz;
+    return HAL_HOST_SPI_SETUP_US + (length * 8 * 1000000ull + hz - 1) / hz;
+}
+
+// Full duplex, nothing comes back without a selected device
+static void hal_spi_move(HalSpiBus *bus, const uint8_t *tx, uint8_t repeated_tx, uint8_t *rx, size_t length) {
+    HostSpiDevice *device = bus->device;
+    bool selected = device != NULL && !gpios[device->cs_pin].level;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t mosi = tx != NULL ? tx[i] : repeated_tx;
+        uint8_t miso = selected ? device->transfer(device, mosi) : 0xFF;
+        if (rx != NULL) {
+            rx[i] = miso;
+        }
+    }
+}
+
+int hal_spi_write(HalSpiBus *bus, const uint8_t *src, size_t length) {
+    uint64_t start = now_us;
+    hal_spi_move(bus, src, 0, NULL, length);
+    hal_host_charge(hal_spi_wire_us(bus, length));
+    hal_account(&bus->stats, start, (int)length, length);
+    return (int)length;
+}
+
+int hal_spi_read(HalSpiBus *bus, uint8_t repeated_tx, uint8_t *dst, size_t length) {
+    uint64_t start = now_us;
+    hal_spi_move(bus, NULL, repeated_tx, dst, length);
+    hal_host_charge(hal_spi_wire_us(bus, length));
+    hal_account(&bus->stats, start, (int)length, length);
+    return (int)length;
+}
+
+static void hal_spi_done(int32_t id, void *context) {
+    HalSpiBus *bus = context;
+    bus->async_busy = false;
+    bus->async_event = 0;
+    hal_account(&bus->stats, bus->async_start_us, (int)bus->async_length, bus->async_length);
+    hal_done_callback_t done = bus->done;
+    bus->done = NULL;
+    if (done != NULL) {
+        done();
+    }
+}
+
+bool hal_spi_transfer_async(HalSpiBus *bus, const uint8_t *tx, uint8_t *rx, size_t length,
+                            hal_done_callback_t done) {
+    if (bus->async_busy || length == 0) {
+        return false;
+    }
+    hal_spi_move(bus, tx, 0, rx, length);
+    bus->async_busy = true;
+    bus->async_length = length;
+    bus->async_start_us = now_us;
+    bus->done = done;
+    if (!bus->stalled) {
+        bus->async_event = hal_host_schedule(now_us + hal_spi_wire_us(bus, length), hal_spi_done, bus);
+    }
+    return true;
+}
+
+void hal_spi_abort(HalSpiBus *bus) {
+    if (!bus->async_busy) {
+        return;
+    }
+    hal_host_cancel(bus->async_event);
+    bus->async_event = 0;
+    bus->async_busy = false;
+    bus->done = NULL;
+    hal_account(&bus->stats, bus->async_start_us, HAL_ERROR_TIMEOUT, bus->async_length);
+}
+
+void hal_host_spi_stall(HalSpiBus *bus, bool stalled) {
+    bus->stalled = stalled;
+}
+
+// Flash, NOR semantics: erase sets bits, programming only clears them
+
+bool hal_flash_erase(uint32_t offset, size_t length) {
+    if (offset % HAL_FLASH_SECTOR_SIZE != 0 || length % HAL_FLASH_SECTOR_SIZE != 0 ||
+        offset + length > sizeof(flash)) {
+        flash_stats.errors++;
+        return false;
+    }
+    uint64_t start = now_us;
+    memset(&flash[offset], 0xFF, length);
+    hal_host_charge(HAL_HOST_FLASH_ERASE_US * (length / HAL_FLASH_SECTOR_SIZE));
+    flash_stats.busy_us += now_us - start;
+    flash_stats.transactions++;
+    return true;
+}
+
+bool hal_flash_program(uint32_t offset, const uint8_t *src, size_t length) {
+    if (offset % HAL_FLASH_PAGE_SIZE != 0 || length % HAL_FLASH_PAGE_SIZE != 0 ||
+        offset + length > sizeof(flash)) {
+        flash_stats.errors++;
+        return false;
+    }
+    uint64_t start = now_us;
+    for (size_t i = 0; i < length; i++) {
+        flash[offset + i] &= src[i];
+    }
+    hal_host_charge(HAL_HOST_FLASH_PROGRAM_US * (length / HAL_FLASH_PAGE_SIZE));
+    flash_stats.busy_us += now_us - start;
+    flash_stats.bytes += length;
+    flash_stats.transactions++;
+    return true;
+}
+
+const uint8_t *hal_flash_read(uint32_t offset) {
+    return &flash[offset];
+}
+
+// GPIO
+
+void hal_gpio_init_output(uint32_t gpio, bool value) {
+    hal_gpio_put(gpio, value);
+}
+
+void hal_gpio_init_input(uint32_t gpio) {
+}
+
+void hal_gpio_put(uint32_t gpio, bool value) {
+    gpios[gpio].level = value;
+    HostSpiDevice *device = hal_spi0_bus.device;
+    if (device != NULL && device->cs_pin == gpio && device->select != NULL) {
+        device->select(device, !value);
+    }
+}
+
+bool hal_host_gpio_output(uint32_t gpio) {
+    return gpios[gpio].level;
+}
+
+bool hal_gpio_get(uint32_t gpio) {
+    HostGpio *pin = &gpios[gpio];
+    return pin->source != NULL ? pin->source(pin->source_context, gpio) : pin->level;
+}
+
+void hal_host_gpio_source(uint32_t gpio, hal_host_gpio_source_t source, void *context) {
+    gpios[gpio].source = source;
+    gpios[gpio].source_context = context;
+}
+
+static void hal_gpio_irq(int32_t id, void *context) {
+    uint32_t gpio = (uint32_t)(uintptr_t)context & 0xFF;
+    uint32_t edge = (uint32_t)(uintptr_t)context >> 8;
+    if (gpio_callback != NULL && (gpios[gpio].irq_edges & edge)) {
+        gpio_callback(gpio, edge);
+    }
+}
+
+void hal_host_gpio_drive(uint32_t gpio, bool value) {
+    HostGpio *pin = &gpios[gpio];
+    if (pin->level == value) {
+        return;
+    }
+    pin->level = value;
+    uint32_t edge = value ? HAL_GPIO_EDGE_RISE : HAL_GPIO_EDGE_FALL;
+    if (pin->irq_edges & edge) {
+        hal_host_schedule(now_us, hal_gpio_irq, (void *)(uintptr_t)(gpio | edge << 8));
+    }
+}
+
+void hal_gpio_set_irq(uint32_t gpio, uint32_t edges, hal_gpio_callback_t callback) {
+    gpios[gpio].irq_edges = edges;
+    gpio_callback = callback;
+}
+
+// Alarms
+
+static void hal_alarm_fire(int32_t id, void *context) {
+    hal_alarm_callback_t callback = (hal_alarm_callback_t)(uintptr_t)context;
+    callback(id);
+}
+
+void hal_alarm_init(void) {
+}
+
+int32_t hal_alarm_at(uint64_t at_us, hal_alarm_callback_t callback) {
+    if (at_us <= now_us) {
+        callback(0);
+        return 0;
+    }
+    return hal_host_schedule(at_us, hal_alarm_fire, (void *)(uintptr_t)callback);
+}
+
+bool hal_alarm_cancel(int32_t id) {
+    return hal_host_cancel(id);
+}
+
+// Interrupts and events
+
+uint32_t hal_irq_save(void) {
+    uint32_t state = irq_masked;
+    irq_masked = true;
+    return state;
+}
+
+void hal_irq_restore(uint32_t state) {
+    irq_masked = state != 0;
+}
+
+void hal_wait_event(void) {
+    if (event_flag) {
+        event_flag = false;
+        return;
+    }
+    HostEvent *next = hal_host_next();
+    if (next == NULL || irq_masked) {
+        fprintf(stderr, "hal_host: hal_wait_event with nothing to wake it\n");
+        abort();
+    }
+    hal_host_dispatch(next->at_us);
+    event_flag = false;
+}
+
+void hal_wait_event_until(uint64_t at_us) {
+    if (event_flag) {
+        event_flag = false;
+        return;
+    }
+    if (hal_host_dispatch(at_us)) {
+        event_flag = false;
+    } else if (at_us > now_us) {
+        now_us = at_us;
+    }
+}
+
+void hal_signal_event(void) {
+    event_flag = true;
+}
+
+void hal_spin(void) {
+    hal_host_run_until(now_us + HAL_HOST_SPIN_US);
+}
+
+// Time
+
+uint64_t hal_time_us(void) {
+    return now_us;
+}
+
+void hal_sleep_us(uint64_t us) {
+    hal_sleep_until(now_us + us);
+}
+
+void hal_sleep_ms(uint32_t ms) {
+    hal_sleep_us((uint64_t)ms * 1000);
+}
+
+void hal_sleep_until(uint64_t at_us) {
+    uint64_t start = now_us;
+    hal_host_run_until(at_us);
+    sleep_total_us += now_us - start;
+}
+
+// Host time in cycles of the RP2040's 125 MHz clock, for relative comparisons
+void hal_cycles_init(void) {
+}
+
+uint32_t hal_cycles_start(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec) / 8) & 0x00FFFFFF;
+}
+
+uint32_t hal_cycles_since(uint32_t start) {
+    return (hal_cycles_start() - start) & 0x00FFFFFF;
+}
+
+void hal_get_i2c_stats(HalI2cBus *bus, HalBusStats *stats) {
+    *stats = bus->stats;
+}
+
+void hal_get_spi_stats(HalSpiBus *bus, HalBusStats *stats) {
+    *stats = bus->stats;
+}
+
+void hal_get_flash_stats(HalBusStats *stats) {
+    *stats = flash_stats;
+}
+
+uint64_t hal_sleep_total_us(void) {
+    return sleep_total_us;
+}
+
+void hal_reset_stats(void) {
+    memset(&hal_i2c0_bus.stats, 0, sizeof(HalBusStats));
+    memset(&hal_i2c1_bus.stats, 0, sizeof(HalBusStats));
+    memset(&hal_spi0_bus.stats, 0, sizeof(HalBusStats));
+    memset(&flash_stats, 0, sizeof(flash_stats));
+    sleep_total_us = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include "hal.h"
+
+// Host backend of hal.h for the tests in tests/. Time is virtual: it starts
+// at 0 on hal_host_reset and only moves when the code sleeps, waits or
+// spins, or when a bus transfer charges its time on the wire. Interrupts
+// (GPIO edges, alarms, DMA completion) are events on that clock and are
+// delivered at the next sleep, wait or spin, in time order.
+//
+// Devices are register-level models (host/*_model.c) attached to a bus:
+// I2C by address, SPI to the bus with its chip select pin.
+
+// Transfer costs charged to the virtual clock
+#define HAL_HOST_I2C_OVERHEAD_BITS 2  // START and STOP
+#define HAL_HOST_I2C_SETUP_US 2       // Controller setup per call
+#define HAL_HOST_I2C_RECOVER_US 100   // Nine SCL pulses and a STOP at 100 kHz
+#define HAL_HOST_SPI_SETUP_US 1
+#define HAL_HOST_FLASH_PROGRAM_US 400 // Per page, W25Q16JV typical
+#define HAL_HOST_FLASH_ERASE_US 45000 // Per sector
+#define HAL_HOST_SPIN_US 1            // One hal_spin iteration
+
+typedef void (*hal_host_event_t)(int32_t id, void *context);
+
+// Events on the virtual clock, ids are positive
+int32_t hal_host_schedule(uint64_t at_us, hal_host_event_t event, void *context);
+bool hal_host_cancel(int32_t id);
+// Deliver every event due up to at_us, then move the clock there
+void hal_host_run_until(uint64_t at_us);
+// Busy time without a chance for interrupts, e.g. a blocking bus transfer
+void hal_host_charge(uint64_t us);
+// Time 0, no events, devices, hooks or stats; flash erased
+void hal_host_reset(void);
+
+typedef struct HostI2cDevice HostI2cDevice;
+struct HostI2cDevice {
+    uint8_t addr;
+    uint32_t max_hz; // Faster clocks corrupt the transfer, the device NAKs
+    // A false return NAKs the transfer
+    bool (*write)(HostI2cDevice *device, const uint8_t *src, size_t length);
+    bool (*read)(HostI2cDevice *device, uint8_t *dst, size_t length);
+    uint32_t naks;
+    HostI2cDevice *next;
+};
+
+void hal_host_i2c_attach(HalI2cBus *bus, HostI2cDevice *device);
+
+typedef struct HostSpiDevice HostSpiDevice;
+struct HostSpiDevice {
+    uint32_t cs_pin;
+    void (*select)(HostSpiDevice *device, bool selected);
+    uint8_t (*transfer)(HostSpiDevice *device, uint8_t mosi);
+};
+
+void hal_host_spi_attach(HalSpiBus *bus, HostSpiDevice *device);
+// Fault injection: while stalled, async transfers never complete
+void hal_host_spi_stall(HalSpiBus *bus, bool stalled);
+
+// Pins driven by a model; edges raise the interrupt set with hal_gpio_set_irq
+typedef bool (*hal_host_gpio_source_t)(void *context, uint32_t gpio);
+void hal_host_gpio_source(uint32_t gpio, hal_host_gpio_source_t source, void *context);
+void hal_host_gpio_drive(uint32_t gpio, bool value);
+// Output pin level as last written by the code under test
+bool hal_host_gpio_output(uint32_t gpio);
+
+void hal_host_set_console(void (*put)(uint8_t byte));
+// What hal_unique_id returns, until the next hal_host_reset
+void hal_host_set_unique_id(const uint8_t id[HAL_UNIQUE_ID_SIZE]);
+
+// Raw flash contents, for fault injection
+uint8_t *hal_host_flash(void);
+
+#endif // HAL_HOST_H
@@ -0,0 +1,34 @@
+#include "log.h"
+#include "trace.h"
+
+// log.c and trace.c for the host tests: built with LOG_TEXT=1 the LOG()
+// macros print directly and with TRACE_ENABLED=0 no trace point is left,
+// these only satisfy the remaining calls. Tests start quiet, at errors only.
+
+volatile uint8_t log_level = LOG_LEVEL_ERROR;
+
+void log_init(void) {
+}
+
+void log_set_level(uint8_t level) {
+    log_level = level;
+}
+
+void log_write(uint8_t level, const uint32_t *words, uint8_t word_count) {
+}
+
+void log_drain(void) {
+}
+
+uint32_t log_dropped(void) {
+    return 0;
+}
+
+void trace_record(uint16_t event, uint16_t arg) {
+}
+
+void trace_set_enabled(bool enabled) {
+}
+
+void trace_dump(void) {
+}
@@ -0,0 +1,13 @@
+#ifndef PICO_CRITICAL_SECTION_H
+#define PICO_CRITICAL_SECTION_H
+
+// One thread on the host, nothing to lock
+typedef struct {
+    int unused;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *lock) { (void)lock; }
+static inline void critical_section_enter_blocking(critical_section_t *lock) { (void)lock; }
+static inline void critical_section_exit(critical_section_t *lock) { (void)lock; }
+
+#endif // PICO_CRITICAL_SECTION_H
@@ -0,0 +1,18 @@
+#ifndef PICO_STDLIB_H
+#define PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Stand-in for the few Pico SDK calls trace.c and log.c make, so the host
+// tests can build those two as they are. Time and core number are whatever
+// the test sets, see host/sdk/pico_sdk_host.c.
+
+extern uint32_t pico_host_core;
+extern uint32_t pico_host_time_us;
+
+static inline uint32_t get_core_num(void) { return pico_host_core; }
+static inline uint32_t time_us_32(void) { return pico_host_time_us; }
+static inline int putchar_raw(int c) { return putchar(c); }
+
+#endif // PICO_STDLIB_H
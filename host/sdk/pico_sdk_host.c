@@ -0,0 +1,5 @@
+#include "pico/stdlib.h"
+
+// Set by the tests before each call into trace.c or log.c
+uint32_t pico_host_core;
+uint32_t pico_host_time_us;
@@ -0,0 +1,272 @@
+#include "sensor_models.h"
+#include "BMP280.h"
+#include "SHT40.h"
+#include "INA219.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BMP280_STATUS_REG 0xF3
+#define BMP280_STATUS_MEASURING 0x08
+
+// BMP280: registers auto-increment on reads, writes are register/value pairs
+
+static const int16_t bmp280_example_calibration[12] = {
+    27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000,
+};
+
+static void bmp280_model_reset(Bmp280Model *model) {
+    memset(model->regs, 0, sizeof(model->regs));
+    model->regs[BMP280_CHIP_ID_REG] = BMP280_CHIP_ID;
+    for (int i = 0; i < 12; i++) {
+        model->regs[BMP280_CALIBRATION_REG + 2 * i] = (uint16_t)model->calibration[i] & 0xFF;
+        model->regs[BMP280_CALIBRATION_REG + 2 * i + 1] = (uint16_t)model->calibration[i] >> 8;
+    }
+    // Skipped measurements read back as 0x80000
+    model->regs[BMP280_PRESSURE_REG_LOW] = 0x80;
+    model->regs[BMP280_TEMPERATURE_REG_LOW] = 0x80;
+    model->measuring = false;
+}
+
+// Oversampling code (1..5) to samples, 0 = skipped
+static uint32_t bmp280_model_samples(uint8_t code) {
+    return code == 0 ? 0 : 1u << ((code > 5 ? 5 : code) - 1);
+}
+
+static void bmp280_model_latch(Bmp280Model *model) {
+    if (!model->measuring || hal_time_us() < model->ready_us) {
+        return;
+    }
+    model->measuring = false;
+    model->regs[BMP280_STATUS_REG] &= ~BMP280_STATUS_MEASURING;
+    uint8_t *data = &model->regs[BMP280_PRESSURE_REG_LOW];
+    data[0] = model->adc_p >> 12;
+    data[1] = (model->adc_p >> 4) & 0xFF;
+    data[2] = (model->adc_p & 0x0F) << 4;
+    data[3] = model->adc_t >> 12;
+    data[4] = (model->adc_t >> 4) & 0xFF;
+    data[5] = (model->adc_t & 0x0F) << 4;
+    model->conversions++;
+}
+
+static bool bmp280_model_write(HostI2cDevice *device, const uint8_t *src, size_t length) {
+    Bmp280Model *model = (Bmp280Model *)device;
+    bmp280_model_latch(model);
+    model->pointer = src[0];
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        uint8_t reg = src[i], value = src[i + 1];
+        if (reg == BMP280_RESET_REG) {
+            if (value == BMP280_RESET_VAL) {
+                bmp280_model_reset(model);
+            }
+        } else if (reg == BMP280_POWER_CTL_REG) {
+            model->regs[reg] = value;
+            uint8_t mode = value & 0x03;
+            if (mode == BMP280_MODE_FORCED || mode == 2) {
+                // Datasheet measurement time, maximum
+                uint32_t time_us = 1250 + 2300 * bmp280_model_samples(value >> 5) +
+                                   2300 * bmp280_model_samples((value >> 2) & 0x07) + 575;
+                model->measuring = true;
+                model->ready_us = hal_time_us() + time_us;
+                model->regs[BMP280_STATUS_REG] |= BMP280_STATUS_MEASURING;
+            }
+        } else if (reg >= 0xF4) {
+            model->regs[reg] = value;
+        }
+    }
+    return true;
+}
+
+static bool bmp280_model_read(HostI2cDevice *device, uint8_t *dst, size_t length) {
+    Bmp280Model *model = (Bmp280Model *)device;
+    bmp280_model_latch(model);
+    for (size_t i = 0; i < length; i++) {
+        dst[i] = model->regs[model->pointer++];
+    }
+    return true;
+}
+
+void bmp280_model_init(Bmp280Model *model, uint8_t addr) {
+    memset(model, 0, sizeof(*model));
+    model->device = (HostI2cDevice){
+        .addr = addr, .max_hz = BMP280_I2C_MAX_HZ, .write = bmp280_model_write, .read = bmp280_model_read};
+    memcpy(model->calibration, bmp280_example_calibration, sizeof(model->calibration));
+    bmp280_model_reset(model);
+    bmp280_model_set_adc(model, 519888, 415148);
+}
+
+void bmp280_model_set_adc(Bmp280Model *model, int32_t adc_t, int32_t adc_p) {
+    model->adc_t = adc_t & 0xFFFFF;
+    model->adc_p = adc_p & 0xFFFFF;
+}
+
+// SHT40: one-byte commands; while measuring the chip NAKs its address, a
+// result is read once
+
+#define SHT40_MODEL_RESET_US 1000
+
+static uint8_t sht40_model_crc(const uint8_t *data) {
+    uint8_t crc = SHT40_CRC8_INIT;
+    for (int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ SHT40_CRC8_POLYNOMIAL) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t sht40_model_ticks(float value, float offset, float span) {
+    float ticks = (value + offset) / span * 65535.0f + 0.5f;
+    return ticks < 0 ? 0 : ticks > 65535 ? 65535 : (uint16_t)ticks;
+}
+
+static bool sht40_model_write(HostI2cDevice *device, const uint8_t *src, size_t length) {
+    Sht40Model *model = (Sht40Model *)device;
+    uint64_t now = hal_time_us();
+    if (now < model->busy_until_us) {
+        return false;
+    }
+    model->last_command = src[0];
+    uint32_t time_us = 0;
+    switch (src[0]) {
+        case SHT40_MEASURE_HIGHREP_STRETCH:
+            time_us = SHT40_MEASURE_TIME_HIGHREP_US;
+            break;
+        case SHT40_MEASURE_MEDREP_STRETCH:
+            time_us = SHT40_MEASURE_TIME_MEDREP_US;
+            break;
+        case SHT40_MEASURE_LOWREP_STRETCH:
+            time_us = SHT40_MEASURE_TIME_LOWREP_US;
+            break;
+        case SHT40_SOFT_RESET:
+            model->data_ready = false;
+            model->busy_until_us = now + SHT40_MODEL_RESET_US;
+            return true;
+        default:
+            return true;
+    }
+    uint16_t t = sht40_model_ticks(model->temperature, 45.0f, 175.0f);
+    uint16_t rh = sht40_model_ticks(model->humidity, 6.0f, 125.0f);
+    model->data[0] = t >> 8;
+    model->data[1] = t & 0xFF;
+    model->data[2] = sht40_model_crc(&model->data[0]);
+    model->data[3] = rh >> 8;
+    model->data[4] = rh & 0xFF;
+    model->data[5] = sht40_model_crc(&model->data[3]);
+    model->data_ready = true;
+    model->busy_until_us = now + time_us;
+    model->measurements++;
+    return true;
+}
+
+static bool sht40_model_read(HostI2cDevice *device, uint8_t *dst, size_t length) {
+    Sht40Model *model = (Sht40Model *)device;
+    if (hal_time_us() < model->busy_until_us || !model->data_ready) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        dst[i] = i < sizeof(model->data) ? model->data[i] : 0xFF;
+    }
+    model->data_ready = false;
+    return true;
+}
+
+void sht40_model_init(Sht40Model *model, uint8_t addr) {
+    memset(model, 0, sizeof(*model));
+    model->device = (HostI2cDevice){
+        .addr = addr, .max_hz = SHT40_I2C_MAX_HZ, .write = sht40_model_write, .read = sht40_model_read};
+    model->temperature = 20.0f;
+    model->humidity = 50.0f;
+}
+
+// INA219: 16 bit big-endian registers, reads return the pointed register
+// without auto-increment
+
+#define INA219_MODEL_RESET 0x8000
+
+// ADC field to conversion time, datasheet maximum
+static uint32_t ina219_model_adc_us(uint8_t code) {
+    static const uint16_t bits_us[4] = {93, 163, 304, 586};
+    return (code & 0x08) ? 586u << (code & 0x07) : bits_us[code & 0x03];
+}
+
+static void ina219_model_latch(Ina219Model *model) {
+    if (!model->converting || hal_time_us() < model->ready_us) {
+        return;
+    }
+    model->converting = false;
+    int32_t shunt = (int32_t)lroundf(model->current * model->shunt_ohms / 10e-6f);
+    shunt = shunt > 32767 ? 32767 : shunt < -32768 ? -32768 : shunt;
+    uint32_t bus = (uint32_t)lroundf(model->bus_voltage / 0.004f);
+    bus = bus > 0x1FFF ? 0x1FFF : bus;
+    int32_t current = shunt * model->regs[INA219_REG_CALIBRATION] / 4096;
+    current = current > 32767 ? 32767 : current < -32768 ? -32768 : current;
+    uint32_t power = (uint32_t)abs(current) * bus / 5000;
+    model->regs[INA219_REG_SHUNTVOLTAGE] = (uint16_t)shunt;
+    model->regs[INA219_REG_BUSVOLTAGE] = bus << 3 | INA219_BUSVOLTAGE_CNVR;
+    model->regs[INA219_REG_CURRENT] = (uint16_t)current;
+    model->regs[INA219_REG_POWER] = power > 0xFFFF ? 0xFFFF : power;
+    model->conversions++;
+}
+
+static bool ina219_model_write(HostI2cDevice *device, const uint8_t *src, size_t length) {
+    Ina219Model *model = (Ina219Model *)device;
+    if (src[0] > INA219_REG_CALIBRATION) {
+        return false;
+    }
+    ina219_model_latch(model);
+    model->pointer = src[0];
+    if (length < 3) {
+        return true;
+    }
+    uint16_t value = src[1] << 8 | src[2];
+    if (model->pointer == INA219_REG_CONFIG) {
+        if (value & INA219_MODEL_RESET) {
+            memset(model->regs, 0, sizeof(model->regs));
+            model->regs[INA219_REG_CONFIG] = 0x399F;
+            model->converting = false;
+            return true;
+        }
+        model->regs[INA219_REG_CONFIG] = value;
+        model->regs[INA219_REG_BUSVOLTAGE] &= ~INA219_BUSVOLTAGE_CNVR;
+        uint8_t mode = value & 0x07;
+        if (mode >= 1 && mode <= 3) {
+            uint32_t time_us = 0;
+            if (mode & 0x01) {
+                time_us += ina219_model_adc_us((value >> 3) & 0x0F);
+            }
+            if (mode & 0x02) {
+                time_us += ina219_model_adc_us((value >> 7) & 0x0F);
+            }
+            model->converting = true;
+            model->ready_us = hal_time_us() + time_us;
+        } else {
+            model->converting = false;
+        }
+    } else if (model->pointer == INA219_REG_CALIBRATION) {
+        model->regs[INA219_REG_CALIBRATION] = value & 0xFFFE;
+    }
+    return true;
+}
+
+static bool ina219_model_read(HostI2cDevice *device, uint8_t *dst, size_t length) {
+    Ina219Model *model = (Ina219Model *)device;
+    ina219_model_latch(model);
+    uint16_t value = model->regs[model->pointer];
+    for (size_t i = 0; i < length; i++) {
+        dst[i] = i % 2 == 0 ? value >> 8 : value & 0xFF;
+    }
+    if (model->pointer == INA219_REG_POWER) {
+        model->regs[INA219_REG_BUSVOLTAGE] &= ~INA219_BUSVOLTAGE_CNVR;
+    }
+    return true;
+}
+
+void ina219_model_init(Ina219Model *model, uint8_t addr, float shunt_ohms) {
+    memset(model, 0, sizeof(*model));
+    model->device = (HostI2cDevice){
+        .addr = addr, .max_hz = INA219_I2C_MAX_HZ, .write = ina219_model_write, .read = ina219_model_read};
+    model->regs[INA219_REG_CONFIG] = 0x399F;
+    model->shunt_ohms = shunt_ohms;
+}
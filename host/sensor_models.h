@@ -0,0 +1,55 @@
+#ifndef SENSOR_MODELS_H
+#define SENSOR_MODELS_H
+
+#include "hal_host.h"
+
+// Register models of the station's I2C sensors for the host backend. Each
+// follows its datasheet at the register level: conversions take their
+// datasheet time on the virtual clock and results only appear once they are
+// done. Inputs are set in physical units (or raw ADC counts for the BMP280).
+
+typedef struct {
+    HostI2cDevice device;
+    uint8_t regs[256];
+    uint8_t pointer;
+    bool measuring;
+    uint64_t ready_us;
+    int32_t adc_t; // 20 bit raw values latched at the end of a conversion
+    int32_t adc_p;
+    int16_t calibration[12]; // dig_T1 .. dig_P9 in the chip's NVM, loaded at reset
+    uint32_t conversions;
+} Bmp280Model;
+
+// Chip id, datasheet example calibration (adc_t 519888 = 25.08 DegC,
+// adc_p 415148 = 100653.27 Pa), sleep mode
+void bmp280_model_init(Bmp280Model *model, uint8_t addr);
+void bmp280_model_set_adc(Bmp280Model *model, int32_t adc_t, int32_t adc_p);
+
+typedef struct {
+    HostI2cDevice device;
+    float temperature; // DegC
+    float humidity;    // %RH
+    uint64_t busy_until_us; // Measuring or resetting, NAKs its address
+    bool data_ready;
+    uint8_t data[6]; // The next read's frame: words with their CRCs
+    uint8_t last_command;
+    uint32_t measurements;
+} Sht40Model;
+
+void sht40_model_init(Sht40Model *model, uint8_t addr);
+
+typedef struct {
+    HostI2cDevice device;
+    uint16_t regs[6];
+    uint8_t pointer;
+    bool converting;
+    uint64_t ready_us;
+    float bus_voltage; // V
+    float current;     // A through the shunt
+    float shunt_ohms;
+    uint32_t conversions;
+} Ina219Model;
+
+void ina219_model_init(Ina219Model *model, uint8_t addr, float shunt_ohms);
+
+#endif // SENSOR_MODELS_H
@@ -0,0 +1,212 @@
+#include "i2c_bus.h"
+#include "hal.h"
+#include <string.h>
+
+_Static_assert(I2C_BUS_JOB_WRITE_MAX + I2C_BUS_JOB_READ_MAX <= HAL_I2C_ASYNC_MAX, "job too long for the HAL");
+
+typedef struct {
+    HalI2cBus *i2c;
+    I2cJob *chain[I2C_BUS_CHAIN_MAX];
+    uint8_t chain_length;
+    uint8_t chain_next;   // First job not yet started
+    I2cJob *running;
+    uint64_t running_start_us;
+    uint32_t running_timeout_us;
+    uint32_t max_hz;       // Slowest attached device, 0 = none attached
+} I2cBus;
+
+static I2cBus buses[HAL_I2C_COUNT];
+
+// Start a bus over with no jobs or devices, hal_i2c_init must have been called
+void i2c_bus_init(HalI2cBus *i2c) {
+    I2cBus *bus = &buses[hal_i2c_index(i2c)];
+    bus->i2c = i2c;
+    bus->chain_length = 0;
+    bus->chain_next = 0;
+    bus->running = NULL;
+    bus->max_hz = 0;
+}
+
+// Note the fastest clock a device on the bus supports. Attach every device
+// before i2c_bus_negotiate; until then the bus runs at I2C_BUS_PROBE_HZ.
+void i2c_bus_attach(HalI2cBus *i2c, uint32_t max_hz) {
+    I2cBus *bus = &buses[hal_i2c_index(i2c)];
+    if (bus->max_hz == 0 || max_hz < bus->max_hz) {
+        bus->max_hz = max_hz;
+    }
+}
+
+// Switch the bus to the fastest clock all attached devices support, returns
+// the actual clock. Without external pull-ups the probe clock is kept.
+uint32_t i2c_bus_negotiate(HalI2cBus *i2c) {
+    I2cBus *bus = &buses[hal_i2c_index(i2c)];
+    uint32_t hz = bus->max_hz == 0 ? I2C_BUS_PROBE_HZ : bus->max_hz;
+    if (hz > I2C_BUS_MAX_HZ) {
+        hz = I2C_BUS_MAX_HZ;
+    }
+#if !I2C_EXTERNAL_PULLUPS
+    if (hz > I2C_BUS_PROBE_HZ) {
+        hz = I2C_BUS_PROBE_HZ;
+    }
+#endif
+    return hal_i2c_set_clock(i2c, hz);
+}
+
+void i2c_job_write(I2cJob *job, uint8_t addr, const uint8_t *src, uint8_t length) {
+    memset(job, 0, sizeof(*job));
+    job->addr = addr;
+    job->write_length = length > I2C_BUS_JOB_WRITE_MAX ? I2C_BUS_JOB_WRITE_MAX : length;
+    job->nak_backoff_us = I2C_BUS_NAK_BACKOFF_US;
+    if (job->write_length > 0) {
+        memcpy(job->write, src, job->write_length);
+    }
+}
+
+// Register read: the register pointer, then read_length bytes after a repeated start
+void i2c_job_write_read(I2cJob *job, uint8_t addr, uint8_t reg, uint8_t read_length) {
+    i2c_job_write(job, addr, &reg, 1);
+    job->read_length = read_length > I2C_BUS_JOB_READ_MAX ? I2C_BUS_JOB_READ_MAX : read_length;
+}
+
+// Append a job to the bus's chain, it runs on the next i2c_bus_run
+bool i2c_bus_queue(HalI2cBus *i2c, I2cJob *job) {
+    I2cBus *bus = &buses[hal_i2c_index(i2c)];
+    if (bus->i2c == NULL || bus->chain_length == I2C_BUS_CHAIN_MAX) {
+        job->result = HAL_ERROR_GENERIC;
+        return false;
+    }
+    job->result = 0;
+    job->attempts = 0;
+    bus->chain[bus->chain_length++] = job;
+    return true;
+}
+
+static void i2c_bus_finish(I2cBus *bus, int result);
+
+static void i2c_bus_start(I2cBus *bus, I2cJob *job) {
+    job->attempts++;
+    bus->running = job;
+    bus->running_start_us = hal_time_us();
+    bus->running_timeout_us = hal_i2c_timeout_us(bus->i2c, job->write_length + job->read_length);
+    if (!hal_i2c_start(bus->i2c, job->addr, job->write, job->write_length, job->read, job->read_length)) {
+        i2c_bus_finish(bus, HAL_ERROR_GENERIC);
+    }
+}
+
+static void i2c_bus_finish(I2cBus *bus, int result) {
+    I2cJob *job = bus->running;
+    if (result < 0) {
+        hal_i2c_abort(bus->i2c);
+    }
+    job->result = result;
+    hal_i2c_account(bus->i2c, bus->running_start_us, result, job->write_length + job->read_length);
+    bus->running = NULL;
+
+    if (result == HAL_ERROR_TIMEOUT) {
+        hal_i2c_recover(bus->i2c);
+    }
+    // Jobs are self-contained (the register pointer travels with the read),
+    // so a failed one can simply run again. After a NAK the device is given
+    // time: the job goes back to the head of the chain with a start time.
+    if (result < 0 && job->attempts <= I2C_BUS_JOB_RETRIES) {
+        hal_i2c_account_retry(bus->i2c);
+        if (result == HAL_ERROR_TIMEOUT) {
+            i2c_bus_start(bus, job);
+        } else {
+            job->not_before_us = hal_time_us() + job->nak_backoff_us;
+            bus->chain_next--;
+        }
+    }
+}
+
+// Advance a bus's chain, returns true while it has work left
+static bool i2c_bus_poll(I2cBus *bus, uint64_t now_us) {
+    if (bus->running != NULL) {
+        int result = hal_i2c_poll(bus->i2c);
+        if (result != HAL_PENDING) {
+            i2c_bus_finish(bus, result); // Bytes moved, or an address or data NAK
+        } else if (now_us - bus->running_start_us > bus->running_timeout_us) {
+            i2c_bus_finish(bus, HAL_ERROR_TIMEOUT);
+        } else {
+            return true;
+        }
+        if (bus->running != NULL) {
+            return true; // Retrying
+        }
+    }
+
+    if (bus->chain_next < bus->chain_length) {
+        I2cJob *next = bus->chain[bus->chain_next];
+        if (now_us >= next->not_before_us) {
+            bus->chain_next++;
+            i2c_bus_start(bus, next);
+        }
+        return true;
+    }
+
+    bus->chain_length = 0;
+    bus->chain_next = 0;
+    return false;
+}
+
+// Upper bound on how long i2c_bus_run will take for the queued chains: every
+// job waits for its start time, misses its deadline and on each retry first
+// recovers the bus or backs off from a NAK, whichever is longer. The buses run in parallel, so the slower
+// chain sets the bound.
+uint32_t i2c_bus_worst_case_us(void) {
+    uint64_t now_us = hal_time_us();
+    uint64_t worst_us = now_us;
+    for (uint8_t i = 0; i < HAL_I2C_COUNT; i++) {
+        I2cBus *bus = &buses[i];
+        if (bus->i2c == NULL) {
+            continue;
+        }
+        uint64_t t = now_us;
+        for (uint8_t j = bus->chain_next; j < bus->chain_length; j++) {
+            const I2cJob *job = bus->chain[j];
+            if (job->not_before_us > t) {
+                t = job->not_before_us;
+            }
+            uint32_t attempt_us = hal_i2c_timeout_us(bus->i2c, job->write_length + job->read_length);
+            uint32_t retry_us = attempt_us + (job->nak_backoff_us > HAL_I2C_RECOVER_MAX_US
+                                                  ? job->nak_backoff_us
+                                                  : HAL_I2C_RECOVER_MAX_US);
+            t += attempt_us + (uint64_t)I2C_BUS_JOB_RETRIES * retry_us;
+        }
+        if (t > worst_us) {
+            worst_us = t;
+        }
+    }
+    return (uint32_t)(worst_us - now_us);
+}
+
+// Run every queued chain to completion, the buses in parallel. While no
+// transfer is in flight the core sleeps until the next job's start time.
+void i2c_bus_run(void) {
+    while (true) {
+        uint64_t now_us = hal_time_us();
+        bool busy = false;
+        bool transferring = false;
+        uint64_t wake_us = UINT64_MAX;
+        for (uint8_t i = 0; i < HAL_I2C_COUNT; i++) {
+            I2cBus *bus = &buses[i];
+            if (bus->i2c == NULL || !i2c_bus_poll(bus, now_us)) {
+                continue;
+            }
+            busy = true;
+            if (bus->running != NULL) {
+                transferring = true;
+            } else if (bus->chain[bus->chain_next]->not_before_us < wake_us) {
+                wake_us = bus->chain[bus->chain_next]->not_before_us;
+            }
+        }
+        if (!busy) {
+            return;
+        }
+        if (transferring) {
+            hal_spin();
+        } else if (wake_us != UINT64_MAX) {
+            hal_sleep_until(wake_us);
+        }
+    }
+}
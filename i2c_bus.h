@@ -0,0 +1,60 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Asynchronous transactions on both I2C controllers. Jobs are queued per bus
+// and run in order, each one as a split-phase HAL transfer (DMA on the
+// RP2040). i2c_bus_run drives the chains on i2c0 and i2c1 side by side, so
+// devices on different buses are read at the same time. A job may carry a
+// start time (e.g. a conversion finishing); later jobs on the same bus wait
+// for it.
+// Bus time is charged to the HAL's per-bus stats.
+//
+// Every job has a deadline from hal_i2c_timeout_us. A job that misses it
+// recovers the bus (hal_i2c_recover) and runs again at once. A NAK usually
+// means the device is busy, the job runs again after its nak_backoff_us
+// (a conversion time, say); other jobs on the bus wait for it.
+// After I2C_BUS_JOB_RETRIES repeats the error is left in job->result.
+// Devices are attached with the fastest clock they support. With
+// I2C_EXTERNAL_PULLUPS each bus is run at the slowest of those, capped at
+// I2C_BUS_MAX_HZ; the internal pull-ups (~50 kOhm) only hold standard mode,
+// so without it every bus stays at I2C_BUS_PROBE_HZ.
+
+#define I2C_BUS_JOB_WRITE_MAX 4
+#define I2C_BUS_JOB_READ_MAX  8
+#define I2C_BUS_CHAIN_MAX     12
+#define I2C_BUS_JOB_RETRIES   1
+#define I2C_BUS_MAX_HZ        1000000 // Fast-mode Plus
+#define I2C_BUS_PROBE_HZ      100000  // Standard mode, every device answers
+#define I2C_BUS_NAK_BACKOFF_US 1000   // Default wait before a NAKed job runs again
+
+// Board define: 1 if the I2C lines have external pull-ups fitted
+#ifndef I2C_EXTERNAL_PULLUPS
+#define I2C_EXTERNAL_PULLUPS 0
+#endif
+
+typedef struct {
+    uint8_t addr;
+    uint8_t write_length;
+    uint8_t read_length;   // Read after a repeated start, 0 for a plain write
+    uint8_t write[I2C_BUS_JOB_WRITE_MAX];
+    uint8_t read[I2C_BUS_JOB_READ_MAX];
+    uint64_t not_before_us; // hal_time_us() the job may start at, 0 = at once
+    uint32_t nak_backoff_us; // Wait before running again after a NAK
+    int result;            // Bytes moved, HAL_ERROR_GENERIC (NAK) or HAL_ERROR_TIMEOUT
+    uint8_t attempts;      // Runs so far, 1 unless retried
+} I2cJob;
+
+void i2c_bus_init(HalI2cBus *i2c);
+void i2c_bus_attach(HalI2cBus *i2c, uint32_t max_hz);
+uint32_t i2c_bus_negotiate(HalI2cBus *i2c);
+void i2c_job_write(I2cJob *job, uint8_t addr, const uint8_t *src, uint8_t length);
+void i2c_job_write_read(I2cJob *job, uint8_t addr, uint8_t reg, uint8_t read_length);
+bool i2c_bus_queue(HalI2cBus *i2c, I2cJob *job);
+uint32_t i2c_bus_worst_case_us(void);
+void i2c_bus_run(void);
+
+#endif // I2C_BUS_H
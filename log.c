@@ -0,0 +1,87 @@
+#include "log.h"
+#include "pico/stdlib.h"
+#include "pico/critical_section.h"
+
+// Records from both cores and from interrupt handlers share one byte ring,
+// each record is written and removed as a whole under the critical section.
+
+volatile uint8_t log_level = LOG_COMPILE_LEVEL;
+
+static uint8_t buffer[LOG_BUFFER_SIZE];
+static uint32_t head; // Next byte to write
+static uint32_t tail; // Next byte to drain
+static uint32_t dropped;
+static critical_section_t lock;
+
+void log_init(void) {
+    critical_section_init(&lock);
+}
+
+void log_set_level(uint8_t level) {
+    log_level = level;
+}
+
+static void log_put(uint32_t* position, uint8_t byte) {
+    buffer[*position & (LOG_BUFFER_SIZE - 1)] = byte;
+    (*position)++;
+}
+
+static void log_put_word(uint32_t* position, uint32_t word) {
+    for (int i = 0; i < 4; i++) {
+        log_put(position, (uint8_t)(word >> (8 * i)));
+    }
+}
+
+// words[0] is the format string address, the rest are the arguments
+void log_write(uint8_t level, const uint32_t* words, uint8_t word_count) {
+    uint8_t arg_count = word_count - 1;
+    if (arg_count > LOG_MAX_ARGS) {
+        arg_count = LOG_MAX_ARGS;
+    }
+    uint32_t size = LOG_RECORD_HEADER_SIZE + arg_count * 4;
+    uint32_t timestamp = time_us_32();
+
+    critical_section_enter_blocking(&lock);
+    if (LOG_BUFFER_SIZE - (head - tail) < size) {
+        dropped++;
+        critical_section_exit(&lock);
+        return;
+    }
+    uint32_t position = head;
+    log_put(&position, LOG_RECORD_SYNC);
+    log_put(&position, (uint8_t)((level << 4) | arg_count));
+    log_put_word(&position, timestamp);
+    for (uint8_t i = 0; i <= arg_count; i++) {
+        log_put_word(&position, words[i]);
+    }
+    head = position;
+    critical_section_exit(&lock);
+}
+
+// Write out everything queued so far. Safe to call from either core.
+void log_drain(void) {
+    uint8_t record[LOG_RECORD_MAX_SIZE];
+
+    while (true) {
+        critical_section_enter_blocking(&lock);
+        if (head == tail) {
+            critical_section_exit(&lock);
+            return;
+        }
+        uint8_t info = buffer[(tail + 1) & (LOG_BUFFER_SIZE - 1)];
+        uint32_t size = LOG_RECORD_HEADER_SIZE + (info & 0x0F) * 4;
+        for (uint32_t i = 0; i < size; i++) {
+            record[i] = buffer[tail & (LOG_BUFFER_SIZE - 1)];
+            tail++;
+        }
+        critical_section_exit(&lock);
+
+        for (uint32_t i = 0; i < size; i++) {
+            putchar_raw(record[i]);
+        }
+    }
+}
+
+uint32_t log_dropped(void) {
+    return dropped;
+}
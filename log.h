@@ -0,0 +1,102 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tokenized logging. A LOG() call stores the address of its format string
+// plus each argument as a raw 32-bit word in a RAM ring; log_drain() writes
+// the records out as binary and tools/log_decode.py rebuilds the text from
+// the firmware ELF. No printf formatting happens at the call site.
+//
+// Arguments: integers up to 32 bits, float/double (sent as float bits) and
+// pointers to strings that live in flash (string literals). 64-bit integers
+// are truncated, use %lu with a cast for those.
+//
+// Build with -DLOG_TEXT=1 to turn LOG() back into plain printf.
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+
+// Calls above this level compile to nothing
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_BUFFER_SIZE 2048 // Must be a power of two
+#define LOG_MAX_ARGS 8
+
+// Record: SYNC, info (level << 4 | argument count), timestamp us (u32),
+// format string address (u32), arguments (u32 each). All little endian.
+#define LOG_RECORD_SYNC 0x1E
+#define LOG_RECORD_HEADER_SIZE 10
+#define LOG_RECORD_MAX_SIZE (LOG_RECORD_HEADER_SIZE + LOG_MAX_ARGS * 4)
+
+// Runtime level, calls above it are skipped
+extern volatile uint8_t log_level;
+
+void log_init(void);
+void log_set_level(uint8_t level);
+void log_write(uint8_t level, const uint32_t *words, uint8_t word_count);
+void log_drain(void);
+uint32_t log_dropped(void);
+
+// A function rather than in the macro: with LOG_LEVEL_ERROR the comparison
+// is always true and -Wextra would flag every LOG_ERROR call
+static inline bool log_enabled(uint8_t level) { return level <= log_level; }
+
+static inline uint32_t log_word_int(uint32_t value) { return value; }
+static inline uint32_t log_word_float(float value) {
+    union { float f; uint32_t u; } bits = { .f = value };
+    return bits.u;
+}
+static inline uint32_t log_word_double(double value) { return log_word_float((float)value); }
+static inline uint32_t log_word_pointer(const void *value) { return (uint32_t)(uintptr_t)value; }
+
+#define LOG_ARG(x) _Generic((x), \
+    float: log_word_float, \
+    double: log_word_double, \
+    char *: log_word_pointer, \
+    const char *: log_word_pointer, \
+    default: log_word_int)(x)
+
+#define LOG_NARGS(...) LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a##b
+#define LOG_MAP_0()
+#define LOG_MAP_1(a) LOG_ARG(a)
+#define LOG_MAP_2(a, ...) LOG_ARG(a), LOG_MAP_1(__VA_ARGS__)
+#define LOG_MAP_3(a, ...) LOG_ARG(a), LOG_MAP_2(__VA_ARGS__)
+#define LOG_MAP_4(a, ...) LOG_ARG(a), LOG_MAP_3(__VA_ARGS__)
+#define LOG_MAP_5(a, ...) LOG_ARG(a), LOG_MAP_4(__VA_ARGS__)
+#define LOG_MAP_6(a, ...) LOG_ARG(a), LOG_MAP_5(__VA_ARGS__)
+#define LOG_MAP_7(a, ...) LOG_ARG(a), LOG_MAP_6(__VA_ARGS__)
+#define LOG_MAP_8(a, ...) LOG_ARG(a), LOG_MAP_7(__VA_ARGS__)
+#define LOG_WORDS(...) LOG_CAT(LOG_MAP_, LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+#if LOG_TEXT
+#include <stdio.h>
+#define LOG(level, fmt, ...) do { \
+        if ((level) <= LOG_COMPILE_LEVEL && log_enabled(level)) { \
+            printf(fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+#else
+#define LOG(level, fmt, ...) do { \
+        if ((level) <= LOG_COMPILE_LEVEL && log_enabled(level)) { \
+            static const char log_format[] = fmt; \
+            const uint32_t log_words[] = { log_word_pointer(log_format), LOG_WORDS(__VA_ARGS__) }; \
+            log_write((level), log_words, sizeof(log_words) / sizeof(log_words[0])); \
+        } \
+    } while (0)
+#endif
+
+#define LOG_ERROR(...) LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  LOG(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)  LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif // LOG_H
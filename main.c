@@ -1,31 +1,332 @@
 #include "sensors.h"
 #include "radio.h"
+#include "spsc_queue.h"
+#include "log.h"
+#include "trace.h"
+#include "power.h"
+#include "scheduler.h"
+#include "tx_filter.h"
+#include "packet.h"
+#include "sensor_stats.h"
+#include "sample_log.h"
+#include "boot_cache.h"
+#include "hal.h"
 #include "hardware/spi.h"
 #include "hardware/i2c.h"
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/flash.h"
 #include <stdio.h>
 
+#define SAMPLE_QUEUE_CAPACITY 8 // Must be a power of two
+#define TRACE_DUMP_COMMAND 't'  // Send over the console to dump the trace rings
+// Store-and-forward log, 256 KiB right below the boot cache sector
+#define SAMPLE_LOG_SECTORS 64
+#define SAMPLE_LOG_FLASH_OFFSET (BOOT_CACHE_FLASH_OFFSET - SAMPLE_LOG_SECTORS * HAL_FLASH_SECTOR_SIZE)
+
+// The pipeline the station runs, see STATION_FIXED_PIPELINE in sensors.h.
+// Everything from the read to the sample log goes through these.
+#if STATION_FIXED_PIPELINE
+typedef SensorDataFixed StationSample;
+typedef SensorStatsFixed StationStats;
+#define station_read_sensors sensors_read_all_fixed
+#define station_stats_reset sensor_stats_fixed_reset
+#define station_stats_add sensor_stats_fixed_add
+#define station_stats_report sensor_stats_fixed_report
+#define station_scheduler_update scheduler_update_fixed
+#define station_scheduler_annotate scheduler_annotate_fixed
+#define station_tx_filter_check tx_filter_check_fixed
+#define station_batch_sample_size packet_batch_sample_size_fixed
+#define station_radio_queue radio_queue_fixed
+#define station_radio_set_undelivered radio_set_undelivered_fixed
+#define station_sample_log_append sample_log_append_fixed
+#else
+typedef SensorData StationSample;
+typedef SensorStats StationStats;
+#define station_read_sensors sensors_read_all
+#define station_stats_reset sensor_stats_reset
+#define station_stats_add sensor_stats_add
+#define station_stats_report sensor_stats_report
+#define station_scheduler_update scheduler_update
+#define station_scheduler_annotate scheduler_annotate
+#define station_tx_filter_check tx_filter_check
+#define station_batch_sample_size packet_batch_sample_size
+#define station_radio_queue radio_queue_data
+#define station_radio_set_undelivered radio_set_undelivered
+#define station_sample_log_append sample_log_append
+#endif
+
+// Samples handed from the acquisition core (0) to the radio core (1)
+static StationSample sample_storage[SAMPLE_QUEUE_CAPACITY];
+static SpscQueue sample_queue;
+
+// Batch as many samples as one transmit interval spans, sent no later than
+// the interval after the oldest. Runs on the radio core.
+static void apply_tx_interval(const StationSample *data) {
+    static uint32_t applied_ms;
+    if (!(data->present & SENSOR_BIT(SENSOR_CH_TX_INTERVAL)) || data->sample_interval <= 0) {
+        return;
+    }
+#if STATION_FIXED_PIPELINE
+    uint32_t tx_interval_ms = (uint32_t)data->tx_interval * 1000;
+#else
+    uint32_t tx_interval_ms = (uint32_t)(data->tx_interval * 1000.0f);
+#endif
+    if (tx_interval_ms == applied_ms) {
+        return;
+    }
+    uint32_t samples = (uint32_t)(data->tx_interval / data->sample_interval);
+    if (samples > RADIO_BATCH_MAX_SAMPLES) {
+        samples = RADIO_BATCH_MAX_SAMPLES;
+    }
+    radio_set_batching(samples, tx_interval_ms);
+    applied_ms = tx_interval_ms;
+}
+
+// Sample log writes from the radio core park core 0 under flash_safe_execute
+// with its interrupts off for the whole operation: W25Q16JV sector erase
+// 45 ms typical, 400 ms max, page program 0.4 ms typical, 3 ms max. An I2C
+// transaction core 0 had in flight would miss its deadline
+// (HAL_I2C_TIMEOUT_BASE_US, 1 ms plus twice the wire time) and be recovered
+// as a timeout. The undelivered handler and backfill only fill RAM;
+// sync_sample_log programs it from the radio core's idle loop, while core 0
+// sleeps between sensor cycles and only as much as the time left before it
+// wakes covers at the worst case. Nothing waits for flash in a send or an ACK
+// window. Needs a sample interval longer than an erase,
+// STATS_OVERSAMPLE_INTERVAL_MS is the shortest.
+#define FLASH_ERASE_MAX_US 400000
+#define FLASH_PROGRAM_MAX_US 3000
+
+static volatile bool sensors_sleeping;
+static volatile uint32_t sensors_wake_us;
+
+static const SampleLogFlash sample_log_flash = {
+    .offset = SAMPLE_LOG_FLASH_OFFSET,
+    .sectors = SAMPLE_LOG_SECTORS,
+    .erase = hal_flash_erase,
+    .program = hal_flash_program,
+    .read = hal_flash_read,
+    .erase_max_us = FLASH_ERASE_MAX_US,
+    .program_max_us = FLASH_PROGRAM_MAX_US,
+};
+
+// Radio core, between sends: program what the sample log holds in RAM if
+// core 0 sleeps. The rest waits for the next pass, __sev() from core 0 going
+// to sleep starts one.
+static void sync_sample_log(void) {
+    int32_t left_us = (int32_t)(sensors_wake_us - time_us_32());
+    if (sensors_sleeping && left_us > 0) {
+        sample_log_sync((uint32_t)left_us);
+    }
+}
+
+// Radio core: samples the gateway did not acknowledge wait in the sample log
+static void log_undelivered(const StationSample *data, uint64_t queued_us) {
+    if (!station_sample_log_append(data, (uint32_t)(queued_us / 1000))) {
+        LOG_WARN("Sample log write failed, sample dropped\n");
+    }
+}
+
+// Send logged samples in full frames back to back while the link holds. Live
+// samples go first: stops as soon as one is queued or a batch is due.
+static void backfill(void) {
+    uint8_t body[RADIO_MAX_PAYLOAD - PACKET_BATCH_HEADER_SIZE];
+    uint8_t length;
+    uint32_t sent = 0;
+    uint32_t start_us = time_us_32();
+    while (radio_link_up() && sample_log_pending() > 0 && spsc_queue_depth(&sample_queue) == 0 &&
+           radio_batch_time_left_ms() > 0) {
+        uint8_t count = sample_log_peek(body, &length, NULL, RADIO_BATCH_MAX_SAMPLES, sizeof(body),
+                                        (uint32_t)(time_us_64() / 1000));
+        if (count == 0 || !radio_send_backfill(body, length, count)) {
+            break;
+        }
+        sample_log_consume(count);
+        sent += count;
+    }
+    if (sent > 0) {
+        SampleLogStats stats;
+        sample_log_get_stats(&stats);
+        LOG_INFO("Backfill: %lu samples in %lu us, %lu pending\n", (unsigned long)sent,
+                 (unsigned long)(time_us_32() - start_us), (unsigned long)sample_log_pending());
+        LOG_INFO("Sample log: %lu logged, %lu delivered, %lu dropped, %lu erases, %lu write errors, "
+                 "%lu read errors\n",
+                 (unsigned long)stats.appended, (unsigned long)stats.delivered, (unsigned long)stats.dropped,
+                 (unsigned long)stats.erases, (unsigned long)stats.write_errors, (unsigned long)stats.read_errors);
+    }
+}
+
+// Core 1: owns the radio, encodes and transmits queued samples
+static void core1_entry(void) {
+    // Lets core 0 write flash (boot cache) while this core runs
+    flash_safe_execute_core_init();
+    printf("Radio starting..\n");
+    radio_init(F_433);
+    radio_set_batching(RADIO_BATCH_SAMPLES, RADIO_BATCH_MAX_LATENCY_MS);
+    radio_sleep(); // Woken for each send
+    // Frames wait for the gateway's acknowledgement, what it misses is logged
+    // and sent again once the link is back (first try: right now, for what
+    // was left from before the reset)
+    sample_log_init(&sample_log_flash);
+    station_radio_set_undelivered(log_undelivered);
+    LOG_INFO("Sample log: %lu samples pending\n", (unsigned long)sample_log_pending());
+    bool first_packet = true;
+
+    while (true) {
+        StationSample sensor_data;
+        if (!spsc_queue_pop(&sample_queue, &sensor_data)) {
+            sync_sample_log();
+            backfill();
+            uint32_t time_left_ms = radio_batch_time_left_ms();
+            if (time_left_ms == 0) {
+                radio_flush();
+            } else if (time_left_ms != UINT32_MAX) {
+                best_effort_wfe_or_timeout(make_timeout_time_ms(time_left_ms));
+            } else {
+                __wfe(); // Woken by __sev() from the producer
+            }
+            continue;
+        }
+        // Send data via radio, possibly batched with later samples
+        apply_tx_interval(&sensor_data);
+        LOG_DEBUG("Sending data...\n");
+        station_radio_queue(&sensor_data);
+        if (first_packet) {
+            // The first report tells the gateway the node is up, it is not
+            // held back for a batch
+            radio_flush();
+            LOG_INFO("First packet %lu ms after power-on\n", (unsigned long)(time_us_32() / 1000));
+            first_packet = false;
+        }
+        LOG_DEBUG("Sending finished...\n");
+    }
+}
+
+// Modelled charge of the cycle that just ended, next to the same cycle with
+// the radio left in IDLE and the INA219 left running. Measured times,
+// datasheet currents from power.h: an estimate, not a supply measurement.
+static void report_cycle_energy(uint32_t cycle_us, uint32_t awake_us, uint32_t sensors_us) {
+    static RadioPowerStats radio_before;
+    RadioPowerStats radio_now;
+    radio_get_power_stats(&radio_now);
+
+    PowerCycle cycle = {
+        .cycle_us = cycle_us,
+        .radio_awake_us = radio_now.awake_us - radio_before.awake_us,
+        .radio_tx_us = radio_now.tx_us - radio_before.tx_us,
+        .radio_rx_us = radio_now.rx_us - radio_before.rx_us,
+        .ina219_active_us = sensors_us, // Upper bound, it is powered down mid-cycle
+    };
+    cycle.mcu_active_us = awake_us + cycle.radio_awake_us;
+    if (cycle.mcu_active_us > cycle_us) {
+        cycle.mcu_active_us = cycle_us;
+    }
+    radio_before = radio_now;
+
+    LOG_INFO("Modelled cycle charge: %lu uC (%lu uC without power-down), awake %lu us, radio awake %lu us\n",
+             (unsigned long)power_cycle_charge_uc(&cycle, true),
+             (unsigned long)power_cycle_charge_uc(&cycle, false),
+             (unsigned long)awake_us, (unsigned long)cycle.radio_awake_us);
+}
+
 int main()
 {
     stdio_init_all();
+    log_init();
 
-    printf("Radio starting..\n");
-    radio_init(F_433);
+    spsc_queue_init(&sample_queue, sample_storage, sizeof(StationSample), SAMPLE_QUEUE_CAPACITY);
+    // Lets core 1 write flash (sample log) while this core runs
+    flash_safe_execute_core_init();
+    multicore_launch_core1(core1_entry);
 
     printf("Hello, IoT world from RP2040!\n");
     sensors_init();
     printf("Sensors starting..\n");
 
+    // The sensors are read every STATS_OVERSAMPLE_INTERVAL_MS; a report with
+    // the interval's statistics goes out on the scheduler's cadence,
+    // independent of radio airtime
+    Scheduler scheduler;
+    scheduler_init(&scheduler);
+    TxFilter tx_filter;
+    tx_filter_init(&tx_filter);
+    StationStats stats;
+    station_stats_reset(&stats);
+    uint64_t airtime_saved_us = 0;
+    absolute_time_t next_sample = get_absolute_time();
+    absolute_time_t next_report = next_sample;
+    uint32_t wake_us = time_us_32();
     while (true) {
         // Read sensor data
-        printf("Reading sensors...\n");
-        SensorData sensor_data  = sensors_read_all();
-        printf("Reading finished...\n");
-        // Send data via radio
-        printf("Sending data...\n");
-        radio_send_data(&sensor_data);
-        printf("Sending finished...\n");
-        // Delay between readings
-        sleep_ms(10000);
+        LOG_DEBUG("Reading sensors...\n");
+        StationSample sensor_data = station_read_sensors();
+        LOG_DEBUG("Reading finished...\n");
+        // Scheduled wake to sample ready: wake-up lateness plus the sensor cycle
+        uint32_t sensors_us = time_us_32() - wake_us;
+        LOG_DEBUG("Wake to sample: %lu us\n", (unsigned long)absolute_time_diff_us(next_sample, get_absolute_time()));
+        station_stats_add(&stats, &sensor_data);
+
+        if (time_reached(next_report)) {
+            StationSample report;
+            station_stats_report(&stats, &report);
+            LOG_INFO("Report over %lu samples\n", (unsigned long)stats.samples);
+            station_stats_reset(&stats);
+
+            // Pick the next intervals from the energy readings and report them
+            if (station_scheduler_update(&scheduler, &report)) {
+                LOG_INFO("Scheduler state %d: sample every %lu ms, transmit every %lu ms\n", scheduler.state,
+                         (unsigned long)scheduler.sample_interval_ms, (unsigned long)scheduler.tx_interval_ms);
+            }
+            station_scheduler_annotate(&scheduler, &report);
+            next_report = delayed_by_ms(next_report, scheduler.sample_interval_ms);
+
+            // Only reports that moved past a deadband (or the heartbeat) go out.
+            // Hand over to the radio core, the report is dropped if it fell behind
+            if (station_tx_filter_check(&tx_filter, &report, time_us_64())) {
+                if (!spsc_queue_push(&sample_queue, &report)) {
+                    LOG_WARN("Sample queue full, sample dropped\n");
+                }
+                __sev();
+            } else {
+                // What the report would have cost on air as a frame of its own
+                airtime_saved_us += radio_airtime_us(PACKET_HEADER_SIZE + station_batch_sample_size(&report) -
+                                                     PACKET_AGE_SIZE);
+            }
+            LOG_INFO("TX filter: %lu sent, %lu suppressed, ~%lu ms airtime saved\n", (unsigned long)tx_filter.sent,
+                     (unsigned long)tx_filter.suppressed, (unsigned long)(airtime_saved_us / 1000));
+            LOG_INFO("Sample queue depth: %lu/%lu, max: %lu, overruns: %lu, log drops: %lu\n",
+                     (unsigned long)spsc_queue_depth(&sample_queue),
+                     (unsigned long)spsc_queue_capacity(&sample_queue),
+                     (unsigned long)spsc_queue_high_watermark(&sample_queue),
+                     (unsigned long)spsc_queue_overruns(&sample_queue),
+                     (unsigned long)log_dropped());
+        }
+
+        // Write out the log records from both cores while the sensors idle
+        log_drain();
+        if (getchar_timeout_us(0) == TRACE_DUMP_COMMAND) {
+            trace_dump();
+        }
+
+        // Delay between readings. The radio is in SLEEP and the INA219 powered
+        // down; sleep_until parks this core in WFE until the timer alarm, the
+        // same MCU sleep state as the baseline's sleep_ms.
+        uint32_t awake_us = time_us_32() - wake_us;
+        // Low on energy there is no budget for oversampling, one read per report
+        uint32_t oversample_ms = scheduler.state == SCHEDULER_STATE_LOW ? scheduler.sample_interval_ms
+                                                                        : STATS_OVERSAMPLE_INTERVAL_MS;
+        next_sample = delayed_by_ms(next_sample, oversample_ms);
+        if (absolute_time_diff_us(next_report, next_sample) > 0) {
+            next_sample = next_report; // Never oversample past a report
+        }
+        sensors_wake_us = to_us_since_boot(next_sample);
+        sensors_sleeping = true;
+        __sev();
+        sleep_until(next_sample);
+        sensors_sleeping = false;
+
+        uint32_t now_us = time_us_32();
+        report_cycle_energy(now_us - wake_us, awake_us, sensors_us);
+        wake_us = now_us;
     }
 }
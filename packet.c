@@ -0,0 +1,459 @@
+#include "packet.h"
+#include <stddef.h>
+#include <string.h>
+
+// Per-channel wire scale, chosen from the resolution each sensor really has:
+// wire units per physical unit
+static const float packet_schema[SENSOR_CH_COUNT] = {
+    [SENSOR_CH_TEMPERATURE]          = 100.0f,    // 0.01 DegC
+    [SENSOR_CH_PRESSURE]             = 10.0f,     // 0.1 hPa
+    [SENSOR_CH_EXTERIOR_TEMPERATURE] = 100.0f,    // 0.01 DegC
+    [SENSOR_CH_EXTERIOR_HUMIDITY]    = 100.0f,    // 0.01 %RH
+    [SENSOR_CH_BATTERY_VOLTAGE]      = 1000.0f,   // 1 mV (LSB 4 mV)
+    [SENSOR_CH_BATTERY_CURRENT]      = 10000.0f,  // 0.1 mA
+    [SENSOR_CH_BATTERY_POWER]        = 1000.0f,   // 1 mW
+    [SENSOR_CH_SOLAR_VOLTAGE]        = 1000.0f,   // 1 mV (LSB 4 mV)
+    [SENSOR_CH_SOLAR_CURRENT]        = 10000.0f,  // 0.1 mA
+    [SENSOR_CH_SOLAR_POWER]          = 1000.0f,   // 1 mW
+    [SENSOR_CH_SAMPLE_INTERVAL]      = 1.0f,      // 1 s
+    [SENSOR_CH_TX_INTERVAL]          = 1.0f,      // 1 s
+};
+
+static int16_t packet_to_wire(float value, float scale) {
+    float scaled = value * scale;
+    if (scaled >= 32767.0f) {
+        return INT16_MAX;
+    }
+    if (scaled <= -32768.0f) {
+        return INT16_MIN;
+    }
+    return (int16_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+static uint16_t packet_present(const SensorData *data) {
+    return data->present & (SENSOR_BIT(SENSOR_CH_COUNT) - 1);
+}
+
+// Fixed point values are already in wire units, only the range is clamped
+static int16_t packet_fixed_to_wire(int32_t value) {
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)value;
+}
+
+static bool packet_put_wire(uint8_t *buffer, uint8_t size, uint8_t *byte_index, int16_t value) {
+    if (*byte_index + PACKET_CHANNEL_SIZE > size) {
+        return false;
+    }
+    uint16_t wire = (uint16_t)value;
+    buffer[(*byte_index)++] = wire & 0xFF;
+    buffer[(*byte_index)++] = wire >> 8;
+    return true;
+}
+
+static bool packet_put(uint8_t *buffer, uint8_t size, uint8_t *byte_index, float value, float scale) {
+    return packet_put_wire(buffer, size, byte_index, packet_to_wire(value, scale));
+}
+
+static uint16_t packet_spread_present(const SensorData *data) {
+    return data->spread_present & packet_present(data);
+}
+
+// Encode the bitmap and channel values, returns the length or 0 if it does not fit
+uint8_t packet_encode_sample(const SensorData *data, uint8_t *buffer, uint8_t size) {
+    uint16_t present = packet_present(data);
+    uint16_t spread_present = packet_spread_present(data);
+    uint16_t bitmap = present | (spread_present ? PACKET_PRESENT_SPREAD : 0);
+    uint8_t byte_index = 0;
+
+    if (size < PACKET_BITMAP_SIZE) {
+        return 0;
+    }
+    buffer[byte_index++] = bitmap & 0xFF;
+    buffer[byte_index++] = bitmap >> 8;
+
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (!(present & SENSOR_BIT(ch))) {
+            continue;
+        }
+        if (!packet_put(buffer, size, &byte_index, sensor_value(data, ch), packet_schema[ch])) {
+            return 0;
+        }
+    }
+
+    if (spread_present) {
+        if (byte_index + PACKET_BITMAP_SIZE > size) {
+            return 0;
+        }
+        buffer[byte_index++] = spread_present & 0xFF;
+        buffer[byte_index++] = spread_present >> 8;
+        for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+            if (!(spread_present & SENSOR_BIT(ch))) {
+                continue;
+            }
+            const SensorSpread *spread = &data->spread[ch];
+            float scale = packet_schema[ch];
+            if (!packet_put(buffer, size, &byte_index, spread->min, scale) ||
+                !packet_put(buffer, size, &byte_index, spread->max, scale) ||
+                !packet_put(buffer, size, &byte_index, spread->stddev, scale)) {
+                return 0;
+            }
+        }
+    }
+
+    return byte_index;
+}
+
+static uint16_t packet_present_fixed(const SensorDataFixed *data) {
+    return data->present & (SENSOR_BIT(SENSOR_CH_COUNT) - 1);
+}
+
+static uint16_t packet_spread_present_fixed(const SensorDataFixed *data) {
+    return data->spread_present & packet_present_fixed(data);
+}
+
+// packet_encode_sample for the integer pipeline
+uint8_t packet_encode_sample_fixed(const SensorDataFixed *data, uint8_t *buffer, uint8_t size) {
+    uint16_t present = packet_present_fixed(data);
+    uint16_t spread_present = packet_spread_present_fixed(data);
+    uint16_t bitmap = present | (spread_present ? PACKET_PRESENT_SPREAD : 0);
+    uint8_t byte_index = 0;
+
+    if (size < PACKET_BITMAP_SIZE) {
+        return 0;
+    }
+    buffer[byte_index++] = bitmap & 0xFF;
+    buffer[byte_index++] = bitmap >> 8;
+
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if ((present & SENSOR_BIT(ch)) &&
+            !packet_put_wire(buffer, size, &byte_index, packet_fixed_to_wire(sensor_fixed_value(data, ch)))) {
+            return 0;
+        }
+    }
+
+    if (spread_present) {
+        if (byte_index + PACKET_BITMAP_SIZE > size) {
+            return 0;
+        }
+        buffer[byte_index++] = spread_present & 0xFF;
+        buffer[byte_index++] = spread_present >> 8;
+        for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+            if (!(spread_present & SENSOR_BIT(ch))) {
+                continue;
+            }
+            const SensorSpreadFixed *spread = &data->spread[ch];
+            if (!packet_put_wire(buffer, size, &byte_index, packet_fixed_to_wire(spread->min)) ||
+                !packet_put_wire(buffer, size, &byte_index, packet_fixed_to_wire(spread->max)) ||
+                !packet_put_wire(buffer, size, &byte_index, packet_fixed_to_wire(spread->stddev))) {
+                return 0;
+            }
+        }
+    }
+
+    return byte_index;
+}
+
+static float packet_get(const uint8_t *buffer, uint8_t *byte_index, float scale) {
+    int16_t wire = (int16_t)(buffer[*byte_index] | (buffer[*byte_index + 1] << 8));
+    *byte_index += PACKET_CHANNEL_SIZE;
+    return wire / scale;
+}
+
+// Decode one sample, returns the number of bytes consumed or 0 on error.
+// Channels absent from the bitmap are zero in data and clear in data->present.
+uint8_t packet_decode_sample(const uint8_t *buffer, uint8_t length, SensorData *data) {
+    if (length < PACKET_BITMAP_SIZE) {
+        return 0;
+    }
+
+    uint16_t bitmap = buffer[0] | (buffer[1] << 8);
+    uint16_t present = bitmap & ~PACKET_PRESENT_SPREAD;
+    uint8_t byte_index = PACKET_BITMAP_SIZE;
+
+    memset(data, 0, sizeof(*data));
+    // Bits above SENSOR_CH_COUNT are channels from a newer schema, skip them
+    for (uint8_t ch = 0; ch < 15; ch++) {
+        if (!(present & SENSOR_BIT(ch))) {
+            continue;
+        }
+        if (byte_index + PACKET_CHANNEL_SIZE > length) {
+            return 0;
+        }
+        if (ch < SENSOR_CH_COUNT) {
+            sensor_set_value(data, ch, packet_get(buffer, &byte_index, packet_schema[ch]));
+        } else {
+            byte_index += PACKET_CHANNEL_SIZE;
+        }
+    }
+    data->present = present & (SENSOR_BIT(SENSOR_CH_COUNT) - 1);
+
+    if (bitmap & PACKET_PRESENT_SPREAD) {
+        if (byte_index + PACKET_BITMAP_SIZE > length) {
+            return 0;
+        }
+        uint16_t spread_present = buffer[byte_index] | (buffer[byte_index + 1] << 8);
+        byte_index += PACKET_BITMAP_SIZE;
+        for (uint8_t ch = 0; ch < 15; ch++) {
+            if (!(spread_present & SENSOR_BIT(ch))) {
+                continue;
+            }
+            if (byte_index + PACKET_SPREAD_SIZE > length) {
+                return 0;
+            }
+            if (ch < SENSOR_CH_COUNT) {
+                SensorSpread *spread = &data->spread[ch];
+                float scale = packet_schema[ch];
+                spread->min = packet_get(buffer, &byte_index, scale);
+                spread->max = packet_get(buffer, &byte_index, scale);
+                spread->stddev = packet_get(buffer, &byte_index, scale);
+            } else {
+                byte_index += PACKET_SPREAD_SIZE;
+            }
+        }
+        data->spread_present = spread_present & data->present;
+    }
+
+    return byte_index;
+}
+
+// Encode data into buffer, returns the encoded length or 0 if it does not fit
+uint8_t packet_encode(const SensorData *data, uint8_t sequence, uint8_t *buffer, uint8_t size) {
+    if (size < PACKET_HEADER_SIZE) {
+        return 0;
+    }
+    buffer[0] = PACKET_VERSION;
+    buffer[1] = sequence;
+
+    uint8_t length = packet_encode_sample(data, &buffer[PACKET_HEADER_SIZE], size - PACKET_HEADER_SIZE);
+    return length ? PACKET_HEADER_SIZE + length : 0;
+}
+
+// packet_encode for the integer pipeline, same wire format and units
+uint8_t packet_encode_fixed(const SensorDataFixed *data, uint8_t sequence, uint8_t *buffer, uint8_t size) {
+    if (size < PACKET_HEADER_SIZE) {
+        return 0;
+    }
+    buffer[0] = PACKET_VERSION;
+    buffer[1] = sequence;
+
+    uint8_t length = packet_encode_sample_fixed(data, &buffer[PACKET_HEADER_SIZE], size - PACKET_HEADER_SIZE);
+    return length ? PACKET_HEADER_SIZE + length : 0;
+}
+
+// A fixed point sample in physical units, as a receiver decodes it from the
+// packet_encode_fixed frame
+void packet_fixed_to_sample(const SensorDataFixed *fixed, SensorData *data) {
+    memset(data, 0, sizeof(*data));
+    data->present = fixed->present & (SENSOR_BIT(SENSOR_CH_COUNT) - 1);
+    data->spread_present = fixed->spread_present & data->present;
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        float scale = packet_schema[ch];
+        if (data->present & SENSOR_BIT(ch)) {
+            sensor_set_value(data, ch, packet_fixed_to_wire(sensor_fixed_value(fixed, ch)) / scale);
+        }
+        if (data->spread_present & SENSOR_BIT(ch)) {
+            data->spread[ch].min = packet_fixed_to_wire(fixed->spread[ch].min) / scale;
+            data->spread[ch].max = packet_fixed_to_wire(fixed->spread[ch].max) / scale;
+            data->spread[ch].stddev = packet_fixed_to_wire(fixed->spread[ch].stddev) / scale;
+        }
+    }
+}
+
+// Decode a payload produced by packet_encode
+bool packet_decode(const uint8_t *buffer, uint8_t length, SensorData *data) {
+    if (buffer == NULL || data == NULL || length < PACKET_HEADER_SIZE || buffer[0] != PACKET_VERSION) {
+        return false;
+    }
+
+    uint8_t consumed = packet_decode_sample(&buffer[PACKET_HEADER_SIZE], length - PACKET_HEADER_SIZE, data);
+    return consumed != 0 && PACKET_HEADER_SIZE + consumed == length;
+}
+
+static uint8_t packet_sample_size(uint16_t present, uint16_t spread_present) {
+    uint8_t size = PACKET_AGE_SIZE + PACKET_BITMAP_SIZE;
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (present & SENSOR_BIT(ch)) {
+            size += PACKET_CHANNEL_SIZE;
+        }
+        if (spread_present & SENSOR_BIT(ch)) {
+            size += PACKET_SPREAD_SIZE;
+        }
+    }
+    if (spread_present) {
+        size += PACKET_BITMAP_SIZE;
+    }
+    return size;
+}
+
+// Bytes data takes up inside a batch frame, including its age
+uint8_t packet_batch_sample_size(const SensorData *data) {
+    return packet_sample_size(packet_present(data), packet_spread_present(data));
+}
+
+uint8_t packet_batch_sample_size_fixed(const SensorDataFixed *data) {
+    return packet_sample_size(packet_present_fixed(data), packet_spread_present_fixed(data));
+}
+
+static uint8_t packet_put_batch_header(uint8_t count, uint8_t sequence, uint8_t *buffer, uint8_t size) {
+    if (size < PACKET_BATCH_HEADER_SIZE) {
+        return 0;
+    }
+    buffer[0] = PACKET_VERSION | PACKET_FLAG_BATCH;
+    buffer[1] = sequence;
+    buffer[2] = count;
+    return PACKET_BATCH_HEADER_SIZE;
+}
+
+// Age of a batch sample, PACKET_AGE_SIZE bytes, saturating
+void packet_encode_age(uint32_t age_ms, uint8_t *buffer) {
+    uint32_t age = age_ms / PACKET_AGE_UNIT_MS;
+    if (age > UINT16_MAX) {
+        age = UINT16_MAX;
+    }
+    buffer[0] = age & 0xFF;
+    buffer[1] = age >> 8;
+}
+
+static bool packet_put_age(uint8_t *buffer, uint8_t size, uint8_t *byte_index, uint32_t age_ms) {
+    if (*byte_index + PACKET_AGE_SIZE > size) {
+        return false;
+    }
+    packet_encode_age(age_ms, &buffer[*byte_index]);
+    *byte_index += PACKET_AGE_SIZE;
+    return true;
+}
+
+// Encode count samples into one frame. ages_ms[i] is how old samples[i] is
+// at transmission time. Returns the encoded length or 0 if it does not fit.
+uint8_t packet_encode_batch(const SensorData *samples, const uint32_t *ages_ms, uint8_t count,
+                            uint8_t sequence, uint8_t *buffer, uint8_t size) {
+    uint8_t byte_index = packet_put_batch_header(count, sequence, buffer, size);
+    if (byte_index == 0) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (!packet_put_age(buffer, size, &byte_index, ages_ms[i])) {
+            return 0;
+        }
+        uint8_t length = packet_encode_sample(&samples[i], &buffer[byte_index], size - byte_index);
+        if (length == 0) {
+            return 0;
+        }
+        byte_index += length;
+    }
+
+    return byte_index;
+}
+
+uint8_t packet_encode_batch_fixed(const SensorDataFixed *samples, const uint32_t *ages_ms, uint8_t count,
+                                  uint8_t sequence, uint8_t *buffer, uint8_t size) {
+    uint8_t byte_index = packet_put_batch_header(count, sequence, buffer, size);
+    if (byte_index == 0) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (!packet_put_age(buffer, size, &byte_index, ages_ms[i])) {
+            return 0;
+        }
+        uint8_t length = packet_encode_sample_fixed(&samples[i], &buffer[byte_index], size - byte_index);
+        if (length == 0) {
+            return 0;
+        }
+        byte_index += length;
+    }
+
+    return byte_index;
+}
+
+// Batch frame around a body of count samples with their ages, as
+// sample_log_peek assembles it. Returns the length or 0 if it does not fit.
+uint8_t packet_encode_batch_body(const uint8_t *body, uint8_t length, uint8_t count, uint8_t sequence,
+                                 uint8_t *buffer, uint8_t size) {
+    uint8_t byte_index = packet_put_batch_header(count, sequence, buffer, size);
+    if (byte_index == 0 || byte_index + length > size) {
+        return 0;
+    }
+    memcpy(&buffer[byte_index], body, length);
+    return byte_index + length;
+}
+
+static uint8_t packet_count_bits(uint16_t bitmap) {
+    uint8_t bits = 0;
+    for (; bitmap != 0; bitmap &= bitmap - 1) {
+        bits++;
+    }
+    return bits;
+}
+
+// Length of the encoded sample at buffer, spread and channels of a newer
+// schema included, without decoding it. 0 if it runs past length.
+uint8_t packet_sample_length(const uint8_t *buffer, uint8_t length) {
+    if (length < PACKET_BITMAP_SIZE) {
+        return 0;
+    }
+    uint16_t bitmap = buffer[0] | (buffer[1] << 8);
+    uint16_t size = PACKET_BITMAP_SIZE + packet_count_bits(bitmap & ~PACKET_PRESENT_SPREAD) * PACKET_CHANNEL_SIZE;
+    if (bitmap & PACKET_PRESENT_SPREAD) {
+        if (size + PACKET_BITMAP_SIZE > length) {
+            return 0;
+        }
+        uint16_t spread_present = buffer[size] | (buffer[size + 1] << 8);
+        size += PACKET_BITMAP_SIZE + packet_count_bits(spread_present & ~PACKET_PRESENT_SPREAD) * PACKET_SPREAD_SIZE;
+    }
+    return size <= length ? (uint8_t)size : 0;
+}
+
+// Frame sequence number, the buffer must hold at least PACKET_HEADER_SIZE bytes
+uint8_t packet_sequence(const uint8_t *buffer) {
+    return buffer[1];
+}
+
+bool packet_is_batch(const uint8_t *buffer, uint8_t length) {
+    return length >= PACKET_BATCH_HEADER_SIZE && buffer[0] == (PACKET_VERSION | PACKET_FLAG_BATCH);
+}
+
+// Acknowledge the frame with the given sequence number
+uint8_t packet_encode_ack(uint8_t sequence, uint8_t *buffer, uint8_t size) {
+    if (size < PACKET_ACK_SIZE) {
+        return 0;
+    }
+    buffer[0] = PACKET_VERSION | PACKET_FLAG_ACK;
+    buffer[1] = sequence;
+    return PACKET_ACK_SIZE;
+}
+
+bool packet_is_ack(const uint8_t *buffer, uint8_t length) {
+    return length == PACKET_ACK_SIZE && buffer[0] == (PACKET_VERSION | PACKET_FLAG_ACK);
+}
+
+// Decode a payload produced by packet_encode_batch into at most max_samples entries
+bool packet_decode_batch(const uint8_t *buffer, uint8_t length, SensorData *samples,
+                         uint32_t *ages_ms, uint8_t max_samples, uint8_t *count) {
+    if (buffer == NULL || samples == NULL || ages_ms == NULL || count == NULL ||
+        !packet_is_batch(buffer, length) || buffer[2] > max_samples) {
+        return false;
+    }
+
+    uint8_t byte_index = PACKET_BATCH_HEADER_SIZE;
+    *count = buffer[2];
+    for (uint8_t i = 0; i < *count; i++) {
+        if (byte_index + PACKET_AGE_SIZE > length) {
+            return false;
+        }
+        ages_ms[i] = (uint32_t)(buffer[byte_index] | (buffer[byte_index + 1] << 8)) * PACKET_AGE_UNIT_MS;
+        byte_index += PACKET_AGE_SIZE;
+
+        uint8_t consumed = packet_decode_sample(&buffer[byte_index], length - byte_index, &samples[i]);
+        if (consumed == 0) {
+            return false;
+        }
+        byte_index += consumed;
+    }
+
+    return byte_index == length;
+}
@@ -0,0 +1,78 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensors.h"
+
+// Over-the-air SensorData encoding
+//
+// Single sample frame:
+//   [0]    PACKET_VERSION
+//   [1]    sequence number
+//   [2..]  sample
+//
+// Batch frame:
+//   [0]    PACKET_VERSION | PACKET_FLAG_BATCH
+//   [1]    sequence number
+//   [2]    number of samples
+//   [3..]  per sample: age at transmission in 0.1 s (uint16), then sample
+//
+// Acknowledgement, gateway to station (addressed to the station):
+//   [0]    PACKET_VERSION | PACKET_FLAG_ACK
+//   [1]    sequence number of the frame acknowledged
+//
+// The sequence number counts transmitted frames (mod 256), so a receiver
+// can tell lost frames (a gap) from suppressed samples (no gap).
+//
+// Sample:
+//   [0..1] presence bitmap, bit n = SENSOR_CH_n, bit 15 = spread follows
+//   [2..]  one int16 per present channel, in channel order, scaled to the
+//          resolution listed in packet_schema (packet.c)
+//   then, if bit 15 is set:
+//   [0..1] spread bitmap, bit n = SENSOR_CH_n
+//   [2..]  min, max, stddev (int16 each, channel scale) per channel in it
+//
+// All multi-byte fields are little endian. Absent channels cost nothing,
+// a full single sample frame without spread is 28 bytes.
+#define PACKET_VERSION 3
+#define PACKET_FLAG_BATCH 0x80
+#define PACKET_FLAG_ACK 0x40
+#define PACKET_ACK_SIZE 2
+#define PACKET_HEADER_SIZE 2
+#define PACKET_BATCH_HEADER_SIZE 3
+#define PACKET_AGE_SIZE 2
+#define PACKET_BITMAP_SIZE 2
+#define PACKET_CHANNEL_SIZE 2
+#define PACKET_SPREAD_SIZE (3 * PACKET_CHANNEL_SIZE)
+#define PACKET_PRESENT_SPREAD 0x8000
+#define PACKET_MAX_SIZE (PACKET_HEADER_SIZE + PACKET_BITMAP_SIZE + SENSOR_CH_COUNT * PACKET_CHANNEL_SIZE)
+#define PACKET_AGE_UNIT_MS 100
+
+uint8_t packet_encode(const SensorData *data, uint8_t sequence, uint8_t *buffer, uint8_t size);
+uint8_t packet_encode_fixed(const SensorDataFixed *data, uint8_t sequence, uint8_t *buffer, uint8_t size);
+void packet_fixed_to_sample(const SensorDataFixed *fixed, SensorData *data);
+bool packet_decode(const uint8_t *buffer, uint8_t length, SensorData *data);
+uint8_t packet_batch_sample_size(const SensorData *data);
+uint8_t packet_batch_sample_size_fixed(const SensorDataFixed *data);
+uint8_t packet_encode_batch(const SensorData *samples, const uint32_t *ages_ms, uint8_t count,
+                            uint8_t sequence, uint8_t *buffer, uint8_t size);
+uint8_t packet_encode_batch_fixed(const SensorDataFixed *samples, const uint32_t *ages_ms, uint8_t count,
+                                  uint8_t sequence, uint8_t *buffer, uint8_t size);
+bool packet_decode_batch(const uint8_t *buffer, uint8_t length, SensorData *samples,
+                         uint32_t *ages_ms, uint8_t max_samples, uint8_t *count);
+uint8_t packet_sequence(const uint8_t *buffer);
+bool packet_is_batch(const uint8_t *buffer, uint8_t length);
+uint8_t packet_encode_ack(uint8_t sequence, uint8_t *buffer, uint8_t size);
+bool packet_is_ack(const uint8_t *buffer, uint8_t length);
+// One sample without frame header, as stored by sample_log.c
+uint8_t packet_encode_sample(const SensorData *data, uint8_t *buffer, uint8_t size);
+uint8_t packet_encode_sample_fixed(const SensorDataFixed *data, uint8_t *buffer, uint8_t size);
+uint8_t packet_decode_sample(const uint8_t *buffer, uint8_t length, SensorData *data);
+uint8_t packet_sample_length(const uint8_t *buffer, uint8_t length);
+// Batch frames from samples already encoded, see sample_log_peek
+void packet_encode_age(uint32_t age_ms, uint8_t *buffer);
+uint8_t packet_encode_batch_body(const uint8_t *body, uint8_t length, uint8_t count, uint8_t sequence,
+                                 uint8_t *buffer, uint8_t size);
+
+#endif // PACKET_H
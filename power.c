@@ -0,0 +1,32 @@
+#include "power.h"
+
+static uint64_t power_charge(uint32_t current_ua, uint32_t time_us) {
+    return (uint64_t)current_ua * time_us;
+}
+
+// whole - part, 0 if the part is longer
+static uint32_t power_rest(uint32_t whole_us, uint32_t part_us) {
+    return part_us < whole_us ? whole_us - part_us : 0;
+}
+
+uint32_t power_cycle_charge_uc(const PowerCycle *cycle, bool power_down) {
+    uint32_t radio_idle_us = power_rest(cycle->radio_awake_us, cycle->radio_tx_us + cycle->radio_rx_us);
+    uint32_t radio_off_us = power_rest(cycle->cycle_us, cycle->radio_awake_us);
+    uint32_t ina219_off_us = power_rest(cycle->cycle_us, cycle->ina219_active_us);
+
+    uint64_t charge = power_charge(POWER_MCU_ACTIVE_UA, cycle->mcu_active_us) +
+                      power_charge(POWER_MCU_WFE_UA, power_rest(cycle->cycle_us, cycle->mcu_active_us)) +
+                      power_charge(POWER_RADIO_TX_UA, cycle->radio_tx_us) +
+                      power_charge(POWER_RADIO_RX_UA, cycle->radio_rx_us) +
+                      power_charge(POWER_RADIO_IDLE_UA, radio_idle_us) +
+                      power_charge(POWER_INA219_ACTIVE_UA, cycle->ina219_active_us) +
+                      power_charge(POWER_SENSORS_IDLE_UA, cycle->cycle_us);
+    if (power_down) {
+        charge += power_charge(POWER_RADIO_SLEEP_UA, radio_off_us) +
+                  power_charge(POWER_INA219_DOWN_UA, ina219_off_us);
+    } else {
+        charge += power_charge(POWER_RADIO_IDLE_UA, radio_off_us) +
+                  power_charge(POWER_INA219_ACTIVE_UA, ina219_off_us);
+    }
+    return (uint32_t)(charge / 1000000);
+}
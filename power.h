@@ -0,0 +1,36 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Typical supply currents from the datasheets, used to model the charge
+// drawn per sample cycle. None of them has been measured on the board;
+// adjust them when it is.
+#define POWER_MCU_ACTIVE_UA    24000 // RP2040 at 125 MHz, a core running
+#define POWER_MCU_WFE_UA        6000 // Clocks running, both cores in WFE
+#define POWER_RADIO_TX_UA      29200 // CC1101 at 433 MHz, +10 dBm
+#define POWER_RADIO_RX_UA      15700 // CC1101 at 433 MHz, listening
+#define POWER_RADIO_IDLE_UA     1700
+#define POWER_RADIO_SLEEP_UA       1 // 0.2 uA, rounded up
+#define POWER_INA219_ACTIVE_UA  1000
+#define POWER_INA219_DOWN_UA       6
+#define POWER_SENSORS_IDLE_UA      1 // BMP280 sleep + SHT40 idle
+
+// Time spent in each state during one cycle
+typedef struct {
+    uint32_t cycle_us;          // Wake to wake
+    uint32_t mcu_active_us;     // Either core running
+    uint32_t radio_awake_us;    // CC1101 out of SLEEP, including TX
+    uint32_t radio_tx_us;       // CC1101 transmitting
+    uint32_t radio_rx_us;       // CC1101 listening (the ACK window)
+    uint32_t ina219_active_us;  // Trigger to power-down
+} PowerCycle;
+
+// Modelled charge in microcoulombs (uA * s). With power_down false the radio
+// is taken to idle and the INA219 to stay active between samples instead.
+// The times come from counters on both cores and may overlap the cycle
+// boundary; a part longer than the whole is clamped.
+uint32_t power_cycle_charge_uc(const PowerCycle *cycle, bool power_down);
+
+#endif // POWER_H
@@ -1,134 +1,156 @@
 #include "cc1101.h"
 #include "radio.h"
-#include "hardware/gpio.h"
-#include "pico/stdlib.h"
+#include "packet.h"
+#include "hal.h"
+#include "log.h"
 #include <stdio.h>
 #include <string.h>
 
+// Samples waiting for a batch frame, from one pipeline at a time: the
+// integer one fills batch_fixed
+static SensorData batch_samples[RADIO_BATCH_MAX_SAMPLES];
+static SensorDataFixed batch_fixed[RADIO_BATCH_MAX_SAMPLES];
+static bool batch_is_fixed;
+static uint64_t batch_times_us[RADIO_BATCH_MAX_SAMPLES];
+static uint8_t batch_count;
+static uint8_t batch_bytes = PACKET_BATCH_HEADER_SIZE;
+static uint8_t batch_limit = RADIO_BATCH_SAMPLES;
+static uint32_t batch_latency_ms = RADIO_BATCH_MAX_LATENCY_MS;
+
+// Sequence number of the next frame, see packet.h
+static uint8_t tx_sequence;
+
+// Written by the radio core, read by the other core for the energy report
+static RadioPowerStats power_stats;
+
+// Acknowledged delivery, off until a handler for undelivered samples is set
+static radio_undelivered_t undelivered_handler;
+static radio_undelivered_fixed_t undelivered_fixed_handler;
+static bool link_up = true;
+
+// Register values uploaded in one burst by radio_init, FREQ2..0 are filled
+// in per band. Registers not listed in the comments keep their reset value.
+static const uint8_t radio_config[CC1101_CONFIG_SIZE] = {
+    [CC1101_IOCFG2]   = 0x29, // reset
+    [CC1101_IOCFG1]   = 0x2E, // reset
+    [CC1101_IOCFG0]   = 0x06, // Asserts on sync word, deasserts at end of packet
+    [CC1101_FIFOTHR]  = 0x07, // reset
+    // Sync word configuration
+    // The SYNC_DETECT function is designed to trigger an interrupt when the sync word 
+    // has been detected in a packet. This means that the GDO0 pin will go high when the 
+    // CC1101 detects a sync word match, indicating the start of a packet.
+    [CC1101_SYNC1]    = 0xDE,
+    [CC1101_SYNC0]    = 0xAD,
+    [CC1101_PKTLEN]   = 0x3D, // 61 bytes
+    // Set packet control:
+    // Address filtering is handled separately from sync word detection. After detecting a 
+    // sync word and pulling GDO0 high, the CC1101 will still need to check if the packet’s 
+    // address matches the configured address (if address filtering is enabled).
+    // If the address doesn’t match, the packet will be discarded, but this won’t affect 
+    // the initial sync word detection signal from GDO0.
+    [CC1101_PKTCTRL1] = 0xFF, // Enable address filtering, auto Flush
+    [CC1101_PKTCTRL0] = 0x45, // Enable CRC and variable length mode
+    [CC1101_ADDR]     = 0x66, // Replaced by radio_address()
+    [CC1101_CHANNR]   = 0x00,
+    [CC1101_FSCTRL1]  = 0x08,
+    [CC1101_FSCTRL0]  = 0x00,
+    [CC1101_FREQ2]    = F2_433,
+    [CC1101_FREQ1]    = F1_433,
+    [CC1101_FREQ0]    = F0_433,
+    [CC1101_MDMCFG4]  = 0x5B,
+    [CC1101_MDMCFG3]  = 0xF8,
+    //MDMCFG2:
+    //0 DC blocking
+    //001 GFSK
+    //0 Menchester
+    //010 16/16 sync word has to match
+    [CC1101_MDMCFG2]  = 0x12, // Set modulation format (GFSK)
+    [CC1101_MDMCFG1]  = 0x40, // 8 byte preamble
+    [CC1101_MDMCFG0]  = 0xF8,
+    [CC1101_DEVIATN]  = 0x47,
+    [CC1101_MCSM2]    = 0x07, // reset
+    [CC1101_MCSM1]    = 0x30, // CCA enabled TX->IDLE RX->IDLE
+    [CC1101_MCSM0]    = 0x18,
+    [CC1101_FOCCFG]   = 0x1D,
+    [CC1101_BSCFG]    = 0x1C,
+    [CC1101_AGCCTRL2] = 0xC7,
+    [CC1101_AGCCTRL1] = 0x00,
+    [CC1101_AGCCTRL0] = 0xB2,
+    [CC1101_WOREVT1]  = 0x87, // reset
+    [CC1101_WOREVT0]  = 0x6B, // reset
+    [CC1101_WORCTRL]  = 0xF8, // reset
+    [CC1101_FREND1]   = 0xB6,
+    [CC1101_FREND0]   = 0x10,
+    [CC1101_FSCAL3]   = 0xEA,
+    [CC1101_FSCAL2]   = 0x2A,
+    [CC1101_FSCAL1]   = 0x00,
+    [CC1101_FSCAL0]   = 0x11,
+    [CC1101_RCCTRL1]  = 0x41, // reset
+    [CC1101_RCCTRL0]  = 0x00, // reset
+    [CC1101_FSTEST]   = 0x59,
+    [CC1101_PTEST]    = 0x7F, // reset
+    [CC1101_AGCTEST]  = 0x3F, // reset
+    [CC1101_TEST2]    = 0x81,
+    [CC1101_TEST1]    = 0x35,
+    [CC1101_TEST0]    = 0x09,
+};
+
 // Initialize the radio module
+// Folds the unique ID into one byte. 0x00 and 0xFF are broadcast addresses
+// under the station's address filter, those IDs move to the next value.
+uint8_t radio_address(void) {
+    if (RADIO_ADDRESS != 0) {
+        return RADIO_ADDRESS;
+    }
+    uint8_t id[HAL_UNIQUE_ID_SIZE];
+    hal_unique_id(id);
+    uint8_t address = 0;
+    for (uint8_t i = 0; i < HAL_UNIQUE_ID_SIZE; i++) {
+        address ^= id[i];
+    }
+    if (address == 0x00 || address == 0xFF) {
+        address ^= 0x01;
+    }
+    return address;
+}
+
 void radio_init(uint8_t f) {
+    uint8_t config[CC1101_CONFIG_SIZE];
+    CC1101Stats before, after;
+    uint64_t start_us = hal_time_us();
+
     // Initialize the CC1101 module
     cc1101_init();
-    
-    cc1101_write_reg(CC1101_FSCTRL1,  0x08);
-    cc1101_write_reg(CC1101_FSCTRL0,  0x00);
-	
+    cc1101_get_stats(&before);
+
+    memcpy(config, radio_config, sizeof(config));
+    config[CC1101_ADDR] = radio_address();
     switch(f)
     {
       case F_868:
-      	cc1101_write_reg(CC1101_FREQ2,    F2_868);
-      	cc1101_write_reg(CC1101_FREQ1,    F1_868);
-      	cc1101_write_reg(CC1101_FREQ0,    F0_868);
+        config[CC1101_FREQ2] = F2_868;
+        config[CC1101_FREQ1] = F1_868;
+        config[CC1101_FREQ0] = F0_868;
         break;
       case F_915:
-        cc1101_write_reg(CC1101_FREQ2,    F2_915);
-        cc1101_write_reg(CC1101_FREQ1,    F1_915);
-        cc1101_write_reg(CC1101_FREQ0,    F0_915);
+        config[CC1101_FREQ2] = F2_915;
+        config[CC1101_FREQ1] = F1_915;
+        config[CC1101_FREQ0] = F0_915;
         break;
 	  case F_433:
-        cc1101_write_reg(CC1101_FREQ2,    F2_433);
-        cc1101_write_reg(CC1101_FREQ1,    F1_433);
-        cc1101_write_reg(CC1101_FREQ0,    F0_433);
         break;
 	  default: // F must be set
 	  	break;
 	}
-	
-    cc1101_write_reg(CC1101_MDMCFG4,  0x5B);
-    cc1101_write_reg(CC1101_MDMCFG3,  0xF8);
-    //MDMCFG2:
-    //0 DC blocking
-    //001 GFSK
-    //0 Menchester
-    //010 16/16 sync word has to match
-    cc1101_write_reg(CC1101_MDMCFG2,  0x12); // Set modulation format (GFSK)
-    cc1101_write_reg(CC1101_MDMCFG1,  0x40); // 8 byte preamble
-    cc1101_write_reg(CC1101_MDMCFG0,  0xF8);
-    cc1101_write_reg(CC1101_CHANNR,   0x00);
-    cc1101_write_reg(CC1101_DEVIATN,  0x47);
-    cc1101_write_reg(CC1101_FREND1,   0xB6);
-    cc1101_write_reg(CC1101_FREND0,   0x10);
-    cc1101_write_reg(CC1101_MCSM0 ,   0x18);
-    cc1101_write_reg(CC1101_FOCCFG,   0x1D);
-    cc1101_write_reg(CC1101_BSCFG,    0x1C);
-    cc1101_write_reg(CC1101_AGCCTRL2, 0xC7);
-	cc1101_write_reg(CC1101_AGCCTRL1, 0x00);
-    cc1101_write_reg(CC1101_AGCCTRL0, 0xB2);
-    cc1101_write_reg(CC1101_FSCAL3,   0xEA);
-	cc1101_write_reg(CC1101_FSCAL2,   0x2A);
-	cc1101_write_reg(CC1101_FSCAL1,   0x00);
-    cc1101_write_reg(CC1101_FSCAL0,   0x11);
-    cc1101_write_reg(CC1101_FSTEST,   0x59);
-    cc1101_write_reg(CC1101_TEST2,    0x81);
-    cc1101_write_reg(CC1101_TEST1,    0x35);
-    cc1101_write_reg(CC1101_TEST0,    0x09);
-    cc1101_write_reg(CC1101_IOCFG0,   0x06); 
-    cc1101_write_reg(CC1101_PKTCTRL1, 0xFF); // Enable address filtering, auto Flush
-    cc1101_write_reg(CC1101_PKTCTRL0, 0x45); // Enable CRC and variable length mode
-    // Set packet control:
-    // Address filtering is handled separately from sync word detection. After detecting a 
-    // sync word and pulling GDO0 high, the CC1101 will still need to check if the packet’s 
-    // address matches the configured address (if address filtering is enabled).
-    // If the address doesn’t match, the packet will be discarded, but this won’t affect 
-    // the initial sync word detection signal from GDO0.
-    cc1101_write_reg(CC1101_PKTLEN, 0x3D); // 61 bytes
-    cc1101_write_reg(CC1101_MCSM1,0x30); // CCA enabled TX->IDLE RX->IDLE
-    // Sync word configuration
-    // The SYNC_DETECT function is designed to trigger an interrupt when the sync word 
-    // has been detected in a packet. This means that the GDO0 pin will go high when the 
-    // CC1101 detects a sync word match, indicating the start of a packet.
-    cc1101_write_reg(CC1101_SYNC1, 0xDE);  // SYNC1
-    cc1101_write_reg(CC1101_SYNC0, 0xAD);  // SYNC0
-
-    // Set device address
-    cc1101_write_reg(CC1101_ADDR, 0x66); // Unique address for this device
-
-}
-
-// Helper function to convert SensorData to byte array
-static void sensor_data_to_bytes(const SensorData *data, uint8_t *buffer, uint8_t *length) {
-    // Use memcpy to pack floats into the byte array
-    uint8_t byte_index = 0;
-    
-    memcpy(&buffer[byte_index], &data->temperature, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->pressure, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->exterior_temperature, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->exterior_humidity, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->battery_voltage, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->battery_current, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->battery_power, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->solar_voltage, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->solar_current, sizeof(float)); byte_index += sizeof(float);
-    memcpy(&buffer[byte_index], &data->solar_power, sizeof(float)); byte_index += sizeof(float);
-    
-    *length = byte_index; // Total length of the data packet
-}
-
-// Helper function to convert byte array to SensorData
-void bytes_to_sensor_data(const uint8_t *buffer, uint8_t *packet_length, uint8_t *address, SensorData *data) {
-    if (buffer == NULL || data == NULL || packet_length == NULL || address == NULL) {
-        printf("Invalid pointer passed to bytes_to_sensor_data.\n");
-        return;
-    }
-
-    // Read length and address from buffer
-    *packet_length = buffer[0];  // Length of the packet
-    *address = buffer[1];        // Address
 
-    // Set up byte_index to point to the start of the payload
-    uint8_t byte_index = 2;
+    if (!cc1101_load_config(config)) {
+        printf("Radio configuration verify failed\n");
+    }
 
-    // Convert the payload bytes to SensorData structure
-    memcpy(&data->temperature, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->pressure, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->exterior_temperature, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->exterior_humidity, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->battery_voltage, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->battery_current, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->battery_power, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->solar_voltage, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->solar_current, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
-    memcpy(&data->solar_power, &buffer[byte_index], sizeof(float)); byte_index += sizeof(float);
+    cc1101_get_stats(&after);
+    printf("Radio configured: address 0x%02X, %lu SPI transactions, %lu us\n", config[CC1101_ADDR],
+           (unsigned long)(after.transactions - before.transactions),
+           (unsigned long)(hal_time_us() - start_us));
 }
 
 void print_binary(const uint8_t *buffer, size_t length) {
@@ -140,69 +162,328 @@ void print_binary(const uint8_t *buffer, size_t length) {
     printf("\n");
 }
 
-void radio_send_data(const SensorData *data) {
-    uint8_t buffer[64] = {0};
+// Time on air for one frame carrying payload_length bytes
+uint32_t radio_airtime_us(uint8_t payload_length) {
+    uint32_t bits = (RADIO_FRAME_OVERHEAD + payload_length) * 8;
+    return (uint32_t)(((uint64_t)bits * 1000000 + RADIO_DATA_RATE_BPS - 1) / RADIO_DATA_RATE_BPS);
+}
+
+// Put the CC1101 into SLEEP until the next send
+void radio_sleep(void) {
+    cc1101_power_down();
+}
+
+void radio_get_power_stats(RadioPowerStats *stats) {
+    *stats = power_stats;
+}
+
+// Pass every frame through the gateway's acknowledgement (see packet.h);
+// samples of frames that get none are handed to handler. NULL turns it off.
+void radio_set_undelivered(radio_undelivered_t handler) {
+    undelivered_handler = handler;
+}
+
+// The same for samples sent from the integer pipeline
+void radio_set_undelivered_fixed(radio_undelivered_fixed_t handler) {
+    undelivered_fixed_handler = handler;
+}
+
+static bool radio_acknowledged(void) {
+    return undelivered_handler != NULL || undelivered_fixed_handler != NULL;
+}
+
+// Whether the last frame was acknowledged, always true without acknowledgements
+bool radio_link_up(void) {
+    return link_up;
+}
+
+// Listen for the acknowledgement of the frame just sent. Address filtering
+// keeps other stations' frames out; anything else received is skipped.
+static bool radio_wait_ack(uint8_t sequence) {
+    uint8_t buffer[CC1101_FIFO_SIZE];
     uint8_t length;
-    uint8_t address = cc1101_read_reg(CC1101_ADDR);
+    uint64_t deadline_us = hal_time_us() + RADIO_ACK_TIMEOUT_MS * 1000;
+    uint64_t now_us;
+    while ((now_us = hal_time_us()) < deadline_us) {
+        CC1101Result result = cc1101_receive(buffer, &length, (uint32_t)(deadline_us - now_us));
+        if (result == CC1101_RESULT_TIMEOUT) {
+            break;
+        }
+        // FIFO layout: length, address, payload, RSSI, LQI
+        if (result == CC1101_RESULT_OK && length == PACKET_ACK_SIZE + 4 && buffer[0] == PACKET_ACK_SIZE + 1 &&
+            packet_is_ack(&buffer[2], PACKET_ACK_SIZE) && packet_sequence(&buffer[2]) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Convert SensorData to byte array
-    sensor_data_to_bytes(data, buffer, &length);
+// Returns true once the frame is on air (acknowledged, with a handler set)
+static bool radio_send_payload(uint8_t *buffer, uint8_t length, uint8_t samples) {
+    uint8_t address = cc1101_get_config(CC1101_ADDR);
+    CC1101Stats before, after;
+
+    // A radio put to sleep by radio_sleep() goes back to sleep after the send
+    uint64_t awake_start_us = hal_time_us();
+    bool sleeping = cc1101_is_powered_down();
+    if (sleeping && !cc1101_wake()) {
+        LOG_WARN("Radio did not wake, frame dropped\n");
+        link_up = false;
+        return false;
+    }
 
      // Check the initial state of GDO0
-    printf("Initial GDO0 state: %d\n", gpio_get(CC1101_GDO0_PIN));
+    LOG_DEBUG("Initial GDO0 state: %d\n", hal_gpio_get(CC1101_GDO0_PIN));
 
-    // Write the data to the TX FIFO
-    cc1101_send_data(buffer, length, address);
+    // Write the data to the TX FIFO and sleep until it is on air
+    cc1101_get_stats(&before);
+    bool on_air = cc1101_send_data(buffer, length, address);
+    bool sent = on_air;
+    if (!on_air) {
+        LOG_WARN("Send failed\n");
+    } else if (radio_acknowledged()) {
+        uint64_t listen_start_us = hal_time_us();
+        sent = radio_wait_ack(packet_sequence(buffer));
+        power_stats.rx_us += (uint32_t)(hal_time_us() - listen_start_us);
+        link_up = sent;
+        LOG_DEBUG("Frame %u %s\n", packet_sequence(buffer), sent ? "acknowledged" : "not acknowledged");
+    }
+    // Only frames that went out take a sequence number: the gateway counts
+    // the gaps as lost frames
+    if (on_air) {
+        tx_sequence++;
+    }
+    cc1101_get_stats(&after);
+    LOG_DEBUG("Send used %lu SPI transactions\n", (unsigned long)(after.transactions - before.transactions));
+    if (after.dma_transfers != before.dma_transfers && after.last_dma_transfer_us > 0) {
+        LOG_DEBUG("FIFO DMA: %lu bytes in %lu us (%lu B/s), CPU busy %lu us\n",
+               (unsigned long)after.last_dma_bytes, (unsigned long)after.last_dma_transfer_us,
+               (unsigned long)(after.last_dma_bytes * 1000000ull / after.last_dma_transfer_us),
+               (unsigned long)after.last_dma_busy_us);
+    }
+
+    uint32_t airtime = radio_airtime_us(length);
+    LOG_DEBUG("Frame: %d samples, %d bytes, airtime %lu us (%lu us/sample)\n",
+           samples, length, (unsigned long)airtime, (unsigned long)(airtime / samples));
+
+    if (sleeping) {
+        cc1101_power_down();
+        LOG_DEBUG("Radio wake %lu us\n", (unsigned long)after.last_wake_us);
+    }
+    power_stats.awake_us += (uint32_t)(hal_time_us() - awake_start_us);
+    power_stats.tx_us += airtime;
+    power_stats.frames++;
+    return sent;
 }
 
-void radio_receive_data(SensorData *data) {
+void radio_send_data(const SensorData *data) {
     uint8_t buffer[64] = {0};
-    uint8_t length;
-    uint8_t address = cc1101_read_reg(CC1101_ADDR);
 
-     // Set the CC1101 to IDLE mode
-    cc1101_strobe(CC1101_SIDLE);
-    cc1101_strobe(CC1101_SRX);
+    // Convert SensorData to its compact wire encoding
+    uint8_t length = packet_encode(data, tx_sequence, buffer, RADIO_MAX_PAYLOAD);
+    if (length == 0) {
+        LOG_WARN("Sample does not fit a packet\n");
+        return;
+    }
 
-     // Check the initial state of GDO0
-    printf("Initial GDO0 state: %d\n", gpio_get(CC1101_GDO0_PIN));
+    if (!radio_send_payload(buffer, length, 1) && undelivered_handler != NULL) {
+        undelivered_handler(data, hal_time_us());
+    }
+}
+
+void radio_send_fixed(const SensorDataFixed *data) {
+    uint8_t buffer[64] = {0};
+
+    uint8_t length = packet_encode_fixed(data, tx_sequence, buffer, RADIO_MAX_PAYLOAD);
+    if (length == 0) {
+        LOG_WARN("Sample does not fit a packet\n");
+        return;
+    }
 
-    // Wait until a packet is received (GDO0 goes high)
-    while (gpio_get(CC1101_GDO0_PIN)) {
-        printf("Waiting for GDO0 to go high (packet reception in progress)...\n");
-        sleep_ms(1000); // Small delay to avoid flooding the console
+    if (!radio_send_payload(buffer, length, 1) && undelivered_fixed_handler != NULL) {
+        undelivered_fixed_handler(data, hal_time_us());
     }
-    printf("GDO0 is high (packet received).\n");
+}
 
-    // Read the data from the RX FIFO
-    cc1101_receive_data(buffer, &length);
+// Select how many samples go into one frame (1 = no batching) and how long
+// the oldest sample may wait for its frame
+void radio_set_batching(uint8_t samples, uint32_t max_latency_ms) {
+    radio_flush();
+    if (samples < 1) {
+        samples = 1;
+    }
+    batch_limit = samples > RADIO_BATCH_MAX_SAMPLES ? RADIO_BATCH_MAX_SAMPLES : samples;
+    batch_latency_ms = max_latency_ms;
+}
+
+// Send all buffered samples in one frame, each tagged with its age
+void radio_flush(void) {
+    if (batch_count == 0) {
+        return;
+    }
 
+    uint8_t buffer[64] = {0};
+    uint32_t ages_ms[RADIO_BATCH_MAX_SAMPLES];
+    uint64_t now = hal_time_us();
+    for (uint8_t i = 0; i < batch_count; i++) {
+        ages_ms[i] = (uint32_t)((now - batch_times_us[i]) / 1000);
+    }
+
+    uint8_t length = batch_is_fixed
+                         ? packet_encode_batch_fixed(batch_fixed, ages_ms, batch_count, tx_sequence, buffer,
+                                                     RADIO_MAX_PAYLOAD)
+                         : packet_encode_batch(batch_samples, ages_ms, batch_count, tx_sequence, buffer,
+                                               RADIO_MAX_PAYLOAD);
     if (length == 0) {
-        printf("No data processed.\n");
+        LOG_WARN("Batch does not fit a packet\n");
+    } else if (!radio_send_payload(buffer, length, batch_count)) {
+        for (uint8_t i = 0; i < batch_count; i++) {
+            if (batch_is_fixed && undelivered_fixed_handler != NULL) {
+                undelivered_fixed_handler(&batch_fixed[i], batch_times_us[i]);
+            } else if (!batch_is_fixed && undelivered_handler != NULL) {
+                undelivered_handler(&batch_samples[i], batch_times_us[i]);
+            }
+        }
+    }
+
+    batch_count = 0;
+    batch_bytes = PACKET_BATCH_HEADER_SIZE;
+}
+
+// Account for the sample just stored at batch_count, send when due
+static void radio_batch_added(uint8_t sample_size) {
+    batch_times_us[batch_count] = hal_time_us();
+    batch_count++;
+    batch_bytes += sample_size;
+
+    if (batch_count >= batch_limit || radio_batch_time_left_ms() == 0) {
+        radio_flush();
+    }
+}
+
+// Queue a sample for transmission. It goes out right away without batching,
+// otherwise once the frame is full or the latency bound is reached.
+void radio_queue_data(const SensorData *data) {
+    if (batch_limit <= 1) {
+        radio_send_data(data);
         return;
     }
+
+    uint8_t sample_size = packet_batch_sample_size(data);
+    if (batch_is_fixed || batch_bytes + sample_size > RADIO_MAX_PAYLOAD) {
+        radio_flush();
+    }
+    batch_is_fixed = false;
+    batch_samples[batch_count] = *data;
+    radio_batch_added(sample_size);
+}
+
+// radio_queue_data for the integer pipeline
+void radio_queue_fixed(const SensorDataFixed *data) {
+    if (batch_limit <= 1) {
+        radio_send_fixed(data);
+        return;
+    }
+
+    uint8_t sample_size = packet_batch_sample_size_fixed(data);
+    if (!batch_is_fixed || batch_bytes + sample_size > RADIO_MAX_PAYLOAD) {
+        radio_flush();
+    }
+    batch_is_fixed = true;
+    batch_fixed[batch_count] = *data;
+    radio_batch_added(sample_size);
+}
+
+// Send logged samples in one batch frame, body as sample_log_peek assembles
+// it. Returns true if the gateway acknowledged it. Failures are not passed
+// to the undelivered handler, the caller still holds the samples.
+bool radio_send_backfill(const uint8_t *body, uint8_t body_length, uint8_t count) {
+    uint8_t buffer[64] = {0};
+    uint8_t length = packet_encode_batch_body(body, body_length, count, tx_sequence, buffer, RADIO_MAX_PAYLOAD);
+    if (length == 0) {
+        LOG_WARN("Backfill does not fit a packet\n");
+        return false;
+    }
+    return radio_send_payload(buffer, length, count);
+}
+
+// Time until the buffered samples must be flushed, UINT32_MAX if none are waiting
+uint32_t radio_batch_time_left_ms(void) {
+    if (batch_count == 0) {
+        return UINT32_MAX;
+    }
+    uint64_t waited_ms = (hal_time_us() - batch_times_us[0]) / 1000;
+    return waited_ms >= batch_latency_ms ? 0 : (uint32_t)(batch_latency_ms - waited_ms);
+}
+
+bool radio_receive_data(SensorData *data, uint32_t timeout_ms) {
+    uint8_t buffer[64] = {0};
+    uint8_t length;
+
+    // Sleep until a packet is received or the timeout passes, GDO0 edges
+    // are handled by the CC1101 interrupt state machine
+    CC1101Result result = cc1101_receive(buffer, &length, timeout_ms * 1000);
+    if (result != CC1101_RESULT_OK) {
+        LOG_WARN("Receive failed: %d\n", result);
+        return false;
+    }
+
+    if (length == 0) {
+        LOG_WARN("No data processed.\n");
+        return false;
+    }
+#if LOG_TEXT
     // Print the entire packet in binary format
     printf("Received packet in binary: ");
     print_binary(buffer, length);
+#endif
 
-    uint8_t packet_length;
-    uint8_t packet_address;
-    // Convert the received buffer into a SensorData struct
-    bytes_to_sensor_data(buffer, &packet_length, &packet_address, data);
+    // FIFO layout: length, address, payload, RSSI, LQI
+    uint8_t packet_length = buffer[0];
+    uint8_t packet_address = buffer[1];
+    if (packet_length < 1 || packet_length + 3 != length) {
+        LOG_WARN("Malformed packet, length byte %d for %d bytes\n", packet_length, length);
+        return false;
+    }
+    // Convert the received payload into a SensorData struct, a batch frame
+    // yields its newest sample
+    if (packet_is_batch(&buffer[2], packet_length - 1)) {
+        SensorData samples[RADIO_BATCH_MAX_SAMPLES];
+        uint32_t ages_ms[RADIO_BATCH_MAX_SAMPLES];
+        uint8_t count;
+        if (!packet_decode_batch(&buffer[2], packet_length - 1, samples, ages_ms,
+                                 RADIO_BATCH_MAX_SAMPLES, &count) || count == 0) {
+            LOG_WARN("Malformed batch payload\n");
+            return false;
+        }
+        LOG_DEBUG("Batch of %d samples, oldest %lu ms ago\n", count, (unsigned long)ages_ms[0]);
+        *data = samples[count - 1];
+    } else if (!packet_decode(&buffer[2], packet_length - 1, data)) {
+        LOG_WARN("Unsupported payload encoding\n");
+        return false;
+    }
     // Print the length
-    printf("Length: %d\n", packet_length);
+    LOG_DEBUG("Length: %d\n", packet_length);
     // Print the address in hexadecimal format
-    printf("Address: 0x%02X\n", packet_address);
+    LOG_DEBUG("Address: 0x%02X\n", packet_address);
+    LOG_DEBUG("Sequence: %u\n", packet_sequence(&buffer[2]));
     // Print the received data
-    printf("Temperature: %.2f°C\n", data->temperature);
-    printf("Pressure: %.2f hPa\n", data->pressure);
-    printf("Exterior Temperature: %.2f°C\n", data->exterior_temperature);
-    printf("Exterior Humidity: %.2f%%\n", data->exterior_humidity);
-    printf("Battery Voltage: %.2fV\n", data->battery_voltage);
-    printf("Battery Current: %.2fA\n", data->battery_current);
-    printf("Battery Power: %.2fW\n", data->battery_power);
-    printf("Solar Voltage: %.2fV\n", data->solar_voltage);
-    printf("Solar Current: %.2fA\n", data->solar_current);
-    printf("Solar Power: %.2fW\n", data->solar_power);
-    
+    LOG_DEBUG("Temperature: %.2f°C\n", data->temperature);
+    LOG_DEBUG("Pressure: %.2f hPa\n", data->pressure);
+    LOG_DEBUG("Exterior Temperature: %.2f°C\n", data->exterior_temperature);
+    LOG_DEBUG("Exterior Humidity: %.2f%%\n", data->exterior_humidity);
+    LOG_DEBUG("Battery Voltage: %.2fV\n", data->battery_voltage);
+    LOG_DEBUG("Battery Current: %.2fA\n", data->battery_current);
+    LOG_DEBUG("Battery Power: %.2fW\n", data->battery_power);
+    LOG_DEBUG("Solar Voltage: %.2fV\n", data->solar_voltage);
+    LOG_DEBUG("Solar Current: %.2fA\n", data->solar_current);
+    LOG_DEBUG("Solar Power: %.2fW\n", data->solar_power);
+    LOG_DEBUG("Intervals: sample %.0fs, transmit %.0fs\n", data->sample_interval, data->tx_interval);
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (data->spread_present & SENSOR_BIT(ch)) {
+            LOG_DEBUG("Channel %d spread: min %.2f, max %.2f, stddev %.3f\n", ch, data->spread[ch].min,
+                      data->spread[ch].max, data->spread[ch].stddev);
+        }
+    }
+    return true;
 }
\ No newline at end of file
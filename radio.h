@@ -24,12 +24,66 @@
 #define F1_433  0xA7        
 #define F0_433  0x62    
 
+// Source address of this station, what the gateway tells stations apart by.
+// 0 derives it from the board's unique ID; a fleet where two boards fold to
+// the same byte sets it per build with -DRADIO_ADDRESS=0x..
+#ifndef RADIO_ADDRESS
+#define RADIO_ADDRESS 0
+#endif
+
+// Packet budget: PKTLEN (61) minus the address byte
+#define RADIO_MAX_PAYLOAD 60
+// MDMCFG4/MDMCFG3 = 0x5B/0xF8 at 26 MHz
+#define RADIO_DATA_RATE_BPS 99975
+// Bytes around every payload: preamble (8), sync (2), length, address, CRC (2)
+#define RADIO_FRAME_OVERHEAD 14
+
+// Multi-sample frames: up to RADIO_BATCH_SAMPLES readings are buffered and
+// sent together, at most RADIO_BATCH_MAX_LATENCY_MS after the oldest one was
+// queued. 1 sends every sample on its own.
+#define RADIO_BATCH_MAX_SAMPLES 8
+#define RADIO_BATCH_SAMPLES 1
+#define RADIO_BATCH_MAX_LATENCY_MS 60000
+
+// Acknowledged delivery: with an undelivered handler set, every frame waits
+// up to RADIO_ACK_TIMEOUT_MS for the gateway's acknowledgement (ACK frame
+// airtime plus the gateway's turnaround). Samples of a frame that got none
+// go to the handler with the time they were queued.
+#define RADIO_ACK_TIMEOUT_MS 20
+
+typedef void (*radio_undelivered_t)(const SensorData *data, uint64_t queued_us);
+typedef void (*radio_undelivered_fixed_t)(const SensorDataFixed *data, uint64_t queued_us);
+
+// Radio-core time accounting for the energy estimate. 32-bit counters so the
+// other core reads them whole; take differences between reads.
+typedef struct {
+    uint32_t awake_us; // Out of SLEEP around each send
+    uint32_t tx_us;    // Estimated time on air
+    uint32_t rx_us;    // Listening for acknowledgements
+    uint32_t frames;
+} RadioPowerStats;
+
 // Initialize the radio module
 void radio_init(uint8_t f);
+// The address radio_init sets, never one of the broadcast addresses 0x00/0xFF
+uint8_t radio_address(void);
 
 // Send sensor data using the radio module
 void radio_send_data(const SensorData *data);
-void radio_receive_data(SensorData *data);
+void radio_send_fixed(const SensorDataFixed *data);
+void radio_set_batching(uint8_t samples, uint32_t max_latency_ms);
+void radio_queue_data(const SensorData *data);
+void radio_queue_fixed(const SensorDataFixed *data);
+void radio_flush(void);
+uint32_t radio_batch_time_left_ms(void);
+void radio_set_undelivered(radio_undelivered_t handler);
+void radio_set_undelivered_fixed(radio_undelivered_fixed_t handler);
+bool radio_link_up(void);
+bool radio_send_backfill(const uint8_t *body, uint8_t length, uint8_t count);
+uint32_t radio_airtime_us(uint8_t payload_length);
+bool radio_receive_data(SensorData *data, uint32_t timeout_ms);
 void radio_switch_mode(bool is_transmitting);
+void radio_sleep(void);
+void radio_get_power_stats(RadioPowerStats *stats);
 
 #endif // RADIO_H
@@ -0,0 +1,525 @@
+#include "sample_log.h"
+#include "crc32.h"
+#include <string.h>
+
+typedef struct {
+    uint16_t magic;
+    uint16_t boot;      // Log boot count the records were taken in
+    uint32_t sequence;  // Pages programmed before this one, orders the ring
+    uint16_t used;      // Record bytes after the header
+    uint8_t count;      // Records on the page
+    uint8_t delivered;  // 0xFF while records are pending, 0x00 once all are acknowledged
+    uint32_t crc;       // CRC-32 of the page with delivered and crc left erased
+} SampleLogPage;
+
+_Static_assert(sizeof(SampleLogPage) == SAMPLE_LOG_PAGE_HEADER_SIZE, "page header size");
+
+static SampleLogFlash log_flash;
+static bool log_ready;
+static uint32_t log_pages;
+static uint16_t log_boot;
+static uint32_t head_page;       // Next page to program
+static uint32_t head_sequence;
+static bool flash_pending;       // Flash holds pending pages, from tail_page on
+static uint32_t tail_page;       // Oldest pending page, equals head_page with the ring full
+static uint8_t tail_record;      // Records of tail_page already delivered
+static uint32_t pending_records; // In flash and in the RAM page
+
+// Records not yet programmed. Only undelivered ones are kept: when the link
+// comes back before their page is programmed they never reach flash. A full
+// page is sealed and waits for sample_log_sync, the next fills behind it.
+typedef struct {
+    uint8_t records[SAMPLE_LOG_PAGE_CAPACITY];
+    uint16_t used;
+    uint8_t count;
+} SampleLogBuffer;
+
+static SampleLogBuffer sealed_page;
+static SampleLogBuffer open_page;
+
+// Flash pages all of whose records were delivered, marker not yet programmed
+#define SAMPLE_LOG_MARKERS 8
+static uint32_t unmarked_pages[SAMPLE_LOG_MARKERS];
+static uint8_t unmarked_count;
+
+static SampleLogStats log_stats;
+
+static const uint8_t *sample_log_page(uint32_t page) {
+    return log_flash.read(log_flash.offset + page * SAMPLE_LOG_PAGE_SIZE);
+}
+
+static uint32_t sample_log_page_crc(const uint8_t *page) {
+    uint8_t copy[SAMPLE_LOG_PAGE_SIZE];
+    memcpy(copy, page, sizeof(copy));
+    SampleLogPage *header = (SampleLogPage *)copy;
+    header->delivered = 0xFF;
+    header->crc = 0xFFFFFFFF;
+    return crc32(copy, sizeof(copy));
+}
+
+// A programmed, intact page with records not yet acknowledged
+static bool sample_log_page_pending(uint32_t page, SampleLogPage *header) {
+    const uint8_t *data = sample_log_page(page);
+    memcpy(header, data, sizeof(*header));
+    return header->magic == SAMPLE_LOG_MAGIC && header->delivered == 0xFF && header->count > 0 &&
+           header->used <= SAMPLE_LOG_PAGE_CAPACITY && sample_log_page_crc(data) == header->crc;
+}
+
+static bool sample_log_page_erased(uint32_t page) {
+    const uint8_t *data = sample_log_page(page);
+    for (uint32_t i = 0; i < SAMPLE_LOG_PAGE_SIZE; i++) {
+        if (data[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Neither erased, pending nor delivered: a torn program or flipped bits
+static bool sample_log_page_corrupt(uint32_t page) {
+    SampleLogPage header;
+    memcpy(&header, sample_log_page(page), sizeof(header));
+    if (header.magic == SAMPLE_LOG_MAGIC && header.delivered == 0x00) {
+        return false;
+    }
+    return !sample_log_page_erased(page);
+}
+
+// Records in flash from the tail on plus the RAM pages
+static void sample_log_count_pending(void) {
+    pending_records = sealed_page.count + open_page.count;
+    if (!flash_pending) {
+        return;
+    }
+    uint32_t page = tail_page;
+    do {
+        SampleLogPage header;
+        if (sample_log_page_pending(page, &header)) {
+            pending_records += header.count - (page == tail_page ? tail_record : 0);
+        }
+        page = (page + 1) % log_pages;
+    } while (page != head_page);
+}
+
+// Move the tail to the first pending page from page on, short of the head.
+// The records of a corrupt page are not known any more: count them again.
+static void sample_log_advance_tail(uint32_t page) {
+    SampleLogPage header;
+    bool corrupt = false;
+    while (page != head_page && !sample_log_page_pending(page, &header)) {
+        if (sample_log_page_corrupt(page)) {
+            log_stats.read_errors++;
+            corrupt = true;
+        }
+        page = (page + 1) % log_pages;
+    }
+    tail_page = page;
+    tail_record = 0;
+    flash_pending = page != head_page;
+    if (corrupt) {
+        sample_log_count_pending();
+    }
+}
+
+static void sample_log_put32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = value >> 24;
+}
+
+static uint32_t sample_log_get32(const uint8_t *buffer) {
+    return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+// Find the head after the newest page and the tail at the oldest pending one
+void sample_log_init(const SampleLogFlash *flash) {
+    log_flash = *flash;
+    log_pages = flash->sectors * SAMPLE_LOG_PAGES_PER_SECTOR;
+    log_ready = log_pages > 0;
+    memset(&log_stats, 0, sizeof(log_stats));
+    sealed_page.used = 0;
+    sealed_page.count = 0;
+    open_page.used = 0;
+    open_page.count = 0;
+    unmarked_count = 0;
+    tail_record = 0;
+    pending_records = 0;
+    if (!log_ready) {
+        return;
+    }
+
+    bool found = false;
+    uint32_t newest = 0;
+    SampleLogPage newest_header = {0};
+    for (uint32_t page = 0; page < log_pages; page++) {
+        SampleLogPage header;
+        memcpy(&header, sample_log_page(page), sizeof(header));
+        if (header.magic != SAMPLE_LOG_MAGIC) {
+            continue;
+        }
+        if (!found || (int32_t)(header.sequence - newest_header.sequence) > 0) {
+            found = true;
+            newest = page;
+            newest_header = header;
+        }
+    }
+    head_page = found ? (newest + 1) % log_pages : 0;
+    head_sequence = found ? newest_header.sequence + 1 : 0;
+    log_boot = found ? newest_header.boot + 1 : 0;
+
+    // A program torn by a reset leaves a page that cannot be written again:
+    // carry on in the next sector, it is erased on entry
+    if (head_page % SAMPLE_LOG_PAGES_PER_SECTOR != 0 && !sample_log_page_erased(head_page)) {
+        head_page = (head_page / SAMPLE_LOG_PAGES_PER_SECTOR + 1) % flash->sectors * SAMPLE_LOG_PAGES_PER_SECTOR;
+    }
+
+    // Pages from the head on are the oldest; the head page itself only
+    // holds any with the ring full
+    SampleLogPage header;
+    if (sample_log_page_pending(head_page, &header)) {
+        tail_page = head_page;
+        tail_record = 0;
+        flash_pending = true;
+    } else {
+        sample_log_advance_tail((head_page + 1) % log_pages);
+    }
+    sample_log_count_pending();
+}
+
+// The ring entered the sector starting at first_page: account for the
+// pending records the erase is about to destroy, and forget markers due
+// there, they would land on the pages programmed after the erase
+static void sample_log_drop_sector(uint32_t first_page) {
+    uint32_t sector = first_page / SAMPLE_LOG_PAGES_PER_SECTOR;
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < unmarked_count; i++) {
+        if (unmarked_pages[i] / SAMPLE_LOG_PAGES_PER_SECTOR != sector) {
+            unmarked_pages[kept++] = unmarked_pages[i];
+        }
+    }
+    unmarked_count = kept;
+    while (flash_pending && tail_page / SAMPLE_LOG_PAGES_PER_SECTOR == sector) {
+        SampleLogPage header;
+        if (sample_log_page_pending(tail_page, &header)) {
+            uint8_t lost = header.count - tail_record;
+            log_stats.dropped += lost;
+            pending_records -= lost;
+        }
+        sample_log_advance_tail((tail_page + 1) % log_pages);
+    }
+}
+
+// Program the sealed page at the head, erasing the head sector on entry
+static bool sample_log_flush(void) {
+    uint32_t page_offset = log_flash.offset + head_page * SAMPLE_LOG_PAGE_SIZE;
+    if (head_page % SAMPLE_LOG_PAGES_PER_SECTOR == 0) {
+        sample_log_drop_sector(head_page);
+        if (!log_flash.erase(page_offset, SAMPLE_LOG_SECTOR_SIZE)) {
+            log_stats.write_errors++;
+            return false;
+        }
+        log_stats.erases++;
+    }
+
+    uint8_t page[SAMPLE_LOG_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    SampleLogPage header = {
+        .magic = SAMPLE_LOG_MAGIC,
+        .boot = log_boot,
+        .sequence = head_sequence,
+        .used = sealed_page.used,
+        .count = sealed_page.count,
+        .delivered = 0xFF,
+        .crc = 0xFFFFFFFF,
+    };
+    memcpy(page, &header, sizeof(header));
+    memcpy(page + sizeof(header), sealed_page.records, sealed_page.used);
+    header.crc = sample_log_page_crc(page);
+    memcpy(page, &header, sizeof(header));
+    if (!log_flash.program(page_offset, page, sizeof(page))) {
+        log_stats.write_errors++;
+        return false;
+    }
+    log_stats.programmed_bytes += sizeof(page);
+
+    if (!flash_pending) {
+        tail_page = head_page;
+        tail_record = 0;
+        flash_pending = true;
+    }
+    head_page = (head_page + 1) % log_pages;
+    head_sequence++;
+    sealed_page.used = 0;
+    sealed_page.count = 0;
+    return true;
+}
+
+// Log one encoded sample (record[SAMPLE_LOG_RECORD_HEADER_SIZE..], length
+// bytes) taken at time_ms
+static bool sample_log_append_record(uint8_t *record, uint8_t length, uint32_t time_ms) {
+    if (length == 0) {
+        log_stats.dropped++;
+        return false;
+    }
+    record[0] = length;
+    sample_log_put32(&record[1], time_ms);
+    uint16_t size = SAMPLE_LOG_RECORD_HEADER_SIZE + length;
+
+    if (open_page.used + size > SAMPLE_LOG_PAGE_CAPACITY || open_page.count == UINT8_MAX) {
+        if (sealed_page.count > 0) {
+            // Two pages full since the last sample_log_sync
+            log_stats.dropped++;
+            return false;
+        }
+        sealed_page = open_page;
+        open_page.used = 0;
+        open_page.count = 0;
+    }
+    memcpy(&open_page.records[open_page.used], record, size);
+    open_page.used += size;
+    open_page.count++;
+    pending_records++;
+    log_stats.appended++;
+    log_stats.record_bytes += size;
+    return true;
+}
+
+// Log one sample taken at time_ms (since boot), without its spread. Only
+// RAM is written. Returns false if it was dropped.
+bool sample_log_append(const SensorData *data, uint32_t time_ms) {
+    if (!log_ready) {
+        return false;
+    }
+    SensorData sample = *data;
+    sample.spread_present = 0;
+    uint8_t record[SAMPLE_LOG_PAGE_CAPACITY];
+    uint8_t length = packet_encode_sample(&sample, &record[SAMPLE_LOG_RECORD_HEADER_SIZE],
+                                          sizeof(record) - SAMPLE_LOG_RECORD_HEADER_SIZE);
+    return sample_log_append_record(record, length, time_ms);
+}
+
+// sample_log_append for the integer pipeline, the record is the same
+bool sample_log_append_fixed(const SensorDataFixed *data, uint32_t time_ms) {
+    if (!log_ready) {
+        return false;
+    }
+    SensorDataFixed sample = *data;
+    sample.spread_present = 0;
+    uint8_t record[SAMPLE_LOG_PAGE_CAPACITY];
+    uint8_t length = packet_encode_sample_fixed(&sample, &record[SAMPLE_LOG_RECORD_HEADER_SIZE],
+                                                sizeof(record) - SAMPLE_LOG_RECORD_HEADER_SIZE);
+    return sample_log_append_record(record, length, time_ms);
+}
+
+uint32_t sample_log_pending(void) {
+    return pending_records;
+}
+
+// Mark a flash page delivered by clearing its marker byte, the rest of the
+// programmed buffer is 0xFF and leaves the page as it is
+static void sample_log_mark_delivered(uint32_t page) {
+    uint8_t marker[SAMPLE_LOG_PAGE_SIZE];
+    memset(marker, 0xFF, sizeof(marker));
+    marker[offsetof(SampleLogPage, delivered)] = 0;
+    if (log_flash.program(log_flash.offset + page * SAMPLE_LOG_PAGE_SIZE, marker, sizeof(marker))) {
+        log_stats.programmed_bytes += sizeof(marker);
+    } else {
+        log_stats.write_errors++; // Sent again after the next reset
+    }
+}
+
+// Leave the marker of page for sample_log_sync. With too many waiting the
+// page stays pending in flash and is sent again after the next reset.
+static void sample_log_delivered(uint32_t page) {
+    if (unmarked_count < SAMPLE_LOG_MARKERS) {
+        unmarked_pages[unmarked_count++] = page;
+    }
+}
+
+// The RAM page holding the oldest records
+static SampleLogBuffer *sample_log_ram_tail(void) {
+    return sealed_page.count > 0 ? &sealed_page : &open_page;
+}
+
+// The oldest pending records do not decode: drop them with their page
+static void sample_log_discard_tail(uint8_t count) {
+    log_stats.read_errors++;
+    log_stats.dropped += count;
+    pending_records -= count;
+    if (flash_pending) {
+        sample_log_delivered(tail_page); // Would fail the same way after a reset
+        sample_log_advance_tail((tail_page + 1) % log_pages);
+    } else {
+        SampleLogBuffer *buffer = sample_log_ram_tail();
+        buffer->used = 0;
+        buffer->count = 0;
+    }
+}
+
+// Copy the oldest pending records out without removing them, as the body
+// of a batch frame (age, then the sample, per record; see packet.h): as
+// many as fit max_samples and max_bytes, across page boundaries. *length is
+// set to the bytes written; ages_ms, if not NULL, gets each record's age in
+// full. A tail page that fails its CRC or holds a record that does not
+// parse is skipped and counted in read_errors, the peek goes on with the
+// next one; one further on ends the peek short of it.
+uint8_t sample_log_peek(uint8_t *body, uint8_t *length, uint32_t *ages_ms, uint8_t max_samples,
+                        uint8_t max_bytes, uint32_t now_ms) {
+    *length = 0;
+    while (log_ready && pending_records > 0) {
+        uint8_t n = 0;
+        uint16_t bytes = 0;
+        bool discarded = false;
+        bool full = false;
+        // Pages in delivery order: the pending ones in flash from the tail,
+        // then the sealed and the open RAM page
+        bool in_flash = flash_pending;
+        uint32_t page = tail_page;
+        uint8_t first = tail_record;
+        uint8_t ram = 0;
+        while (n < max_samples && !full && !discarded) {
+            const uint8_t *records;
+            uint16_t used;
+            uint8_t count;
+            uint16_t boot = log_boot;
+            if (in_flash) {
+                SampleLogPage header;
+                if (page == head_page) {
+                    in_flash = false;
+                    continue;
+                }
+                if (!sample_log_page_pending(page, &header)) {
+                    if (n == 0 && page == tail_page) {
+                        // Corrupted since it became the tail
+                        sample_log_advance_tail(tail_page);
+                        sample_log_count_pending();
+                        discarded = true;
+                    }
+                    break;
+                }
+                records = sample_log_page(page) + SAMPLE_LOG_PAGE_HEADER_SIZE;
+                used = header.used;
+                count = header.count;
+                boot = header.boot;
+                page = (page + 1) % log_pages;
+            } else {
+                if (ram == 2) {
+                    break;
+                }
+                const SampleLogBuffer *buffer = ram++ == 0 ? &sealed_page : &open_page;
+                records = buffer->records;
+                used = buffer->used;
+                count = buffer->count;
+            }
+
+            uint16_t index = 0;
+            for (uint8_t i = 0; i < first && index < used; i++) {
+                index += SAMPLE_LOG_RECORD_HEADER_SIZE + records[index];
+            }
+            for (uint8_t i = first; i < count && n < max_samples; i++) {
+                uint8_t record_length = records[index];
+                const uint8_t *sample = &records[index + SAMPLE_LOG_RECORD_HEADER_SIZE];
+                if (index + SAMPLE_LOG_RECORD_HEADER_SIZE + record_length > used ||
+                    packet_sample_length(sample, record_length) != record_length) {
+                    if (n == 0) {
+                        sample_log_discard_tail(count - first);
+                        discarded = true;
+                    }
+                    full = true; // Nothing past a bad record in this peek
+                    break;
+                }
+                if (bytes + PACKET_AGE_SIZE + record_length > max_bytes) {
+                    full = true;
+                    break;
+                }
+                // Time since boot means nothing across a reset
+                uint32_t age_ms = boot == log_boot ? now_ms - sample_log_get32(&records[index + 1])
+                                                   : SAMPLE_LOG_AGE_UNKNOWN;
+                if (ages_ms != NULL) {
+                    ages_ms[n] = age_ms;
+                }
+                packet_encode_age(age_ms, &body[bytes]);
+                memcpy(&body[bytes + PACKET_AGE_SIZE], sample, record_length);
+                bytes += PACKET_AGE_SIZE + record_length;
+                index += SAMPLE_LOG_RECORD_HEADER_SIZE + record_length;
+                n++;
+            }
+            first = 0;
+        }
+        if (!discarded) {
+            *length = (uint8_t)bytes;
+            return n;
+        }
+    }
+    return 0;
+}
+
+// Remove the count records the last sample_log_peek returned, they were acknowledged
+void sample_log_consume(uint8_t count) {
+    if (!log_ready) {
+        return;
+    }
+    while (count > 0 && pending_records > 0) {
+        uint8_t taken;
+        if (flash_pending) {
+            SampleLogPage header;
+            memcpy(&header, sample_log_page(tail_page), sizeof(header));
+            taken = count < header.count - tail_record ? count : header.count - tail_record;
+            tail_record += taken;
+            // Before the tail moves on: a corrupt page past it makes it count again
+            pending_records -= taken;
+            if (tail_record >= header.count) {
+                sample_log_delivered(tail_page);
+                sample_log_advance_tail((tail_page + 1) % log_pages);
+            }
+        } else {
+            SampleLogBuffer *buffer = sample_log_ram_tail();
+            taken = count < buffer->count ? count : buffer->count;
+            uint16_t index = 0;
+            for (uint8_t i = 0; i < taken; i++) {
+                index += SAMPLE_LOG_RECORD_HEADER_SIZE + buffer->records[index];
+            }
+            memmove(buffer->records, &buffer->records[index], buffer->used - index);
+            buffer->used -= index;
+            buffer->count -= taken;
+            pending_records -= taken;
+        }
+        if (taken == 0) {
+            break;
+        }
+        count -= taken;
+        log_stats.delivered += taken;
+    }
+}
+
+// Program what append and consume left in RAM, as far as budget_us covers
+// at the flash's worst case: delivered markers first, then the sealed page.
+// Returns true once nothing is left.
+bool sample_log_sync(uint32_t budget_us) {
+    if (!log_ready) {
+        return true;
+    }
+    uint8_t marked = 0;
+    while (marked < unmarked_count && budget_us >= log_flash.program_max_us) {
+        sample_log_mark_delivered(unmarked_pages[marked++]);
+        budget_us -= log_flash.program_max_us;
+    }
+    memmove(unmarked_pages, &unmarked_pages[marked], (unmarked_count - marked) * sizeof(unmarked_pages[0]));
+    unmarked_count -= marked;
+
+    if (unmarked_count == 0 && sealed_page.count > 0) {
+        uint32_t cost_us = log_flash.program_max_us;
+        if (head_page % SAMPLE_LOG_PAGES_PER_SECTOR == 0) {
+            cost_us += log_flash.erase_max_us;
+        }
+        if (budget_us >= cost_us) {
+            sample_log_flush(); // Tried again next time if the flash refused it
+        }
+    }
+    return unmarked_count == 0 && sealed_page.count == 0;
+}
+
+void sample_log_get_stats(SampleLogStats *stats) {
+    *stats = log_stats;
+}
@@ -0,0 +1,78 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sensors.h"
+#include "packet.h"
+
+// Store-and-forward log of samples the gateway did not acknowledge, in a
+// ring of flash sectors. Records are packed into a RAM page and programmed a
+// page at a time. Pages are written in ring order, so every sector is erased
+// once per lap: wear levelling by construction. Once all its records are
+// acknowledged a page is marked delivered by programming its marker byte to
+// 0, NOR flash clears bits without an erase.
+//
+// Appending and consuming only touch RAM. A full RAM page is sealed, and it
+// and the delivered markers are programmed by sample_log_sync, which the
+// caller runs where a flash operation holds nothing up; a third page's worth
+// of records before then is dropped.
+//
+// After a reset the ring is scanned for pending pages; a page that was only
+// partly delivered is sent again (at-least-once delivery). Records still in
+// the RAM pages, at most two pages of them, are lost with the reset. When the ring is
+// full the oldest sector is erased and its pending records are dropped.
+// Records taken before the last reset have no usable time base, their age
+// is SAMPLE_LOG_AGE_UNKNOWN. A page that no longer passes its CRC is skipped
+// and counted as a read error.
+//
+// Page:   header (SampleLogPage, sample_log.c), then records back to back
+// Record: [0] sample length, [1..4] time in ms since boot, then the sample
+//         in its wire encoding (packet_encode_sample) without the spread:
+//         backfill frames carry means only, several samples to a frame
+//
+// Flash access is passed in, tools/sample_log_sim.c runs the same code on
+// the host against simulated flash.
+
+#define SAMPLE_LOG_PAGE_SIZE 256
+#define SAMPLE_LOG_SECTOR_SIZE 4096
+#define SAMPLE_LOG_PAGES_PER_SECTOR (SAMPLE_LOG_SECTOR_SIZE / SAMPLE_LOG_PAGE_SIZE)
+#define SAMPLE_LOG_PAGE_HEADER_SIZE 16
+#define SAMPLE_LOG_RECORD_HEADER_SIZE 5
+#define SAMPLE_LOG_PAGE_CAPACITY (SAMPLE_LOG_PAGE_SIZE - SAMPLE_LOG_PAGE_HEADER_SIZE)
+#define SAMPLE_LOG_MAGIC 0x4C53 // "SL"
+#define SAMPLE_LOG_AGE_UNKNOWN UINT32_MAX
+
+typedef struct {
+    uint32_t offset;  // Flash offset of the first sector
+    uint32_t sectors;
+    bool (*erase)(uint32_t offset, size_t length);
+    bool (*program)(uint32_t offset, const uint8_t *src, size_t length);
+    const uint8_t *(*read)(uint32_t offset);
+    uint32_t erase_max_us;   // Worst case of one sector erase, for sample_log_sync
+    uint32_t program_max_us; // The same for one page program
+} SampleLogFlash;
+
+typedef struct {
+    uint32_t appended;         // Records logged
+    uint32_t delivered;        // Records acknowledged through backfill
+    uint32_t dropped;          // Records lost undelivered: ring full or write refused
+    uint32_t record_bytes;     // Record bytes appended, headers included
+    uint32_t programmed_bytes; // Bytes programmed, delivered markers included
+    uint32_t erases;           // Sector erases
+    uint32_t write_errors;     // Erases or programs the flash refused
+    uint32_t read_errors;      // Pages skipped: failed CRC or records that do not decode
+} SampleLogStats;
+
+void sample_log_init(const SampleLogFlash *flash);
+bool sample_log_append(const SensorData *data, uint32_t time_ms);
+bool sample_log_append_fixed(const SensorDataFixed *data, uint32_t time_ms);
+uint32_t sample_log_pending(void);
+uint8_t sample_log_peek(uint8_t *body, uint8_t *length, uint32_t *ages_ms, uint8_t max_samples,
+                        uint8_t max_bytes, uint32_t now_ms);
+void sample_log_consume(uint8_t count);
+bool sample_log_sync(uint32_t budget_us);
+void sample_log_get_stats(SampleLogStats *stats);
+
+#endif // SAMPLE_LOG_H
@@ -0,0 +1,141 @@
+#include "scheduler.h"
+#include "radio.h"
+
+void scheduler_init(Scheduler *scheduler) {
+    scheduler->state = SCHEDULER_STATE_NORMAL;
+    scheduler->sample_interval_ms = SCHEDULER_NORMAL_INTERVAL_MS;
+    scheduler->tx_interval_ms = SCHEDULER_NORMAL_TX_INTERVAL_MS;
+}
+
+// Thresholds in the integer pipeline's mV and mW, rounded at compile time
+#define SCHEDULER_MILLI(value) ((int32_t)((value) * 1000.0f + 0.5f))
+
+static bool scheduler_has(uint16_t present, uint8_t channel) {
+    return (present & SENSOR_BIT(channel)) != 0;
+}
+
+static SchedulerState scheduler_next_state(SchedulerState state, const SensorData *data) {
+    bool battery_known = scheduler_has(data->present, SENSOR_CH_BATTERY_VOLTAGE);
+    bool solar_known = scheduler_has(data->present, SENSOR_CH_SOLAR_POWER);
+    if (!battery_known && !solar_known) {
+        return state; // Nothing to go on, keep the current policy
+    }
+
+    // Low charge wins over everything else
+    bool low;
+    if (battery_known) {
+        float limit = state == SCHEDULER_STATE_LOW ? SCHEDULER_BATTERY_LOW_LEAVE_V : SCHEDULER_BATTERY_LOW_ENTER_V;
+        low = data->battery_voltage < limit;
+    } else {
+        float limit = state == SCHEDULER_STATE_LOW ? SCHEDULER_SOLAR_LOW_LEAVE_W : SCHEDULER_SOLAR_LOW_ENTER_W;
+        low = data->solar_power < limit;
+    }
+    if (low) {
+        return SCHEDULER_STATE_LOW;
+    }
+
+    if (solar_known) {
+        float limit = state == SCHEDULER_STATE_SURPLUS ? SCHEDULER_SOLAR_SURPLUS_LEAVE_W : SCHEDULER_SOLAR_SURPLUS_ENTER_W;
+        if (data->solar_power >= limit) {
+            return SCHEDULER_STATE_SURPLUS;
+        }
+    }
+    return SCHEDULER_STATE_NORMAL;
+}
+
+static SchedulerState scheduler_next_state_fixed(SchedulerState state, const SensorDataFixed *data) {
+    bool battery_known = scheduler_has(data->present, SENSOR_CH_BATTERY_VOLTAGE);
+    bool solar_known = scheduler_has(data->present, SENSOR_CH_SOLAR_POWER);
+    if (!battery_known && !solar_known) {
+        return state;
+    }
+
+    bool low;
+    if (battery_known) {
+        int32_t limit = state == SCHEDULER_STATE_LOW ? SCHEDULER_MILLI(SCHEDULER_BATTERY_LOW_LEAVE_V)
+                                                     : SCHEDULER_MILLI(SCHEDULER_BATTERY_LOW_ENTER_V);
+        low = data->battery_voltage < limit;
+    } else {
+        int32_t limit = state == SCHEDULER_STATE_LOW ? SCHEDULER_MILLI(SCHEDULER_SOLAR_LOW_LEAVE_W)
+                                                     : SCHEDULER_MILLI(SCHEDULER_SOLAR_LOW_ENTER_W);
+        low = data->solar_power < limit;
+    }
+    if (low) {
+        return SCHEDULER_STATE_LOW;
+    }
+
+    if (solar_known) {
+        int32_t limit = state == SCHEDULER_STATE_SURPLUS ? SCHEDULER_MILLI(SCHEDULER_SOLAR_SURPLUS_LEAVE_W)
+                                                         : SCHEDULER_MILLI(SCHEDULER_SOLAR_SURPLUS_ENTER_W);
+        if (data->solar_power >= limit) {
+            return SCHEDULER_STATE_SURPLUS;
+        }
+    }
+    return SCHEDULER_STATE_NORMAL;
+}
+
+// Set the intervals of state, returns true when they changed
+static bool scheduler_enter(Scheduler *scheduler, SchedulerState state) {
+    uint32_t sample_interval = scheduler->sample_interval_ms;
+    uint32_t tx_interval = scheduler->tx_interval_ms;
+
+    switch (state) {
+    case SCHEDULER_STATE_SURPLUS:
+        // Every sample goes out on its own
+        sample_interval = SCHEDULER_SURPLUS_INTERVAL_MS;
+        tx_interval = sample_interval;
+        break;
+    case SCHEDULER_STATE_NORMAL:
+        sample_interval = SCHEDULER_NORMAL_INTERVAL_MS;
+        tx_interval = SCHEDULER_NORMAL_TX_INTERVAL_MS;
+        break;
+    case SCHEDULER_STATE_LOW:
+        // Back off from wherever we were, then batch as much as a frame holds
+        if (scheduler->state != SCHEDULER_STATE_LOW) {
+            sample_interval = SCHEDULER_NORMAL_INTERVAL_MS;
+        }
+        sample_interval *= 2;
+        if (sample_interval > SCHEDULER_FLOOR_INTERVAL_MS) {
+            sample_interval = SCHEDULER_FLOOR_INTERVAL_MS;
+        }
+        tx_interval = sample_interval * RADIO_BATCH_MAX_SAMPLES;
+        break;
+    }
+
+    // Heartbeat: never stay silent longer than this, whatever the state
+    if (sample_interval > SCHEDULER_HEARTBEAT_MS) {
+        sample_interval = SCHEDULER_HEARTBEAT_MS;
+    }
+    if (tx_interval > SCHEDULER_HEARTBEAT_MS) {
+        tx_interval = SCHEDULER_HEARTBEAT_MS;
+    }
+    if (tx_interval < sample_interval) {
+        tx_interval = sample_interval;
+    }
+
+    bool changed = sample_interval != scheduler->sample_interval_ms || tx_interval != scheduler->tx_interval_ms;
+    scheduler->state = state;
+    scheduler->sample_interval_ms = sample_interval;
+    scheduler->tx_interval_ms = tx_interval;
+    return changed;
+}
+
+bool scheduler_update(Scheduler *scheduler, const SensorData *data) {
+    return scheduler_enter(scheduler, scheduler_next_state(scheduler->state, data));
+}
+
+bool scheduler_update_fixed(Scheduler *scheduler, const SensorDataFixed *data) {
+    return scheduler_enter(scheduler, scheduler_next_state_fixed(scheduler->state, data));
+}
+
+void scheduler_annotate(const Scheduler *scheduler, SensorData *data) {
+    data->sample_interval = scheduler->sample_interval_ms / 1000.0f;
+    data->tx_interval = scheduler->tx_interval_ms / 1000.0f;
+    data->present |= SENSOR_BIT(SENSOR_CH_SAMPLE_INTERVAL) | SENSOR_BIT(SENSOR_CH_TX_INTERVAL);
+}
+
+void scheduler_annotate_fixed(const Scheduler *scheduler, SensorDataFixed *data) {
+    data->sample_interval = (int32_t)((scheduler->sample_interval_ms + 500) / 1000);
+    data->tx_interval = (int32_t)((scheduler->tx_interval_ms + 500) / 1000);
+    data->present |= SENSOR_BIT(SENSOR_CH_SAMPLE_INTERVAL) | SENSOR_BIT(SENSOR_CH_TX_INTERVAL);
+}
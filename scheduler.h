@@ -0,0 +1,51 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensors.h"
+
+// Energy-aware sampling: the sample and transmit intervals follow the energy
+// state derived from the INA219 readings. Thresholds come in enter/leave pairs
+// so a reading hovering around one does not flip the state every cycle.
+//
+// Battery voltage decides LOW when it is measured; without it the station
+// falls back to solar power alone (no harvest counts as low).
+
+#define SCHEDULER_BATTERY_LOW_ENTER_V   3.50f
+#define SCHEDULER_BATTERY_LOW_LEAVE_V   3.65f
+#define SCHEDULER_SOLAR_SURPLUS_ENTER_W 0.50f
+#define SCHEDULER_SOLAR_SURPLUS_LEAVE_W 0.30f
+#define SCHEDULER_SOLAR_LOW_ENTER_W     0.02f // Only used without a battery reading
+#define SCHEDULER_SOLAR_LOW_LEAVE_W     0.05f
+
+#define SCHEDULER_SURPLUS_INTERVAL_MS   5000
+#define SCHEDULER_NORMAL_INTERVAL_MS    10000
+#define SCHEDULER_NORMAL_TX_INTERVAL_MS 30000
+// On low charge the sample interval doubles every cycle up to the floor
+#define SCHEDULER_FLOOR_INTERVAL_MS     300000
+// Upper bound on the time between transmissions, in every state
+#define SCHEDULER_HEARTBEAT_MS          600000
+
+typedef enum {
+    SCHEDULER_STATE_LOW,
+    SCHEDULER_STATE_NORMAL,
+    SCHEDULER_STATE_SURPLUS,
+} SchedulerState;
+
+typedef struct {
+    SchedulerState state;
+    uint32_t sample_interval_ms;
+    uint32_t tx_interval_ms;
+} Scheduler;
+
+void scheduler_init(Scheduler *scheduler);
+// Feed the latest sample; returns true when the intervals changed
+bool scheduler_update(Scheduler *scheduler, const SensorData *data);
+// Record the intervals in effect in the sample's telemetry channels
+void scheduler_annotate(const Scheduler *scheduler, SensorData *data);
+// The same on the integer pipeline, thresholds in mV and mW
+bool scheduler_update_fixed(Scheduler *scheduler, const SensorDataFixed *data);
+void scheduler_annotate_fixed(const Scheduler *scheduler, SensorDataFixed *data);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,180 @@
+#include "sensor_stats.h"
+#include <math.h>
+#include <string.h>
+
+void welford_reset(WelfordStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+// Running mean and squared deviation updated in one pass, without the
+// cancellation a sum-of-squares accumulator suffers on offsets like 1013 hPa.
+// Values are taken relative to the first one, so the rounding of the mean
+// update scales with the spread rather than with the offset.
+void welford_add(WelfordStats *stats, float value) {
+    stats->count++;
+    if (stats->count == 1) {
+        stats->shift = value;
+        stats->mean = 0.0f;
+        stats->m2 = 0.0f;
+        stats->min = value;
+        stats->max = value;
+        return;
+    }
+    float delta = value - stats->shift - stats->mean;
+    stats->mean += delta / stats->count;
+    stats->m2 += delta * (value - stats->shift - stats->mean);
+    if (value < stats->min) {
+        stats->min = value;
+    }
+    if (value > stats->max) {
+        stats->max = value;
+    }
+}
+
+float welford_mean(const WelfordStats *stats) {
+    return stats->shift + stats->mean;
+}
+
+// Sample standard deviation, 0 with fewer than two values
+float welford_stddev(const WelfordStats *stats) {
+    if (stats->count < 2) {
+        return 0.0f;
+    }
+    return sqrtf(stats->m2 / (stats->count - 1));
+}
+
+void sensor_stats_reset(SensorStats *stats) {
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        welford_reset(&stats->channels[ch]);
+    }
+    stats->samples = 0;
+}
+
+void sensor_stats_add(SensorStats *stats, const SensorData *data) {
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (data->present & SENSOR_BIT(ch)) {
+            welford_add(&stats->channels[ch], sensor_value(data, ch));
+        }
+    }
+    stats->samples++;
+}
+
+void sensor_stats_report(const SensorStats *stats, SensorData *report) {
+    memset(report, 0, sizeof(*report));
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        const WelfordStats *channel = &stats->channels[ch];
+        if (channel->count == 0) {
+            continue;
+        }
+        sensor_set_value(report, ch, welford_mean(channel));
+        report->present |= SENSOR_BIT(ch);
+        if ((STATS_SPREAD_CHANNELS & SENSOR_BIT(ch)) && channel->count >= 2) {
+            report->spread[ch].min = channel->min;
+            report->spread[ch].max = channel->max;
+            report->spread[ch].stddev = welford_stddev(channel);
+            report->spread_present |= SENSOR_BIT(ch);
+        }
+    }
+}
+
+void fixed_stats_reset(FixedStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void fixed_stats_add(FixedStats *stats, int32_t value) {
+    stats->count++;
+    if (stats->count == 1) {
+        stats->shift = value;
+        stats->min = value;
+        stats->max = value;
+        return;
+    }
+    int64_t delta = (int64_t)value - stats->shift;
+    stats->sum += delta;
+    stats->sum2 += (uint64_t)(delta * delta);
+    if (value < stats->min) {
+        stats->min = value;
+    }
+    if (value > stats->max) {
+        stats->max = value;
+    }
+}
+
+int32_t fixed_stats_mean(const FixedStats *stats) {
+    if (stats->count == 0) {
+        return 0;
+    }
+    int64_t half = stats->count / 2;
+    int64_t offset = stats->sum >= 0 ? (stats->sum + half) / stats->count : -((-stats->sum + half) / stats->count);
+    return (int32_t)(stats->shift + offset);
+}
+
+static uint32_t fixed_stats_isqrt(uint64_t value) {
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+// Sample standard deviation, 0 with fewer than two values. The variance is
+// (n * sum2 - sum^2) / (n * (n - 1)); the root is rounded against that
+// fraction, not a truncated quotient.
+int32_t fixed_stats_stddev(const FixedStats *stats) {
+    if (stats->count < 2) {
+        return 0;
+    }
+    uint64_t n = stats->count;
+    uint64_t numerator = n * stats->sum2 - (uint64_t)(stats->sum * stats->sum);
+    uint64_t denominator = n * (n - 1);
+    uint64_t root = fixed_stats_isqrt(numerator / denominator);
+    // Up to the next unit from root + 0.5 on
+    if (4 * numerator >= denominator * (4 * root * root + 4 * root + 1)) {
+        root++;
+    }
+    return (int32_t)root;
+}
+
+void sensor_stats_fixed_reset(SensorStatsFixed *stats) {
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        fixed_stats_reset(&stats->channels[ch]);
+    }
+    stats->samples = 0;
+}
+
+void sensor_stats_fixed_add(SensorStatsFixed *stats, const SensorDataFixed *data) {
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (data->present & SENSOR_BIT(ch)) {
+            fixed_stats_add(&stats->channels[ch], sensor_fixed_value(data, ch));
+        }
+    }
+    stats->samples++;
+}
+
+void sensor_stats_fixed_report(const SensorStatsFixed *stats, SensorDataFixed *report) {
+    memset(report, 0, sizeof(*report));
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        const FixedStats *channel = &stats->channels[ch];
+        if (channel->count == 0) {
+            continue;
+        }
+        sensor_fixed_set_value(report, ch, fixed_stats_mean(channel));
+        report->present |= SENSOR_BIT(ch);
+        if ((STATS_SPREAD_CHANNELS & SENSOR_BIT(ch)) && channel->count >= 2) {
+            report->spread[ch].min = channel->min;
+            report->spread[ch].max = channel->max;
+            report->spread[ch].stddev = fixed_stats_stddev(channel);
+            report->spread_present |= SENSOR_BIT(ch);
+        }
+    }
+}
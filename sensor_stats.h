@@ -0,0 +1,70 @@
+#ifndef SENSOR_STATS_H
+#define SENSOR_STATS_H
+
+#include <stdint.h>
+#include "sensors.h"
+
+// Oversampling: the sensors are read every STATS_OVERSAMPLE_INTERVAL_MS and
+// each channel feeds a streaming (Welford) accumulator. A report carries the
+// mean as the channel value plus min/max/stddev for STATS_SPREAD_CHANNELS.
+// Fixed size, no allocation.
+
+#define STATS_OVERSAMPLE_INTERVAL_MS 2000
+// Channels whose spread is transmitted, 6 bytes each on air
+#define STATS_SPREAD_CHANNELS (SENSOR_BIT(SENSOR_CH_EXTERIOR_TEMPERATURE) | \
+                               SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY) | \
+                               SENSOR_BIT(SENSOR_CH_SOLAR_CURRENT) | \
+                               SENSOR_BIT(SENSOR_CH_SOLAR_POWER))
+
+typedef struct {
+    uint32_t count;
+    float shift; // First value; the mean is kept relative to it
+    float mean;  // Running mean minus shift, see welford_mean()
+    float m2;    // Sum of squared deviations from the running mean
+    float min;
+    float max;
+} WelfordStats;
+
+typedef struct {
+    WelfordStats channels[SENSOR_CH_COUNT];
+    uint32_t samples;
+} SensorStats;
+
+// Integer counterpart for SensorDataFixed, in wire units. Sums of the
+// deviations from the first value are exact in 64 bits over any report
+// interval, so plain sums do here what Welford's update does for floats.
+typedef struct {
+    uint32_t count;
+    int32_t shift; // First value
+    int64_t sum;   // Sum of value - shift
+    uint64_t sum2; // Sum of (value - shift)^2
+    int32_t min;
+    int32_t max;
+} FixedStats;
+
+typedef struct {
+    FixedStats channels[SENSOR_CH_COUNT];
+    uint32_t samples;
+} SensorStatsFixed;
+
+void welford_reset(WelfordStats *stats);
+void welford_add(WelfordStats *stats, float value);
+float welford_mean(const WelfordStats *stats);
+float welford_stddev(const WelfordStats *stats);
+
+void sensor_stats_reset(SensorStats *stats);
+void sensor_stats_add(SensorStats *stats, const SensorData *data);
+// Build a report: means as values, spread for STATS_SPREAD_CHANNELS seen at least twice
+void sensor_stats_report(const SensorStats *stats, SensorData *report);
+
+void fixed_stats_reset(FixedStats *stats);
+void fixed_stats_add(FixedStats *stats, int32_t value);
+// Both rounded to the nearest wire unit
+int32_t fixed_stats_mean(const FixedStats *stats);
+int32_t fixed_stats_stddev(const FixedStats *stats);
+
+void sensor_stats_fixed_reset(SensorStatsFixed *stats);
+void sensor_stats_fixed_add(SensorStatsFixed *stats, const SensorDataFixed *data);
+void sensor_stats_fixed_report(const SensorStatsFixed *stats, SensorDataFixed *report);
+
+#endif // SENSOR_STATS_H
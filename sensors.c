@@ -1,172 +1,345 @@
 #include "sensors.h"
-#include "hardware/gpio.h"
-#include "hardware/i2c.h"
+#include "hal.h"
+#include "log.h"
+#include "trace.h"
+#include "i2c_bus.h"
+#include "boot_cache.h"
 #include "INA219.h"
-#include "sht40.h" // Include the header file for the SHT40 sensor
-#include "bmp280.h" // Include the header file for the BMP280 sensor
+#include "SHT40.h" // Include the header file for the SHT40 sensor
+#include "BMP280.h" // Include the header file for the BMP280 sensor
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
 INA219 ina219_battery;
 INA219 ina219_solar;
+SHT40 sht40;
 bmp280 bmp;
 
+// True if a device acknowledges its address
+static bool i2c_probe(HalI2cBus *i2c_instance, uint8_t addr) {
+    uint8_t data = 0;
+    return hal_i2c_write(i2c_instance, addr, &data, 1, true) == 1;
+}
+
 // Function to scan the I2C bus for devices
-void i2c_scan(i2c_inst_t *i2c_instance) {
+void i2c_scan(HalI2cBus *i2c_instance) {
     printf("Scanning I2C bus...\n");
     for (uint8_t addr = 0x01; addr < 0x7F; addr++) {
-        uint8_t data = 0;
-        int ret = i2c_write_blocking(i2c_instance, addr, &data, 1, true);
-        if (ret == 1) {
+        if (i2c_probe(i2c_instance, addr)) {
             printf("Device found at address: 0x%02X\n", addr);
         }
     }
     printf("I2C scan complete.\n");
 }
+
+// Devices sensors_init expects, bit n of the inventory is entry n
+static const struct {
+    HalI2cBus *i2c;
+    uint8_t addr;
+} sensors_devices[] = {
+    {INA219_SOLAR_BUS, INA219_I2C_ADDRESS},
+    {INA219_BATTERY_BUS, INA219_BATTERY_I2C_ADDRESS},
+    {SHT40_BUS, SHT40_I2C_ADDRESS},
+    {BMP280_BUS, BMP280_I2C_ADDRESS},
+};
+
+// Which of the expected devices answer, four probes instead of a full scan
+static uint32_t sensors_probe_inventory(void) {
+    uint32_t inventory = 0;
+    for (uint8_t i = 0; i < sizeof(sensors_devices) / sizeof(sensors_devices[0]); i++) {
+        if (i2c_probe(sensors_devices[i].i2c, sensors_devices[i].addr)) {
+            inventory |= 1u << i;
+        }
+    }
+    return inventory;
+}
+
+// Boot cache payload (boot_cache.h), bump the version with any layout change
+#define SENSORS_BOOT_CACHE_VERSION 1
+
+typedef struct {
+    uint32_t inventory; // sensors_probe_inventory() at the full init
+    uint8_t bmp280_coefficients[BMP280_CALIBRATION_SIZE];
+} SensorsBootCache;
+
+// Sea level pressure for a pressure measured at altitude (m), the inverse of
+// the standard atmosphere's barometric formula
+float calculate_sea_level_pressure(float pressure, float altitude) {
+    float sea_level_pressure = pressure * powf(1 - (TEMPERATURE_LAPSE_RATE * altitude) / SEA_LEVEL_TEMP_K,
+                                               -(GRAVITY_ACCELERATION * MOLAR_MASS_AIR) / (UNIVERSAL_GAS_CONSTANT * TEMPERATURE_LAPSE_RATE));
+
+    return sea_level_pressure;
+}
+
+// Q24.8 Pa to sea level hPa, set up once by sensors_set_altitude
+static float sea_level_scale = 1.0f / 25600.0f;
+
+// Function to normalize a BMP280 pressure reading (Q24.8 Pa) to sea level
+float convert_pressure_to_sea_level(float measured_pressure) {
+    return measured_pressure * sea_level_scale;
+}
+
+// Sea level factor minus one in Q15 for the integer path. 32 bits hold
+// 110000 Pa times a correction of up to ~+58% (about 3700 m).
+static int32_t sea_level_offset_q15;
+
+// BMP280 pressure (Q24.8 Pa) to sea level in 0.1 hPa, integer math only
+int32_t convert_pressure_to_sea_level_fixed(uint32_t measured_pressure) {
+    int32_t pa = (int32_t)((measured_pressure + 128) >> 8);
+    int32_t sea_level_pa = pa + ((pa * sea_level_offset_q15 + (1 << 14)) >> 15);
+    return (sea_level_pa + 5) / 10;
+}
+
+// The station does not move, the reduction is a constant factor
+void sensors_set_altitude(float altitude_m) {
+    float sea_level_factor = calculate_sea_level_pressure(1.0f, altitude_m);
+    sea_level_scale = sea_level_factor / 25600.0f;
+    sea_level_offset_q15 = (int32_t)((sea_level_factor - 1.0f) * 32768.0f + 0.5f);
+}
+
+static void sensors_bus_init(HalI2cBus *i2c, uint32_t sda_pin, uint32_t scl_pin) {
+    // Pins with internal pull-ups, controller at the probe clock
+    hal_i2c_init(i2c, sda_pin, scl_pin, I2C_FREQ_HZ);
+    i2c_bus_init(i2c);
+}
+
 // Initialize sensors
 void sensors_init() {
     // Initialize I2C
-    i2c_init(I2C_BUS_INSTANCE, I2C_FREQ_HZ); 
     printf("Starting I2C\n");
+    sensors_bus_init(I2C_BUS_INSTANCE, I2C_SDA_PIN, I2C_SCL_PIN);
+    sensors_bus_init(I2C_POWER_BUS_INSTANCE, I2C_POWER_SDA_PIN, I2C_POWER_SCL_PIN);
 
-    // Set GPIO pins for I2C functionality
-    gpio_set_function(I2C_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_PIN, GPIO_FUNC_I2C);
-
-    // Enable internal pull-up resistors
-    gpio_pull_up(I2C_SDA_PIN);
-    gpio_pull_up(I2C_SCL_PIN);
+    sensors_set_altitude(STATION_ALTITUDE_M);
 
-    // Scan the I2C bus
-    i2c_scan(I2C_BUS_INSTANCE);     
+    // Fast boot: a cache from an earlier full init with the same devices
+    // answering skips the bus scans and the BMP280 reset and calibration read
+    SensorsBootCache cache;
+    uint32_t inventory = sensors_probe_inventory();
+    bool cached = boot_cache_load(SENSORS_BOOT_CACHE_VERSION, &cache, sizeof(cache)) &&
+                  cache.inventory == inventory;
+    if (!cached) {
+        // Scan the I2C buses
+        i2c_scan(I2C_BUS_INSTANCE);
+        i2c_scan(I2C_POWER_BUS_INSTANCE);
+    }
 
     // Initialize INA219 sensors
-    
-    ina219_init(&ina219_solar, I2C_BUS_INSTANCE, INA219_I2C_ADDRESS);
+    ina219_init(&ina219_solar, INA219_SOLAR_BUS, INA219_I2C_ADDRESS);
     printf("INA219 Solar sensor initialized\n");
 
-    //ina219_init(&ina219_battery, i2c0, 0x41);
-    //printf("INA219 Battery sensor initialized\n");
+    ina219_init(&ina219_battery, INA219_BATTERY_BUS, INA219_BATTERY_I2C_ADDRESS);
+    printf("INA219 Battery sensor initialized\n");
 
     // Initialize SHT40 sensor
-    sht40_init(I2C_BUS_INSTANCE, SHT40_I2C_ADDRESS); // Replace with your SHT40 address if different
+    sht40_init(&sht40, SHT40_BUS, SHT40_I2C_ADDRESS); // Replace with your SHT40 address if different
+    sht40_set_repeatability(&sht40, SHT40_REPEATABILITY);
     printf("SHT40 sensor initialized\n");
-    // Initialize BMP280 sensor
-    bmp280_init(I2C_BUS_INSTANCE, BMP280_I2C_ADDRESS);
-    bmp280_calibrate(&bmp);
+    // Initialize BMP280 sensor, the chip-ID check confirms it is the one cached
+    if (!cached || bmp280_init_cached(&bmp, BMP280_BUS, BMP280_I2C_ADDRESS, cache.bmp280_coefficients) < 0) {
+        cached = false;
+        bmp280_init(&bmp, BMP280_BUS, BMP280_I2C_ADDRESS);
+        bmp280_calibrate(&bmp);
+    }
     printf("BMP280 sensor initialized\n");
-   
-    printf("All sensors initialized\n");
-}
 
-// Read current from INA219 sensor
-float read_current_from_ina219(INA219 *ina219) {
-    return ina219_read_current(ina219);
-}
+    // Run each bus as fast as its slowest device allows
+    i2c_bus_attach(INA219_SOLAR_BUS, INA219_I2C_MAX_HZ);
+    i2c_bus_attach(INA219_BATTERY_BUS, INA219_I2C_MAX_HZ);
+    i2c_bus_attach(SHT40_BUS, SHT40_I2C_MAX_HZ);
+    i2c_bus_attach(BMP280_BUS, BMP280_I2C_MAX_HZ);
+    printf("I2C0 clock: %lu Hz\n", (unsigned long)i2c_bus_negotiate(HAL_I2C0));
+    printf("I2C1 clock: %lu Hz\n", (unsigned long)i2c_bus_negotiate(HAL_I2C1));
 
-// Read power from INA219 sensor
-float read_power_from_ina219(INA219 *ina219) {
-    return ina219_read_power(ina219);
+    if (!cached) {
+        cache.inventory = inventory;
+        memcpy(cache.bmp280_coefficients, bmp.coefficients, BMP280_CALIBRATION_SIZE);
+        if (!boot_cache_store(SENSORS_BOOT_CACHE_VERSION, &cache, sizeof(cache))) {
+            printf("Boot cache write failed\n");
+        }
+    }
+   
+    printf("All sensors initialized (%s boot, %lu us since power-on)\n", cached ? "fast" : "full",
+           (unsigned long)hal_time_us());
 }
 
-// Read voltage from INA219 sensor
-float read_voltage_from_ina219(INA219 *ina219) {
-    return ina219_read_voltage(ina219);
-}
+// Conversion sum if each sensor was triggered and waited for in turn
+#define SENSORS_SEQUENTIAL_TIME_US (INA219_CONVERSION_TIME_US + sht40_measure_time_us(&sht40) + BMP280_MEASURE_TIME_US)
 
-// Read temperature from SHT40 sensor
-float read_temperature_from_sht40() {
-    float temperature, humidity;
-    sht40_read_data(&temperature, &humidity);
-        return temperature;
+// Per-bus transfers of one cycle and the share of the cycle the bus was busy
+static void sensors_log_bus(uint8_t index, const HalBusStats *before, const HalBusStats *after, uint32_t cycle_us) {
+    uint32_t busy_us = (uint32_t)(after->busy_us - before->busy_us);
+    LOG_INFO("I2C%d: %lu transactions, %lu bytes, %lu us busy (%lu%% of cycle), %lu errors\n", index,
+           (unsigned long)(after->transactions - before->transactions),
+           (unsigned long)(after->bytes - before->bytes),
+           (unsigned long)busy_us, (unsigned long)(cycle_us ? busy_us * 100 / cycle_us : 0),
+           (unsigned long)(after->errors - before->errors));
+    if (after->errors != before->errors) {
+        LOG_WARN("I2C%d: %lu timeouts, %lu retries, %lu recoveries\n", index,
+                 (unsigned long)(after->timeouts - before->timeouts),
+                 (unsigned long)(after->retries - before->retries),
+                 (unsigned long)(after->recoveries - before->recoveries));
+    }
 }
 
-// Read humidity from SHT40 sensor
-float read_humidity_from_sht40() {
-    float temperature, humidity;
-    sht40_read_data(&temperature, &humidity);
-        return humidity;
-}
-// Read temperature from BMP280 sensor
-float read_temperature_from_bmp280() {
-    bmp280_read_temperature(&bmp);
-    return bmp.temperature;
-}
+// Worst case of the last sensor cycle's collect phase, every job timing
+// out and retried
+static uint32_t cycle_bound_us;
 
-// Read pressure from BMP280 sensor
-float read_pressure_from_bmp280() {
-    bmp280_read_pressure(&bmp);
-    return bmp.pressure;
+uint32_t sensors_cycle_bound_us(void) {
+    return cycle_bound_us;
 }
 
+// The collect jobs of one cycle, parsed by either pipeline
+typedef struct {
+    I2cJob battery[INA219_COLLECT_JOBS];
+    I2cJob solar[INA219_COLLECT_JOBS];
+    I2cJob sht40;
+    I2cJob bmp280;
+} SensorJobs;
 
-float calculate_sea_level_pressure(float pressure, float altitude) {
-    // Calculate sea level pressure using the formula
-    float sea_level_pressure = pressure * powf((1 + (TEMPERATURE_LAPSE_RATE * altitude) / SEA_LEVEL_TEMP_K), 
-                                             (GRAVITY_ACCELERATION * MOLAR_MASS_AIR) / (UNIVERSAL_GAS_CONSTANT * TEMPERATURE_LAPSE_RATE));
-    
-    return sea_level_pressure;
-}
+// Trigger every sensor first, then collect each one once its conversion
+// time has passed. The cycle takes about as long as the slowest sensor.
+// Both phases run as job chains, one per bus, so the buses work side by side.
+static void sensors_run_jobs(SensorJobs *jobs) {
+    HalBusStats bus_before[HAL_I2C_COUNT], bus_after[HAL_I2C_COUNT];
+    for (uint8_t i = 0; i < HAL_I2C_COUNT; i++) {
+        hal_get_i2c_stats(hal_i2c_bus(i), &bus_before[i]);
+    }
+    uint64_t cycle_start_us = hal_time_us();
 
-float calculate_altitude(float pressure) {
+    I2cJob battery_start, solar_start, sht40_start, bmp280_start;
+    ina219_start_job(&ina219_battery, &battery_start);
+    ina219_start_job(&ina219_solar, &solar_start);
+    sht40_start_job(&sht40, &sht40_start);
+    bmp280_start_job(&bmp, &bmp280_start);
+    i2c_bus_queue(INA219_BATTERY_BUS, &battery_start);
+    i2c_bus_queue(INA219_SOLAR_BUS, &solar_start);
+    i2c_bus_queue(SHT40_BUS, &sht40_start);
+    i2c_bus_queue(BMP280_BUS, &bmp280_start);
+    i2c_bus_run();
 
-    // Calculate altitude using the barometric formula
-    float altitude = (SEA_LEVEL_TEMP_K / TEMPERATURE_LAPSE_RATE) * 
-                      (1 - powf((pressure / SEA_LEVEL_PRESSURE_HPA), 
-                      (UNIVERSAL_GAS_CONSTANT * TEMPERATURE_LAPSE_RATE) / 
-                      (GRAVITY_ACCELERATION * MOLAR_MASS_AIR)));
-    
-    return altitude;
-}
+    // Conversions are running; each collect waits for its own ready time.
+    // The INA219s are powered down right after their reads.
+    uint64_t start_us = hal_time_us();
+    I2cJob battery_down, solar_down;
+    ina219_collect_jobs(&ina219_battery, jobs->battery);
+    jobs->battery[0].not_before_us = start_us + INA219_CONVERSION_TIME_US;
+    ina219_power_down_job(&ina219_battery, &battery_down);
+    ina219_collect_jobs(&ina219_solar, jobs->solar);
+    jobs->solar[0].not_before_us = start_us + INA219_CONVERSION_TIME_US;
+    ina219_power_down_job(&ina219_solar, &solar_down);
+    sht40_collect_job(&sht40, &jobs->sht40);
+    jobs->sht40.not_before_us = start_us + sht40_measure_time_us(&sht40);
+    bmp280_collect_job(&bmp, &jobs->bmp280);
+    jobs->bmp280.not_before_us = start_us + BMP280_MEASURE_TIME_US;
+    for (uint8_t i = 0; i < INA219_COLLECT_JOBS; i++) {
+        i2c_bus_queue(INA219_BATTERY_BUS, &jobs->battery[i]);
+    }
+    i2c_bus_queue(INA219_BATTERY_BUS, &battery_down);
+    for (uint8_t i = 0; i < INA219_COLLECT_JOBS; i++) {
+        i2c_bus_queue(INA219_SOLAR_BUS, &jobs->solar[i]);
+    }
+    i2c_bus_queue(INA219_SOLAR_BUS, &solar_down);
+    i2c_bus_queue(SHT40_BUS, &jobs->sht40);
+    i2c_bus_queue(BMP280_BUS, &jobs->bmp280);
+    // Even with every job timing out and retried the cycle ends by then
+    cycle_bound_us = (uint32_t)(hal_time_us() - start_us) + i2c_bus_worst_case_us();
+    i2c_bus_run();
 
-// Function to read and normalize pressure to sea level
-float convert_pressure_to_sea_level() {
-    float measured_pressure = read_pressure_from_bmp280(); // Read pressure from BMP280
-
-    // Convert pressure to hPa
-    float measured_pressure_hpa = measured_pressure / 25600.0f;
-    
-    // Estimate altitude based on measured pressure
-    float estimated_altitude = calculate_altitude(measured_pressure_hpa);
-    printf("Estimated altitude: %f\n", estimated_altitude);
-    
-    // Calculate sea level pressure using estimated altitude
-    float sea_level_pressure_hpa = calculate_sea_level_pressure(measured_pressure_hpa, estimated_altitude);
-    
-    return sea_level_pressure_hpa;
+    uint32_t cycle_us = (uint32_t)(hal_time_us() - cycle_start_us);
+    LOG_INFO("Sensor cycle: %lu us (sequential conversions: %lu us, collect bound: %lu us)\n",
+           (unsigned long)cycle_us, (unsigned long)SENSORS_SEQUENTIAL_TIME_US, (unsigned long)cycle_bound_us);
+    for (uint8_t i = 0; i < HAL_I2C_COUNT; i++) {
+        hal_get_i2c_stats(hal_i2c_bus(i), &bus_after[i]);
+        sensors_log_bus(i, &bus_before[i], &bus_after[i], cycle_us);
+    }
 }
 
 // Read all sensor data
 SensorData sensors_read_all() {
     SensorData data = {0};
-    /*
+
+    TRACE_BEGIN(TRACE_SENSOR_CYCLE, 0);
+    SensorJobs jobs;
+    sensors_run_jobs(&jobs);
+
     // Read battery data from INA219 sensor
-    data.battery_voltage = read_voltage_from_ina219(&ina219_battery);
-    data.battery_current = read_current_from_ina219(&ina219_battery);
-    data.battery_power = read_power_from_ina219(&ina219_battery);
-    */
+    if (ina219_parse_jobs(&ina219_battery, jobs.battery, &data.battery_voltage, &data.battery_current,
+                          &data.battery_power)) {
+        data.present |= SENSOR_BIT(SENSOR_CH_BATTERY_VOLTAGE) | SENSOR_BIT(SENSOR_CH_BATTERY_CURRENT) |
+                        SENSOR_BIT(SENSOR_CH_BATTERY_POWER);
+    }
+    LOG_DEBUG("Battery voltage: %f\n", data.battery_voltage);
+    LOG_DEBUG("Battery current: %f\n", data.battery_current);
+    LOG_DEBUG("Battery power: %f\n", data.battery_power);
+
     // Read solar data from INA219 sensor
-    printf("Reading solar data from INA219 sensar\n");
-    data.solar_voltage = read_voltage_from_ina219(&ina219_solar);
-    printf("Solar voltage: %f\n", data.solar_voltage);
-    data.solar_current = read_current_from_ina219(&ina219_solar);
-    printf("Solar current: %f\n", data.solar_current);
-    data.solar_power = read_power_from_ina219(&ina219_solar);
-    printf("Solar power: %f\n", data.solar_power);
-
-  // Read temperature and humidity from SHT40 sensor
-    printf("Reading temperature and humidity from SHT40\n");
-    data.exterior_temperature = read_temperature_from_sht40();
-    printf("Temperature: %f\n", data.exterior_temperature);
-    data.exterior_humidity = read_humidity_from_sht40();
-    printf("Humidity: %f\n", data.exterior_humidity);
+    if (ina219_parse_jobs(&ina219_solar, jobs.solar, &data.solar_voltage, &data.solar_current,
+                          &data.solar_power)) {
+        data.present |= SENSOR_BIT(SENSOR_CH_SOLAR_VOLTAGE) | SENSOR_BIT(SENSOR_CH_SOLAR_CURRENT) |
+                        SENSOR_BIT(SENSOR_CH_SOLAR_POWER);
+    }
+    LOG_DEBUG("Solar voltage: %f\n", data.solar_voltage);
+    LOG_DEBUG("Solar current: %f\n", data.solar_current);
+    LOG_DEBUG("Solar power: %f\n", data.solar_power);
+
+    // Read temperature and humidity from SHT40 sensor, one measurement gives both values
+    if (sht40_parse_job(&jobs.sht40, &data.exterior_temperature, &data.exterior_humidity)) {
+        data.present |= SENSOR_BIT(SENSOR_CH_EXTERIOR_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY);
+    }
+    LOG_DEBUG("Temperature: %f\n", data.exterior_temperature);
+    LOG_DEBUG("Humidity: %f\n", data.exterior_humidity);
 
     // Read temperature and pressure from BMP280
-    printf("Reading temperature and pressure from BMP280\n");
-    data.temperature = read_temperature_from_bmp280();
-    printf("Temperature: %f\n", data.temperature);
-    data.pressure = convert_pressure_to_sea_level();
-    printf("Pressure: %f\n", data.pressure);
+    if (bmp280_parse_job(&bmp, &jobs.bmp280)) {
+        data.temperature = bmp.temperature;
+        LOG_DEBUG("Temperature: %f\n", data.temperature);
+        data.pressure = convert_pressure_to_sea_level(bmp.pressure);
+        LOG_DEBUG("Pressure: %f\n", data.pressure);
+        data.present |= SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE);
+    }
+    TRACE_END(TRACE_SENSOR_CYCLE, data.present);
+
+    return data;
+}
+
+// sensors_read_all on the integer pipeline, no float operations per sample.
+// Same job chains, so the two differ only in the parsing and scaling.
+SensorDataFixed sensors_read_all_fixed() {
+    SensorDataFixed data = {0};
+
+    TRACE_BEGIN(TRACE_SENSOR_CYCLE, 1);
+    SensorJobs jobs;
+    sensors_run_jobs(&jobs);
+
+    if (ina219_parse_jobs_fixed(&ina219_battery, jobs.battery, &data.battery_voltage, &data.battery_current,
+                                &data.battery_power)) {
+        data.present |= SENSOR_BIT(SENSOR_CH_BATTERY_VOLTAGE) | SENSOR_BIT(SENSOR_CH_BATTERY_CURRENT) |
+                        SENSOR_BIT(SENSOR_CH_BATTERY_POWER);
+    }
+    if (ina219_parse_jobs_fixed(&ina219_solar, jobs.solar, &data.solar_voltage, &data.solar_current,
+                                &data.solar_power)) {
+        data.present |= SENSOR_BIT(SENSOR_CH_SOLAR_VOLTAGE) | SENSOR_BIT(SENSOR_CH_SOLAR_CURRENT) |
+                        SENSOR_BIT(SENSOR_CH_SOLAR_POWER);
+    }
+    LOG_DEBUG("Solar: %ld mV, %ld x0.1 mA, %ld mW\n", (long)data.solar_voltage, (long)data.solar_current,
+              (long)data.solar_power);
+
+    if (sht40_parse_job_fixed(&jobs.sht40, &data.exterior_temperature, &data.exterior_humidity)) {
+        data.present |= SENSOR_BIT(SENSOR_CH_EXTERIOR_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY);
+    }
+    LOG_DEBUG("Exterior: %ld x0.01 DegC, %ld x0.01 %%RH\n", (long)data.exterior_temperature,
+              (long)data.exterior_humidity);
+
+    if (bmp280_parse_job_fixed(&bmp, &jobs.bmp280)) {
+        data.temperature = bmp.temperature_fixed;
+        data.pressure = convert_pressure_to_sea_level_fixed(bmp.pressure_fixed);
+        data.present |= SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE);
+    }
+    LOG_DEBUG("Interior: %ld x0.01 DegC, %ld x0.1 hPa\n", (long)data.temperature, (long)data.pressure);
+    TRACE_END(TRACE_SENSOR_CYCLE, data.present);
 
     return data;
-}
\ No newline at end of file
+}
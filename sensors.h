@@ -1,16 +1,51 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 // Define I2C pins
 #define I2C_SDA_PIN  14  //Black I2C Data pin (GPIO 14)
 #define I2C_SCL_PIN  15  //White I2C Clock pin (GPIO 15)
 
+// Clock each bus starts at; sensors_init raises it to what the attached
+// devices support (i2c_bus_negotiate). Above 100 kHz the internal pull-ups
+// are too weak: fit external ones (2.2 kOhm for 400 kHz, 1 kOhm for 1 MHz)
+// and build with -DI2C_EXTERNAL_PULLUPS=1, otherwise the buses stay here.
 #define I2C_FREQ_HZ  100000
-#define I2C_BUS_INSTANCE i2c1
+#define I2C_BUS_INSTANCE HAL_I2C1
+
+// Second controller, for the power monitors. Devices on different buses are
+// read at the same time, see i2c_bus.h
+#define I2C_POWER_SDA_PIN 12 // I2C0 Data pin (GPIO 12)
+#define I2C_POWER_SCL_PIN 13 // I2C0 Clock pin (GPIO 13)
+#define I2C_POWER_BUS_INSTANCE HAL_I2C0
+
+// Bus of each device, follow the wiring. The solar INA219 stays on i2c1
+// next to the SHT40 and BMP280 as on existing boards; boards that moved it
+// to the power bus build with -DINA219_SOLAR_BUS=I2C_POWER_BUS_INSTANCE.
+#ifndef INA219_SOLAR_BUS
+#define INA219_SOLAR_BUS   I2C_BUS_INSTANCE
+#endif
+#ifndef INA219_BATTERY_BUS
+#define INA219_BATTERY_BUS I2C_POWER_BUS_INSTANCE
+#endif
+#define SHT40_BUS          I2C_BUS_INSTANCE
+#define BMP280_BUS         I2C_BUS_INSTANCE
 
 #define BMP280_I2C_ADDRESS 0x76
 #define SHT40_I2C_ADDRESS 0x44
 #define INA219_I2C_ADDRESS 0x40
+#define INA219_BATTERY_I2C_ADDRESS 0x41
+
+// SHT40 measurement command, SHT40_MEASURE_LOWREP_STRETCH for fast/low-power profiles
+#define SHT40_REPEATABILITY SHT40_MEASURE_HIGHREP_STRETCH
+
+// Height of the BMP280 above sea level, pressure is reported reduced to sea level
+#ifndef STATION_ALTITUDE_M
+#define STATION_ALTITUDE_M 0.0f
+#endif
 
 #define SEA_LEVEL_PRESSURE_HPA 1013.25 // Standard sea level pressure in hPa
 #define SEA_LEVEL_PRESSURE_PA (SEA_LEVEL_PRESSURE_HPA * 100.0f) // Convert hPa to Pa
@@ -20,6 +55,34 @@
 #define UNIVERSAL_GAS_CONSTANT 8.31447 // Universal gas constant in J/(mol·K)
 #define SEA_LEVEL_TEMP_K 288.15f // Standard sea-level temperature in Kelvin
 
+// Channel indices, sensor_channel_offset maps them to SensorData fields.
+// Bit n of SensorData.present is set when channel n was measured in this
+// sample.
+enum {
+    SENSOR_CH_TEMPERATURE,
+    SENSOR_CH_PRESSURE,
+    SENSOR_CH_EXTERIOR_TEMPERATURE,
+    SENSOR_CH_EXTERIOR_HUMIDITY,
+    SENSOR_CH_BATTERY_VOLTAGE,
+    SENSOR_CH_BATTERY_CURRENT,
+    SENSOR_CH_BATTERY_POWER,
+    SENSOR_CH_SOLAR_VOLTAGE,
+    SENSOR_CH_SOLAR_CURRENT,
+    SENSOR_CH_SOLAR_POWER,
+    SENSOR_CH_SAMPLE_INTERVAL,
+    SENSOR_CH_TX_INTERVAL,
+    SENSOR_CH_COUNT
+};
+
+#define SENSOR_BIT(ch) (1u << (ch))
+
+// Spread of a channel over one report interval, see sensor_stats.h
+typedef struct {
+    float min;
+    float max;
+    float stddev;
+} SensorSpread;
+
 typedef struct {
     float temperature;
     float pressure;
@@ -31,9 +94,108 @@ typedef struct {
     float solar_voltage;
     float solar_current;
     float solar_power;
+    float sample_interval; // Scheduler intervals in effect, seconds
+    float tx_interval;
+    uint16_t present; // SENSOR_BIT() mask of valid channels
+    uint16_t spread_present; // SENSOR_BIT() mask of channels with spread[] filled
+    SensorSpread spread[SENSOR_CH_COUNT];
 } SensorData;
 
+// SensorSpread in wire units
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t stddev;
+} SensorSpreadFixed;
+
+// Integer pipeline: the same channels scaled to their wire units (packet.c
+// packet_schema), so drivers to encoder run without soft-float. Floats only
+// appear where a receiver decodes the packet.
+typedef struct {
+    int32_t temperature;          // 0.01 DegC
+    int32_t pressure;             // 0.1 hPa, sea level
+    int32_t exterior_temperature; // 0.01 DegC
+    int32_t exterior_humidity;    // 0.01 %RH
+    int32_t battery_voltage;      // mV
+    int32_t battery_current;      // 0.1 mA
+    int32_t battery_power;        // mW
+    int32_t solar_voltage;        // mV
+    int32_t solar_current;        // 0.1 mA
+    int32_t solar_power;          // mW
+    int32_t sample_interval;      // s
+    int32_t tx_interval;          // s
+    uint16_t present; // SENSOR_BIT() mask of valid channels
+    uint16_t spread_present; // SENSOR_BIT() mask of channels with spread[] filled
+    SensorSpreadFixed spread[SENSOR_CH_COUNT];
+} SensorDataFixed;
+
+// Channel to field. Loops over channels go through these rather than
+// walking the structs from their first field.
+static const uint8_t sensor_channel_offset[SENSOR_CH_COUNT] = {
+    [SENSOR_CH_TEMPERATURE]          = offsetof(SensorData, temperature),
+    [SENSOR_CH_PRESSURE]             = offsetof(SensorData, pressure),
+    [SENSOR_CH_EXTERIOR_TEMPERATURE] = offsetof(SensorData, exterior_temperature),
+    [SENSOR_CH_EXTERIOR_HUMIDITY]    = offsetof(SensorData, exterior_humidity),
+    [SENSOR_CH_BATTERY_VOLTAGE]      = offsetof(SensorData, battery_voltage),
+    [SENSOR_CH_BATTERY_CURRENT]      = offsetof(SensorData, battery_current),
+    [SENSOR_CH_BATTERY_POWER]        = offsetof(SensorData, battery_power),
+    [SENSOR_CH_SOLAR_VOLTAGE]        = offsetof(SensorData, solar_voltage),
+    [SENSOR_CH_SOLAR_CURRENT]        = offsetof(SensorData, solar_current),
+    [SENSOR_CH_SOLAR_POWER]          = offsetof(SensorData, solar_power),
+    [SENSOR_CH_SAMPLE_INTERVAL]      = offsetof(SensorData, sample_interval),
+    [SENSOR_CH_TX_INTERVAL]          = offsetof(SensorData, tx_interval),
+};
+static const uint8_t sensor_fixed_channel_offset[SENSOR_CH_COUNT] = {
+    [SENSOR_CH_TEMPERATURE]          = offsetof(SensorDataFixed, temperature),
+    [SENSOR_CH_PRESSURE]             = offsetof(SensorDataFixed, pressure),
+    [SENSOR_CH_EXTERIOR_TEMPERATURE] = offsetof(SensorDataFixed, exterior_temperature),
+    [SENSOR_CH_EXTERIOR_HUMIDITY]    = offsetof(SensorDataFixed, exterior_humidity),
+    [SENSOR_CH_BATTERY_VOLTAGE]      = offsetof(SensorDataFixed, battery_voltage),
+    [SENSOR_CH_BATTERY_CURRENT]      = offsetof(SensorDataFixed, battery_current),
+    [SENSOR_CH_BATTERY_POWER]        = offsetof(SensorDataFixed, battery_power),
+    [SENSOR_CH_SOLAR_VOLTAGE]        = offsetof(SensorDataFixed, solar_voltage),
+    [SENSOR_CH_SOLAR_CURRENT]        = offsetof(SensorDataFixed, solar_current),
+    [SENSOR_CH_SOLAR_POWER]          = offsetof(SensorDataFixed, solar_power),
+    [SENSOR_CH_SAMPLE_INTERVAL]      = offsetof(SensorDataFixed, sample_interval),
+    [SENSOR_CH_TX_INTERVAL]          = offsetof(SensorDataFixed, tx_interval),
+};
+
+static inline float sensor_value(const SensorData *data, uint8_t ch) {
+    float value;
+    memcpy(&value, (const uint8_t *)data + sensor_channel_offset[ch], sizeof(value));
+    return value;
+}
+
+static inline void sensor_set_value(SensorData *data, uint8_t ch, float value) {
+    memcpy((uint8_t *)data + sensor_channel_offset[ch], &value, sizeof(value));
+}
+
+static inline int32_t sensor_fixed_value(const SensorDataFixed *data, uint8_t ch) {
+    int32_t value;
+    memcpy(&value, (const uint8_t *)data + sensor_fixed_channel_offset[ch], sizeof(value));
+    return value;
+}
+
+static inline void sensor_fixed_set_value(SensorDataFixed *data, uint8_t ch, int32_t value) {
+    memcpy((uint8_t *)data + sensor_fixed_channel_offset[ch], &value, sizeof(value));
+}
+
+// Build with -DSTATION_FIXED_PIPELINE=1 to run the station on SensorDataFixed
+// from the drivers (sensors_read_all_fixed) through the statistics,
+// scheduler, TX filter and encoder to the radio and the sample log, the
+// _fixed variants of each.
+#ifndef STATION_FIXED_PIPELINE
+#define STATION_FIXED_PIPELINE 0
+#endif
+
 void sensors_init(void);
 SensorData sensors_read_all(void);
+SensorDataFixed sensors_read_all_fixed(void);
+uint32_t sensors_cycle_bound_us(void);
+float calculate_sea_level_pressure(float pressure, float altitude);
+// Sea level reduction for a station altitude, sensors_init sets STATION_ALTITUDE_M
+void sensors_set_altitude(float altitude_m);
+float convert_pressure_to_sea_level(float measured_pressure);
+int32_t convert_pressure_to_sea_level_fixed(uint32_t measured_pressure);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "spsc_queue.h"
+#include <string.h>
+
+// head and tail run freely and wrap at 2^32; the slot index is taken with
+// the mask, so head - tail is always the fill level.
+
+bool spsc_queue_init(SpscQueue *queue, void *storage, uint32_t element_size, uint32_t capacity) {
+    if (queue == NULL || storage == NULL || element_size == 0 ||
+        capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+    queue->storage = (uint8_t *)storage;
+    queue->element_size = element_size;
+    queue->mask = capacity - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->overruns, 0);
+    atomic_init(&queue->high_watermark, 0);
+    return true;
+}
+
+// Producer side. Returns false and counts an overrun if the ring is full.
+bool spsc_queue_push(SpscQueue *queue, const void *element) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    uint32_t depth = head - tail;
+
+    if (depth > queue->mask) {
+        uint32_t overruns = atomic_load_explicit(&queue->overruns, memory_order_relaxed);
+        atomic_store_explicit(&queue->overruns, overruns + 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(&queue->storage[(head & queue->mask) * queue->element_size], element, queue->element_size);
+    // Publish the element before the new head becomes visible to the consumer
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    if (depth + 1 > atomic_load_explicit(&queue->high_watermark, memory_order_relaxed)) {
+        atomic_store_explicit(&queue->high_watermark, depth + 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+// Consumer side. Returns false if the ring is empty.
+bool spsc_queue_pop(SpscQueue *queue, void *element) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    memcpy(element, &queue->storage[(tail & queue->mask) * queue->element_size], queue->element_size);
+    // Release the slot only after the copy is done
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Snapshot of the fill level, safe to call from either side
+uint32_t spsc_queue_depth(SpscQueue *queue) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    return head - tail;
+}
+
+uint32_t spsc_queue_capacity(const SpscQueue *queue) {
+    return queue->mask + 1;
+}
+
+uint32_t spsc_queue_overruns(SpscQueue *queue) {
+    return atomic_load_explicit(&queue->overruns, memory_order_relaxed);
+}
+
+uint32_t spsc_queue_high_watermark(SpscQueue *queue) {
+    return atomic_load_explicit(&queue->high_watermark, memory_order_relaxed);
+}
@@ -0,0 +1,30 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bounded lock-free single-producer/single-consumer ring.
+// Exactly one context may push and exactly one other context may pop
+// (e.g. core 0 and core 1, or an IRQ handler and the main loop).
+// Storage is supplied by the caller; capacity must be a power of two.
+typedef struct {
+    uint8_t *storage;
+    uint32_t element_size;
+    uint32_t mask;              // capacity - 1
+    _Atomic uint32_t head;      // next slot to write, owned by the producer
+    _Atomic uint32_t tail;      // next slot to read, owned by the consumer
+    _Atomic uint32_t overruns;  // pushes rejected because the ring was full
+    _Atomic uint32_t high_watermark; // deepest fill level seen by the producer
+} SpscQueue;
+
+bool spsc_queue_init(SpscQueue *queue, void *storage, uint32_t element_size, uint32_t capacity);
+bool spsc_queue_push(SpscQueue *queue, const void *element);
+bool spsc_queue_pop(SpscQueue *queue, void *element);
+uint32_t spsc_queue_depth(SpscQueue *queue);
+uint32_t spsc_queue_capacity(const SpscQueue *queue);
+uint32_t spsc_queue_overruns(SpscQueue *queue);
+uint32_t spsc_queue_high_watermark(SpscQueue *queue);
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,23 @@
+#include "test.h"
+#include "sensors.h"
+
+int test_failures;
+
+#define TEST_SHUNT_OHMS 0.1f
+
+void test_station_models(StationModels *models) {
+    hal_host_reset();
+    bmp280_model_init(&models->bmp280, BMP280_I2C_ADDRESS);
+    sht40_model_init(&models->sht40, SHT40_I2C_ADDRESS);
+    ina219_model_init(&models->solar, INA219_I2C_ADDRESS, TEST_SHUNT_OHMS);
+    ina219_model_init(&models->battery, INA219_BATTERY_I2C_ADDRESS, TEST_SHUNT_OHMS);
+    hal_host_i2c_attach(BMP280_BUS, &models->bmp280.device);
+    hal_host_i2c_attach(SHT40_BUS, &models->sht40.device);
+    hal_host_i2c_attach(INA219_SOLAR_BUS, &models->solar.device);
+    hal_host_i2c_attach(INA219_BATTERY_BUS, &models->battery.device);
+}
+
+int test_result(const char *name) {
+    printf("%s: %s (%d failed checks)\n", name, test_failures ? "FAIL" : "PASS", test_failures);
+    return test_failures ? 1 : 0;
+}
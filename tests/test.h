@@ -0,0 +1,41 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include "hal_host.h"
+#include "sensor_models.h"
+
+// Host tests: plain programs run by CTest, a failed CHECK prints where and
+// the program exits non-zero from test_result().
+
+extern int test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) do { \
+        double check_value = (value), check_expected = (expected); \
+        if (!(check_value >= check_expected - (tolerance) && check_value <= check_expected + (tolerance))) { \
+            printf("%s:%d: %s = %g, expected %g +- %g\n", __FILE__, __LINE__, #value, check_value, \
+                   check_expected, (double)(tolerance)); \
+            test_failures++; \
+        } \
+    } while (0)
+
+// The station's sensors as wired in sensors.h
+typedef struct {
+    Bmp280Model bmp280;
+    Sht40Model sht40;
+    Ina219Model solar;
+    Ina219Model battery;
+} StationModels;
+
+// Fresh virtual time and HAL, sensor models attached to their buses
+void test_station_models(StationModels *models);
+int test_result(const char *name);
+
+#endif // TEST_H
@@ -0,0 +1,110 @@
+// The benchmark suite of bench.c on the simulated buses: bench_run against
+// the sensor and CC1101 models, its CSV captured and checked for the stages
+// and their breakdown, then passed on to the test output so runs can be
+// diffed.
+#include "test.h"
+#include "bench.h"
+#include "sensors.h"
+#include "BMP280.h"
+#include "cc1101_model.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    char name[64];
+    unsigned long count, min_us, p50_us, p99_us, max_us;
+} BenchRow;
+
+static BenchRow rows[80];
+static int row_count;
+static bool ended;
+// The bench,power_model line
+static unsigned long charge_uc, charge_no_power_down_uc;
+static char measured[8];
+
+static const BenchRow *row(const char *name) {
+    for (int i = 0; i < row_count; i++) {
+        if (strcmp(rows[i].name, name) == 0) {
+            return &rows[i];
+        }
+    }
+    printf("missing row %s\n", name);
+    test_failures++;
+    static const BenchRow none;
+    return &none;
+}
+
+static void parse(FILE *csv) {
+    char line[256];
+    while (fgets(line, sizeof(line), csv) != NULL) {
+        fputs(line, stdout);
+        BenchRow parsed;
+        if (strcmp(line, "bench,end\n") == 0) {
+            ended = true;
+        } else if (strncmp(line, "bench,power_model,", 18) == 0 && strstr(line, "charge_uc=") != NULL) {
+            sscanf(strstr(line, "charge_uc="), "charge_uc=%lu,charge_no_power_down_uc=%lu,measured=%7[a-z]",
+                   &charge_uc, &charge_no_power_down_uc, measured);
+        } else if (sscanf(line, "bench,%63[^,],%lu,%lu,%lu,%lu,%lu", parsed.name, &parsed.count, &parsed.min_us,
+                          &parsed.p50_us, &parsed.p99_us, &parsed.max_us) == 6 &&
+                   row_count < (int)(sizeof(rows) / sizeof(rows[0]))) {
+            rows[row_count++] = parsed;
+        }
+    }
+}
+
+static void test_bench_run(void) {
+    StationModels models;
+    test_station_models(&models);
+    cc1101_model_init();
+
+    // bench_run reports on stdout, run it into a file
+    FILE *csv = tmpfile();
+    CHECK(csv != NULL);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(csv), STDOUT_FILENO);
+    bench_run();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    rewind(csv);
+    parse(csv);
+    fclose(csv);
+
+    CHECK(ended);
+    for (int i = 0; i < row_count; i++) {
+        const BenchRow *r = &rows[i];
+        if (!(r->min_us <= r->p50_us && r->p50_us <= r->p99_us && r->p99_us <= r->max_us)) {
+            printf("row %s out of order\n", r->name);
+            test_failures++;
+        }
+    }
+
+    const BenchRow *cycle = row("sensors_read_all_quiet");
+    CHECK(cycle->count == BENCH_ITERATIONS);
+    // The slowest conversion bounds the cycle, the bus and sleep rows explain most of it
+    CHECK(cycle->min_us >= BMP280_MEASURE_TIME_US && cycle->max_us < BMP280_MEASURE_TIME_US + 3000);
+    CHECK(row("sensors_read_all_quiet.i2c")->p50_us > 0);
+    CHECK(row("sensors_read_all_quiet.sleep")->p50_us > 0);
+    CHECK(row("sensors_read_all_100khz.i2c")->p50_us >= row("sensors_read_all_quiet.i2c")->p50_us);
+    CHECK(row("sensors_read_all.bound")->p50_us > 0);
+    // Both pipelines on the same bus path, the bus and sleep rows match
+    CHECK(row("sensors_read_all_fixed.i2c")->p50_us == row("sensors_read_all_quiet.i2c")->p50_us);
+    CHECK(row("sensors_read_all_fixed.sleep")->p50_us == row("sensors_read_all_quiet.sleep")->p50_us);
+    CHECK(row("sensors_init_full")->p50_us > row("sensors_init_fast")->p50_us);
+    CHECK(row("radio_send_data.spi")->p50_us > 0);
+    CHECK(row("bmp280_read_data.i2c")->max_us < 1000);
+    CHECK(row("packet_encode.cycles")->count == BENCH_ITERATIONS);
+    CHECK(row("log_tokenized.cycles")->count == BENCH_ITERATIONS);
+    CHECK(row("log_text.cycles")->count == BENCH_ITERATIONS);
+
+    // A modelled estimate, labelled as such: the power-down only ever lowers it
+    CHECK(charge_uc > 0 && charge_uc < charge_no_power_down_uc);
+    CHECK(strcmp(measured, "no") == 0);
+}
+
+int main(void) {
+    test_bench_run();
+    return test_result("test_bench");
+}
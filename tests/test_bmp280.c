@@ -0,0 +1,93 @@
+// BMP280 sample read: the original access pattern (temperature and pressure
+// as two register reads, 20 ms of sleep before the pointer write and again
+// before the read) against the single 0xF7..0xFC burst of bmp280_read_data,
+// both on the register model at 100 kHz.
+#include "test.h"
+#include "sensors.h"
+#include "BMP280.h"
+
+#define OLD_SETTLE_MS 20
+
+// bmp280_read_reg as it was: pointer write with a stop, sleep, read
+static void old_read_reg(uint8_t reg, uint8_t *dst, size_t length) {
+    hal_sleep_ms(OLD_SETTLE_MS);
+    CHECK(hal_i2c_write(BMP280_BUS, BMP280_I2C_ADDRESS, &reg, 1, false) == 1);
+    hal_sleep_ms(OLD_SETTLE_MS);
+    CHECK(hal_i2c_read(BMP280_BUS, BMP280_I2C_ADDRESS, dst, length, false) == (int)length);
+}
+
+static void measure(bmp280 *device) {
+    CHECK(bmp280_start_measurement(device));
+    hal_sleep_us(BMP280_MEASURE_TIME_US);
+}
+
+static void test_burst_read(void) {
+    StationModels models;
+    test_station_models(&models);
+    hal_i2c_init(BMP280_BUS, I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ_HZ);
+    bmp280 device;
+    CHECK(bmp280_init(&device, BMP280_BUS, BMP280_I2C_ADDRESS) == 1);
+    bmp280_calibrate(&device);
+
+    HalBusStats before, after;
+    measure(&device);
+    hal_get_i2c_stats(BMP280_BUS, &before);
+    uint64_t start_us = hal_time_us();
+    uint8_t temperature[3], pressure[3];
+    old_read_reg(BMP280_TEMPERATURE_REG_LOW, temperature, sizeof(temperature));
+    old_read_reg(BMP280_PRESSURE_REG_LOW, pressure, sizeof(pressure));
+    uint32_t old_us = (uint32_t)(hal_time_us() - start_us);
+    hal_get_i2c_stats(BMP280_BUS, &after);
+    uint32_t old_transactions = after.transactions - before.transactions;
+
+    measure(&device);
+    hal_get_i2c_stats(BMP280_BUS, &before);
+    start_us = hal_time_us();
+    CHECK(bmp280_read_data(&device));
+    uint32_t new_us = (uint32_t)(hal_time_us() - start_us);
+    hal_get_i2c_stats(BMP280_BUS, &after);
+    uint32_t new_transactions = after.transactions - before.transactions;
+    uint32_t new_busy_us = (uint32_t)(after.busy_us - before.busy_us);
+
+    printf("old: %lu us per sample, %lu transactions\n", (unsigned long)old_us, (unsigned long)old_transactions);
+    printf("new: %lu us per sample (%lu us busy), %lu transactions\n", (unsigned long)new_us,
+           (unsigned long)new_busy_us, (unsigned long)new_transactions);
+    CHECK(old_us >= 4 * OLD_SETTLE_MS * 1000);
+    CHECK(new_us < 1000 && new_busy_us <= new_us);
+    // The burst is one repeated-start transfer, counted as its write and read
+    CHECK(old_transactions == 4 && new_transactions == 2);
+
+    // Both ADC values from the same conversion, datasheet example
+    CHECK_NEAR(device.temperature, 25.08, 0.01);
+    CHECK_NEAR(device.pressure_fixed / 256.0, 100653.27, 4.0); // 32 bit kernel: 1 Pa steps
+    CHECK(device.temperature_fixed == 2508);
+}
+
+// t_fine comes from the same burst: a new temperature moves the pressure
+// result in the same read
+static void test_fresh_t_fine(void) {
+    StationModels models;
+    test_station_models(&models);
+    hal_i2c_init(BMP280_BUS, I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ_HZ);
+    bmp280 device;
+    CHECK(bmp280_init(&device, BMP280_BUS, BMP280_I2C_ADDRESS) == 1);
+    bmp280_calibrate(&device);
+
+    measure(&device);
+    CHECK(bmp280_read_data(&device));
+    int32_t t_fine = device.t_fine;
+    float pressure = device.pressure;
+
+    bmp280_model_set_adc(&models.bmp280, 560000, 415148);
+    measure(&device);
+    CHECK(bmp280_read_data(&device));
+    CHECK(device.t_fine > t_fine);
+    CHECK(device.pressure != pressure);
+    CHECK(models.bmp280.conversions == 2);
+}
+
+int main(void) {
+    test_burst_read();
+    test_fresh_t_fine();
+    return test_result("test_bmp280");
+}
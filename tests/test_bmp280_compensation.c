@@ -0,0 +1,120 @@
+// BMP280 pressure compensation kernels against the datasheet's double
+// precision formula: bmp280_compensate_pressure_int64 and _int32 over the
+// whole 20 bit pressure ADC range at temperatures across the operating range
+// (-40 .. 85 DegC), for two calibration sets. Inside the specified pressure
+// range (300 .. 1100 hPa) both have to stay inside the 10 Pa step of the
+// packet; outside it the error is reported only (past 1677 hPa Q24.8 wraps).
+#include "test.h"
+#include "BMP280.h"
+#include <math.h>
+
+#define ADC_P_STRIDE 7 // Odd, so every low bit pattern comes up
+#define T_STEPS 26     // -40 .. 85 DegC in 5 DegC steps
+#define P_MIN_PA 30000.0
+#define P_MAX_PA 110000.0
+
+typedef struct {
+    const char *name;
+    int16_t dig_p[9]; // dig_P1 (unsigned) .. dig_P9
+} Calibration;
+
+static const Calibration calibrations[] = {
+    // The datasheet example, also what the register model reports
+    {"datasheet", {(int16_t)36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000}},
+    // Other magnitudes and signs on P4..P6, P8 and P9
+    {"second set", {(int16_t)38462, -10541, 3024, 6543, -141, -7, 15500, -14600, 9000}},
+};
+
+// Datasheet section 8.1, double precision with the same t_fine
+static double reference_pa(const bmp280 *device, int32_t adc_p) {
+    double var1 = device->t_fine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * device->dig_P6 / 32768.0;
+    var2 = var2 + var1 * device->dig_P5 * 2.0;
+    var2 = var2 / 4.0 + device->dig_P4 * 65536.0;
+    var1 = (device->dig_P3 * var1 * var1 / 524288.0 + device->dig_P2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * device->dig_P1;
+    if (var1 == 0.0) {
+        return 0.0;
+    }
+    double p = 1048576.0 - adc_p;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = device->dig_P9 * p * p / 2147483648.0;
+    var2 = p * device->dig_P8 / 32768.0;
+    return p + (var1 + var2 + device->dig_P7) / 16.0;
+}
+
+typedef struct {
+    double worst_pa; // Largest error inside the specified range
+    double worst_outside_pa;
+    uint32_t checked;
+} KernelError;
+
+static void track(KernelError *error, double value_pa, double reference, bool inside) {
+    double difference = fabs(value_pa - reference);
+    if (inside) {
+        error->checked++;
+        if (difference > error->worst_pa) {
+            error->worst_pa = difference;
+        }
+    } else if (difference > error->worst_outside_pa) {
+        error->worst_outside_pa = difference;
+    }
+}
+
+static void sweep(const Calibration *calibration) {
+    bmp280 device = {0};
+    device.dig_P1 = (uint16_t)calibration->dig_p[0];
+    device.dig_P2 = calibration->dig_p[1];
+    device.dig_P3 = calibration->dig_p[2];
+    device.dig_P4 = calibration->dig_p[3];
+    device.dig_P5 = calibration->dig_p[4];
+    device.dig_P6 = calibration->dig_p[5];
+    device.dig_P7 = calibration->dig_p[6];
+    device.dig_P8 = calibration->dig_p[7];
+    device.dig_P9 = calibration->dig_p[8];
+
+    KernelError int64_error = {0}, int32_error = {0};
+    for (int step = 0; step < T_STEPS; step++) {
+        // t_fine is DegC * 5120
+        device.t_fine = (-40 + 5 * step) * 5120;
+        for (int32_t adc_p = 0; adc_p < (1 << 20); adc_p += ADC_P_STRIDE) {
+            double reference = reference_pa(&device, adc_p);
+            bool inside = reference >= P_MIN_PA && reference <= P_MAX_PA;
+            track(&int64_error, bmp280_compensate_pressure_int64(&device, adc_p) / 256.0, reference, inside);
+            track(&int32_error, bmp280_compensate_pressure_int32(&device, adc_p) / 256.0, reference, inside);
+        }
+    }
+
+    printf("%s: %lu samples in 300..1100 hPa, worst error int64 %.3f Pa, int32 %.3f Pa; "
+           "outside the range int64 %.0f Pa, int32 %.0f Pa\n", calibration->name,
+           (unsigned long)int64_error.checked, int64_error.worst_pa, int32_error.worst_pa,
+           int64_error.worst_outside_pa, int32_error.worst_outside_pa);
+    CHECK(int64_error.checked == int32_error.checked && int64_error.checked > 0);
+    // The 64 bit kernel is good to its 1/256 Pa steps. The 32 bit one divides
+    // by a term quantized to about 1/dig_P1, a few Pa at sea level; still
+    // below the 10 Pa steps the packet carries.
+    CHECK(int64_error.worst_pa < 0.1);
+    CHECK(int32_error.worst_pa < 6.0);
+}
+
+static void test_compensation(void) {
+    for (size_t i = 0; i < sizeof(calibrations) / sizeof(calibrations[0]); i++) {
+        sweep(&calibrations[i]);
+    }
+}
+
+// The datasheet's worked example (section 3.12): 25.08 DegC, 100653.27 Pa
+static void test_datasheet_example(void) {
+    bmp280 device = {.dig_P1 = 36477, .dig_P2 = -10685, .dig_P3 = 3024, .dig_P4 = 2855, .dig_P5 = 140,
+                     .dig_P6 = -7, .dig_P7 = 15500, .dig_P8 = -14600, .dig_P9 = 6000, .t_fine = 128422};
+    CHECK_NEAR(reference_pa(&device, 415148), 100653.27, 0.05);
+    CHECK_NEAR(bmp280_compensate_pressure_int64(&device, 415148) / 256.0, 100653.27, 0.05);
+    CHECK_NEAR(bmp280_compensate_pressure_int32(&device, 415148) / 256.0, 100653.27, 6.0);
+    CHECK((bmp280_compensate_pressure_int32(&device, 415148) & 0xFF) == 0);
+}
+
+int main(void) {
+    test_datasheet_example();
+    test_compensation();
+    return test_result("test_bmp280_compensation");
+}
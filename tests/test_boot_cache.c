@@ -0,0 +1,164 @@
+// The flash boot cache on its own and through sensors_init: a second boot
+// with the same devices takes the fast path and keeps the cached BMP280
+// calibration; a changed device inventory, a corrupt payload or one of an
+// older layout fall back to the full probe, which writes the cache again.
+// Flash survives the simulated reboots, the rest of the host HAL does not.
+#include "test.h"
+#include "sensors.h"
+#include "boot_cache.h"
+#include "BMP280.h"
+#include <string.h>
+
+// Driver state owned by sensors.c
+extern bmp280 bmp;
+
+typedef struct {
+    uint32_t i2c_transactions;
+    uint32_t flash_writes;
+    uint16_t dig_T1;
+} BootResult;
+
+static uint8_t saved_sector[HAL_FLASH_SECTOR_SIZE];
+
+// Power cycle: fresh HAL and models, the cache sector kept. The BMP280
+// carries a dig_T1 of its own, so a calibration read shows up in the result.
+static void reboot(StationModels *models, bool sht40_attached, uint16_t dig_T1) {
+    memcpy(saved_sector, hal_host_flash() + BOOT_CACHE_FLASH_OFFSET, sizeof(saved_sector));
+    test_station_models(models);
+    memcpy(hal_host_flash() + BOOT_CACHE_FLASH_OFFSET, saved_sector, sizeof(saved_sector));
+    if (!sht40_attached) {
+        models->sht40.device.addr = 0x7F; // Off the bus, nothing answers at its address
+    }
+    models->bmp280.calibration[0] = (int16_t)dig_T1;
+    models->bmp280.regs[BMP280_CALIBRATION_REG] = (uint8_t)dig_T1;
+    models->bmp280.regs[BMP280_CALIBRATION_REG + 1] = (uint8_t)(dig_T1 >> 8);
+}
+
+static BootResult boot(void) {
+    HalBusStats i2c0, i2c1, flash;
+    sensors_init();
+    hal_get_i2c_stats(HAL_I2C0, &i2c0);
+    hal_get_i2c_stats(HAL_I2C1, &i2c1);
+    hal_get_flash_stats(&flash);
+    return (BootResult){i2c0.transactions + i2c1.transactions, flash.transactions, bmp.dig_T1};
+}
+
+// The full path scans both buses, a hundred and more probes
+#define FULL_PROBE_MIN_TRANSACTIONS 200
+
+static void check_full(const BootResult *result, uint16_t dig_T1) {
+    CHECK(result->i2c_transactions >= FULL_PROBE_MIN_TRANSACTIONS);
+    CHECK(result->dig_T1 == dig_T1);
+    CHECK(result->flash_writes == 2); // Erase and program
+}
+
+static void check_fast(const BootResult *result, uint16_t cached_dig_T1) {
+    CHECK(result->i2c_transactions < FULL_PROBE_MIN_TRANSACTIONS / 4);
+    CHECK(result->dig_T1 == cached_dig_T1);
+    CHECK(result->flash_writes == 0);
+}
+
+static void test_store_load(void) {
+    hal_host_reset();
+    uint8_t payload[32], loaded[32];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 37 + 1);
+    }
+    CHECK(!boot_cache_load(1, loaded, sizeof(loaded))); // Erased flash
+    CHECK(boot_cache_store(1, payload, sizeof(payload)));
+    memset(loaded, 0, sizeof(loaded));
+    CHECK(boot_cache_load(1, loaded, sizeof(loaded)) && memcmp(loaded, payload, sizeof(payload)) == 0);
+    CHECK(!boot_cache_load(2, loaded, sizeof(loaded)));
+    CHECK(!boot_cache_load(1, loaded, sizeof(loaded) - 1));
+    CHECK(!boot_cache_store(1, payload, BOOT_CACHE_MAX_PAYLOAD + 1));
+
+    // The same payload again costs no erase
+    HalBusStats before, after;
+    hal_get_flash_stats(&before);
+    CHECK(boot_cache_store(1, payload, sizeof(payload)));
+    hal_get_flash_stats(&after);
+    CHECK(after.transactions == before.transactions);
+
+    // Any flipped payload bit fails the CRC, the caller's buffer is untouched
+    for (size_t bit = 0; bit < sizeof(payload) * 8; bit += 13) {
+        uint8_t *stored = hal_host_flash() + BOOT_CACHE_FLASH_OFFSET + BOOT_CACHE_HEADER_SIZE;
+        stored[bit / 8] ^= 1u << (bit % 8);
+        memset(loaded, 0xA5, sizeof(loaded));
+        CHECK(!boot_cache_load(1, loaded, sizeof(loaded)) && loaded[0] == 0xA5);
+        stored[bit / 8] ^= 1u << (bit % 8);
+    }
+    CHECK(boot_cache_erase() && !boot_cache_load(1, loaded, sizeof(loaded)));
+}
+
+static void test_hit(void) {
+    StationModels models;
+    test_station_models(&models);
+    reboot(&models, true, 27504);
+    BootResult first = boot();
+    check_full(&first, 27504);
+
+    // Recalibrated chip, same inventory: the cached coefficients are used
+    reboot(&models, true, 27000);
+    BootResult second = boot();
+    check_fast(&second, 27504);
+    printf("boot: full %lu I2C transactions, fast %lu\n", (unsigned long)first.i2c_transactions,
+           (unsigned long)second.i2c_transactions);
+}
+
+// A device missing or added since the cache was written
+static void test_inventory_changed(void) {
+    StationModels models;
+    reboot(&models, false, 27100);
+    BootResult missing = boot();
+    check_full(&missing, 27100);
+    // The cache now describes the smaller inventory
+    reboot(&models, false, 27200);
+    BootResult again = boot();
+    check_fast(&again, 27100);
+
+    reboot(&models, true, 27300);
+    BootResult back = boot();
+    check_full(&back, 27300);
+}
+
+// Each way a cache can go bad ends in a full probe that writes it afresh
+static void test_corrupt_or_stale(void) {
+    StationModels models;
+    uint8_t *sector = hal_host_flash() + BOOT_CACHE_FLASH_OFFSET;
+
+    // A bit flipped in the calibration bytes
+    sector[BOOT_CACHE_HEADER_SIZE + 8] ^= 0x10;
+    reboot(&models, true, 27400);
+    BootResult corrupt = boot();
+    check_full(&corrupt, 27400);
+    reboot(&models, true, 27401);
+    BootResult rewritten = boot();
+    check_fast(&rewritten, 27400);
+
+    // The same bytes under an older layout version
+    uint16_t length;
+    memcpy(&length, sector + 6, sizeof(length));
+    uint8_t payload[BOOT_CACHE_MAX_PAYLOAD];
+    memcpy(payload, sector + BOOT_CACHE_HEADER_SIZE, length);
+    CHECK(boot_cache_store(0, payload, length));
+    reboot(&models, true, 27500);
+    BootResult stale = boot();
+    check_full(&stale, 27500);
+
+    // Power lost between the erase and the program
+    CHECK(boot_cache_erase());
+    reboot(&models, true, 27600);
+    BootResult erased = boot();
+    check_full(&erased, 27600);
+    reboot(&models, true, 27601);
+    BootResult last = boot();
+    check_fast(&last, 27600);
+}
+
+int main(void) {
+    test_store_load();
+    test_hit();
+    test_inventory_changed();
+    test_corrupt_or_stale();
+    return test_result("test_boot_cache");
+}
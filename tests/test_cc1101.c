@@ -0,0 +1,194 @@
+// The GDO0 state machine in cc1101.c against the register model: GDO0 edges
+// and timeout alarms arrive as interrupts on the virtual clock. Covers
+// one-shot and continuous receive, the per-state timeouts including a
+// stalled FIFO burst, the receive calls that must be refused, and the
+// station address radio_init derives from the board ID.
+#include "test.h"
+#include "radio.h"
+#include "cc1101.h"
+#include "cc1101_model.h"
+#include <string.h>
+
+#define TEST_PAYLOAD 20 // Above CC1101_DMA_MIN_LENGTH: the FIFOs go through DMA
+
+static CC1101Result last_result;
+static uint8_t last_length;
+static uint8_t last_buffer[CC1101_FIFO_SIZE];
+static uint32_t callbacks;
+
+static void on_done(CC1101Result result, const uint8_t *buffer, uint8_t length) {
+    last_result = result;
+    last_length = length;
+    if (buffer != NULL && length > 0) {
+        memcpy(last_buffer, buffer, length);
+    }
+    callbacks++;
+}
+
+// Frame for this station (radio_init sets the address filter), sync word
+// ending at sync_us
+static uint8_t test_frame(uint8_t *frame, uint8_t address, uint8_t fill) {
+    frame[0] = TEST_PAYLOAD + 1;
+    frame[1] = address;
+    memset(&frame[2], fill, TEST_PAYLOAD);
+    return TEST_PAYLOAD + 2;
+}
+
+static void test_setup(void) {
+    hal_host_reset();
+    cc1101_model_init();
+    radio_init(F_433);
+    callbacks = 0;
+}
+
+static void test_receive_one_shot(void) {
+    test_setup();
+    uint8_t address = cc1101_model_reg(CC1101_ADDR);
+    uint8_t frame[CC1101_FIFO_SIZE];
+    uint8_t length = test_frame(frame, address, 0x5A);
+    cc1101_model_inject(frame, length, hal_time_us() + 2000, true);
+
+    uint8_t buffer[CC1101_FIFO_SIZE];
+    uint8_t received;
+    CHECK(cc1101_receive(buffer, &received, 10000) == CC1101_RESULT_OK);
+    CHECK(received == length + 2);
+    CHECK(memcmp(buffer, frame, length) == 0);
+    CHECK(buffer[received - 1] & CC1101_LQI_CRC_OK);
+    CHECK(cc1101_get_state() == CC1101_STATE_IDLE);
+
+    // Nothing on air: the sync timeout ends it
+    uint64_t start_us = hal_time_us();
+    CHECK(cc1101_receive(buffer, &received, 3000) == CC1101_RESULT_TIMEOUT);
+    CHECK(hal_time_us() - start_us >= 3000 && hal_time_us() - start_us < 3100);
+    CHECK(cc1101_get_state() == CC1101_STATE_IDLE);
+
+    // One-shot without a bound is refused instead of timing out at once
+    CHECK(!cc1101_receive_async(0, on_done));
+    CHECK(cc1101_get_state() == CC1101_STATE_IDLE);
+}
+
+// A packet for another address ends after the one-shot deadline: the
+// relisten finds the deadline passed and the timeout runs right away
+static void test_receive_deadline_passed(void) {
+    test_setup();
+    uint8_t frame[CC1101_FIFO_SIZE];
+    uint8_t length = test_frame(frame, 0x10, 0x00);
+    uint64_t sync_us = hal_time_us() + 1500;
+    cc1101_model_inject(frame, length, sync_us, true);
+    CHECK(cc1101_receive_async(2000, on_done));
+    hal_sleep_us(20000);
+    CHECK(callbacks == 1 && last_result == CC1101_RESULT_TIMEOUT);
+    CHECK(hal_time_us() > sync_us + cc1101_model_frame_us(length));
+    CHECK(cc1101_get_state() == CC1101_STATE_IDLE);
+}
+
+static void test_continuous(void) {
+    test_setup();
+    uint8_t address = cc1101_model_reg(CC1101_ADDR);
+    cc1101_write_reg(CC1101_MCSM1, 0x3C); // RXOFF_MODE = RX
+    CHECK(cc1101_receive_continuous(on_done));
+
+    uint8_t frame[CC1101_FIFO_SIZE];
+    uint8_t length = test_frame(frame, address, 0x11);
+    uint64_t sync_us = hal_time_us() + 2000;
+    uint32_t frame_us = cc1101_model_frame_us(length) + cc1101_model_sync_us() + 200;
+    for (int i = 0; i < 3; i++) {
+        frame[2] = i;
+        cc1101_model_inject(frame, length, sync_us + i * frame_us, true);
+    }
+    hal_sleep_us(100000); // No timeout while waiting for sync in this mode
+    CHECK(callbacks == 3 && last_result == CC1101_RESULT_OK && last_buffer[2] == 2);
+    CHECK(cc1101_get_state() == CC1101_STATE_RX_WAIT_SYNC);
+
+    cc1101_stop_receive();
+    CHECK(cc1101_get_state() == CC1101_STATE_IDLE);
+    CHECK(cc1101_model_marcstate() == 0x01);
+}
+
+// A FIFO burst that never completes is bounded by its state's timeout, the
+// burst is aborted and CS released, the next transfer works again
+static void test_stalled_bursts(void) {
+    test_setup();
+    uint8_t payload[TEST_PAYLOAD] = {0};
+    Cc1101ModelStats radio;
+
+    hal_host_spi_stall(HAL_SPI0, true);
+    uint64_t start_us = hal_time_us();
+    CHECK(cc1101_send_data_async(payload, sizeof(payload), 0x00, on_done));
+    CHECK(cc1101_get_state() == CC1101_STATE_TX_LOAD);
+    while (cc1101_get_state() != CC1101_STATE_IDLE) {
+        hal_wait_event();
+    }
+    CHECK_NEAR(hal_time_us() - start_us, CC1101_TX_LOAD_TIMEOUT_US, 50);
+    CHECK(callbacks == 1 && last_result == CC1101_RESULT_TIMEOUT);
+    CHECK(hal_host_gpio_output(CC1101_CS_PIN));
+
+    hal_host_spi_stall(HAL_SPI0, false);
+    CHECK(cc1101_send_data(payload, sizeof(payload), 0x00));
+    cc1101_model_get_stats(&radio);
+    CHECK(radio.sent == 1);
+
+    // Continuous receive survives a stalled drain and takes the next packet
+    uint8_t address = cc1101_model_reg(CC1101_ADDR);
+    cc1101_write_reg(CC1101_MCSM1, 0x3C);
+    CHECK(cc1101_receive_continuous(on_done));
+    uint8_t frame[CC1101_FIFO_SIZE];
+    uint8_t length = test_frame(frame, address, 0x22);
+    hal_host_spi_stall(HAL_SPI0, true);
+    cc1101_model_inject(frame, length, hal_time_us() + 2000, true);
+    hal_sleep_us(10000);
+    CHECK(callbacks == 2 && last_result == CC1101_RESULT_TIMEOUT);
+    CHECK(cc1101_get_state() == CC1101_STATE_RX_WAIT_SYNC);
+    CHECK(hal_host_gpio_output(CC1101_CS_PIN));
+
+    hal_host_spi_stall(HAL_SPI0, false);
+    cc1101_model_inject(frame, length, hal_time_us() + 2000, true);
+    hal_sleep_us(10000);
+    CHECK(callbacks == 3 && last_result == CC1101_RESULT_OK && last_length == length + 2);
+    cc1101_stop_receive();
+    CHECK(cc1101_get_state() == CC1101_STATE_IDLE);
+}
+
+static uint8_t sent_address;
+
+static void on_station_tx(const uint8_t *frame, uint8_t length, void *context) {
+    sent_address = frame[1];
+}
+
+// radio_init programs an address folded from the board's unique ID, frames go
+// out with it; boards differ, broadcast addresses are never taken
+static void test_station_address(void) {
+    static const uint8_t ids[][HAL_UNIQUE_ID_SIZE] = {
+        {0xE6, 0x60, 0x58, 0x38, 0x83, 0x4B, 0x2A, 0x2F},
+        {0xE6, 0x60, 0x58, 0x38, 0x83, 0x4B, 0x2A, 0x30},
+        {0xE6, 0x61, 0x4C, 0x24, 0x13, 0x77, 0x31, 0x26},
+        {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80}, // Folds to 0xFF
+        {0},                                              // Folds to 0x00
+    };
+    uint8_t addresses[5];
+    for (int i = 0; i < 5; i++) {
+        hal_host_reset();
+        hal_host_set_unique_id(ids[i]);
+        cc1101_model_init();
+        cc1101_model_on_tx(on_station_tx, NULL);
+        radio_init(F_433);
+        addresses[i] = radio_address();
+        CHECK(cc1101_model_reg(CC1101_ADDR) == addresses[i]);
+        SensorData data = {.temperature = 20.0f, .present = SENSOR_BIT(SENSOR_CH_TEMPERATURE)};
+        sent_address = 0;
+        radio_send_data(&data);
+        CHECK(sent_address == addresses[i]);
+        CHECK(addresses[i] != 0x00 && addresses[i] != 0xFF);
+    }
+    CHECK(addresses[0] != addresses[1] && addresses[0] != addresses[2] && addresses[1] != addresses[2]);
+    CHECK(addresses[3] == 0xFE && addresses[4] == 0x01);
+}
+
+int main(void) {
+    test_station_address();
+    test_receive_one_shot();
+    test_receive_deadline_passed();
+    test_continuous();
+    test_stalled_bursts();
+    return test_result("test_cc1101");
+}
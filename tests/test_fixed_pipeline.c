@@ -0,0 +1,357 @@
+// Float and integer sensor pipelines side by side: the same model readings
+// go through sensors_read_all and sensors_read_all_fixed, every channel must
+// land within one wire LSB, and a fixed point sample must decode to what a
+// receiver gets from its frame. Past the drivers the integer statistics,
+// scheduler and TX filter decide as the float ones do on the same samples,
+// and fixed samples reach the air and, unacknowledged, the sample log
+// without a float in between.
+#include "test.h"
+#include "sensors.h"
+#include "packet.h"
+#include "sensor_stats.h"
+#include "scheduler.h"
+#include "tx_filter.h"
+#include "radio.h"
+#include "sample_log.h"
+#include "cc1101_model.h"
+#include "hal.h"
+#include <math.h>
+#include <string.h>
+
+// Wire units per physical unit, as packet_schema in packet.c
+static const float test_scale[SENSOR_CH_COUNT] = {
+    100.0f, 10.0f, 100.0f, 100.0f, 1000.0f, 10000.0f, 1000.0f, 1000.0f, 10000.0f, 1000.0f, 1.0f, 1.0f,
+};
+
+static uint32_t compared;
+static uint32_t worst_lsb_x100[SENSOR_CH_COUNT];
+
+static void compare_at(void) {
+    SensorData data = sensors_read_all();
+    SensorDataFixed fixed = sensors_read_all_fixed();
+    CHECK(data.present == fixed.present);
+
+    // Both as a receiver sees them
+    uint8_t frame[PACKET_MAX_SIZE];
+    uint8_t length = packet_encode(&data, 0, frame, sizeof(frame));
+    SensorData received;
+    CHECK(length > 0 && packet_decode(frame, length, &received));
+    uint8_t fixed_frame[PACKET_MAX_SIZE];
+    uint8_t fixed_length = packet_encode_fixed(&fixed, 0, fixed_frame, sizeof(fixed_frame));
+    SensorData fixed_received, fixed_sample;
+    CHECK(fixed_length > 0 && packet_decode(fixed_frame, fixed_length, &fixed_received));
+    packet_fixed_to_sample(&fixed, &fixed_sample);
+
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (!(data.present & SENSOR_BIT(ch))) {
+            continue;
+        }
+        float lsb = 1.0f / test_scale[ch];
+        float delta = fabsf(sensor_value(&received, ch) - sensor_value(&fixed_received, ch));
+        uint32_t lsb_x100 = (uint32_t)lroundf(delta / lsb * 100.0f);
+        if (lsb_x100 > worst_lsb_x100[ch]) {
+            worst_lsb_x100[ch] = lsb_x100;
+        }
+        CHECK(lsb_x100 <= 100);
+        CHECK(sensor_value(&fixed_sample, ch) == sensor_value(&fixed_received, ch));
+    }
+    compared++;
+}
+
+static void test_sweep(void) {
+    StationModels models;
+    test_station_models(&models);
+    sensors_init();
+
+    for (int step = 0; step <= 40; step++) {
+        models.sht40.temperature = -40.0f + step * 3.0f + 0.013f * step;
+        models.sht40.humidity = step * 2.5f + 0.007f * step;
+        models.battery.bus_voltage = 3.0f + step * 0.03f;
+        models.battery.current = -0.5f + step * 0.0251f;
+        models.solar.bus_voltage = step * 0.5f;
+        models.solar.current = step * 0.01f + 0.00037f * step;
+        // BMP280 raw values from cold and low to hot and high
+        bmp280_model_set_adc(&models.bmp280, 420000 + step * 4000 + step * 37, 280000 + step * 6000 + step * 53);
+        compare_at();
+    }
+
+    printf("compared %lu samples, worst difference in 1/100 LSB:", (unsigned long)compared);
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        printf(" %lu", (unsigned long)worst_lsb_x100[ch]);
+    }
+    printf("\n");
+    CHECK(compared == 41);
+}
+
+// SHT40 raw values over the whole range, temperature and humidity together.
+// A full sensor cycle each, so a stride rather than every value.
+static void test_sht40_range(void) {
+    StationModels models;
+    test_station_models(&models);
+    sensors_init();
+    compared = 0;
+    for (uint32_t ticks = 0; ticks <= 65535; ticks += 61) {
+        models.sht40.temperature = -45.0f + 175.0f * ticks / 65535.0f;
+        models.sht40.humidity = -6.0f + 125.0f * ticks / 65535.0f;
+        compare_at();
+    }
+    printf("SHT40: worst difference %lu/100 LSB temperature, %lu/100 LSB humidity\n",
+           (unsigned long)worst_lsb_x100[SENSOR_CH_EXTERIOR_TEMPERATURE],
+           (unsigned long)worst_lsb_x100[SENSOR_CH_EXTERIOR_HUMIDITY]);
+    CHECK(compared == 65535 / 61 + 1);
+}
+
+// packet_fixed_to_sample clamps like the wire does
+static void test_fixed_to_sample_range(void) {
+    SensorDataFixed fixed = {.temperature = 40000, .pressure = -40000, .solar_power = 1234,
+                             .present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE) |
+                                        SENSOR_BIT(SENSOR_CH_SOLAR_POWER)};
+    SensorData data;
+    packet_fixed_to_sample(&fixed, &data);
+    CHECK(data.present == fixed.present);
+    CHECK_NEAR(data.temperature, 327.67, 1e-3);
+    CHECK_NEAR(data.pressure, -3276.8, 1e-3);
+    CHECK_NEAR(data.solar_power, 1.234, 1e-6);
+    CHECK(data.battery_voltage == 0.0f && data.spread_present == 0);
+}
+
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Noisy readings around a station's values, in wire units
+static SensorDataFixed noisy_sample(void) {
+    static const int32_t base[SENSOR_CH_COUNT] = {2150, 10132, 1234, 6512, 3900, -1200, -470, 5400, 2300, 1240, 10, 30};
+    SensorDataFixed fixed = {.present = SENSOR_BIT(SENSOR_CH_COUNT) - 1};
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        int32_t noise = ch < SENSOR_CH_SAMPLE_INTERVAL ? (int32_t)(rng() % 201) - 100 : 0;
+        sensor_fixed_set_value(&fixed, ch, base[ch] + noise);
+    }
+    return fixed;
+}
+
+// Two reports as a receiver decodes them, within one LSB per value
+static void check_reports(const SensorData *report, const SensorDataFixed *fixed_report) {
+    uint8_t sample_frame[2 * RADIO_MAX_PAYLOAD], fixed_frame[2 * RADIO_MAX_PAYLOAD];
+    SensorData received, fixed_received;
+    uint8_t length = packet_encode_sample(report, sample_frame, sizeof(sample_frame));
+    CHECK(length > 0 && packet_decode_sample(sample_frame, length, &received) == length);
+    uint8_t fixed_length = packet_encode_sample_fixed(fixed_report, fixed_frame, sizeof(fixed_frame));
+    CHECK(fixed_length == length && packet_decode_sample(fixed_frame, fixed_length, &fixed_received) == length);
+
+    CHECK(received.present == fixed_received.present && received.spread_present == fixed_received.spread_present);
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        float lsb = 1.0f / test_scale[ch];
+        CHECK(fabsf(sensor_value(&received, ch) - sensor_value(&fixed_received, ch)) <= lsb * 1.01f);
+        if (fixed_received.spread_present & SENSOR_BIT(ch)) {
+            // Extremes are samples, the same on both sides
+            CHECK(received.spread[ch].min == fixed_received.spread[ch].min);
+            CHECK(received.spread[ch].max == fixed_received.spread[ch].max);
+            CHECK(fabsf(received.spread[ch].stddev - fixed_received.spread[ch].stddev) <= lsb * 1.01f);
+        }
+    }
+}
+
+// Integer statistics against Welford in float on the samples as decoded
+static void test_stats(void) {
+    for (uint32_t samples = 1; samples <= 150; samples += 37) {
+        SensorStats stats;
+        SensorStatsFixed fixed_stats;
+        sensor_stats_reset(&stats);
+        sensor_stats_fixed_reset(&fixed_stats);
+        for (uint32_t i = 0; i < samples; i++) {
+            SensorDataFixed fixed = noisy_sample();
+            SensorData data;
+            packet_fixed_to_sample(&fixed, &data);
+            sensor_stats_add(&stats, &data);
+            sensor_stats_fixed_add(&fixed_stats, &fixed);
+        }
+        SensorData report;
+        SensorDataFixed fixed_report;
+        sensor_stats_report(&stats, &report);
+        sensor_stats_fixed_report(&fixed_stats, &fixed_report);
+        CHECK(fixed_stats.samples == samples);
+        CHECK(fixed_report.spread_present == (samples >= 2 ? STATS_SPREAD_CHANNELS : 0));
+        check_reports(&report, &fixed_report);
+    }
+
+    // Exact rounding: mean of 1 and 2 is 1.5 -> 2, of -1 and -2 -> -2;
+    // stddev of 0, 0, 3 is sqrt(3) -> 2, of 0, 1 is 0.707 -> 1
+    FixedStats channel;
+    fixed_stats_reset(&channel);
+    fixed_stats_add(&channel, 1);
+    fixed_stats_add(&channel, 2);
+    CHECK(fixed_stats_mean(&channel) == 2 && fixed_stats_stddev(&channel) == 1);
+    fixed_stats_reset(&channel);
+    fixed_stats_add(&channel, -1);
+    fixed_stats_add(&channel, -2);
+    CHECK(fixed_stats_mean(&channel) == -2);
+    fixed_stats_reset(&channel);
+    fixed_stats_add(&channel, 0);
+    fixed_stats_add(&channel, 0);
+    fixed_stats_add(&channel, 3);
+    CHECK(fixed_stats_mean(&channel) == 1 && fixed_stats_stddev(&channel) == 2);
+}
+
+// Both schedulers through the battery and solar thresholds, the float one
+// fed what the fixed samples decode to
+static void test_scheduler(void) {
+    Scheduler scheduler, fixed_scheduler;
+    scheduler_init(&scheduler);
+    scheduler_init(&fixed_scheduler);
+    uint32_t transitions = 0;
+    for (int step = 0; step < 2000; step++) {
+        int phase = step % 400 < 200 ? step % 200 : 200 - step % 200;
+        SensorDataFixed fixed = {0};
+        if (step < 1000) {
+            fixed.battery_voltage = 3400 + phase * 2; // 3.4 .. 3.8 V, hitting both thresholds exactly
+            fixed.solar_power = phase * 4;            // 0 .. 800 mW
+            fixed.present = SENSOR_BIT(SENSOR_CH_BATTERY_VOLTAGE) | SENSOR_BIT(SENSOR_CH_SOLAR_POWER);
+        } else {
+            fixed.solar_power = phase / 2;            // 0 .. 100 mW, around the low thresholds
+            fixed.present = SENSOR_BIT(SENSOR_CH_SOLAR_POWER);
+        }
+        SensorData data;
+        packet_fixed_to_sample(&fixed, &data);
+        bool changed = scheduler_update(&scheduler, &data);
+        CHECK(scheduler_update_fixed(&fixed_scheduler, &fixed) == changed);
+        CHECK(fixed_scheduler.state == scheduler.state);
+        CHECK(fixed_scheduler.sample_interval_ms == scheduler.sample_interval_ms);
+        CHECK(fixed_scheduler.tx_interval_ms == scheduler.tx_interval_ms);
+        transitions += changed;
+
+        scheduler_annotate(&scheduler, &data);
+        scheduler_annotate_fixed(&fixed_scheduler, &fixed);
+        SensorData annotated;
+        packet_fixed_to_sample(&fixed, &annotated);
+        CHECK(annotated.present == data.present);
+        CHECK(annotated.sample_interval == data.sample_interval && annotated.tx_interval == data.tx_interval);
+    }
+    CHECK(transitions > 20);
+}
+
+// Deadbands in wire units: a move of exactly the deadband stays quiet
+static void test_tx_filter(void) {
+    TxFilter filter;
+    tx_filter_init(&filter);
+    SensorDataFixed fixed = {.temperature = 2150, .exterior_humidity = 6500, .tx_interval = 30,
+                             .present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY) |
+                                        SENSOR_BIT(SENSOR_CH_TX_INTERVAL)};
+    uint64_t now_us = 1000000;
+    CHECK(tx_filter_check_fixed(&filter, &fixed, now_us)); // First sample
+    fixed.temperature += 20;
+    CHECK(!tx_filter_check_fixed(&filter, &fixed, now_us += 1000000));
+    fixed.temperature += 1;
+    CHECK(tx_filter_check_fixed(&filter, &fixed, now_us += 1000000)); // 0.21 DegC from the reference
+    fixed.exterior_humidity -= 100;
+    CHECK(!tx_filter_check_fixed(&filter, &fixed, now_us += 1000000));
+    fixed.tx_interval = 60; // Zero deadband
+    CHECK(tx_filter_check_fixed(&filter, &fixed, now_us += 1000000));
+    fixed.present &= ~SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY);
+    CHECK(tx_filter_check_fixed(&filter, &fixed, now_us += 1000000));
+    CHECK(!tx_filter_check_fixed(&filter, &fixed, now_us += 1000000));
+    // Heartbeat
+    CHECK(tx_filter_check_fixed(&filter, &fixed, now_us + (uint64_t)TX_FILTER_MAX_SILENCE_MS * 1000));
+    CHECK(filter.sent == 5 && filter.suppressed == 3);
+}
+
+// What went on air, payload after the address byte
+static uint8_t sent_frames[16][RADIO_MAX_PAYLOAD];
+static uint8_t sent_lengths[16];
+static uint32_t sent_count;
+static uint32_t undelivered_count;
+
+static void capture_tx(const uint8_t *frame, uint8_t length, void *context) {
+    if (sent_count < 16) {
+        memcpy(sent_frames[sent_count], &frame[2], frame[0] - 1);
+        sent_lengths[sent_count] = frame[0] - 1;
+    }
+    sent_count++;
+}
+
+// As main.c wires it up on the integer pipeline
+static void log_undelivered(const SensorDataFixed *data, uint64_t queued_us) {
+    undelivered_count++;
+    CHECK(sample_log_append_fixed(data, (uint32_t)(queued_us / 1000)));
+}
+
+static void test_radio_and_log(void) {
+    hal_host_reset();
+    cc1101_model_init();
+    cc1101_model_on_tx(capture_tx, NULL);
+    radio_init(F_433);
+    radio_sleep();
+    SampleLogFlash flash = {.offset = 0, .sectors = 4, .erase = hal_flash_erase, .program = hal_flash_program,
+                            .read = hal_flash_read, .erase_max_us = 400000, .program_max_us = 3000};
+    sample_log_init(&flash);
+    radio_set_undelivered_fixed(log_undelivered);
+
+    SensorStatsFixed stats;
+    sensor_stats_fixed_reset(&stats);
+    for (int i = 0; i < 5; i++) {
+        SensorDataFixed sample = noisy_sample();
+        // Small enough for three to a frame with the spread
+        sample.present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_EXTERIOR_TEMPERATURE);
+        sensor_stats_fixed_add(&stats, &sample);
+    }
+    SensorDataFixed report;
+    sensor_stats_fixed_report(&stats, &report);
+    SensorData expected;
+    packet_fixed_to_sample(&report, &expected);
+    CHECK(report.spread_present != 0);
+
+    // Single frame: on air as encoded, no gateway to acknowledge it
+    radio_send_fixed(&report);
+    SensorData received;
+    CHECK(sent_count == 1 && packet_decode(sent_frames[0], sent_lengths[0], &received));
+    CHECK(memcmp(&received, &expected, sizeof(received)) == 0);
+    CHECK(undelivered_count == 1 && sample_log_pending() == 1 && !radio_link_up());
+
+    // Batches of three, the last one left for the flush
+    radio_set_batching(3, RADIO_BATCH_MAX_LATENCY_MS);
+    for (int i = 0; i < 4; i++) {
+        report.temperature = 2000 + i;
+        radio_queue_fixed(&report);
+    }
+    CHECK(sent_count == 2);
+    SensorData samples[RADIO_BATCH_MAX_SAMPLES];
+    uint32_t ages_ms[RADIO_BATCH_MAX_SAMPLES];
+    uint8_t count = 0;
+    CHECK(packet_decode_batch(sent_frames[1], sent_lengths[1], samples, ages_ms, RADIO_BATCH_MAX_SAMPLES, &count));
+    CHECK(count == 3 && samples[2].spread_present == expected.spread_present);
+    CHECK_NEAR(samples[2].temperature, 20.02, 1e-4);
+    // A float sample flushes the fixed one first, they do not share a frame
+    radio_queue_data(&expected);
+    CHECK(sent_count == 3 && packet_is_batch(sent_frames[2], sent_lengths[2]) && sent_frames[2][2] == 1);
+    radio_flush();
+    CHECK(sent_count == 4);
+    CHECK(undelivered_count == 5 && sample_log_pending() == 5);
+
+    // The log holds the fixed samples as sent, without the spread
+    uint8_t body[UINT8_MAX], body_length, frame[UINT8_MAX];
+    uint8_t peeked = sample_log_peek(body, &body_length, NULL, RADIO_BATCH_MAX_SAMPLES, sizeof(body), 0);
+    CHECK(peeked == 5);
+    uint8_t frame_length = packet_encode_batch_body(body, body_length, peeked, 0, frame, sizeof(frame));
+    CHECK(packet_decode_batch(frame, frame_length, samples, ages_ms, RADIO_BATCH_MAX_SAMPLES, &count) && count == 5);
+    expected.spread_present = 0;
+    memset(expected.spread, 0, sizeof(expected.spread));
+    CHECK(memcmp(&samples[0], &expected, sizeof(expected)) == 0);
+    CHECK_NEAR(samples[4].temperature, 20.03, 1e-4);
+    radio_set_undelivered_fixed(NULL);
+}
+
+int main(void) {
+    test_sweep();
+    test_sht40_range();
+    test_fixed_to_sample_range();
+    test_stats();
+    test_scheduler();
+    test_tx_filter();
+    test_radio_and_log();
+    return test_result("test_fixed_pipeline");
+}
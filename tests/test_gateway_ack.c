@@ -0,0 +1,110 @@
+// Several stations send back to back while the gateway acknowledges every
+// frame. Stations listen before talk (CCA, as their MCSM1 sets), so they
+// defer to each other and to the gateway's ACKs. Every frame has to be
+// received, forwarded and acknowledged before the station's ACK timeout.
+#include "test.h"
+#include "gateway.h"
+#include "radio.h"
+#include "packet.h"
+#include "cc1101.h"
+#include "cc1101_model.h"
+#include <string.h>
+
+#define STATIONS 6
+#define ROUNDS 4
+#define STATION_BACKOFF_US 150 // Per station index, after the channel clears
+
+typedef struct {
+    uint8_t address;
+    uint8_t sequence;
+    uint8_t frame[CC1101_FIFO_SIZE];
+    uint8_t length;
+    uint64_t end_us; // Frame on air until
+    bool acked;
+} Station;
+
+static Station stations[STATIONS];
+static uint32_t acks, late_acks, stray_acks;
+
+static void station_talk(int32_t id, void *context) {
+    Station *station = context;
+    uint64_t now = hal_time_us();
+    uint64_t busy_until = cc1101_model_air_busy_until();
+    if (busy_until > now) {
+        uint64_t retry = busy_until + STATION_BACKOFF_US * (station - stations + 1);
+        hal_host_schedule(retry, station_talk, station);
+        return;
+    }
+    uint64_t sync_us = now + cc1101_model_sync_us();
+    cc1101_model_inject(station->frame, station->length, sync_us, true);
+    station->end_us = sync_us + cc1101_model_frame_us(station->length);
+    station->acked = false;
+}
+
+static void station_queue(Station *station, uint64_t at_us) {
+    SensorData data = {.temperature = 20.0f + station->sequence, .pressure = 1000.0f + station->address,
+                       .present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE)};
+    uint8_t length = packet_encode(&data, station->sequence, &station->frame[2], RADIO_MAX_PAYLOAD);
+    station->frame[0] = length + 1;
+    station->frame[1] = station->address;
+    station->length = length + 2;
+    hal_host_schedule(at_us, station_talk, station);
+}
+
+static void on_gateway_tx(const uint8_t *frame, uint8_t length, void *context) {
+    for (int i = 0; i < STATIONS; i++) {
+        Station *station = &stations[i];
+        if (frame[1] == station->address && length == PACKET_ACK_SIZE + 2 &&
+            packet_is_ack(&frame[2], PACKET_ACK_SIZE) && packet_sequence(&frame[2]) == station->sequence &&
+            !station->acked) {
+            station->acked = true;
+            acks++;
+            if (hal_time_us() > station->end_us + RADIO_ACK_TIMEOUT_MS * 1000) {
+                late_acks++;
+            }
+            return;
+        }
+    }
+    stray_acks++;
+}
+
+int main(void) {
+    hal_host_reset();
+    cc1101_model_init();
+    cc1101_model_on_tx(on_gateway_tx, NULL);
+    gateway_init();
+
+    uint64_t start_us = hal_time_us() + 1000;
+    for (int round = 0; round < ROUNDS; round++) {
+        // Everyone wants the channel at once
+        uint64_t round_us = start_us + round * 100000ull;
+        for (int i = 0; i < STATIONS; i++) {
+            stations[i].address = 0x10 + i;
+            stations[i].sequence = round;
+            station_queue(&stations[i], round_us + i * 10);
+        }
+        while (hal_time_us() < round_us + 100000) {
+            if (!gateway_poll()) {
+                uint64_t deadline = gateway_next_deadline_us();
+                hal_wait_event_until(deadline < round_us + 100000 ? deadline : round_us + 100000);
+            }
+        }
+    }
+
+    GatewayStats stats;
+    gateway_get_stats(&stats);
+    Cc1101ModelStats radio;
+    cc1101_model_get_stats(&radio);
+    printf("received %lu, rx errors %lu, overruns %lu, stations %u; acks %lu (late %lu, stray %lu); "
+           "radio lost %lu, filtered %lu\n",
+           (unsigned long)stats.received, (unsigned long)stats.rx_errors, (unsigned long)stats.overruns,
+           stats.stations, (unsigned long)acks, (unsigned long)late_acks, (unsigned long)stray_acks,
+           (unsigned long)radio.lost, (unsigned long)radio.filtered);
+    CHECK(radio.lost == 0);
+    CHECK(stats.received == STATIONS * ROUNDS);
+    CHECK(stats.rx_errors == 0 && stats.crc_errors == 0 && stats.overruns == 0);
+    CHECK(stats.stations == STATIONS);
+    CHECK(acks == STATIONS * ROUNDS);
+    CHECK(late_acks == 0 && stray_acks == 0);
+    return test_result("test_gateway_ack");
+}
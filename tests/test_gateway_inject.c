@@ -0,0 +1,234 @@
+// Packet injector for the gateway: a full table of stations sends single,
+// batch and spread frames as fast as the channel allows (each waits for the
+// air to clear and the gateway's ACK window to pass), with sequence gaps,
+// corrupted frames and one station more than the table holds. The USB
+// stream is parsed back and every sample has to come out once, in order,
+// with its station's packet and loss counts.
+#include "test.h"
+#include "gateway.h"
+#include "radio.h"
+#include "packet.h"
+#include "cc1101.h"
+#include "cc1101_model.h"
+#include <string.h>
+
+#define STATIONS (GATEWAY_MAX_STATIONS + 1) // The last one finds the table full
+#define FRAMES 12                           // Per station
+#define ACK_WINDOW_US 3000                  // Left after each frame for the gateway's ACK
+#define GAP_EVERY 5                         // Stations with odd addresses skip a sequence number
+#define CORRUPT_EVERY 7                     // Every 7th frame after the first round fails its CRC
+#define EXPECTED_MAX (STATIONS * FRAMES * 2)
+
+typedef struct {
+    uint8_t address;
+    float temperature;
+    uint32_t packets; // Station counters the gateway should report with it
+    uint32_t lost;
+    bool spread;
+} ExpectedSample;
+
+// Samples the gateway has to forward, in injection order
+static ExpectedSample expected[EXPECTED_MAX];
+static uint32_t expected_count;
+
+// Per station state as the gateway should track it
+static uint8_t sequences[STATIONS];
+static uint8_t last_sequences[STATIONS];
+static uint32_t packets[STATIONS];
+static uint32_t lost[STATIONS];
+static uint32_t frames_sent[STATIONS];
+
+static uint32_t injected, corrupted, spread_expected;
+static uint32_t next_station;
+
+static uint8_t station_address(uint32_t station) {
+    return 0x20 + station;
+}
+
+static void injector_run(int32_t id, void *context);
+
+static void injector_schedule(uint64_t at_us) {
+    hal_host_schedule(at_us, injector_run, NULL);
+}
+
+// Builds the next frame of a station, records what the gateway should forward
+static uint8_t injector_frame(uint32_t station, bool good, uint8_t *frame) {
+    uint32_t k = frames_sent[station]++;
+    if ((station & 1) && k % GAP_EVERY == GAP_EVERY - 1) {
+        sequences[station]++; // A frame that never reached the gateway
+    }
+    uint8_t sequence = sequences[station]++;
+
+    SensorData samples[2] = {0};
+    uint32_t ages_ms[2] = {1000, 0};
+    uint8_t count = k % 3 == 2 ? 2 : 1;
+    for (uint8_t i = 0; i < count; i++) {
+        samples[i].temperature = 20.0f + station + k * 0.1f + i * 0.01f;
+        samples[i].pressure = 1000.0f + k;
+        samples[i].present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE);
+        if (station == 1) {
+            samples[i].spread[SENSOR_CH_TEMPERATURE] = (SensorSpread){.min = 19.0f, .max = 21.0f, .stddev = 0.5f};
+            samples[i].spread_present = SENSOR_BIT(SENSOR_CH_TEMPERATURE);
+        }
+    }
+    uint8_t length = count == 1 ? packet_encode(&samples[0], sequence, &frame[2], RADIO_MAX_PAYLOAD)
+                                : packet_encode_batch(samples, ages_ms, count, sequence, &frame[2],
+                                                      RADIO_MAX_PAYLOAD);
+    CHECK(length > 0);
+    frame[0] = length + 1;
+    frame[1] = station_address(station);
+
+    // Corrupt frames are counted as CRC errors by the gateway and show up as
+    // a gap in the sequence like the skipped ones
+    if (good && station < GATEWAY_MAX_STATIONS) {
+        if (packets[station] > 0) {
+            lost[station] += (uint8_t)(sequence - last_sequences[station] - 1);
+        }
+        last_sequences[station] = sequence;
+        packets[station]++;
+        for (uint8_t i = 0; i < count; i++) {
+            ExpectedSample *sample = &expected[expected_count++];
+            sample->address = station_address(station);
+            sample->temperature = samples[i].temperature;
+            sample->packets = packets[station];
+            sample->lost = lost[station];
+            sample->spread = samples[i].spread_present != 0;
+            spread_expected += sample->spread;
+        }
+    }
+    return length + 2;
+}
+
+static void injector_run(int32_t id, void *context) {
+    uint64_t now = hal_time_us();
+    uint64_t busy_until = cc1101_model_air_busy_until();
+    if (busy_until > now) {
+        injector_schedule(busy_until + ACK_WINDOW_US);
+        return;
+    }
+    uint32_t station = next_station % STATIONS;
+    if (next_station >= STATIONS * FRAMES) {
+        return;
+    }
+    next_station++;
+
+    uint8_t frame[CC1101_FIFO_SIZE];
+    // The first round is clean so the table fills in station order
+    bool good = ++injected % CORRUPT_EVERY != 0 || next_station <= STATIONS;
+    uint8_t length = injector_frame(station, good, frame);
+    uint64_t sync_us = now + cc1101_model_sync_us();
+    cc1101_model_inject(frame, length, sync_us, good);
+    corrupted += !good;
+    injector_schedule(sync_us + cc1101_model_frame_us(length) + ACK_WINDOW_US);
+}
+
+// USB stream parser: SYNC, type, length, payload, CRC-8 over type..payload
+static uint8_t rx_frame[3 + 255 + 1];
+static uint16_t rx_index;
+static uint32_t samples_out, spreads_out, stats_out, mismatches;
+
+static uint8_t crc8(uint8_t crc, const uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint32_t get_u32(const uint8_t *buffer) {
+    return buffer[0] | buffer[1] << 8 | buffer[2] << 16 | (uint32_t)buffer[3] << 24;
+}
+
+static void on_sample(const uint8_t *payload, uint8_t length) {
+    CHECK(length == 16 + SENSOR_CH_COUNT * sizeof(float));
+    if (samples_out >= expected_count) {
+        mismatches++;
+        return;
+    }
+    const ExpectedSample *sample = &expected[samples_out++];
+    float temperature;
+    memcpy(&temperature, &payload[16 + SENSOR_CH_TEMPERATURE * sizeof(float)], sizeof(float));
+    uint16_t present = payload[14] | payload[15] << 8;
+    if (payload[0] != sample->address || get_u32(&payload[6]) != sample->packets ||
+        get_u32(&payload[10]) != sample->lost || temperature < sample->temperature - 0.006f ||
+        temperature > sample->temperature + 0.006f ||
+        present != (SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE))) {
+        printf("sample %lu: address 0x%02x packets %lu lost %lu temperature %.2f, expected 0x%02x %lu %lu %.2f\n",
+               (unsigned long)samples_out - 1, payload[0], (unsigned long)get_u32(&payload[6]),
+               (unsigned long)get_u32(&payload[10]), temperature, sample->address, (unsigned long)sample->packets,
+               (unsigned long)sample->lost, sample->temperature);
+        mismatches++;
+    }
+}
+
+static void console_byte(uint8_t byte) {
+    if (rx_index == 0 && byte != GATEWAY_FRAME_SYNC) {
+        return; // Text from radio_init
+    }
+    rx_frame[rx_index++] = byte;
+    if (rx_index < 3 || rx_index < 3 + rx_frame[2] + 1) {
+        return;
+    }
+    uint8_t type = rx_frame[1], length = rx_frame[2];
+    rx_index = 0;
+    if (crc8(0, &rx_frame[1], 2 + length) != rx_frame[3 + length]) {
+        mismatches++;
+        return;
+    }
+    if (type == GATEWAY_FRAME_SAMPLE) {
+        on_sample(&rx_frame[3], length);
+    } else if (type == GATEWAY_FRAME_SPREAD) {
+        spreads_out++;
+        CHECK(samples_out > 0 && expected[samples_out - 1].spread);
+    } else if (type == GATEWAY_FRAME_STATS) {
+        stats_out++;
+    }
+}
+
+int main(void) {
+    hal_host_reset();
+    hal_host_set_console(console_byte);
+    cc1101_model_init();
+    gateway_init();
+
+    uint64_t start_us = hal_time_us();
+    injector_schedule(start_us + 1000);
+    uint64_t end_us = start_us + GATEWAY_STATS_INTERVAL_MS * 1000ull + 1000;
+    while (hal_time_us() < end_us) {
+        if (!gateway_poll()) {
+            uint64_t deadline = gateway_next_deadline_us();
+            hal_wait_event_until(deadline < end_us ? deadline : end_us);
+        }
+    }
+    hal_host_set_console(NULL);
+
+    GatewayStats stats;
+    gateway_get_stats(&stats);
+    Cc1101ModelStats radio;
+    cc1101_model_get_stats(&radio);
+    uint32_t in_table = 0;
+    for (uint32_t station = 0; station < GATEWAY_MAX_STATIONS; station++) {
+        in_table += packets[station];
+    }
+    printf("injected %lu (%lu corrupt), forwarded %lu/%lu samples, %lu spread, %lu stats frames; "
+           "gateway received %lu, crc errors %lu, rx errors %lu, overruns %lu, stations %u; radio lost %lu\n",
+           (unsigned long)injected, (unsigned long)corrupted, (unsigned long)samples_out,
+           (unsigned long)expected_count, (unsigned long)spreads_out, (unsigned long)stats_out,
+           (unsigned long)stats.received, (unsigned long)stats.crc_errors, (unsigned long)stats.rx_errors,
+           (unsigned long)stats.overruns, stats.stations, (unsigned long)radio.lost);
+
+    CHECK(injected == STATIONS * FRAMES);
+    CHECK(radio.lost == 0 && radio.overflows == 0);
+    CHECK(radio.filtered == 0 && stats.crc_errors == corrupted);
+    CHECK(stats.received == injected - corrupted);
+    CHECK(stats.overruns == 0);
+    CHECK(stats.stations == GATEWAY_MAX_STATIONS);
+    // Only the frames of the station past the table are errors
+    CHECK(stats.rx_errors == stats.received - in_table);
+    CHECK(samples_out == expected_count && mismatches == 0);
+    CHECK(spreads_out == spread_expected && spread_expected > 0);
+    CHECK(stats_out == 1);
+    return test_result("test_gateway_inject");
+}
@@ -0,0 +1,82 @@
+// Smoke test of the host backend: the station's sensor cycle and one radio
+// frame run through the real drivers against the register models.
+#include "test.h"
+#include "sensors.h"
+#include "radio.h"
+#include "packet.h"
+#include "cc1101.h"
+#include "cc1101_model.h"
+#include "BMP280.h"
+#include <string.h>
+
+static uint8_t sent_frame[CC1101_FIFO_SIZE];
+static uint8_t sent_length;
+static uint64_t sent_us;
+
+static void capture_tx(const uint8_t *frame, uint8_t length, void *context) {
+    memcpy(sent_frame, frame, length);
+    sent_length = length;
+    sent_us = hal_time_us();
+}
+
+static void test_sensor_cycle(void) {
+    StationModels models;
+    test_station_models(&models);
+    models.sht40.temperature = 21.5f;
+    models.sht40.humidity = 63.0f;
+    models.solar.bus_voltage = 12.0f;
+    models.battery.bus_voltage = 3.9f;
+
+    sensors_init();
+    HalBusStats before, after;
+    hal_get_i2c_stats(HAL_I2C1, &before);
+    uint64_t start_us = hal_time_us();
+    SensorData data = sensors_read_all();
+    uint32_t cycle_us = (uint32_t)(hal_time_us() - start_us);
+    printf("sensor cycle: %lu us, present 0x%03x\n", (unsigned long)cycle_us, data.present);
+
+    CHECK(data.present == (SENSOR_BIT(SENSOR_CH_COUNT - 2) - 1));
+    CHECK_NEAR(data.temperature, 25.08, 0.01);
+    CHECK_NEAR(data.exterior_temperature, 21.5, 0.01);
+    CHECK_NEAR(data.exterior_humidity, 63.0, 0.01);
+    CHECK_NEAR(data.solar_voltage, 12.0, 0.004);
+    CHECK_NEAR(data.battery_voltage, 3.9, 0.004);
+    // Conversions overlap: the cycle is the slowest sensor plus bus time
+    CHECK(cycle_us >= BMP280_MEASURE_TIME_US);
+    CHECK(cycle_us < BMP280_MEASURE_TIME_US + 2000);
+    CHECK(models.bmp280.conversions == 1 && models.sht40.measurements == 1);
+    CHECK(models.solar.conversions == 1 && models.battery.conversions == 1);
+
+    hal_get_i2c_stats(HAL_I2C1, &after);
+    CHECK(after.transactions > before.transactions && after.errors == before.errors);
+    CHECK(after.busy_us > before.busy_us);
+}
+
+static void test_radio_frame(void) {
+    hal_host_reset();
+    cc1101_model_init();
+    cc1101_model_on_tx(capture_tx, NULL);
+    radio_init(F_433);
+    CHECK(cc1101_model_reg(CC1101_IOCFG0) == 0x06);
+
+    SensorData data = {.temperature = 21.25f, .present = SENSOR_BIT(SENSOR_CH_TEMPERATURE)};
+    uint64_t start_us = hal_time_us();
+    radio_send_data(&data);
+    CHECK(sent_length > 2);
+    CHECK(sent_frame[1] == cc1101_model_reg(CC1101_ADDR));
+
+    SensorData decoded;
+    CHECK(packet_decode(&sent_frame[2], sent_length - 2, &decoded));
+    CHECK_NEAR(decoded.temperature, 21.25, 0.01);
+    // Calibration, then the whole frame on air
+    uint32_t airtime = radio_airtime_us(sent_length - 2);
+    CHECK(sent_us - start_us >= CC1101_MODEL_CAL_US + airtime - 1);
+    CHECK_NEAR((double)cc1101_model_sync_us() + cc1101_model_frame_us(sent_length), airtime, 2);
+    CHECK(cc1101_model_marcstate() == 0x01);
+}
+
+int main(void) {
+    test_sensor_cycle();
+    test_radio_frame();
+    return test_result("test_host_smoke");
+}
@@ -0,0 +1,60 @@
+// i2c_bus.c against the sensor models: the clock negotiation stays at
+// standard mode without external pull-ups, and a NAKed SHT40 read backs off
+// for a measurement time instead of being repeated while the chip is busy.
+#include "test.h"
+#include "sensors.h"
+#include "i2c_bus.h"
+#include "SHT40.h"
+
+static void test_negotiate(void) {
+    StationModels models;
+    test_station_models(&models);
+    sensors_init();
+    // Every device here supports 400 kHz or more
+    for (int i = 0; i < HAL_I2C_COUNT; i++) {
+        uint32_t hz = hal_i2c_get_clock(i == 0 ? HAL_I2C0 : HAL_I2C1);
+        CHECK(I2C_EXTERNAL_PULLUPS ? hz >= 400000 : hz == I2C_BUS_PROBE_HZ);
+    }
+}
+
+static void test_nak_backoff(void) {
+    StationModels models;
+    test_station_models(&models);
+    hal_i2c_init(SHT40_BUS, I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ_HZ);
+    i2c_bus_init(SHT40_BUS);
+    SHT40 sht40;
+    sht40_init(&sht40, SHT40_BUS, SHT40_I2C_ADDRESS);
+    hal_sleep_us(SHT40_MEASURE_TIME_HIGHREP_US); // Soft reset done
+
+    // The read is queued far too early: it is NAKed and has to wait
+    I2cJob start, collect;
+    uint64_t start_us = hal_time_us();
+    sht40_start_job(&sht40, &start);
+    sht40_collect_job(&sht40, &collect);
+    collect.not_before_us = start_us + 1000;
+    HalBusStats before, after;
+    hal_get_i2c_stats(SHT40_BUS, &before);
+    i2c_bus_queue(SHT40_BUS, &start);
+    i2c_bus_queue(SHT40_BUS, &collect);
+    CHECK(i2c_bus_worst_case_us() >= 1000 + 2 * SHT40_MEASURE_TIME_HIGHREP_US);
+    i2c_bus_run();
+    uint32_t elapsed_us = (uint32_t)(hal_time_us() - start_us);
+    hal_get_i2c_stats(SHT40_BUS, &after);
+    printf("NAKed read done after %lu us, %u attempts\n", (unsigned long)elapsed_us, collect.attempts);
+
+    float temperature, humidity;
+    CHECK(start.result == 1 && start.attempts == 1);
+    CHECK(collect.result == 6 && collect.attempts == 2);
+    CHECK(sht40_parse_job(&collect, &temperature, &humidity));
+    CHECK_NEAR(temperature, models.sht40.temperature, 0.01);
+    CHECK(elapsed_us >= 1000 + SHT40_MEASURE_TIME_HIGHREP_US);
+    CHECK(after.retries - before.retries == 1);
+    CHECK(after.timeouts == before.timeouts && after.recoveries == before.recoveries);
+    CHECK(models.sht40.measurements == 1);
+}
+
+int main(void) {
+    test_negotiate();
+    test_nak_backoff();
+    return test_result("test_i2c_bus");
+}
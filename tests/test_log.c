@@ -0,0 +1,134 @@
+// Tokenized logging end to end: log.c built as on the target (LOG_TEXT=0)
+// against the SDK stand-ins in host/sdk. The records are checked here for
+// their framing, level filtering and overflow accounting, and the drained
+// stream goes to stdout, where test_log_decode.py decodes it with
+// tools/log_decode.py against this executable and compares the text.
+//
+// Also times a tokenized call against formatting the same message with
+// snprintf, which is what each LOG() call does with LOG_TEXT=1 before
+// anything is written out. Host cycles scaled to 125 MHz, on stderr.
+#undef LOG_TEXT
+#define LOG_TEXT 0
+#include "test.h"
+#include "log.h"
+#include "pico/stdlib.h"
+#include <string.h>
+#include <unistd.h>
+
+#define TIMING_ROUNDS 200
+#define TIMING_BATCH 32 // Records per round, well inside the ring
+
+static uint8_t drained[LOG_BUFFER_SIZE + LOG_RECORD_MAX_SIZE];
+
+// log_drain writes to stdout, run it into a file and read that back
+static size_t drain(uint8_t *out, size_t size) {
+    FILE *file = tmpfile();
+    CHECK(file != NULL);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(file), STDOUT_FILENO);
+    log_drain();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    rewind(file);
+    size_t length = fread(out, 1, size, file);
+    fclose(file);
+    return length;
+}
+
+// Records in a drained stream, 0 if it does not split into whole records
+static uint32_t count_records(const uint8_t *stream, size_t length, uint8_t level) {
+    uint32_t records = 0;
+    size_t position = 0;
+    while (position < length) {
+        if (stream[position] != LOG_RECORD_SYNC || position + 1 >= length ||
+            (stream[position + 1] >> 4) != level || (stream[position + 1] & 0x0F) > LOG_MAX_ARGS) {
+            return 0;
+        }
+        position += LOG_RECORD_HEADER_SIZE + (stream[position + 1] & 0x0F) * 4;
+        records++;
+    }
+    return position == length ? records : 0;
+}
+
+static void test_levels(void) {
+    log_set_level(LOG_LEVEL_WARN);
+    LOG_INFO("not recorded %d\n", 1);
+    LOG_DEBUG("not recorded\n");
+    LOG_WARN("recorded %d\n", 2);
+    size_t length = drain(drained, sizeof(drained));
+    CHECK(count_records(drained, length, LOG_LEVEL_WARN) == 1);
+    CHECK(length == LOG_RECORD_HEADER_SIZE + 4);
+    log_set_level(LOG_LEVEL_DEBUG);
+}
+
+// A full ring drops whole records and counts them, the rest drain intact
+static void test_overflow(void) {
+    uint32_t dropped = log_dropped();
+    const uint32_t written = LOG_BUFFER_SIZE / (LOG_RECORD_HEADER_SIZE + 8) + 10;
+    for (uint32_t i = 0; i < written; i++) {
+        LOG_ERROR("overflow %lu of %lu\n", (unsigned long)i, (unsigned long)written);
+    }
+    size_t length = drain(drained, sizeof(drained));
+    uint32_t records = count_records(drained, length, LOG_LEVEL_ERROR);
+    CHECK(records == LOG_BUFFER_SIZE / (LOG_RECORD_HEADER_SIZE + 8));
+    CHECK(log_dropped() - dropped == written - records);
+    // Space is back once drained
+    LOG_ERROR("after %d\n", 1);
+    CHECK(count_records(drained, drain(drained, sizeof(drained)), LOG_LEVEL_ERROR) == 1);
+    CHECK(log_dropped() - dropped == written - records);
+}
+
+// What test_log_decode.py expects, one record per line, plain text in between
+static void emit_script(void) {
+    pico_host_time_us = 1000;
+    LOG_INFO("boot %s v%d.%d\n", "station", 2, 7);
+    pico_host_time_us = 1250;
+    LOG_WARN("pressure %.1f hPa over %u samples\n", 1013.25f, 150u);
+    log_drain();
+    printf("plain text passes through\n");
+    pico_host_time_us = 2000000;
+    LOG_ERROR("i2c %d: address 0x%02x, result %d\n", 1, 0x76, -2);
+    pico_host_time_us = 2000500;
+    LOG_DEBUG("%d %d %d %d %d %d %d %d\n", 1, 2, 3, 4, 5, 6, 7, 8);
+    pico_host_time_us = 3500000;
+    LOG_INFO("no newline, %c%c", 'o', 'k');
+    log_drain();
+    fflush(stdout);
+}
+
+static void test_timing(void) {
+    uint32_t tokenized = 0, text = 0;
+    char line[128];
+    for (int round = 0; round < TIMING_ROUNDS; round++) {
+        uint32_t start = hal_cycles_start();
+        for (int i = 0; i < TIMING_BATCH; i++) {
+            LOG_INFO("sample %lu: %.2f DegC, %.1f hPa\n", (unsigned long)i, 21.5f + i, 1013.25f);
+        }
+        tokenized += hal_cycles_since(start);
+
+        start = hal_cycles_start();
+        for (int i = 0; i < TIMING_BATCH; i++) {
+            snprintf(line, sizeof(line), "sample %lu: %.2f DegC, %.1f hPa\n", (unsigned long)i, 21.5f + i,
+                     1013.25f);
+            __asm__ volatile("" : : "r"(line) : "memory");
+        }
+        text += hal_cycles_since(start);
+        drain(drained, sizeof(drained));
+    }
+    uint32_t calls = TIMING_ROUNDS * TIMING_BATCH;
+    fprintf(stderr, "per call: tokenized %lu cycles, formatted %lu cycles (%.1fx)\n",
+            (unsigned long)(tokenized / calls), (unsigned long)(text / calls), (double)text / tokenized);
+}
+
+int main(void) {
+    // Addresses go out as 32 bits: built without PIE, they are the ELF's own
+    CHECK((uintptr_t)emit_script <= UINT32_MAX && (uintptr_t)"station" <= UINT32_MAX);
+    log_init();
+    test_levels();
+    test_overflow();
+    test_timing();
+    emit_script();
+    return test_result("test_log");
+}
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Decode the stream test_log writes with tools/log_decode.py and compare the text.
+
+test_log encodes its records with log.c as on the target; the format strings
+are looked up in the test_log executable itself.
+
+    tests/test_log_decode.py tools/log_decode.py _gate_build/test_log
+"""
+import subprocess
+import sys
+import tempfile
+
+EXPECTED = [
+    "[  0.001000] I boot station v2.7",
+    "[  0.001250] W pressure 1013.2 hPa over 150 samples",
+    "plain text passes through",
+    "[  2.000000] E i2c 1: address 0x76, result -2",
+    "[  2.000500] D 1 2 3 4 5 6 7 8",
+    # The decoder ends every record with a newline
+    "[  3.500000] I no newline, ok",
+    "test_log: PASS (0 failed checks)",
+]
+
+
+def main():
+    decoder, test_log = sys.argv[1:3]
+    stream = subprocess.run([test_log], capture_output=True).stdout
+    with tempfile.NamedTemporaryFile(suffix=".bin") as capture:
+        capture.write(stream)
+        capture.flush()
+        decoded = subprocess.run([sys.executable, decoder, test_log, capture.name], check=True,
+                                 capture_output=True, text=True).stdout
+
+    failures = 0
+    lines = decoded.splitlines()
+    for i in range(max(len(lines), len(EXPECTED))):
+        got = lines[i] if i < len(lines) else None
+        expected = EXPECTED[i] if i < len(EXPECTED) else None
+        if got != expected:
+            print("line %d: got %r, expected %r" % (i, got, expected))
+            failures += 1
+
+    print("test_log_decode: %s (%d failed checks)" % ("FAIL" if failures else "PASS", failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
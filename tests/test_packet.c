@@ -0,0 +1,163 @@
+// Round-trip property test of the wire format: random samples (presence,
+// values anywhere in the int16 range of each channel, spread) go through
+// packet_encode/packet_decode and packet_encode_batch/packet_decode_batch.
+// Every present channel must come back to its wire resolution, absent ones
+// as zero, and any truncated frame must be rejected.
+#include "test.h"
+#include "sensors.h"
+#include "packet.h"
+#include <math.h>
+#include <string.h>
+
+#define ROUNDS 20000
+
+// Wire units per physical unit, as packet_schema in packet.c
+static const float test_scale[SENSOR_CH_COUNT] = {
+    100.0f, 10.0f, 100.0f, 100.0f, 1000.0f, 10000.0f, 1000.0f, 1000.0f, 10000.0f, 1000.0f, 1.0f, 1.0f,
+};
+
+static uint32_t rng_state = 0x12345678;
+
+// xorshift32, fixed seed so a failure reproduces
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// A value that encodes to wire, off the exact step by less than half of it
+static float value_near(int16_t wire, float scale) {
+    float fraction = ((int32_t)(rng() % 801) - 400) / 1000.0f;
+    return (wire + fraction) / scale;
+}
+
+static int16_t random_wire(void) {
+    // Mostly small values, some at the ends of the range
+    switch (rng() % 4) {
+        case 0:
+            return rng() & 1 ? INT16_MAX : INT16_MIN;
+        case 1:
+            return (int16_t)rng();
+        default:
+            return (int16_t)((int32_t)(rng() % 2001) - 1000);
+    }
+}
+
+// Fills data with random content, wire[] gets the expected wire value per channel
+static void random_sample(SensorData *data, int16_t wire[SENSOR_CH_COUNT], int16_t spread_wire[][3]) {
+    memset(data, 0, sizeof(*data));
+    data->present = rng() & (SENSOR_BIT(SENSOR_CH_COUNT) - 1);
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        wire[ch] = random_wire();
+        sensor_set_value(data, ch, value_near(wire[ch], test_scale[ch]));
+        for (int i = 0; i < 3; i++) {
+            spread_wire[ch][i] = random_wire();
+        }
+        data->spread[ch].min = value_near(spread_wire[ch][0], test_scale[ch]);
+        data->spread[ch].max = value_near(spread_wire[ch][1], test_scale[ch]);
+        data->spread[ch].stddev = value_near(spread_wire[ch][2], test_scale[ch]);
+    }
+    // Spread rides along on a few samples, only for present channels
+    data->spread_present = rng() % 4 == 0 ? (rng() & data->present) : 0;
+}
+
+static void check_decoded(const SensorData *decoded, const SensorData *sent, const int16_t wire[SENSOR_CH_COUNT],
+                          int16_t spread_wire[][3]) {
+    CHECK(decoded->present == sent->present);
+    CHECK(decoded->spread_present == sent->spread_present);
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        float expected = (sent->present & SENSOR_BIT(ch)) ? wire[ch] / test_scale[ch] : 0.0f;
+        if (sensor_value(decoded, ch) != expected) {
+            printf("channel %d: %g, expected %g\n", ch, sensor_value(decoded, ch), expected);
+            test_failures++;
+        }
+        if (sent->spread_present & SENSOR_BIT(ch)) {
+            CHECK(decoded->spread[ch].min == spread_wire[ch][0] / test_scale[ch]);
+            CHECK(decoded->spread[ch].max == spread_wire[ch][1] / test_scale[ch]);
+            CHECK(decoded->spread[ch].stddev == spread_wire[ch][2] / test_scale[ch]);
+        }
+    }
+}
+
+static void test_single_round_trip(void) {
+    uint32_t bytes = 0, frames = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        SensorData data, decoded;
+        int16_t wire[SENSOR_CH_COUNT], spread_wire[SENSOR_CH_COUNT][3];
+        random_sample(&data, wire, spread_wire);
+        uint8_t buffer[255];
+        uint8_t length = packet_encode(&data, (uint8_t)round, buffer, sizeof(buffer));
+        CHECK(length == PACKET_HEADER_SIZE + packet_batch_sample_size(&data) - PACKET_AGE_SIZE);
+        CHECK(packet_sequence(buffer) == (uint8_t)round && !packet_is_batch(buffer, length));
+        if (data.spread_present == 0) {
+            CHECK(length <= PACKET_MAX_SIZE);
+        }
+        CHECK(packet_decode(buffer, length, &decoded));
+        check_decoded(&decoded, &data, wire, spread_wire);
+
+        // Too small a buffer encodes nothing, a cut frame does not decode
+        CHECK(packet_encode(&data, 0, buffer, length - 1) == 0);
+        uint8_t cut = rng() % length;
+        CHECK(!packet_decode(buffer, cut, &decoded));
+        bytes += length;
+        frames++;
+    }
+    printf("single: %lu frames, %lu bytes on average\n", (unsigned long)frames, (unsigned long)(bytes / frames));
+}
+
+static void test_batch_round_trip(void) {
+    for (int round = 0; round < ROUNDS / 10; round++) {
+        SensorData samples[8], decoded[8];
+        int16_t wire[8][SENSOR_CH_COUNT], spread_wire[8][SENSOR_CH_COUNT][3];
+        uint32_t ages_ms[8], decoded_ages_ms[8];
+        uint8_t count = 1 + rng() % 8;
+        for (uint8_t i = 0; i < count; i++) {
+            random_sample(&samples[i], wire[i], spread_wire[i]);
+            ages_ms[i] = rng() % (70000 * PACKET_AGE_UNIT_MS);
+        }
+        uint8_t buffer[255];
+        uint8_t length = packet_encode_batch(samples, ages_ms, count, (uint8_t)round, buffer, sizeof(buffer));
+        uint32_t expected_length = PACKET_BATCH_HEADER_SIZE;
+        for (uint8_t i = 0; i < count; i++) {
+            expected_length += packet_batch_sample_size(&samples[i]);
+        }
+        if (expected_length > sizeof(buffer)) {
+            CHECK(length == 0);
+            continue;
+        }
+        CHECK(length == expected_length);
+        CHECK(packet_is_batch(buffer, length));
+
+        uint8_t decoded_count = 0;
+        CHECK(!packet_decode_batch(buffer, length, decoded, decoded_ages_ms, count - 1, &decoded_count));
+        CHECK(packet_decode_batch(buffer, length, decoded, decoded_ages_ms, 8, &decoded_count));
+        CHECK(decoded_count == count);
+        for (uint8_t i = 0; i < decoded_count; i++) {
+            uint32_t age = ages_ms[i] / PACKET_AGE_UNIT_MS;
+            CHECK(decoded_ages_ms[i] == (age > UINT16_MAX ? UINT16_MAX : age) * PACKET_AGE_UNIT_MS);
+            check_decoded(&decoded[i], &samples[i], wire[i], spread_wire[i]);
+        }
+        CHECK(!packet_decode_batch(buffer, rng() % length, decoded, decoded_ages_ms, 8, &decoded_count));
+    }
+}
+
+// Values past the int16 range saturate instead of wrapping
+static void test_saturation(void) {
+    SensorData data = {.temperature = 1000.0f, .pressure = -1e6f, .solar_current = NAN,
+                       .present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE)};
+    SensorData decoded;
+    uint8_t buffer[PACKET_MAX_SIZE];
+    uint8_t length = packet_encode(&data, 0, buffer, sizeof(buffer));
+    CHECK(packet_decode(buffer, length, &decoded));
+    CHECK(decoded.temperature == INT16_MAX / 100.0f);
+    CHECK(decoded.pressure == INT16_MIN / 10.0f);
+    CHECK(decoded.solar_current == 0.0f);
+}
+
+int main(void) {
+    test_single_round_trip();
+    test_batch_round_trip();
+    test_saturation();
+    return test_result("test_packet");
+}
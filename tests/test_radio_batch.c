@@ -0,0 +1,97 @@
+// Airtime per sample across batch sizes: the same samples go through
+// radio_queue_data with radio_set_batching(N) for N = 1 .. the maximum, and
+// the CC1101 model's frames are timed on air. Full 12-channel samples fit
+// two to a frame, interior-only ones (temperature and pressure) seven.
+#include "test.h"
+#include "sensors.h"
+#include "radio.h"
+#include "packet.h"
+#include "cc1101.h"
+#include "cc1101_model.h"
+
+#define SAMPLES 56 // Multiple of 1, 2, 4, 7 and 8: no part-filled last frame
+#define SAMPLE_INTERVAL_MS 1000
+
+static uint32_t frames;
+static uint64_t air_us;
+static uint8_t longest_payload;
+
+static void count_tx(const uint8_t *frame, uint8_t length, void *context) {
+    frames++;
+    air_us += cc1101_model_sync_us() + cc1101_model_frame_us(length);
+    // Length byte counts the address, the payload follows it
+    if (frame[0] - 1 > longest_payload) {
+        longest_payload = frame[0] - 1;
+    }
+}
+
+typedef struct {
+    uint32_t air_us;   // Per sample
+    uint32_t awake_us; // Per sample, wake and calibration included
+    uint32_t frames;
+} BatchResult;
+
+static BatchResult run_batch(uint8_t n, const SensorData *sample) {
+    hal_host_reset();
+    cc1101_model_init();
+    cc1101_model_on_tx(count_tx, NULL);
+    frames = 0;
+    air_us = 0;
+    longest_payload = 0;
+    radio_init(F_433);
+    radio_sleep();
+    radio_set_batching(n, RADIO_BATCH_MAX_LATENCY_MS);
+
+    RadioPowerStats before, after;
+    radio_get_power_stats(&before);
+    for (int i = 0; i < SAMPLES; i++) {
+        radio_queue_data(sample);
+        hal_sleep_ms(SAMPLE_INTERVAL_MS);
+    }
+    radio_flush();
+    radio_get_power_stats(&after);
+
+    CHECK(longest_payload <= RADIO_MAX_PAYLOAD);
+    return (BatchResult){
+        .air_us = (uint32_t)(air_us / SAMPLES),
+        .awake_us = (after.awake_us - before.awake_us) / SAMPLES,
+        .frames = frames,
+    };
+}
+
+static void sweep(const char *name, const SensorData *sample, uint8_t fits) {
+    printf("%s sample (%u bytes in a batch):\n", name, packet_batch_sample_size(sample));
+    printf("  N  frames  air us/sample  awake us/sample\n");
+    BatchResult single = run_batch(1, sample);
+    BatchResult previous = single;
+    for (uint8_t n = 1; n <= RADIO_BATCH_MAX_SAMPLES; n++) {
+        BatchResult result = n == 1 ? single : run_batch(n, sample);
+        printf("  %u  %6lu  %13lu  %15lu\n", n, (unsigned long)result.frames, (unsigned long)result.air_us,
+               (unsigned long)result.awake_us);
+        uint8_t per_frame = n < fits ? n : fits;
+        CHECK(result.frames == (uint32_t)(SAMPLES + per_frame - 1) / per_frame);
+        if (n > 1 && n <= fits) {
+            CHECK(result.air_us < previous.air_us);
+            CHECK(result.awake_us < previous.awake_us);
+        } else if (n > fits) {
+            // Frames are full at fits samples, a larger N changes nothing
+            CHECK(result.frames == previous.frames);
+        }
+        previous = result;
+    }
+    CHECK(previous.air_us < single.air_us);
+}
+
+static void test_airtime_per_sample(void) {
+    SensorData full = {.present = SENSOR_BIT(SENSOR_CH_COUNT) - 1};
+    SensorData interior = {.temperature = 21.5f, .pressure = 1013.2f,
+                           .present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE)};
+    sweep("full", &full, (RADIO_MAX_PAYLOAD - PACKET_BATCH_HEADER_SIZE) / packet_batch_sample_size(&full));
+    sweep("interior", &interior,
+          (RADIO_MAX_PAYLOAD - PACKET_BATCH_HEADER_SIZE) / packet_batch_sample_size(&interior));
+}
+
+int main(void) {
+    test_airtime_per_sample();
+    return test_result("test_radio_batch");
+}
@@ -0,0 +1,128 @@
+// The sample log's flash writes wait for sample_log_sync: appending and
+// consuming only touch RAM, whatever the undelivered handler or backfill
+// does mid-send. The sync programs no more than its time budget covers at
+// the flash's worst case. Records drop the spread, and a peek fills a batch
+// body across page boundaries.
+#include "test.h"
+#include "sample_log.h"
+#include "sensor_stats.h"
+#include "radio.h"
+#include "hal.h"
+#include <string.h>
+
+#define ERASE_MAX_US 400000
+#define PROGRAM_MAX_US 3000
+
+static const SampleLogFlash flash = {
+    .offset = 0,
+    .sectors = 4,
+    .erase = hal_flash_erase,
+    .program = hal_flash_program,
+    .read = hal_flash_read,
+    .erase_max_us = ERASE_MAX_US,
+    .program_max_us = PROGRAM_MAX_US,
+};
+
+static uint32_t flash_writes(void) {
+    HalBusStats stats;
+    hal_get_flash_stats(&stats);
+    return stats.transactions;
+}
+
+// A full report with its spread, tagged through the temperature
+static SensorData report(uint32_t tag) {
+    SensorData data = {.temperature = tag / 100.0f, .pressure = 1013.2f, .exterior_humidity = 64.0f,
+                       .solar_power = 0.41f, .tx_interval = 60.0f};
+    data.present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE) |
+                   SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY) | SENSOR_BIT(SENSOR_CH_SOLAR_POWER) |
+                   SENSOR_BIT(SENSOR_CH_TX_INTERVAL);
+    data.spread_present = STATS_SPREAD_CHANNELS & data.present;
+    data.spread[SENSOR_CH_EXTERIOR_HUMIDITY] = (SensorSpread){63.0f, 65.0f, 0.5f};
+    data.spread[SENSOR_CH_SOLAR_POWER] = (SensorSpread){0.3f, 0.5f, 0.05f};
+    return data;
+}
+
+// Records in a peeked body, checked in order from tag on
+static uint8_t check_body(const uint8_t *body, uint8_t length, uint8_t count, uint32_t tag) {
+    uint8_t frame[UINT8_MAX];
+    SensorData samples[RADIO_BATCH_MAX_SAMPLES];
+    uint32_t ages_ms[RADIO_BATCH_MAX_SAMPLES];
+    uint8_t decoded = 0;
+    uint8_t frame_length = packet_encode_batch_body(body, length, count, 0, frame, sizeof(frame));
+    CHECK(frame_length == PACKET_BATCH_HEADER_SIZE + length);
+    CHECK(packet_decode_batch(frame, frame_length, samples, ages_ms, RADIO_BATCH_MAX_SAMPLES, &decoded));
+    CHECK(decoded == count);
+    for (uint8_t i = 0; i < decoded; i++) {
+        CHECK_NEAR(samples[i].temperature, (tag + i) / 100.0, 1e-4);
+        CHECK(samples[i].spread_present == 0);
+    }
+    return decoded;
+}
+
+static void test_deferred_writes(void) {
+    hal_host_reset();
+    sample_log_init(&flash);
+    SensorData data = report(0);
+    SensorData without_spread = data;
+    without_spread.spread_present = 0;
+    uint8_t record_size = SAMPLE_LOG_RECORD_HEADER_SIZE + packet_batch_sample_size(&without_spread) -
+                          PACKET_AGE_SIZE;
+    CHECK(packet_batch_sample_size(&data) > packet_batch_sample_size(&without_spread));
+    uint32_t per_page = SAMPLE_LOG_PAGE_CAPACITY / record_size;
+
+    // Two pages' worth fit in RAM, the first sealed; the third page is dropped
+    uint32_t tag = 0;
+    for (; tag < 2 * per_page; tag++) {
+        data = report(tag);
+        CHECK(sample_log_append(&data, tag * 1000));
+    }
+    data = report(tag);
+    CHECK(!sample_log_append(&data, tag * 1000));
+    SampleLogStats stats;
+    sample_log_get_stats(&stats);
+    CHECK(stats.appended == 2 * per_page && stats.dropped == 1);
+    CHECK(stats.record_bytes == 2 * per_page * record_size);
+    CHECK(flash_writes() == 0 && sample_log_pending() == 2 * per_page);
+
+    // The first page of the ring needs an erase before its program
+    CHECK(!sample_log_sync(0));
+    CHECK(!sample_log_sync(ERASE_MAX_US));
+    CHECK(flash_writes() == 0);
+    CHECK(sample_log_sync(ERASE_MAX_US + PROGRAM_MAX_US));
+    CHECK(flash_writes() == 2);
+    CHECK(sample_log_sync(UINT32_MAX)); // Nothing left
+    CHECK(flash_writes() == 2);
+
+    // One body across the programmed page and the open RAM page
+    uint8_t body[RADIO_MAX_PAYLOAD - PACKET_BATCH_HEADER_SIZE];
+    uint8_t length;
+    uint32_t consumed = 0;
+    while (consumed < per_page - 1) {
+        uint8_t count = sample_log_peek(body, &length, NULL, RADIO_BATCH_MAX_SAMPLES, sizeof(body), 0);
+        consumed += check_body(body, length, count, consumed);
+        sample_log_consume(count);
+    }
+    uint8_t count = sample_log_peek(body, &length, NULL, RADIO_BATCH_MAX_SAMPLES, sizeof(body), 0);
+    CHECK(count == (sizeof(body) / (PACKET_AGE_SIZE + record_size - SAMPLE_LOG_RECORD_HEADER_SIZE)));
+    check_body(body, length, count, consumed);
+    CHECK(consumed + count > per_page); // Spans the page boundary
+
+    // The delivered marker waits for the next sync, and takes one program
+    sample_log_consume(count);
+    consumed += count;
+    CHECK(flash_writes() == 2);
+    CHECK(!sample_log_sync(PROGRAM_MAX_US - 1));
+    CHECK(sample_log_sync(PROGRAM_MAX_US));
+    CHECK(flash_writes() == 3);
+
+    // After a reset the delivered page stays delivered, the RAM page is gone
+    sample_log_init(&flash);
+    CHECK(sample_log_pending() == 0);
+    sample_log_get_stats(&stats);
+    CHECK(stats.read_errors == 0);
+}
+
+int main(void) {
+    test_deferred_writes();
+    return test_result("test_sample_log");
+}
@@ -0,0 +1,188 @@
+// The sampling scheduler on solar traces: a day of hourly solar power and
+// battery voltage readings from a station (a clear morning, clouds in the
+// afternoon, the battery dipping before dawn) and an overcast day without a
+// battery reading. Readings are interpolated between the hours with some
+// noise on top and fed to scheduler_update at the cadence it asks for, as
+// main.c does with its reports.
+#include "test.h"
+#include "scheduler.h"
+#include "radio.h"
+
+#define HOUR_MS (3600 * 1000u)
+#define NOISE_V 0.02f // Peak noise, well inside the hysteresis bands
+#define NOISE_W 0.01f
+
+typedef struct {
+    const char *name;
+    float solar_w[25];   // On the hour, the last entry closes the day
+    float battery_v[25]; // 0: not measured
+} SolarTrace;
+
+static const SolarTrace clear_morning = {
+    "clear morning, cloudy afternoon",
+    {0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.02f, 0.15f, 0.40f, 0.62f, 0.78f, 0.85f, 0.70f,
+     0.35f, 0.55f, 0.45f, 0.28f, 0.10f, 0.02f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f},
+    {3.70f, 3.66f, 3.62f, 3.58f, 3.54f, 3.49f, 3.46f, 3.47f, 3.55f, 3.66f, 3.78f, 3.90f, 3.98f,
+     4.02f, 4.05f, 4.07f, 4.08f, 4.06f, 4.00f, 3.92f, 3.85f, 3.80f, 3.76f, 3.72f, 3.70f},
+};
+
+static const SolarTrace overcast = {
+    "overcast, no battery reading",
+    {0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.01f, 0.03f, 0.06f, 0.10f, 0.12f, 0.14f, 0.13f,
+     0.11f, 0.09f, 0.07f, 0.05f, 0.03f, 0.01f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f, 0.00f},
+    {0},
+};
+
+static uint32_t rng_state = 0x2468ace1;
+
+// xorshift32, fixed seed so a failure reproduces
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float noise(float peak) {
+    return ((int32_t)(rng() % 2001) - 1000) / 1000.0f * peak;
+}
+
+static float interpolate(const float *hourly, uint32_t t_ms) {
+    uint32_t hour = t_ms / HOUR_MS;
+    float fraction = (float)(t_ms % HOUR_MS) / HOUR_MS;
+    return hourly[hour] + (hourly[hour + 1] - hourly[hour]) * fraction;
+}
+
+static SensorData trace_sample(const SolarTrace *trace, uint32_t t_ms) {
+    SensorData data = {0};
+    data.solar_power = interpolate(trace->solar_w, t_ms);
+    if (data.solar_power > 0.0f) {
+        data.solar_power += noise(NOISE_W);
+    }
+    data.present = SENSOR_BIT(SENSOR_CH_SOLAR_POWER);
+    if (trace->battery_v[0] > 0.0f) {
+        data.battery_voltage = interpolate(trace->battery_v, t_ms) + noise(NOISE_V);
+        data.present |= SENSOR_BIT(SENSOR_CH_BATTERY_VOLTAGE);
+    }
+    return data;
+}
+
+// The state the thresholds call for on the noiseless trace, 0xff in a hysteresis band
+static uint8_t expected_state(const SolarTrace *trace, uint32_t t_ms) {
+    float solar = interpolate(trace->solar_w, t_ms);
+    if (trace->battery_v[0] > 0.0f) {
+        float battery = interpolate(trace->battery_v, t_ms);
+        if (battery < SCHEDULER_BATTERY_LOW_ENTER_V - NOISE_V) {
+            return SCHEDULER_STATE_LOW;
+        }
+        if (battery < SCHEDULER_BATTERY_LOW_LEAVE_V + NOISE_V) {
+            return 0xff;
+        }
+    } else {
+        if (solar < SCHEDULER_SOLAR_LOW_ENTER_W - NOISE_W) {
+            return SCHEDULER_STATE_LOW;
+        }
+        if (solar < SCHEDULER_SOLAR_LOW_LEAVE_W + NOISE_W) {
+            return 0xff;
+        }
+    }
+    if (solar >= SCHEDULER_SOLAR_SURPLUS_ENTER_W + NOISE_W) {
+        return SCHEDULER_STATE_SURPLUS;
+    }
+    if (solar >= SCHEDULER_SOLAR_SURPLUS_LEAVE_W - NOISE_W) {
+        return 0xff;
+    }
+    return SCHEDULER_STATE_NORMAL;
+}
+
+static void run_trace(const SolarTrace *trace) {
+    Scheduler scheduler;
+    scheduler_init(&scheduler);
+    uint32_t reports[3] = {0}, time_ms[3] = {0};
+    uint32_t changes = 0, mismatches = 0, longest_ms = 0;
+    uint32_t previous_interval = scheduler.sample_interval_ms;
+    SchedulerState previous_state = scheduler.state;
+
+    for (uint32_t t_ms = 0; t_ms < 24 * HOUR_MS; t_ms += scheduler.sample_interval_ms) {
+        SensorData data = trace_sample(trace, t_ms);
+        scheduler_update(&scheduler, &data);
+        scheduler_annotate(&scheduler, &data);
+
+        CHECK(data.sample_interval * 1000.0f == scheduler.sample_interval_ms);
+        CHECK(data.tx_interval * 1000.0f == scheduler.tx_interval_ms);
+        CHECK(scheduler.sample_interval_ms <= SCHEDULER_FLOOR_INTERVAL_MS);
+        CHECK(scheduler.tx_interval_ms >= scheduler.sample_interval_ms);
+        CHECK(scheduler.tx_interval_ms <= SCHEDULER_HEARTBEAT_MS);
+
+        uint8_t expected = expected_state(trace, t_ms);
+        if (expected != 0xff && expected != scheduler.state) {
+            mismatches++;
+        }
+        switch (scheduler.state) {
+        case SCHEDULER_STATE_SURPLUS:
+            CHECK(scheduler.sample_interval_ms == SCHEDULER_SURPLUS_INTERVAL_MS);
+            CHECK(scheduler.tx_interval_ms == SCHEDULER_SURPLUS_INTERVAL_MS);
+            break;
+        case SCHEDULER_STATE_NORMAL:
+            CHECK(scheduler.sample_interval_ms == SCHEDULER_NORMAL_INTERVAL_MS);
+            CHECK(scheduler.tx_interval_ms == SCHEDULER_NORMAL_TX_INTERVAL_MS);
+            break;
+        case SCHEDULER_STATE_LOW: {
+            // Doubling from the normal interval up to the floor, batched
+            uint32_t backoff = previous_state == SCHEDULER_STATE_LOW ? previous_interval * 2
+                                                                     : SCHEDULER_NORMAL_INTERVAL_MS * 2;
+            CHECK(scheduler.sample_interval_ms ==
+                  (backoff < SCHEDULER_FLOOR_INTERVAL_MS ? backoff : SCHEDULER_FLOOR_INTERVAL_MS));
+            uint32_t batched = scheduler.sample_interval_ms * RADIO_BATCH_MAX_SAMPLES;
+            CHECK(scheduler.tx_interval_ms == (batched < SCHEDULER_HEARTBEAT_MS ? batched : SCHEDULER_HEARTBEAT_MS));
+            break;
+        }
+        }
+
+        changes += scheduler.state != previous_state;
+        reports[scheduler.state]++;
+        time_ms[scheduler.state] += scheduler.sample_interval_ms;
+        if (scheduler.sample_interval_ms > longest_ms) {
+            longest_ms = scheduler.sample_interval_ms;
+        }
+        previous_state = scheduler.state;
+        previous_interval = scheduler.sample_interval_ms;
+    }
+
+    printf("%s: %lu state changes, %lu off the thresholds, longest interval %lu s\n", trace->name,
+           (unsigned long)changes, (unsigned long)mismatches, (unsigned long)(longest_ms / 1000));
+    static const char *const names[] = {"low", "normal", "surplus"};
+    for (int state = 0; state < 3; state++) {
+        printf("  %-7s %5.1f h, %5lu reports\n", names[state], time_ms[state] / (float)HOUR_MS,
+               (unsigned long)reports[state]);
+    }
+
+    CHECK(mismatches == 0);
+    // Noise on the readings does not flip the state: each threshold is
+    // crossed at most twice a day, once each way
+    CHECK(changes <= 6);
+}
+
+static void test_clear_morning(void) {
+    run_trace(&clear_morning);
+}
+
+static void test_overcast(void) {
+    run_trace(&overcast);
+}
+
+// With neither energy reading the policy stays where it is
+static void test_no_readings(void) {
+    Scheduler scheduler;
+    scheduler_init(&scheduler);
+    SensorData data = {.solar_power = 2.0f, .battery_voltage = 3.0f};
+    CHECK(!scheduler_update(&scheduler, &data));
+    CHECK(scheduler.state == SCHEDULER_STATE_NORMAL);
+}
+
+int main(void) {
+    test_clear_morning();
+    test_overcast();
+    test_no_readings();
+    return test_result("test_scheduler");
+}
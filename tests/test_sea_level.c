@@ -0,0 +1,63 @@
+// Sea level reduction set up once per altitude (sensors_set_altitude) against
+// the full barometric formula in double: the float path of sensors_read_all
+// and the Q15 integer path of sensors_read_all_fixed, from sea level up to the
+// 3700 m the integer path is sized for, over station pressures that reduce
+// to 950 .. 1050 hPa.
+#include "test.h"
+#include "sensors.h"
+#include <math.h>
+
+#define STEPS 20000
+
+static const float altitudes_m[] = {0.0f, 35.0f, 250.0f, 520.0f, 1000.0f, 1650.0f, 2500.0f, 3700.0f};
+
+static double reference_factor(double altitude_m) {
+    return pow(1.0 - TEMPERATURE_LAPSE_RATE * altitude_m / SEA_LEVEL_TEMP_K,
+               -(GRAVITY_ACCELERATION * MOLAR_MASS_AIR) / (UNIVERSAL_GAS_CONSTANT * TEMPERATURE_LAPSE_RATE));
+}
+
+static void check_altitude(float altitude_m) {
+    sensors_set_altitude(altitude_m);
+    double factor = reference_factor(altitude_m);
+    double worst_float = 0.0, worst_fixed = 0.0, worst_powf = 0.0;
+    for (int i = 0; i <= STEPS; i++) {
+        // Q24.8 Pa, fractional bits included, as the BMP280 kernels return it
+        double sea_level_hpa = 950.0 + 100.0 * i / STEPS;
+        uint32_t measured = (uint32_t)(sea_level_hpa * 25600.0 / factor);
+        double reference = measured / 25600.0 * factor;
+
+        double float_error = fabs(convert_pressure_to_sea_level((float)measured) - reference);
+        double fixed_error = fabs(convert_pressure_to_sea_level_fixed(measured) / 10.0 - reference);
+        double powf_error = fabs(calculate_sea_level_pressure(measured / 25600.0f, altitude_m) - reference);
+        worst_float = fmax(worst_float, float_error);
+        worst_fixed = fmax(worst_fixed, fixed_error);
+        worst_powf = fmax(worst_powf, powf_error);
+    }
+    printf("%6.0f m: factor %.5f, worst error float %.4f hPa, fixed %.4f hPa, per-sample powf %.4f hPa\n",
+           altitude_m, factor, worst_float, worst_fixed, worst_powf);
+    // Float: a few ulps of 1000 hPa. Fixed: its 0.1 hPa rounding plus the Q15 factor.
+    CHECK(worst_float < 0.001);
+    CHECK(worst_fixed < 0.08);
+    CHECK(worst_powf < 0.001);
+}
+
+static void test_reduction(void) {
+    for (size_t i = 0; i < sizeof(altitudes_m) / sizeof(altitudes_m[0]); i++) {
+        check_altitude(altitudes_m[i]);
+    }
+}
+
+// The integer path holds the top of the BMP280 range at the highest altitude
+static void test_fixed_headroom(void) {
+    sensors_set_altitude(3700.0f);
+    uint32_t measured = 110000u << 8;
+    double reference = 1100.0 * reference_factor(3700.0);
+    CHECK_NEAR(convert_pressure_to_sea_level_fixed(measured) / 10.0, reference, 0.08);
+    sensors_set_altitude(STATION_ALTITUDE_M);
+}
+
+int main(void) {
+    test_reduction();
+    test_fixed_headroom();
+    return test_result("test_sea_level");
+}
@@ -0,0 +1,65 @@
+// Sensor cycle latency on the simulated buses: every sensor triggered and
+// waited for in turn, as sensors_read_all used to, against the overlapped
+// start/collect cycle of sensors_read_all. Both use the same drivers, so the
+// difference is the scheduling alone.
+#include "test.h"
+#include "sensors.h"
+#include "INA219.h"
+#include "SHT40.h"
+#include "BMP280.h"
+
+// One sensor after the other with blocking waits
+static uint32_t sequential_cycle_us(void) {
+    INA219 solar, battery;
+    SHT40 sht40;
+    bmp280 bmp;
+    ina219_init(&solar, INA219_SOLAR_BUS, INA219_I2C_ADDRESS);
+    ina219_init(&battery, INA219_BATTERY_BUS, INA219_BATTERY_I2C_ADDRESS);
+    sht40_init(&sht40, SHT40_BUS, SHT40_I2C_ADDRESS);
+    CHECK(sht40_set_repeatability(&sht40, SHT40_REPEATABILITY));
+    CHECK(bmp280_init(&bmp, BMP280_BUS, BMP280_I2C_ADDRESS) == 1);
+    bmp280_calibrate(&bmp);
+
+    float voltage, current, power, temperature, humidity;
+    uint64_t start_us = hal_time_us();
+    INA219 *monitors[] = {&battery, &solar};
+    for (int i = 0; i < 2; i++) {
+        ina219_start_conversion(monitors[i]);
+        hal_sleep_us(INA219_CONVERSION_TIME_US);
+        CHECK(ina219_collect_data(monitors[i], &voltage, &current, &power));
+        ina219_power_down(monitors[i]);
+    }
+    CHECK(sht40_read_data(&sht40, &temperature, &humidity));
+    CHECK(bmp280_start_measurement(&bmp));
+    hal_sleep_us(BMP280_MEASURE_TIME_US);
+    CHECK(bmp280_read_data(&bmp));
+    return (uint32_t)(hal_time_us() - start_us);
+}
+
+static void test_cycle_latency(void) {
+    StationModels models;
+    test_station_models(&models);
+    sensors_init();
+
+    uint64_t start_us = hal_time_us();
+    SensorData data = sensors_read_all();
+    uint32_t overlapped_us = (uint32_t)(hal_time_us() - start_us);
+    CHECK(data.present == (SENSOR_BIT(SENSOR_CH_COUNT - 2) - 1));
+
+    uint32_t sequential_us = sequential_cycle_us();
+    uint32_t conversions_us = 2 * INA219_CONVERSION_TIME_US + SHT40_MEASURE_TIME_HIGHREP_US + BMP280_MEASURE_TIME_US;
+    printf("sequential: %lu us (conversions %lu us), overlapped: %lu us (longest conversion %lu us)\n",
+           (unsigned long)sequential_us, (unsigned long)conversions_us, (unsigned long)overlapped_us,
+           (unsigned long)BMP280_MEASURE_TIME_US);
+
+    CHECK(sequential_us >= conversions_us);
+    // Roughly the longest conversion: the BMP280, plus its start and collect
+    CHECK(overlapped_us >= BMP280_MEASURE_TIME_US);
+    CHECK(overlapped_us < BMP280_MEASURE_TIME_US + 2000);
+    CHECK(overlapped_us < sequential_us);
+}
+
+int main(void) {
+    test_cycle_latency();
+    return test_result("test_sensor_cycle");
+}
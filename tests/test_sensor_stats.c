@@ -0,0 +1,143 @@
+// Numerical stability of the Welford accumulators: float streams with a
+// large offset and a small spread (pressure in hPa, battery voltage) checked
+// against a two-pass reference in double, next to the float sum-of-squares
+// the accumulator replaces. Then the report built from them.
+#include "test.h"
+#include "sensor_stats.h"
+#include <float.h>
+#include <math.h>
+
+static uint32_t rng_state = 0x9e3779b9;
+
+// xorshift32, fixed seed so a failure reproduces
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Roughly normal, unit deviation: sum of 12 uniforms
+static float gaussian(void) {
+    float sum = 0.0f;
+    for (int i = 0; i < 12; i++) {
+        sum += (rng() >> 8) / 16777216.0f;
+    }
+    return sum - 6.0f;
+}
+
+static float values[20000];
+
+typedef struct {
+    double mean;
+    double stddev;
+} Reference;
+
+static Reference two_pass(const float *data, uint32_t count) {
+    double sum = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += data[i];
+    }
+    double mean = sum / count, m2 = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        m2 += (data[i] - mean) * (data[i] - mean);
+    }
+    return (Reference){mean, sqrt(m2 / (count - 1))};
+}
+
+// The textbook one-pass formula in float, for comparison
+static float naive_stddev(const float *data, uint32_t count) {
+    float sum = 0.0f, squares = 0.0f;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += data[i];
+        squares += data[i] * data[i];
+    }
+    float variance = (squares - sum * sum / count) / (count - 1);
+    return variance > 0.0f ? sqrtf(variance) : 0.0f;
+}
+
+static void check_stream(const char *name, float offset, float spread, float drift, uint32_t count) {
+    WelfordStats stats;
+    welford_reset(&stats);
+    float min = INFINITY, max = -INFINITY;
+    for (uint32_t i = 0; i < count; i++) {
+        values[i] = offset + spread * gaussian() + drift * i / count;
+        welford_add(&stats, values[i]);
+        min = fminf(min, values[i]);
+        max = fmaxf(max, values[i]);
+    }
+    Reference reference = two_pass(values, count);
+    double stddev = welford_stddev(&stats);
+    double mean_error = fabs(welford_mean(&stats) - reference.mean);
+    double stddev_error = fabs(stddev - reference.stddev) / reference.stddev;
+    double naive_error = fabs(naive_stddev(values, count) - reference.stddev) / reference.stddev;
+    printf("%-22s n=%-5lu mean error %.2e, stddev error %.2e (sum of squares %.2e)\n", name,
+           (unsigned long)count, mean_error, stddev_error, naive_error);
+
+    CHECK(stats.count == count);
+    CHECK(stats.min == min && stats.max == max);
+    CHECK(stats.m2 >= 0.0f);
+    // The mean to the float resolution of the offset however long the run,
+    // the deviation to the resolution of the spread
+    CHECK(mean_error <= 2.0 * offset * FLT_EPSILON);
+    CHECK(stddev_error < 1e-4);
+    CHECK(stddev_error < naive_error);
+}
+
+static void test_stability(void) {
+    // A report interval's worth of oversamples, up to far longer runs
+    check_stream("pressure, hPa", 1013.25f, 0.05f, 0.0f, 150);
+    check_stream("pressure, hPa", 1013.25f, 0.05f, 0.0f, 20000);
+    check_stream("pressure falling, hPa", 1013.25f, 0.02f, -1.5f, 5000);
+    check_stream("battery voltage, V", 3.95f, 0.0005f, 0.0f, 5000);
+    check_stream("temperature, DegC", 21.5f, 0.01f, 0.0f, 5000);
+}
+
+// A constant stream has no spread at all, not a rounding residue
+static void test_constant(void) {
+    WelfordStats stats;
+    welford_reset(&stats);
+    CHECK(welford_stddev(&stats) == 0.0f);
+    welford_add(&stats, 1013.25f);
+    CHECK(welford_stddev(&stats) == 0.0f);
+    for (int i = 0; i < 10000; i++) {
+        welford_add(&stats, 1013.25f);
+    }
+    CHECK(welford_mean(&stats) == 1013.25f && stats.m2 == 0.0f && welford_stddev(&stats) == 0.0f);
+}
+
+static void test_report(void) {
+    SensorStats stats;
+    sensor_stats_reset(&stats);
+    SensorData data = {.present = SENSOR_BIT(SENSOR_CH_PRESSURE) | SENSOR_BIT(SENSOR_CH_SOLAR_POWER)};
+    float powers[] = {0.30f, 0.10f, 0.50f, 0.20f};
+    for (int i = 0; i < 4; i++) {
+        data.pressure = 1013.0f + i;
+        data.solar_power = powers[i];
+        sensor_stats_add(&stats, &data);
+    }
+    SensorData report;
+    sensor_stats_report(&stats, &report);
+    CHECK(stats.samples == 4);
+    CHECK(report.present == data.present);
+    CHECK_NEAR(report.pressure, 1014.5f, 1e-4);
+    CHECK_NEAR(report.solar_power, 0.275f, 1e-6);
+    // Spread only for the channels that carry it
+    CHECK(report.spread_present == SENSOR_BIT(SENSOR_CH_SOLAR_POWER));
+    CHECK(report.spread[SENSOR_CH_SOLAR_POWER].min == 0.10f);
+    CHECK(report.spread[SENSOR_CH_SOLAR_POWER].max == 0.50f);
+    CHECK_NEAR(report.spread[SENSOR_CH_SOLAR_POWER].stddev, 0.170783, 1e-6);
+
+    // One sample gives a value without spread
+    sensor_stats_reset(&stats);
+    sensor_stats_add(&stats, &data);
+    sensor_stats_report(&stats, &report);
+    CHECK(report.present == data.present && report.spread_present == 0);
+}
+
+int main(void) {
+    test_stability();
+    test_constant();
+    test_report();
+    return test_result("test_sensor_stats");
+}
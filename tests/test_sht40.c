@@ -0,0 +1,106 @@
+// SHT40 driver against the host device model: frames with the datasheet's
+// CRC-8 are unpacked, any single flipped bit is rejected on both the
+// blocking and the job path, and each repeatability setting sends its own
+// command byte and waits its own conversion time.
+#include "test.h"
+#include "SHT40.h"
+#include "sensors.h"
+#include <string.h>
+
+// Datasheet CRC example: 0xBEEF gives 0x92. 0x6666 is 0.4 of full scale.
+static const uint8_t known_frame[6] = {0x66, 0x66, 0x93, 0xBE, 0xEF, 0x92};
+
+static SHT40 sensor;
+
+static void setup(Sht40Model *model) {
+    hal_host_reset();
+    sht40_model_init(model, SHT40_I2C_ADDRESS);
+    hal_host_i2c_attach(SHT40_BUS, &model->device);
+    sht40_init(&sensor, SHT40_BUS, SHT40_I2C_ADDRESS);
+    hal_sleep_us(1000); // Soft reset
+}
+
+// One measurement whose frame is replaced before it is read
+static bool measure_frame(Sht40Model *model, const uint8_t frame[6], float *temperature, float *humidity) {
+    CHECK(sht40_start_measurement(&sensor));
+    memcpy(model->data, frame, sizeof(model->data));
+    hal_sleep_us(sht40_measure_time_us(&sensor));
+    return sht40_collect_data(&sensor, temperature, humidity);
+}
+
+static void test_known_frame(void) {
+    Sht40Model model;
+    setup(&model);
+    float temperature = 0.0f, humidity = 0.0f;
+    CHECK(measure_frame(&model, known_frame, &temperature, &humidity));
+    // -45 + 175 * 0.4 DegC, -6 + 125 * 48879 / 65535 %RH
+    CHECK_NEAR(temperature, 25.0, 1e-4);
+    CHECK_NEAR(humidity, 87.2303, 1e-3);
+
+    I2cJob job = {.read_length = 6, .result = 6};
+    memcpy(job.read, known_frame, sizeof(known_frame));
+    CHECK(sht40_parse_job(&job, &temperature, &humidity));
+    CHECK_NEAR(temperature, 25.0, 1e-4);
+}
+
+static void test_flipped_bits(void) {
+    Sht40Model model;
+    setup(&model);
+    uint32_t accepted = 0, jobs_accepted = 0;
+    for (int bit = 0; bit < 48; bit++) {
+        uint8_t frame[6];
+        memcpy(frame, known_frame, sizeof(frame));
+        frame[bit / 8] ^= 0x80 >> (bit % 8);
+        float temperature = -99.0f, humidity = -99.0f;
+        accepted += measure_frame(&model, frame, &temperature, &humidity);
+        // Nothing is written out of a rejected frame
+        CHECK(temperature == -99.0f && humidity == -99.0f);
+
+        I2cJob job = {.read_length = 6, .result = 6};
+        memcpy(job.read, frame, sizeof(frame));
+        jobs_accepted += sht40_parse_job(&job, &temperature, &humidity);
+    }
+    CHECK(accepted == 0 && jobs_accepted == 0);
+    CHECK(model.measurements == 48);
+}
+
+static void test_repeatability(void) {
+    static const struct {
+        uint8_t command;
+        uint32_t time_us;
+    } settings[] = {
+        {SHT40_MEASURE_HIGHREP_STRETCH, SHT40_MEASURE_TIME_HIGHREP_US},
+        {SHT40_MEASURE_MEDREP_STRETCH, SHT40_MEASURE_TIME_MEDREP_US},
+        {SHT40_MEASURE_LOWREP_STRETCH, SHT40_MEASURE_TIME_LOWREP_US},
+    };
+    Sht40Model model;
+    setup(&model);
+    CHECK(sensor.measure_cmd == SHT40_MEASURE_HIGHREP_STRETCH); // The default
+    for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+        CHECK(sht40_set_repeatability(&sensor, settings[i].command));
+        CHECK(sht40_measure_time_us(&sensor) == settings[i].time_us);
+
+        model.temperature = 10.0f + i;
+        float temperature, humidity;
+        CHECK(sht40_start_measurement(&sensor));
+        CHECK(model.last_command == settings[i].command);
+        // The chip NAKs halfway through, the result is there on time
+        hal_sleep_us(settings[i].time_us / 2);
+        CHECK(!sht40_collect_data(&sensor, &temperature, &humidity));
+        hal_sleep_us(settings[i].time_us - settings[i].time_us / 2);
+        CHECK(sht40_collect_data(&sensor, &temperature, &humidity));
+        CHECK_NEAR(temperature, 10.0f + i, 0.01);
+    }
+
+    // Anything else is refused and the setting stays
+    CHECK(!sht40_set_repeatability(&sensor, SHT40_SOFT_RESET));
+    CHECK(sensor.measure_cmd == SHT40_MEASURE_LOWREP_STRETCH);
+    CHECK(sht40_measure_time_us(&sensor) == SHT40_MEASURE_TIME_LOWREP_US);
+}
+
+int main(void) {
+    test_known_frame();
+    test_flipped_bits();
+    test_repeatability();
+    return test_result("test_sht40");
+}
@@ -0,0 +1,84 @@
+// Producer/consumer stress test of spsc_queue on two threads, as core 0 and
+// core 1 use it: every element arrives once, in order, uncorrupted. A small
+// ring keeps it full and empty most of the time, and head/tail start just
+// below 2^32 so the counters wrap during the run.
+#include "test.h"
+#include "spsc_queue.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define STRESS_ELEMENTS 2000000u
+#define STRESS_CAPACITY 8
+
+// Bigger than a word so a torn copy shows up
+typedef struct {
+    uint32_t sequence;
+    uint32_t payload[5];
+    uint32_t check;
+} StressElement;
+
+static SpscQueue queue;
+static StressElement storage[STRESS_CAPACITY];
+static uint32_t producer_full;
+
+static uint32_t stress_check(const StressElement *element) {
+    uint32_t check = element->sequence * 2654435761u;
+    for (int i = 0; i < 5; i++) {
+        check ^= element->payload[i] + i;
+    }
+    return check;
+}
+
+static void *producer(void *arg) {
+    for (uint32_t sequence = 0; sequence < STRESS_ELEMENTS; sequence++) {
+        StressElement element = {.sequence = sequence};
+        for (int i = 0; i < 5; i++) {
+            element.payload[i] = sequence * (i + 3) + 0x5A5A5A5Au;
+        }
+        element.check = stress_check(&element);
+        while (!spsc_queue_push(&queue, &element)) {
+            producer_full++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int main(void) {
+    CHECK(spsc_queue_init(&queue, storage, sizeof(StressElement), STRESS_CAPACITY));
+    atomic_store(&queue.head, 0xFFFFFF00u);
+    atomic_store(&queue.tail, 0xFFFFFF00u);
+
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, producer, NULL) == 0);
+
+    uint32_t expected = 0, out_of_order = 0, corrupt = 0, empty = 0;
+    while (expected < STRESS_ELEMENTS) {
+        StressElement element;
+        if (!spsc_queue_pop(&queue, &element)) {
+            empty++;
+            sched_yield();
+            continue;
+        }
+        if (element.sequence != expected) {
+            out_of_order++;
+        }
+        if (element.check != stress_check(&element)) {
+            corrupt++;
+        }
+        expected = element.sequence + 1;
+    }
+    pthread_join(thread, NULL);
+
+    StressElement extra;
+    printf("%u elements, %u pushes on a full ring, %u pops on an empty one, high watermark %u\n",
+           STRESS_ELEMENTS, producer_full, empty, spsc_queue_high_watermark(&queue));
+    CHECK(out_of_order == 0);
+    CHECK(corrupt == 0);
+    CHECK(!spsc_queue_pop(&queue, &extra));
+    CHECK(spsc_queue_depth(&queue) == 0);
+    CHECK(spsc_queue_overruns(&queue) == producer_full);
+    CHECK(spsc_queue_high_watermark(&queue) <= STRESS_CAPACITY);
+    CHECK(atomic_load(&queue.head) == 0xFFFFFF00u + STRESS_ELEMENTS);
+    return test_result("test_spsc_queue");
+}
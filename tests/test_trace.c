@@ -0,0 +1,133 @@
+// The per-core trace rings of trace.c, built against the SDK stand-ins in
+// host/sdk: records written past the ring capacity, drained with trace_dump
+// and parsed back. Each core keeps its own last TRACE_RING_SIZE records,
+// oldest first, across a wrap of the microsecond timer; nothing is recorded
+// while tracing is off.
+#include "test.h"
+#include "trace.h"
+#include "pico/stdlib.h"
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    TraceRecord records[2][TRACE_RING_SIZE + 1];
+    uint32_t count[2];
+    uint32_t malformed;
+    bool begun, ended;
+} Dump;
+
+static void record(uint32_t core, uint32_t timestamp_us, uint16_t event, uint16_t arg) {
+    pico_host_core = core;
+    pico_host_time_us = timestamp_us;
+    trace_record(event, arg);
+}
+
+// trace_dump prints on stdout, run it into a file and parse that
+static void dump(Dump *out) {
+    memset(out, 0, sizeof(*out));
+    FILE *file = tmpfile();
+    CHECK(file != NULL);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fileno(file), STDOUT_FILENO);
+    trace_dump();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    rewind(file);
+
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long core, timestamp;
+        unsigned event, arg;
+        if (strcmp(line, "trace,begin\n") == 0) {
+            out->begun = !out->begun && !out->ended;
+        } else if (strcmp(line, "trace,end\n") == 0) {
+            out->ended = out->begun;
+        } else if (sscanf(line, "trace,%lu,%lu,%u,%u", &core, &timestamp, &event, &arg) == 4 && out->begun &&
+                   !out->ended && core < 2 && out->count[core] <= TRACE_RING_SIZE) {
+            out->records[core][out->count[core]++] =
+                (TraceRecord){.timestamp_us = (uint32_t)timestamp, .event = (uint16_t)event, .arg = (uint16_t)arg};
+        } else {
+            out->malformed++;
+        }
+    }
+    fclose(file);
+    CHECK(out->begun && out->ended && out->malformed == 0);
+}
+
+static void test_partial(void) {
+    for (uint16_t i = 0; i < 5; i++) {
+        record(0, 1000 + i, TRACE_I2C_READ | TRACE_PHASE_BEGIN, 0x7600 | i);
+    }
+    Dump d;
+    dump(&d);
+    CHECK(d.count[0] == 5 && d.count[1] == 0);
+    for (uint16_t i = 0; i < d.count[0]; i++) {
+        CHECK(d.records[0][i].timestamp_us == 1000u + i);
+        CHECK(d.records[0][i].event == (TRACE_I2C_READ | TRACE_PHASE_BEGIN));
+        CHECK(d.records[0][i].arg == (0x7600 | i));
+    }
+}
+
+// Both rings overwritten several times over, the timer wrapping halfway.
+// Core 1 is written in bursts between core 0's records: neither ring sees
+// the other's writes.
+static void test_wrap(void) {
+    const uint32_t core0_total = 2 * TRACE_RING_SIZE + 37, core1_total = TRACE_RING_SIZE + 1;
+    const uint32_t start_us = 0u - 2 * (core0_total - TRACE_RING_SIZE / 2);
+    uint32_t core1_written = 0;
+    for (uint32_t i = 0; i < core0_total; i++) {
+        record(0, start_us + 2 * i, TRACE_SPI_WRITE, (uint16_t)i);
+        if (i % 2 == 0 && core1_written < core1_total) {
+            record(1, start_us + 2 * i + 1, TRACE_CC1101_STATE, (uint16_t)core1_written++);
+        }
+    }
+    CHECK(core1_written == core1_total);
+
+    Dump d;
+    dump(&d);
+    CHECK(d.count[0] == TRACE_RING_SIZE && d.count[1] == TRACE_RING_SIZE);
+    for (uint32_t i = 0; i < d.count[0]; i++) {
+        uint32_t written = core0_total - TRACE_RING_SIZE + i;
+        CHECK(d.records[0][i].arg == (uint16_t)written);
+        CHECK(d.records[0][i].event == TRACE_SPI_WRITE);
+        CHECK(d.records[0][i].timestamp_us == start_us + 2 * written);
+    }
+    for (uint32_t i = 0; i < d.count[1]; i++) {
+        uint32_t written = core1_total - TRACE_RING_SIZE + i;
+        CHECK(d.records[1][i].arg == (uint16_t)written);
+        CHECK(d.records[1][i].event == TRACE_CC1101_STATE);
+        CHECK(d.records[1][i].timestamp_us == start_us + 4 * written + 1);
+    }
+    // The timer wrapped inside the ring, the dump is still in write order
+    CHECK(d.records[0][0].timestamp_us > d.records[0][TRACE_RING_SIZE - 1].timestamp_us);
+}
+
+static void test_disabled(void) {
+    Dump before, after;
+    dump(&before);
+    trace_set_enabled(false);
+    record(0, 5, TRACE_SLEEP, 1);
+    record(1, 6, TRACE_SLEEP, 2);
+    // Dumping while off leaves tracing off
+    dump(&after);
+    record(0, 7, TRACE_SLEEP, 3);
+    dump(&after);
+    CHECK(after.count[0] == before.count[0] && after.count[1] == before.count[1]);
+    CHECK(memcmp(after.records, before.records, sizeof(before.records)) == 0);
+
+    trace_set_enabled(true);
+    record(0, 8, TRACE_SLEEP, 4);
+    dump(&after);
+    CHECK(after.count[0] == TRACE_RING_SIZE);
+    CHECK(after.records[0][TRACE_RING_SIZE - 1].arg == 4);
+    CHECK(after.records[0][TRACE_RING_SIZE - 2].arg == before.records[0][TRACE_RING_SIZE - 1].arg);
+}
+
+int main(void) {
+    test_partial();
+    test_wrap();
+    test_disabled();
+    return test_result("test_trace");
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Check tools/trace_to_perfetto.py against a known dump, tests/trace_dump.txt.
+
+Core 0 runs a sensor cycle with two I2C reads (the second failing) and a
+sleep across a wrap of the microsecond timer; core 1 strobes the CC1101 into
+TX and back to IDLE. Lines outside the trace block are console noise.
+
+    tests/test_trace_to_perfetto.py tools/trace_to_perfetto.py tests/trace_dump.txt
+"""
+import json
+import subprocess
+import sys
+
+EXPECTED = [
+    {"name": "sensor_cycle", "ts": 100, "pid": 0, "tid": 0, "ph": "B", "args": {"arg": 0}},
+    {"name": "i2c_read", "ts": 110, "pid": 0, "tid": 0, "ph": "B", "args": {"address": "0x76", "length": 6}},
+    {"name": "i2c_read", "ts": 190, "pid": 0, "tid": 0, "ph": "E", "args": {"result": 6}},
+    {"name": "i2c_read", "ts": 200, "pid": 0, "tid": 0, "ph": "B", "args": {"address": "0x76", "length": 6}},
+    {"name": "i2c_read", "ts": 250, "pid": 0, "tid": 0, "ph": "E", "args": {"result": -2}},
+    {"name": "sleep", "ts": 4294967290, "pid": 0, "tid": 0, "ph": "i", "s": "t", "args": {"arg": 500}},
+    # The timer wrapped: 20 us after it is 2^32 + 20
+    {"name": "sensor_cycle", "ts": (1 << 32) + 20, "pid": 0, "tid": 0, "ph": "E", "args": {"result": 0}},
+    {"name": "cc1101_strobe", "ts": 50, "pid": 0, "tid": 1, "ph": "i", "s": "t", "args": {"strobe": "STX"}},
+    # States become slices once the next one starts; the last has no end yet
+    {"name": "TX_LOAD", "ph": "X", "ts": 60, "dur": 20, "pid": 0, "tid": 100},
+    {"name": "TX_WAIT_END", "ph": "X", "ts": 80, "dur": 1920, "pid": 0, "tid": 100},
+]
+
+
+def main():
+    converter, dump = sys.argv[1:3]
+    output = subprocess.run([sys.executable, converter, dump], check=True, capture_output=True, text=True).stdout
+    trace = json.loads(output)
+    events = [event for event in trace["traceEvents"] if event["ph"] != "M"]
+    threads = {event["tid"]: event["args"]["name"] for event in trace["traceEvents"]
+               if event["name"] == "thread_name"}
+
+    failures = 0
+    if threads != {0: "core 0", 1: "core 1", 100: "cc1101 state"}:
+        print("thread names: %s" % threads)
+        failures += 1
+    for i in range(max(len(events), len(EXPECTED))):
+        got = events[i] if i < len(events) else None
+        expected = EXPECTED[i] if i < len(EXPECTED) else None
+        if got != expected:
+            print("event %d: got %s, expected %s" % (i, got, expected))
+            failures += 1
+    # Every begin has its end on the same track
+    for tid in threads:
+        depth = 0
+        for event in events:
+            if event["tid"] == tid and event["ph"] in "BE":
+                depth += 1 if event["ph"] == "B" else -1
+                failures += depth < 0
+        failures += depth != 0
+
+    print("test_trace_to_perfetto: %s (%d failed checks)" % ("FAIL" if failures else "PASS", failures))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
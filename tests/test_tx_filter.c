@@ -0,0 +1,156 @@
+// Send-on-delta on weather traces: a calm night and a day with a front
+// passing, hourly readings of a station interpolated to the 10 s report
+// cadence with sensor noise on top. Every report goes through
+// tx_filter_check; the frames that go out are encoded with a sequence number
+// of their own, so the receiver sees no gaps from suppression. Airtime is
+// compared against sending every report.
+#include "test.h"
+#include "tx_filter.h"
+#include "packet.h"
+#include "radio.h"
+#include <math.h>
+
+#define HOUR_MS (3600 * 1000u)
+#define REPORT_INTERVAL_MS 10000
+
+typedef struct {
+    const char *name;
+    // On the hour, the last entry closes the trace
+    float temperature[13];
+    float pressure[13];
+    float humidity[13];
+    float solar_power[13];
+} WeatherTrace;
+
+static const WeatherTrace calm_night = {
+    "calm night",
+    {14.2f, 13.6f, 13.0f, 12.5f, 12.0f, 11.6f, 11.2f, 10.9f, 10.6f, 10.3f, 10.1f, 9.9f, 9.8f},
+    {1016.4f, 1016.4f, 1016.3f, 1016.3f, 1016.2f, 1016.2f, 1016.1f, 1016.1f, 1016.1f, 1016.0f, 1016.0f,
+     1016.1f, 1016.1f},
+    {68.0f, 70.0f, 72.0f, 74.0f, 76.0f, 78.0f, 80.0f, 82.0f, 84.0f, 85.0f, 86.0f, 87.0f, 88.0f},
+    {0},
+};
+
+static const WeatherTrace front = {
+    "front passing",
+    {12.0f, 13.5f, 15.2f, 17.0f, 18.4f, 16.1f, 13.2f, 12.8f, 13.4f, 14.0f, 13.6f, 12.9f, 12.1f},
+    {1012.0f, 1010.8f, 1009.1f, 1007.2f, 1005.0f, 1003.1f, 1003.8f, 1005.6f, 1007.3f, 1008.6f, 1009.5f,
+     1010.1f, 1010.5f},
+    {75.0f, 70.0f, 64.0f, 60.0f, 66.0f, 88.0f, 95.0f, 93.0f, 85.0f, 78.0f, 76.0f, 78.0f, 80.0f},
+    {0.05f, 0.20f, 0.45f, 0.70f, 0.30f, 0.05f, 0.02f, 0.10f, 0.35f, 0.40f, 0.25f, 0.10f, 0.02f},
+};
+
+static uint32_t rng_state = 0x13579bdf;
+
+// xorshift32, fixed seed so a failure reproduces
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float noise(float peak) {
+    return ((int32_t)(rng() % 2001) - 1000) / 1000.0f * peak;
+}
+
+static float interpolate(const float *hourly, uint32_t t_ms) {
+    uint32_t hour = t_ms / HOUR_MS;
+    float fraction = (float)(t_ms % HOUR_MS) / HOUR_MS;
+    return hourly[hour] + (hourly[hour + 1] - hourly[hour]) * fraction;
+}
+
+// A report as main.c builds it, noise about what the sensors show at rest
+static SensorData trace_report(const WeatherTrace *trace, uint32_t t_ms) {
+    SensorData data = {0};
+    data.temperature = interpolate(trace->temperature, t_ms) + 1.5f + noise(0.03f);
+    data.pressure = interpolate(trace->pressure, t_ms) + noise(0.12f);
+    data.exterior_temperature = interpolate(trace->temperature, t_ms) + noise(0.03f);
+    data.exterior_humidity = interpolate(trace->humidity, t_ms) + noise(0.3f);
+    data.battery_voltage = 3.95f + noise(0.01f);
+    data.solar_power = interpolate(trace->solar_power, t_ms);
+    data.sample_interval = REPORT_INTERVAL_MS / 1000.0f;
+    data.tx_interval = REPORT_INTERVAL_MS / 1000.0f;
+    data.present = SENSOR_BIT(SENSOR_CH_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_PRESSURE) |
+                   SENSOR_BIT(SENSOR_CH_EXTERIOR_TEMPERATURE) | SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY) |
+                   SENSOR_BIT(SENSOR_CH_BATTERY_VOLTAGE) | SENSOR_BIT(SENSOR_CH_SOLAR_POWER) |
+                   SENSOR_BIT(SENSOR_CH_SAMPLE_INTERVAL) | SENSOR_BIT(SENSOR_CH_TX_INTERVAL);
+    return data;
+}
+
+static uint32_t frame_airtime_us(const SensorData *data) {
+    return radio_airtime_us(PACKET_HEADER_SIZE + packet_batch_sample_size(data) - PACKET_AGE_SIZE);
+}
+
+// Runs the trace, returns the airtime with the filter in percent of sending every report
+static uint32_t run_trace(const WeatherTrace *trace) {
+    TxFilter filter;
+    tx_filter_init(&filter);
+    uint64_t all_us = 0, sent_us = 0;
+    uint64_t last_sent_ms = 0;
+    uint32_t longest_silence_ms = 0, stale = 0;
+    uint8_t sequence = 0;
+    SensorData received = {0};
+
+    for (uint32_t t_ms = 0; t_ms < 12 * HOUR_MS; t_ms += REPORT_INTERVAL_MS) {
+        SensorData report = trace_report(trace, t_ms);
+        all_us += frame_airtime_us(&report);
+        if (tx_filter_check(&filter, &report, (uint64_t)t_ms * 1000)) {
+            uint8_t buffer[PACKET_MAX_SIZE];
+            uint8_t length = packet_encode(&report, sequence, buffer, sizeof(buffer));
+            CHECK(length > 0 && packet_decode(buffer, length, &received));
+            // Suppressed reports do not use up sequence numbers
+            CHECK(packet_sequence(buffer) == sequence);
+            sequence++;
+            sent_us += frame_airtime_us(&report);
+            if (t_ms - last_sent_ms > longest_silence_ms) {
+                longest_silence_ms = t_ms - last_sent_ms;
+            }
+            last_sent_ms = t_ms;
+        }
+
+        // The receiver's last sample stays within the deadbands of the truth,
+        // give or take the wire resolution
+        if (fabsf(received.temperature - report.temperature) > TX_FILTER_DEADBAND_TEMPERATURE + 0.01f ||
+            fabsf(received.pressure - report.pressure) > TX_FILTER_DEADBAND_PRESSURE + 0.1f ||
+            fabsf(received.exterior_humidity - report.exterior_humidity) > TX_FILTER_DEADBAND_HUMIDITY + 0.01f ||
+            fabsf(received.solar_power - report.solar_power) > TX_FILTER_DEADBAND_POWER + 0.001f) {
+            stale++;
+        }
+    }
+
+    uint32_t percent = (uint32_t)(sent_us * 100 / all_us);
+    printf("%s: %lu sent, %lu suppressed, airtime %lu of %lu ms (%lu%%), longest silence %lu s\n", trace->name,
+           (unsigned long)filter.sent, (unsigned long)filter.suppressed, (unsigned long)(sent_us / 1000),
+           (unsigned long)(all_us / 1000), (unsigned long)percent, (unsigned long)(longest_silence_ms / 1000));
+    CHECK(filter.sent + filter.suppressed == 12 * HOUR_MS / REPORT_INTERVAL_MS);
+    CHECK(longest_silence_ms <= TX_FILTER_MAX_SILENCE_MS);
+    CHECK(stale == 0);
+    return percent;
+}
+
+static void test_weather_traces(void) {
+    uint32_t night = run_trace(&calm_night);
+    uint32_t day = run_trace(&front);
+    // A calm night is heartbeats only, the front adds what crossed a deadband
+    CHECK(night <= 2);
+    CHECK(day > night && day <= 5);
+}
+
+// A channel dropping out goes out at once, whatever the deadbands
+static void test_presence_change(void) {
+    TxFilter filter;
+    tx_filter_init(&filter);
+    SensorData data = trace_report(&calm_night, 0);
+    CHECK(tx_filter_check(&filter, &data, 0));
+    CHECK(!tx_filter_check(&filter, &data, 10000000));
+    data.present &= ~SENSOR_BIT(SENSOR_CH_EXTERIOR_HUMIDITY);
+    CHECK(tx_filter_check(&filter, &data, 20000000));
+    CHECK(filter.sent == 2 && filter.suppressed == 1);
+}
+
+int main(void) {
+    test_weather_traces();
+    test_presence_change();
+    return test_result("test_tx_filter");
+}
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Decode tokenized log records from the weather station firmware.
+
+Reads the raw stdio stream (a serial port or a capture file), rebuilds each
+LOG() record from the format strings in the firmware ELF and passes any plain
+text through unchanged.
+
+    tools/log_decode.py build/weather_station.elf /dev/ttyACM0
+    tools/log_decode.py build/weather_station.elf capture.bin
+
+Record layout is defined in log.h.
+"""
+import argparse
+import re
+import struct
+import sys
+
+LOG_RECORD_SYNC = 0x1E
+LOG_RECORD_HEADER_SIZE = 10
+LOG_MAX_ARGS = 8
+LEVELS = ("E", "W", "I", "D")
+
+SHT_PROGBITS = 1
+SHF_ALLOC = 0x2
+
+SPEC = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|ll|l|z|j|t)?([diouxXfFeEgGcsp%])")
+
+
+class Image:
+    """Loadable sections of the ELF, for looking up strings by address."""
+
+    def __init__(self, path):
+        self.sections = []
+        with open(path, "rb") as f:
+            elf = f.read()
+        if elf[:4] != b"\x7fELF":
+            raise ValueError("%s is not an ELF file" % path)
+        # Section headers only, 32 bit (the firmware) or 64 bit (host tests)
+        order = "<" if elf[5] == 1 else ">"
+        if elf[4] == 1:
+            shoff, = struct.unpack_from(order + "I", elf, 0x20)
+            shentsize, shnum = struct.unpack_from(order + "HH", elf, 0x2E)
+            header = order + "IIIIII"
+        else:
+            shoff, = struct.unpack_from(order + "Q", elf, 0x28)
+            shentsize, shnum = struct.unpack_from(order + "HH", elf, 0x3A)
+            header = order + "IIQQQQ"
+        for i in range(shnum):
+            _, sh_type, sh_flags, sh_addr, sh_offset, sh_size = struct.unpack_from(header, elf, shoff + i * shentsize)
+            if sh_type == SHT_PROGBITS and sh_flags & SHF_ALLOC:
+                self.sections.append((sh_addr, elf[sh_offset:sh_offset + sh_size]))
+
+    def string(self, address):
+        for base, data in self.sections:
+            if base <= address < base + len(data):
+                end = data.index(b"\0", address - base)
+                return data[address - base:end].decode("utf-8", "replace")
+        return None
+
+
+def format_record(image, fmt, args):
+    args = list(args)
+
+    def substitute(match):
+        flags, _, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        if not args:
+            return "<missing>"
+        word = args.pop(0)
+        if conversion in "fFeEgG":
+            value = struct.unpack("<f", struct.pack("<I", word))[0]
+            return ("%" + flags + conversion) % value
+        if conversion in "di":
+            value = word - (1 << 32) if word & 0x80000000 else word
+            return ("%" + flags + "d") % value
+        if conversion == "c":
+            return chr(word & 0xFF)
+        if conversion == "s":
+            text = image.string(word)
+            return text if text is not None else "<0x%08x>" % word
+        if conversion == "p":
+            return "0x%08x" % word
+        return ("%" + flags + conversion) % word
+
+    return SPEC.sub(substitute, fmt)
+
+
+def decode(image, stream, out):
+    pending = bytearray()
+    while True:
+        chunk = stream.read(1) if not pending else b""
+        if chunk:
+            pending += chunk
+        elif not pending:
+            return
+
+        if pending[0] != LOG_RECORD_SYNC:
+            out.write(pending[:1].decode("utf-8", "replace"))
+            del pending[:1]
+            continue
+        if len(pending) < 2:
+            chunk = stream.read(1)
+            if not chunk:
+                return
+            pending += chunk
+        arg_count = pending[1] & 0x0F
+        size = LOG_RECORD_HEADER_SIZE + arg_count * 4
+        if arg_count > LOG_MAX_ARGS:
+            out.write(pending[:1].decode("utf-8", "replace"))
+            del pending[:1]
+            continue
+        while len(pending) < size:
+            chunk = stream.read(size - len(pending))
+            if not chunk:
+                return
+            pending += chunk
+
+        level = pending[1] >> 4
+        timestamp, address = struct.unpack_from("<II", pending, 2)
+        args = struct.unpack_from("<%dI" % arg_count, pending, LOG_RECORD_HEADER_SIZE)
+        del pending[:size]
+
+        fmt = image.string(address)
+        if fmt is None:
+            out.write("[%10.6f] ? unknown format 0x%08x %s\n" % (timestamp / 1e6, address, args))
+            continue
+        text = format_record(image, fmt, args)
+        level_name = LEVELS[level] if level < len(LEVELS) else str(level)
+        out.write("[%10.6f] %s %s" % (timestamp / 1e6, level_name, text))
+        if not text.endswith("\n"):
+            out.write("\n")
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF the stream was produced by")
+    parser.add_argument("input", nargs="?", help="serial device or capture file (default: stdin)")
+    args = parser.parse_args()
+
+    image = Image(args.elf)
+    stream = open(args.input, "rb", buffering=0) if args.input else sys.stdin.buffer
+    decode(image, stream, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,239 @@
+// Host simulation of the store-and-forward sample log (sample_log.c) on
+// simulated NOR flash: an outage logs every report, an optional reset
+// half-way re-scans the ring, then the backlog is sent back to back.
+// Reports write amplification, sector wear and the backfill rate, and what
+// backfill frames would carry if records kept the reports' spread. With
+// corrupt, bits flip in two logged pages before the backfill (the oldest
+// and one further on): both have to be skipped.
+//
+//     cc -O2 -I. -o sample_log_sim tools/sample_log_sim.c sample_log.c packet.c crc32.c
+//     ./sample_log_sim [outage_hours] [report_interval_s] [reset] [corrupt]
+//
+// Airtime is computed like radio_airtime_us; flash timing uses typical
+// W25Q16JV figures (page program 0.4 ms, sector erase 45 ms).
+#include "sample_log.h"
+#include "radio.h"
+#include "sensor_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_SECTORS 64 // As on the station, see main.c
+#define SIM_FLASH_SIZE (SIM_SECTORS * SAMPLE_LOG_SECTOR_SIZE)
+#define SIM_PROGRAM_US 400
+#define SIM_ERASE_US 45000
+#define SIM_TURNAROUND_US 1000 // Station TX->RX plus gateway RX->TX, calibration included
+
+static uint8_t flash[SIM_FLASH_SIZE];
+static uint32_t sector_erases[SIM_SECTORS];
+static uint64_t flash_busy_us;
+
+static bool sim_erase(uint32_t offset, size_t length) {
+    if (offset % SAMPLE_LOG_SECTOR_SIZE != 0 || length % SAMPLE_LOG_SECTOR_SIZE != 0 ||
+        offset + length > SIM_FLASH_SIZE) {
+        return false;
+    }
+    memset(&flash[offset], 0xFF, length);
+    for (uint32_t sector = offset / SAMPLE_LOG_SECTOR_SIZE; sector < (offset + length) / SAMPLE_LOG_SECTOR_SIZE;
+         sector++) {
+        sector_erases[sector]++;
+        flash_busy_us += SIM_ERASE_US;
+    }
+    return true;
+}
+
+// NOR programming only clears bits
+static bool sim_program(uint32_t offset, const uint8_t *src, size_t length) {
+    if (offset % SAMPLE_LOG_PAGE_SIZE != 0 || length % SAMPLE_LOG_PAGE_SIZE != 0 ||
+        offset + length > SIM_FLASH_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        flash[offset + i] &= src[i];
+    }
+    flash_busy_us += SIM_PROGRAM_US * (length / SAMPLE_LOG_PAGE_SIZE);
+    return true;
+}
+
+static const uint8_t *sim_read(uint32_t offset) {
+    return &flash[offset];
+}
+
+static const SampleLogFlash sim_flash = {
+    .offset = 0,
+    .sectors = SIM_SECTORS,
+    .erase = sim_erase,
+    .program = sim_program,
+    .read = sim_read,
+    .erase_max_us = SIM_ERASE_US,
+    .program_max_us = SIM_PROGRAM_US,
+};
+
+static uint32_t sim_airtime_us(uint8_t payload_length) {
+    uint32_t bits = (RADIO_FRAME_OVERHEAD + payload_length) * 8;
+    return (uint32_t)(((uint64_t)bits * 1000000 + RADIO_DATA_RATE_BPS - 1) / RADIO_DATA_RATE_BPS);
+}
+
+// A full report as sensor_stats_report builds it, tagged with its index in
+// sample_interval so delivery order can be checked
+static void sim_report(uint32_t index, SensorData *data) {
+    memset(data, 0, sizeof(*data));
+    data->temperature = 21.5f + (index % 50) * 0.01f;
+    data->pressure = 1013.2f;
+    data->exterior_temperature = 12.3f;
+    data->exterior_humidity = 64.0f;
+    data->battery_voltage = 3.9f;
+    data->battery_current = 0.012f;
+    data->battery_power = 0.047f;
+    data->solar_voltage = 5.1f;
+    data->solar_current = 0.08f;
+    data->solar_power = 0.41f;
+    data->sample_interval = (float)(index % 30000);
+    data->tx_interval = 60.0f;
+    data->present = (1u << SENSOR_CH_COUNT) - 1;
+    data->spread_present = STATS_SPREAD_CHANNELS;
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (data->spread_present & SENSOR_BIT(ch)) {
+            data->spread[ch] = (SensorSpread){0.9f, 1.1f, 0.05f};
+        }
+    }
+}
+
+// sample_log_init starts the counters over
+static void sim_add_stats(SampleLogStats *total, const SampleLogStats *stats) {
+    total->appended += stats->appended;
+    total->delivered += stats->delivered;
+    total->dropped += stats->dropped;
+    total->record_bytes += stats->record_bytes;
+    total->programmed_bytes += stats->programmed_bytes;
+    total->erases += stats->erases;
+    total->write_errors += stats->write_errors;
+    total->read_errors += stats->read_errors;
+}
+
+int main(int argc, char **argv) {
+    double outage_hours = argc > 1 ? atof(argv[1]) : 24.0;
+    uint32_t interval_s = argc > 2 ? (uint32_t)atoi(argv[2]) : 60;
+    bool reset = false, corrupt = false;
+    for (int i = 3; i < argc; i++) {
+        reset = reset || strcmp(argv[i], "reset") == 0;
+        corrupt = corrupt || strcmp(argv[i], "corrupt") == 0;
+    }
+    uint32_t reports = (uint32_t)(outage_hours * 3600.0 / interval_s);
+
+    memset(flash, 0xFF, sizeof(flash));
+    sample_log_init(&sim_flash);
+
+    // Outage: every report is logged
+    SampleLogStats before_reset = {0};
+    uint32_t time_ms = 0;
+    for (uint32_t i = 0; i < reports; i++) {
+        if (reset && i == reports / 2) {
+            sample_log_get_stats(&before_reset);
+            sample_log_init(&sim_flash); // The RAM page is lost with the reset
+            time_ms = 0;
+        }
+        SensorData data;
+        sim_report(i, &data);
+        sample_log_append(&data, time_ms);
+        sample_log_sync(UINT32_MAX); // The station's idle point between reports
+        time_ms += interval_s * 1000;
+    }
+    SampleLogStats outage = before_reset;
+    SampleLogStats stats;
+    sample_log_get_stats(&stats);
+    sim_add_stats(&outage, &stats);
+    uint64_t outage_flash_us = flash_busy_us;
+
+    // The ring starts at page 0 and has not wrapped for these outages
+    if (corrupt) {
+        flash[SAMPLE_LOG_PAGE_HEADER_SIZE + 3] ^= 0x10;
+        flash[10 * SAMPLE_LOG_PAGE_SIZE + SAMPLE_LOG_PAGE_HEADER_SIZE + 7] ^= 0x01;
+    }
+
+    // Backfill: full frames back to back, each acknowledged
+    uint64_t backfill_us = 0;
+    uint32_t frames = 0, delivered = 0, unknown_age = 0, out_of_order = 0;
+    int32_t last_tag = -1;
+    SensorData samples[RADIO_BATCH_MAX_SAMPLES];
+    uint32_t ages_ms[RADIO_BATCH_MAX_SAMPLES], frame_ages_ms[RADIO_BATCH_MAX_SAMPLES];
+    uint8_t body[RADIO_MAX_PAYLOAD - PACKET_BATCH_HEADER_SIZE];
+    uint8_t frame[RADIO_MAX_PAYLOAD];
+    while (sample_log_pending() > 0) {
+        uint64_t busy_before = flash_busy_us;
+        uint8_t body_length;
+        uint8_t count = sample_log_peek(body, &body_length, ages_ms, RADIO_BATCH_MAX_SAMPLES, sizeof(body),
+                                        time_ms + (uint32_t)(backfill_us / 1000));
+        uint8_t length = count > 0 ? packet_encode_batch_body(body, body_length, count, (uint8_t)frames, frame,
+                                                              sizeof(frame))
+                                   : 0;
+        // As the gateway decodes it
+        uint8_t decoded = 0;
+        if (length == 0 ||
+            !packet_decode_batch(frame, length, samples, frame_ages_ms, RADIO_BATCH_MAX_SAMPLES, &decoded) ||
+            decoded != count) {
+            printf("Backfill stuck with %u pending\n", (unsigned)sample_log_pending());
+            return 1;
+        }
+        sample_log_consume(count);
+        sample_log_sync(UINT32_MAX);
+        backfill_us += sim_airtime_us(length) + sim_airtime_us(PACKET_ACK_SIZE) + SIM_TURNAROUND_US +
+                       (flash_busy_us - busy_before);
+        for (uint8_t i = 0; i < count; i++) {
+            int32_t tag = (int32_t)samples[i].sample_interval;
+            if (tag <= last_tag) {
+                out_of_order++;
+            }
+            last_tag = tag;
+            if (ages_ms[i] == SAMPLE_LOG_AGE_UNKNOWN) {
+                unknown_age++;
+            }
+        }
+        frames++;
+        delivered += count;
+    }
+
+    SampleLogStats total = before_reset;
+    sample_log_get_stats(&stats);
+    sim_add_stats(&total, &stats);
+    uint32_t min_erases = UINT32_MAX, max_erases = 0;
+    for (uint32_t i = 0; i < SIM_SECTORS; i++) {
+        min_erases = sector_erases[i] < min_erases ? sector_erases[i] : min_erases;
+        max_erases = sector_erases[i] > max_erases ? sector_erases[i] : max_erases;
+    }
+
+    printf("Outage: %.1f h, one report every %u s, %u reports%s\n", outage_hours, (unsigned)interval_s,
+           (unsigned)reports, reset ? ", reset half-way" : "");
+    printf("Logged: %u records, %u record bytes (%.1f B/record)\n", (unsigned)outage.appended,
+           (unsigned)outage.record_bytes, outage.appended ? (double)outage.record_bytes / outage.appended : 0.0);
+    printf("Flash: %u bytes programmed, %u erases, write amplification %.2f (%.2f with delivery markers)\n",
+           (unsigned)outage.programmed_bytes, (unsigned)total.erases,
+           outage.record_bytes ? (double)outage.programmed_bytes / outage.record_bytes : 0.0,
+           total.record_bytes ? (double)total.programmed_bytes / total.record_bytes : 0.0);
+    printf("Wear: %u..%u erases per sector over %u sectors, %.1f ms flash busy while logging\n",
+           (unsigned)min_erases, (unsigned)max_erases, (unsigned)SIM_SECTORS, outage_flash_us / 1000.0);
+    printf("Backfill: %u samples in %u frames, %.1f ms, %.0f samples/s (%.1f samples/frame)\n",
+           (unsigned)delivered, (unsigned)frames, backfill_us / 1000.0,
+           backfill_us ? delivered * 1e6 / backfill_us : 0.0, frames ? (double)delivered / frames : 0.0);
+    // The same report with its spread, as the live frame carries it
+    SensorData report;
+    sim_report(0, &report);
+    uint8_t spread_size = packet_batch_sample_size(&report);
+    report.spread_present = 0;
+    uint8_t logged_size = packet_batch_sample_size(&report);
+    uint32_t spread_per_frame = (RADIO_MAX_PAYLOAD - PACKET_BATCH_HEADER_SIZE) / spread_size;
+    uint32_t spread_frames = (delivered + spread_per_frame - 1) / spread_per_frame;
+    printf("Backfill frames: %u B per sample without spread, %u B with it: %u frames (%.1f samples/frame) "
+           "with the spread kept\n",
+           (unsigned)logged_size, (unsigned)spread_size, (unsigned)spread_frames,
+           spread_frames ? (double)delivered / spread_frames : 0.0);
+    printf("Lost: %u dropped (ring full), %u in RAM at the reset or on %u corrupt pages; "
+           "%u with unknown age, %u out of order\n",
+           (unsigned)total.dropped, (unsigned)(reports - delivered - total.dropped), (unsigned)total.read_errors,
+           (unsigned)unknown_age, (unsigned)out_of_order);
+    if (corrupt && total.read_errors != 2) {
+        printf("Expected 2 corrupt pages skipped\n");
+        return 1;
+    }
+    return 0;
+}
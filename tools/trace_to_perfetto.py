@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Convert a weather station trace dump to Chrome trace / Perfetto JSON.
+
+Reads the console output containing a 'trace,begin' ... 'trace,end' block
+(as printed by trace_dump(); other lines are ignored) and writes JSON that
+chrome://tracing and ui.perfetto.dev open directly.
+
+    tools/trace_to_perfetto.py console.log > trace.json
+
+Event IDs and argument meanings are defined in trace.h.
+"""
+import argparse
+import json
+import sys
+
+PHASE_BEGIN = 0x4000
+PHASE_END = 0x8000
+PHASE_MASK = 0xC000
+
+EVENTS = {
+    1: "i2c_write",
+    2: "i2c_read",
+    3: "spi_write",
+    4: "spi_read",
+    5: "sleep",
+    6: "cc1101_strobe",
+    7: "cc1101_state",
+    8: "cc1101_send",
+    9: "bmp280_read",
+    10: "ina219_read",
+    11: "sensor_cycle",
+    12: "i2c_recover",
+}
+CC1101_STATE_EVENT = 7
+
+CC1101_STATES = ["IDLE", "TX_LOAD", "TX_WAIT_SYNC", "TX_WAIT_END",
+                 "RX_WAIT_SYNC", "RX_WAIT_END", "RX_DRAIN"]
+
+CC1101_STROBES = {0x30: "SRES", 0x31: "SFSTXON", 0x32: "SXOFF", 0x33: "SCAL",
+                  0x34: "SRX", 0x35: "STX", 0x36: "SIDLE", 0x38: "SWOR",
+                  0x39: "SPWD", 0x3A: "SFRX", 0x3B: "SFTX", 0x3C: "SWORRST",
+                  0x3D: "SNOP"}
+
+RADIO_TID = 100  # Separate track for the CC1101 state timeline
+
+
+def read_records(lines):
+    records = []
+    inside = False
+    for line in lines:
+        line = line.strip()
+        if line == "trace,begin":
+            inside = True
+            records = []
+        elif line == "trace,end":
+            inside = False
+        elif inside and line.startswith("trace,"):
+            _, core, timestamp, event, arg = line.split(",")
+            records.append((int(core), int(timestamp), int(event), int(arg)))
+    return records
+
+
+def arg_fields(event_id, arg):
+    if event_id in (1, 2):
+        return {"address": "0x%02x" % (arg >> 8), "length": arg & 0xFF}
+    if event_id == 6:
+        return {"strobe": CC1101_STROBES.get(arg, "0x%02x" % arg)}
+    return {"arg": arg}
+
+
+def convert(records):
+    events = []
+    # The microsecond timer wraps every ~71 minutes; unwrap per core
+    base = {}
+    last = {}
+    radio_state = None
+
+    for core, timestamp, event, arg in sorted(records, key=lambda r: (r[0],)):
+        if core in last and timestamp < last[core]:
+            base[core] = base.get(core, 0) + (1 << 32)
+        last[core] = timestamp
+        ts = timestamp + base.get(core, 0)
+
+        event_id = event & ~PHASE_MASK
+        phase = event & PHASE_MASK
+        name = EVENTS.get(event_id, "event_%d" % event_id)
+
+        if event_id == CC1101_STATE_EVENT:
+            # Turn state changes into back-to-back slices on the radio track
+            if radio_state is not None:
+                events.append({"name": radio_state[1], "ph": "X", "ts": radio_state[0],
+                               "dur": max(ts - radio_state[0], 0), "pid": 0, "tid": RADIO_TID})
+            state = CC1101_STATES[arg] if arg < len(CC1101_STATES) else "STATE_%d" % arg
+            radio_state = (ts, state)
+            continue
+
+        entry = {"name": name, "ts": ts, "pid": 0, "tid": core}
+        if phase == PHASE_BEGIN:
+            entry["ph"] = "B"
+            entry["args"] = arg_fields(event_id, arg)
+        elif phase == PHASE_END:
+            entry["ph"] = "E"
+            entry["args"] = {"result": arg - 0x10000 if arg & 0x8000 else arg}
+        else:
+            entry["ph"] = "i"
+            entry["s"] = "t"
+            entry["args"] = arg_fields(event_id, arg)
+        events.append(entry)
+
+    metadata = [
+        {"name": "process_name", "ph": "M", "pid": 0, "args": {"name": "weather_station"}},
+        {"name": "thread_name", "ph": "M", "pid": 0, "tid": 0, "args": {"name": "core 0"}},
+        {"name": "thread_name", "ph": "M", "pid": 0, "tid": 1, "args": {"name": "core 1"}},
+        {"name": "thread_name", "ph": "M", "pid": 0, "tid": RADIO_TID, "args": {"name": "cc1101 state"}},
+    ]
+    return {"traceEvents": metadata + events}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", help="console capture (default: stdin)")
+    args = parser.parse_args()
+
+    with (open(args.input, errors="replace") if args.input else sys.stdin) as f:
+        records = read_records(f)
+    json.dump(convert(records), sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,54 @@
+#include "trace.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include <stdio.h>
+
+// Each core only writes its own ring, and the slot update runs with that
+// core's interrupts masked, so no lock is shared between the cores.
+
+typedef struct {
+    TraceRecord records[TRACE_RING_SIZE];
+    uint32_t head; // Total records written, the slot is head % TRACE_RING_SIZE
+} TraceRing;
+
+static TraceRing rings[2];
+static volatile bool trace_enabled = true;
+
+void trace_record(uint16_t event, uint16_t arg) {
+    if (!trace_enabled) {
+        return;
+    }
+    TraceRing* ring = &rings[get_core_num()];
+    uint32_t irq_state = save_and_disable_interrupts();
+    TraceRecord* record = &ring->records[ring->head & (TRACE_RING_SIZE - 1)];
+    ring->head++;
+    record->timestamp_us = time_us_32();
+    record->event = event;
+    record->arg = arg;
+    restore_interrupts(irq_state);
+}
+
+void trace_set_enabled(bool enabled) {
+    trace_enabled = enabled;
+}
+
+// Print both rings, oldest record first, as "trace,<core>,<us>,<event>,<arg>".
+// Tracing is paused while dumping so the rings hold still.
+void trace_dump(void) {
+    bool was_enabled = trace_enabled;
+    trace_enabled = false;
+
+    printf("trace,begin\n");
+    for (uint32_t core = 0; core < 2; core++) {
+        TraceRing* ring = &rings[core];
+        uint32_t count = ring->head < TRACE_RING_SIZE ? ring->head : TRACE_RING_SIZE;
+        for (uint32_t i = ring->head - count; i != ring->head; i++) {
+            const TraceRecord* record = &ring->records[i & (TRACE_RING_SIZE - 1)];
+            printf("trace,%lu,%lu,%u,%u\n", (unsigned long)core, (unsigned long)record->timestamp_us,
+                   record->event, record->arg);
+        }
+    }
+    printf("trace,end\n");
+
+    trace_enabled = was_enabled;
+}
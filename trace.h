@@ -0,0 +1,63 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Event trace: fixed-size timestamped records in one ring per core. A trace
+// point reads the timer, masks interrupts for the slot update and stores
+// 8 bytes, so it can stay enabled in production. The rings overwrite their
+// oldest records; trace_dump() prints what is left as CSV, which
+// tools/trace_to_perfetto.py turns into Chrome trace / Perfetto JSON.
+//
+// Build with -DTRACE_ENABLED=0 to compile every trace point out.
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#define TRACE_RING_SIZE 512 // Records per core, must be a power of two
+
+// Phase in the top two bits of TraceRecord.event
+#define TRACE_PHASE_INSTANT 0x0000
+#define TRACE_PHASE_BEGIN   0x4000
+#define TRACE_PHASE_END     0x8000
+#define TRACE_PHASE_MASK    0xC000
+
+// Event IDs, keep tools/trace_to_perfetto.py in sync
+typedef enum {
+    TRACE_I2C_WRITE = 1,    // arg: address << 8 | length
+    TRACE_I2C_READ,         // arg: address << 8 | length
+    TRACE_SPI_WRITE,        // arg: length
+    TRACE_SPI_READ,         // arg: length
+    TRACE_SLEEP,            // arg: requested ms, 0 for sleep_until
+    TRACE_CC1101_STROBE,    // arg: strobe command
+    TRACE_CC1101_STATE,     // arg: new CC1101State
+    TRACE_CC1101_SEND,      // arg: payload length
+    TRACE_BMP280_READ,      // arg: register
+    TRACE_INA219_READ,      // arg: register
+    TRACE_SENSOR_CYCLE,     // arg: none
+    TRACE_I2C_RECOVER,      // arg: bus index << 8 | SDA released
+} TraceEvent;
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint16_t event; // TraceEvent | TRACE_PHASE_*
+    uint16_t arg;
+} TraceRecord;
+
+void trace_record(uint16_t event, uint16_t arg);
+void trace_set_enabled(bool enabled);
+void trace_dump(void);
+
+#if TRACE_ENABLED
+#define TRACE_INSTANT(event, arg) trace_record((event) | TRACE_PHASE_INSTANT, (uint16_t)(arg))
+#define TRACE_BEGIN(event, arg)   trace_record((event) | TRACE_PHASE_BEGIN, (uint16_t)(arg))
+#define TRACE_END(event, arg)     trace_record((event) | TRACE_PHASE_END, (uint16_t)(arg))
+#else
+#define TRACE_INSTANT(event, arg) ((void)0)
+#define TRACE_BEGIN(event, arg)   ((void)0)
+#define TRACE_END(event, arg)     ((void)0)
+#endif
+
+#endif // TRACE_H
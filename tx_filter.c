@@ -0,0 +1,105 @@
+#include "tx_filter.h"
+#include <math.h>
+#include <string.h>
+
+// Per channel, in SensorData field order
+static const float tx_filter_deadbands[SENSOR_CH_COUNT] = {
+    [SENSOR_CH_TEMPERATURE]          = TX_FILTER_DEADBAND_TEMPERATURE,
+    [SENSOR_CH_PRESSURE]             = TX_FILTER_DEADBAND_PRESSURE,
+    [SENSOR_CH_EXTERIOR_TEMPERATURE] = TX_FILTER_DEADBAND_TEMPERATURE,
+    [SENSOR_CH_EXTERIOR_HUMIDITY]    = TX_FILTER_DEADBAND_HUMIDITY,
+    [SENSOR_CH_BATTERY_VOLTAGE]      = TX_FILTER_DEADBAND_VOLTAGE,
+    [SENSOR_CH_BATTERY_CURRENT]      = TX_FILTER_DEADBAND_CURRENT,
+    [SENSOR_CH_BATTERY_POWER]        = TX_FILTER_DEADBAND_POWER,
+    [SENSOR_CH_SOLAR_VOLTAGE]        = TX_FILTER_DEADBAND_VOLTAGE,
+    [SENSOR_CH_SOLAR_CURRENT]        = TX_FILTER_DEADBAND_CURRENT,
+    [SENSOR_CH_SOLAR_POWER]          = TX_FILTER_DEADBAND_POWER,
+    [SENSOR_CH_SAMPLE_INTERVAL]      = TX_FILTER_DEADBAND_INTERVAL,
+    [SENSOR_CH_TX_INTERVAL]          = TX_FILTER_DEADBAND_INTERVAL,
+};
+
+// The deadbands above in wire units (packet.c packet_schema), rounded at compile time
+#define TX_FILTER_WIRE(deadband, scale) ((int32_t)((deadband) * (scale) + 0.5f))
+
+static const int32_t tx_filter_deadbands_fixed[SENSOR_CH_COUNT] = {
+    [SENSOR_CH_TEMPERATURE]          = TX_FILTER_WIRE(TX_FILTER_DEADBAND_TEMPERATURE, 100.0f),
+    [SENSOR_CH_PRESSURE]             = TX_FILTER_WIRE(TX_FILTER_DEADBAND_PRESSURE, 10.0f),
+    [SENSOR_CH_EXTERIOR_TEMPERATURE] = TX_FILTER_WIRE(TX_FILTER_DEADBAND_TEMPERATURE, 100.0f),
+    [SENSOR_CH_EXTERIOR_HUMIDITY]    = TX_FILTER_WIRE(TX_FILTER_DEADBAND_HUMIDITY, 100.0f),
+    [SENSOR_CH_BATTERY_VOLTAGE]      = TX_FILTER_WIRE(TX_FILTER_DEADBAND_VOLTAGE, 1000.0f),
+    [SENSOR_CH_BATTERY_CURRENT]      = TX_FILTER_WIRE(TX_FILTER_DEADBAND_CURRENT, 10000.0f),
+    [SENSOR_CH_BATTERY_POWER]        = TX_FILTER_WIRE(TX_FILTER_DEADBAND_POWER, 1000.0f),
+    [SENSOR_CH_SOLAR_VOLTAGE]        = TX_FILTER_WIRE(TX_FILTER_DEADBAND_VOLTAGE, 1000.0f),
+    [SENSOR_CH_SOLAR_CURRENT]        = TX_FILTER_WIRE(TX_FILTER_DEADBAND_CURRENT, 10000.0f),
+    [SENSOR_CH_SOLAR_POWER]          = TX_FILTER_WIRE(TX_FILTER_DEADBAND_POWER, 1000.0f),
+    [SENSOR_CH_SAMPLE_INTERVAL]      = TX_FILTER_WIRE(TX_FILTER_DEADBAND_INTERVAL, 1.0f),
+    [SENSOR_CH_TX_INTERVAL]          = TX_FILTER_WIRE(TX_FILTER_DEADBAND_INTERVAL, 1.0f),
+};
+
+void tx_filter_init(TxFilter *filter) {
+    memset(filter, 0, sizeof(*filter));
+}
+
+static bool tx_filter_changed(const TxFilter *filter, const SensorData *data) {
+    if (data->present != filter->reference.present) {
+        return true;
+    }
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (!(data->present & SENSOR_BIT(ch))) {
+            continue;
+        }
+        float delta = fabsf(sensor_value(data, ch) - sensor_value(&filter->reference, ch));
+        if (tx_filter_deadbands[ch] == 0.0f ? delta != 0.0f : delta > tx_filter_deadbands[ch]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool tx_filter_changed_fixed(const TxFilter *filter, const SensorDataFixed *data) {
+    if (data->present != filter->reference_fixed.present) {
+        return true;
+    }
+    for (uint8_t ch = 0; ch < SENSOR_CH_COUNT; ch++) {
+        if (!(data->present & SENSOR_BIT(ch))) {
+            continue;
+        }
+        int64_t delta = (int64_t)sensor_fixed_value(data, ch) - sensor_fixed_value(&filter->reference_fixed, ch);
+        if (delta < 0) {
+            delta = -delta;
+        }
+        if (delta > tx_filter_deadbands_fixed[ch]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Counts the decision; on a send the caller stores the new reference
+static bool tx_filter_decide(TxFilter *filter, bool changed, uint64_t now_us) {
+    bool silent_too_long = now_us - filter->last_sent_us >= (uint64_t)TX_FILTER_MAX_SILENCE_MS * 1000;
+    if (filter->primed && !silent_too_long && !changed) {
+        filter->suppressed++;
+        return false;
+    }
+    filter->last_sent_us = now_us;
+    filter->primed = true;
+    filter->sent++;
+    return true;
+}
+
+bool tx_filter_check(TxFilter *filter, const SensorData *data, uint64_t now_us) {
+    if (!tx_filter_decide(filter, tx_filter_changed(filter, data), now_us)) {
+        return false;
+    }
+    filter->reference = *data;
+    return true;
+}
+
+bool tx_filter_check_fixed(TxFilter *filter, const SensorDataFixed *data, uint64_t now_us) {
+    if (!tx_filter_decide(filter, tx_filter_changed_fixed(filter, data), now_us)) {
+        return false;
+    }
+    filter->reference_fixed = *data;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef TX_FILTER_H
+#define TX_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensors.h"
+
+// Send-on-delta: a sample is transmitted only when a channel moved beyond its
+// deadband since the last transmitted sample, a channel appeared or
+// disappeared, or TX_FILTER_MAX_SILENCE_MS passed. Comparing against the last
+// transmitted value (not the last sample) lets slow drift through as well.
+
+// Deadbands in channel units, 0 transmits on any change
+#define TX_FILTER_DEADBAND_TEMPERATURE   0.2f   // DegC
+#define TX_FILTER_DEADBAND_PRESSURE      0.5f   // hPa
+#define TX_FILTER_DEADBAND_HUMIDITY      1.0f   // %RH
+#define TX_FILTER_DEADBAND_VOLTAGE       0.05f  // V
+#define TX_FILTER_DEADBAND_CURRENT       0.01f  // A
+#define TX_FILTER_DEADBAND_POWER         0.05f  // W
+#define TX_FILTER_DEADBAND_INTERVAL      0.0f   // s
+
+#define TX_FILTER_MAX_SILENCE_MS 600000
+
+typedef struct {
+    SensorData reference;   // Last transmitted sample
+    SensorDataFixed reference_fixed; // The same for tx_filter_check_fixed
+    uint64_t last_sent_us;
+    bool primed;            // False until the first sample went out
+    uint32_t sent;
+    uint32_t suppressed;
+} TxFilter;
+
+void tx_filter_init(TxFilter *filter);
+// Returns true if data should be transmitted, and then takes it as the new reference
+bool tx_filter_check(TxFilter *filter, const SensorData *data, uint64_t now_us);
+// The same on the integer pipeline, deadbands in wire units
+bool tx_filter_check_fixed(TxFilter *filter, const SensorDataFixed *data, uint64_t now_us);
+
+#endif // TX_FILTER_H